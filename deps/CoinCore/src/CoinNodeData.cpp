@@ -1497,6 +1497,8 @@ void Transaction::setSerialized(const uchar_vector& bytes)
 
     // lock time
     this->lockTime = vch_to_uint<uint32_t>(uchar_vector(bytes.begin() + pos, bytes.begin() + pos + 4), LITTLE_ENDIAN_);
+
+    resetSigHash();
 }
 
 string Transaction::toString() const
@@ -1587,67 +1589,247 @@ uchar_vector Transaction::getSigHash(uint32_t hashType, uint index, const uchar_
     if (index >= inputs.size())
         throw runtime_error("Index out of range.");
 
-    // TODO: Add other hashtype support
-    if (hashType != SIGHASH_ALL)
+    std::shared_ptr<const SigHasher> sigHasher = getSigHasher();
+    if (inputs[index].scriptWitness.isEmpty())
+        return sigHasher->getLegacySigHash(hashType, index, script);
+    else
+        return sigHasher->getWitnessV0SigHash(hashType, index, script, value);
+}
+
+std::shared_ptr<const SigHasher> Transaction::getSigHasher() const
+{
+    std::shared_ptr<const SigHasher> sigHasher = std::atomic_load(&sigHasher_);
+    if (!sigHasher)
+    {
+        // Threads that get here together each build one, all of them identical.
+        sigHasher = std::make_shared<SigHasher>(*this);
+        std::atomic_store(&sigHasher_, sigHasher);
+    }
+    return sigHasher;
+}
+
+void Transaction::resetSigHash()
+{
+    std::atomic_store(&sigHasher_, std::shared_ptr<const SigHasher>());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// class SigHasher implementation
+//
+namespace
+{
+    inline void sha256_update(SHA256_CTX& sha256, const uchar_vector& data)
+    {
+        if (!data.empty()) { SHA256_Update(&sha256, &data[0], data.size()); }
+    }
+
+    inline void sha256_update(SHA256_CTX& sha256, const uchar_vector& data, std::size_t begin, std::size_t end)
+    {
+        if (end > begin) { SHA256_Update(&sha256, &data[begin], end - begin); }
+    }
+
+    inline uchar_vector sha256_2_final(SHA256_CTX& sha256)
+    {
+        unsigned char hash[SHA256_DIGEST_LENGTH];
+        SHA256_Final(hash, &sha256);
+        SHA256_Init(&sha256);
+        SHA256_Update(&sha256, hash, SHA256_DIGEST_LENGTH);
+        SHA256_Final(hash, &sha256);
+        return uchar_vector(hash, SHA256_DIGEST_LENGTH);
+    }
+}
+
+SigHasher::SigHasher(const Transaction& tx)
+{
+    const std::size_t BLANK_TXIN_SIZE = MIN_OUT_POINT_SIZE + 1 + 4; // outpoint, empty script, sequence
+
+    blankTx_.reserve(8 + 2 * 9 + tx.inputs.size() * BLANK_TXIN_SIZE + tx.outputs.size() * 34);
+    blankTx_ += uint_to_vch(tx.version, LITTLE_ENDIAN_);
+    blankTx_ += VarInt(tx.inputs.size()).getSerialized();
+    for (auto& input: tx.inputs)
+    {
+        inputOffsets_.push_back(blankTx_.size());
+        hasWitness_.push_back(!input.scriptWitness.isEmpty());
+        blankTx_ += input.previousOut.getSerialized();
+        blankTx_.push_back(0x00);
+        blankTx_ += uint_to_vch(input.sequence, LITTLE_ENDIAN_);
+    }
+    outputsOffset_ = blankTx_.size();
+    blankTx_ += VarInt(tx.outputs.size()).getSerialized();
+    for (auto& output: tx.outputs)
+    {
+        outputOffsets_.push_back(blankTx_.size());
+        blankTx_ += output.getSerialized();
+    }
+    outputOffsets_.push_back(blankTx_.size());
+    blankTx_ += uint_to_vch(tx.lockTime, LITTLE_ENDIAN_);
+
+    // One pass over the blank transaction, saving the state as of the end of each outpoint.
+    SHA256_CTX sha256;
+    SHA256_Init(&sha256);
+    std::size_t hashed = 0;
+    midstates_.reserve(inputOffsets_.size());
+    for (auto offset: inputOffsets_)
+    {
+        std::size_t end = offset + MIN_OUT_POINT_SIZE;
+        SHA256_Update(&sha256, &blankTx_[hashed], end - hashed);
+        hashed = end;
+        midstates_.push_back(sha256);
+    }
+
+    // Witness v0 commitments
+    SHA256_CTX prevouts, sequence;
+    SHA256_Init(&prevouts);
+    SHA256_Init(&sequence);
+    for (auto offset: inputOffsets_)
+    {
+        SHA256_Update(&prevouts, &blankTx_[offset], MIN_OUT_POINT_SIZE);
+        SHA256_Update(&sequence, &blankTx_[offset + MIN_OUT_POINT_SIZE + 1], 4);
+    }
+    hashPrevouts_ = sha256_2_final(prevouts);
+    hashSequence_ = sha256_2_final(sequence);
+
+    SHA256_CTX outputs;
+    SHA256_Init(&outputs);
+    sha256_update(outputs, blankTx_, outputOffsets_.front(), outputOffsets_.back());
+    hashOutputs_ = sha256_2_final(outputs);
+}
+
+uchar_vector SigHasher::getSigHash(uint32_t hashType, uint index, const uchar_vector& script, uint64_t value) const
+{
+    if (index >= inputOffsets_.size())
+        throw runtime_error("Index out of range.");
+
+    return hasWitness_[index] ? getWitnessV0SigHash(hashType, index, script, value) : getLegacySigHash(hashType, index, script);
+}
+
+uchar_vector SigHasher::getLegacySigHash(uint32_t hashType, uint index, const uchar_vector& script) const
+{
+    if (index >= inputOffsets_.size())
+        throw runtime_error("Index out of range.");
+
+    uint32_t baseType = hashType & ~(uint32_t)SIGHASH_ANYONECANPAY;
+    if (baseType < SIGHASH_ALL || baseType > SIGHASH_SINGLE)
         throw runtime_error("Unsupported hash type.");
 
-    if (inputs[index].scriptWitness.isEmpty())
+    bool anyoneCanPay = hashType & SIGHASH_ANYONECANPAY;
+    std::size_t outputCount = outputOffsets_.size() - 1;
+
+    // The reference client signs the number one when there is no output to pair with.
+    if (baseType == SIGHASH_SINGLE && index >= outputCount)
     {
-        // Old sighash
-        Transaction copy(*this);
-        for (uint i = 0; i < copy.inputs.size(); i++)
-        {
-            if (index == i) { copy.inputs[i].scriptSig = script; }
-            else            { copy.inputs[i].scriptSig.clear();  }
-        }
-        return sha256_2(copy.getSerialized(false) + uint_to_vch(hashType, LITTLE_ENDIAN_));
+        uchar_vector one(32, 0);
+        one[0] = 0x01;
+        return one;
     }
 
-    if (hashPrevouts.empty())
+    if (baseType == SIGHASH_ALL && !anyoneCanPay)
     {
-        uchar_vector ss;
-        for (auto& input: inputs) { ss += input.previousOut.getSerialized(); }
-//        std::cout << "prevouts: " << ss.getHex() << std::endl;
-        hashPrevouts = sha256_2(ss);
+        SHA256_CTX sha256 = midstates_[index];
+        sha256_update(sha256, VarInt(script.size()).getSerialized());
+        sha256_update(sha256, script);
+
+        std::size_t rest = inputOffsets_[index] + MIN_OUT_POINT_SIZE + 1; // skip the empty script
+        sha256_update(sha256, blankTx_, rest, blankTx_.size());
+        sha256_update(sha256, uint_to_vch(hashType, LITTLE_ENDIAN_));
+        return sha256_2_final(sha256);
     }
 
-    if (hashSequence.empty())
+    // The other types leave out or blank parts of the transaction, so it is streamed piece by piece.
+    const unsigned char blankSequence[4] = { 0, 0, 0, 0 };
+    const unsigned char blankTxOut[9] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 }; // value -1, empty script
+
+    SHA256_CTX sha256;
+    SHA256_Init(&sha256);
+    sha256_update(sha256, blankTx_, 0, 4); // version
+
+    uint firstInput = anyoneCanPay ? index : 0;
+    uint endInput = anyoneCanPay ? index + 1 : inputOffsets_.size();
+    sha256_update(sha256, VarInt(endInput - firstInput).getSerialized());
+    for (uint i = firstInput; i < endInput; i++)
     {
-        uchar_vector ss;
-        for (auto& input: inputs) { ss += uint_to_vch(input.sequence, LITTLE_ENDIAN_); }
-//        std::cout << "sequence: " << ss.getHex() << std::endl;
-        hashSequence = sha256_2(ss);
+        std::size_t offset = inputOffsets_[i];
+        sha256_update(sha256, blankTx_, offset, offset + MIN_OUT_POINT_SIZE);
+        if (i == index)
+        {
+            sha256_update(sha256, VarInt(script.size()).getSerialized());
+            sha256_update(sha256, script);
+            sha256_update(sha256, blankTx_, offset + MIN_OUT_POINT_SIZE + 1, offset + MIN_OUT_POINT_SIZE + 5);
+        }
+        else
+        {
+            sha256_update(sha256, blankTx_, offset + MIN_OUT_POINT_SIZE, offset + MIN_OUT_POINT_SIZE + 1);
+            if (baseType == SIGHASH_ALL)    { sha256_update(sha256, blankTx_, offset + MIN_OUT_POINT_SIZE + 1, offset + MIN_OUT_POINT_SIZE + 5); }
+            else                            { SHA256_Update(&sha256, blankSequence, sizeof(blankSequence)); }
+        }
     }
 
-    if (hashOutputs.empty())
+    switch (baseType)
     {
-        uchar_vector ss;
-        for (auto& output: outputs) { ss += output.getSerialized(); }
-//        std::cout << "outputs: " << ss.getHex() << std::endl;
-        hashOutputs = sha256_2(ss);
-    }
-
-    uchar_vector ss;
-    ss += uint_to_vch(version, LITTLE_ENDIAN_);
-    ss += hashPrevouts;
-    ss += hashSequence;
-    ss += inputs[index].previousOut.getSerialized();
-    ss += VarInt(script.size()).getSerialized();
-    ss += script;
-    ss += uint_to_vch(value, LITTLE_ENDIAN_);
-    ss += uint_to_vch(inputs[index].sequence, LITTLE_ENDIAN_);
-    ss += hashOutputs;
-    ss += uint_to_vch(lockTime, LITTLE_ENDIAN_);
-    ss += uint_to_vch(hashType, LITTLE_ENDIAN_);
-//    std::cout << "data to hash: " << ss.getHex() << std::endl;
-    return sha256_2(ss);
+    case SIGHASH_ALL:
+        sha256_update(sha256, blankTx_, outputsOffset_, outputOffsets_.back());
+        break;
+
+    case SIGHASH_NONE:
+        sha256_update(sha256, VarInt(0).getSerialized());
+        break;
+
+    case SIGHASH_SINGLE:
+        sha256_update(sha256, VarInt(index + 1).getSerialized());
+        for (uint i = 0; i < index; i++) { SHA256_Update(&sha256, blankTxOut, sizeof(blankTxOut)); }
+        sha256_update(sha256, blankTx_, outputOffsets_[index], outputOffsets_[index + 1]);
+        break;
+    }
+
+    sha256_update(sha256, blankTx_, blankTx_.size() - 4, blankTx_.size()); // lock time
+    sha256_update(sha256, uint_to_vch(hashType, LITTLE_ENDIAN_));
+    return sha256_2_final(sha256);
 }
 
-void Transaction::resetSigHash()
+uchar_vector SigHasher::getWitnessV0SigHash(uint32_t hashType, uint index, const uchar_vector& script, uint64_t value) const
 {
-    hashPrevouts.clear();
-    hashSequence.clear();
-    hashOutputs.clear();
+    if (index >= inputOffsets_.size())
+        throw runtime_error("Index out of range.");
+
+    uint32_t baseType = hashType & ~(uint32_t)SIGHASH_ANYONECANPAY;
+    if (baseType < SIGHASH_ALL || baseType > SIGHASH_SINGLE)
+        throw runtime_error("Unsupported hash type.");
+
+    bool anyoneCanPay = hashType & SIGHASH_ANYONECANPAY;
+    std::size_t outputCount = outputOffsets_.size() - 1;
+    std::size_t offset = inputOffsets_[index];
+
+    // BIP143 commits to zeros in place of whatever the hash type leaves out.
+    uchar_vector hashSingleOutput;
+    const uchar_vector* hashOutputs = &g_zero32bytes;
+    if (baseType == SIGHASH_ALL)
+    {
+        hashOutputs = &hashOutputs_;
+    }
+    else if (baseType == SIGHASH_SINGLE && index < outputCount)
+    {
+        SHA256_CTX output;
+        SHA256_Init(&output);
+        sha256_update(output, blankTx_, outputOffsets_[index], outputOffsets_[index + 1]);
+        hashSingleOutput = sha256_2_final(output);
+        hashOutputs = &hashSingleOutput;
+    }
+
+    SHA256_CTX sha256;
+    SHA256_Init(&sha256);
+    sha256_update(sha256, blankTx_, 0, 4); // version
+    sha256_update(sha256, anyoneCanPay ? g_zero32bytes : hashPrevouts_);
+    sha256_update(sha256, (anyoneCanPay || baseType != SIGHASH_ALL) ? g_zero32bytes : hashSequence_);
+    sha256_update(sha256, blankTx_, offset, offset + MIN_OUT_POINT_SIZE);
+    sha256_update(sha256, VarInt(script.size()).getSerialized());
+    sha256_update(sha256, script);
+    sha256_update(sha256, uint_to_vch(value, LITTLE_ENDIAN_));
+    sha256_update(sha256, blankTx_, offset + MIN_OUT_POINT_SIZE + 1, offset + MIN_OUT_POINT_SIZE + 5); // sequence
+    sha256_update(sha256, *hashOutputs);
+    sha256_update(sha256, blankTx_, blankTx_.size() - 4, blankTx_.size()); // lock time
+    sha256_update(sha256, uint_to_vch(hashType, LITTLE_ENDIAN_));
+    return sha256_2_final(sha256);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -21,6 +21,7 @@
 
 #include <functional>
 #include <list>
+#include <memory>
 #include <queue>
 
 #include <stdio.h>
@@ -651,6 +652,8 @@ public:
     std::string toJson() const;
 };
 
+class SigHasher;
+
 class Transaction : public CoinNodeStructure
 {
 public:
@@ -701,22 +704,56 @@ public:
     void setScriptSig(uint index, const uchar_vector& scriptSig);
     void setScriptSig(uint index, const std::string& scriptSigHex);
 
-    void clearInputs() { inputs.clear(); }
-    void clearOutputs() { outputs.clear(); }
+    void clearInputs() { inputs.clear(); resetSigHash(); }
+    void clearOutputs() { outputs.clear(); resetSigHash(); }
 
-    void addInput(const TxIn& txin) { inputs.push_back(txin); }
-    void addOutput(const TxOut& txout) { outputs.push_back(txout); }
+    void addInput(const TxIn& txin) { inputs.push_back(txin); resetSigHash(); }
+    void addOutput(const TxOut& txout) { outputs.push_back(txout); resetSigHash(); }
 	
     uint64_t getTotalSent() const;
 
     uchar_vector getHashWithAppendedCode(uint32_t code) const; // in little endian
+
+    // The first call builds a SigHasher that later calls share, so each further input costs one
+    // SHA-256 pass over the blank transaction instead of a copy and reserialization. Call
+    // resetSigHash() after changing version, lockTime or any outpoint, sequence or output directly -
+    // the add and clear methods above and setSerialized() already do.
     uchar_vector getSigHash(uint32_t hashType, uint index, const uchar_vector& script, uint64_t value = 0) const;
+    std::shared_ptr<const SigHasher> getSigHasher() const;
     void resetSigHash();
 
 private:
-    mutable uchar_vector hashPrevouts;
-    mutable uchar_vector hashSequence;
-    mutable uchar_vector hashOutputs;
+    mutable std::shared_ptr<const SigHasher> sigHasher_; // only accessed with std::atomic_load and std::atomic_store
+};
+
+// Everything the signature hashes of a transaction have in common, computed once. Scripts and
+// witnesses of the inputs do not enter any signature hash, so it stays valid while signatures are
+// being added. Immutable once constructed, so it can be shared between threads.
+class SigHasher
+{
+public:
+    explicit SigHasher(const Transaction& tx);
+
+    // Chooses the legacy or witness v0 algorithm by whether the input had a witness when the
+    // SigHasher was built.
+    uchar_vector getSigHash(uint32_t hashType, uint index, const uchar_vector& script, uint64_t value = 0) const;
+
+    uchar_vector getLegacySigHash(uint32_t hashType, uint index, const uchar_vector& script) const;
+    uchar_vector getWitnessV0SigHash(uint32_t hashType, uint index, const uchar_vector& script, uint64_t value) const;
+
+private:
+    // The legacy serialization with every scriptSig empty. Hashing input i streams the state saved
+    // right after its outpoint, then its script, then everything from its sequence on.
+    uchar_vector blankTx_;
+    std::vector<std::size_t> inputOffsets_;
+    std::vector<SHA256_CTX> midstates_;
+    std::vector<bool> hasWitness_;
+    std::size_t outputsOffset_;                 // of the output count
+    std::vector<std::size_t> outputOffsets_;    // of each output, then of the lock time
+
+    uchar_vector hashPrevouts_;
+    uchar_vector hashSequence_;
+    uchar_vector hashOutputs_;
 };
 
 class CoinBlock;
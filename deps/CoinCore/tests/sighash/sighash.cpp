@@ -0,0 +1,229 @@
+#include <CoinNodeData.h>
+#include <hash.h>
+#include <numericdata.h>
+
+#include <iostream>
+#include <random>
+
+using namespace Coin;
+using namespace std;
+
+// Checks SigHasher against straightforward implementations that copy and reserialize the
+// transaction for every hash, the way getSigHash used to.
+
+const uint32_t HASH_TYPES[] =
+{
+    SIGHASH_ALL,
+    SIGHASH_NONE,
+    SIGHASH_SINGLE,
+    SIGHASH_ALL | SIGHASH_ANYONECANPAY,
+    SIGHASH_NONE | SIGHASH_ANYONECANPAY,
+    SIGHASH_SINGLE | SIGHASH_ANYONECANPAY
+};
+
+mt19937 rng(20161018);
+
+uchar_vector randomBytes(size_t size)
+{
+    uchar_vector bytes(size);
+    for (auto& byte: bytes) { byte = rng() & 0xff; }
+    return bytes;
+}
+
+uchar_vector randomScript()
+{
+    // Now and then long enough to need a multibyte length prefix.
+    return randomBytes(rng() % 8 == 0 ? 253 + rng() % 100 : rng() % 80);
+}
+
+Transaction randomTransaction(size_t inputCount, size_t outputCount, bool withWitness)
+{
+    Transaction tx;
+    tx.version = rng() % 3;
+    tx.lockTime = rng() % 2 ? 0 : rng();
+    for (size_t i = 0; i < inputCount; i++)
+    {
+        TxIn txin(OutPoint(randomBytes(32), rng() % 5), randomScript(), rng() % 2 ? 0xffffffff : rng());
+        if (withWitness && rng() % 2)
+        {
+            txin.scriptWitness.push(randomBytes(72));
+            txin.scriptWitness.push(randomBytes(33));
+        }
+        tx.addInput(txin);
+    }
+    for (size_t i = 0; i < outputCount; i++)
+    {
+        tx.addOutput(TxOut(((uint64_t)rng() << 16) | (rng() & 0xffff), randomScript()));
+    }
+    return tx;
+}
+
+uchar_vector referenceLegacySigHash(const Transaction& tx, uint32_t hashType, uint index, const uchar_vector& script)
+{
+    uint32_t baseType = hashType & ~(uint32_t)SIGHASH_ANYONECANPAY;
+    if (baseType == SIGHASH_SINGLE && index >= tx.outputs.size())
+    {
+        uchar_vector one(32, 0);
+        one[0] = 0x01;
+        return one;
+    }
+
+    Transaction copy(tx);
+    for (uint i = 0; i < copy.inputs.size(); i++)
+    {
+        if (i == index) { copy.inputs[i].scriptSig = script; continue; }
+
+        copy.inputs[i].scriptSig.clear();
+        if (baseType != SIGHASH_ALL) { copy.inputs[i].sequence = 0; }
+    }
+
+    if (baseType == SIGHASH_NONE)
+    {
+        copy.outputs.clear();
+    }
+    else if (baseType == SIGHASH_SINGLE)
+    {
+        copy.outputs.erase(copy.outputs.begin() + index + 1, copy.outputs.end());
+        for (uint i = 0; i < index; i++) { copy.outputs[i] = TxOut(0xffffffffffffffffull, uchar_vector()); }
+    }
+
+    if (hashType & SIGHASH_ANYONECANPAY)
+    {
+        TxIn txin = copy.inputs[index];
+        copy.inputs.clear();
+        copy.inputs.push_back(txin);
+    }
+
+    return sha256_2(copy.getSerialized(false) + uint_to_vch(hashType, LITTLE_ENDIAN_));
+}
+
+uchar_vector referenceWitnessV0SigHash(const Transaction& tx, uint32_t hashType, uint index, const uchar_vector& script, uint64_t value)
+{
+    uint32_t baseType = hashType & ~(uint32_t)SIGHASH_ANYONECANPAY;
+    bool anyoneCanPay = hashType & SIGHASH_ANYONECANPAY;
+
+    uchar_vector hashPrevouts = g_zero32bytes;
+    if (!anyoneCanPay)
+    {
+        uchar_vector ss;
+        for (auto& input: tx.inputs) { ss += input.previousOut.getSerialized(); }
+        hashPrevouts = sha256_2(ss);
+    }
+
+    uchar_vector hashSequence = g_zero32bytes;
+    if (!anyoneCanPay && baseType == SIGHASH_ALL)
+    {
+        uchar_vector ss;
+        for (auto& input: tx.inputs) { ss += uint_to_vch(input.sequence, LITTLE_ENDIAN_); }
+        hashSequence = sha256_2(ss);
+    }
+
+    uchar_vector hashOutputs = g_zero32bytes;
+    if (baseType == SIGHASH_ALL)
+    {
+        uchar_vector ss;
+        for (auto& output: tx.outputs) { ss += output.getSerialized(); }
+        hashOutputs = sha256_2(ss);
+    }
+    else if (baseType == SIGHASH_SINGLE && index < tx.outputs.size())
+    {
+        hashOutputs = sha256_2(tx.outputs[index].getSerialized());
+    }
+
+    uchar_vector ss;
+    ss += uint_to_vch(tx.version, LITTLE_ENDIAN_);
+    ss += hashPrevouts;
+    ss += hashSequence;
+    ss += tx.inputs[index].previousOut.getSerialized();
+    ss += VarInt(script.size()).getSerialized();
+    ss += script;
+    ss += uint_to_vch(value, LITTLE_ENDIAN_);
+    ss += uint_to_vch(tx.inputs[index].sequence, LITTLE_ENDIAN_);
+    ss += hashOutputs;
+    ss += uint_to_vch(tx.lockTime, LITTLE_ENDIAN_);
+    ss += uint_to_vch(hashType, LITTLE_ENDIAN_);
+    return sha256_2(ss);
+}
+
+int failures = 0;
+int checks = 0;
+
+void check(const string& what, const uchar_vector& actual, const uchar_vector& expected)
+{
+    checks++;
+    if (actual == expected) return;
+
+    failures++;
+    cout << what << ": " << actual.getHex() << " != " << expected.getHex() << endl;
+}
+
+void checkTransaction(const string& name, const Transaction& tx)
+{
+    SigHasher sigHasher(tx);
+    for (uint i = 0; i < tx.inputs.size(); i++)
+    {
+        for (auto hashType: HASH_TYPES)
+        {
+            string what = name + " input " + to_string(i) + " hash type " + to_string(hashType);
+            uchar_vector script = randomScript();
+            uint64_t value = ((uint64_t)rng() << 32) | rng();
+
+            uchar_vector legacy = referenceLegacySigHash(tx, hashType, i, script);
+            uchar_vector witness = referenceWitnessV0SigHash(tx, hashType, i, script, value);
+            check(what + " legacy", sigHasher.getLegacySigHash(hashType, i, script), legacy);
+            check(what + " witness v0", sigHasher.getWitnessV0SigHash(hashType, i, script, value), witness);
+            check(what + " transaction", tx.getSigHash(hashType, i, script, value), tx.inputs[i].hasWitness() ? witness : legacy);
+        }
+    }
+}
+
+int main()
+{
+    try
+    {
+        // Legacy and witness inputs mixed, with fewer, as many and more outputs than inputs so that
+        // SIGHASH_SINGLE also gets input indices past the last output.
+        for (int i = 0; i < 50; i++)
+        {
+            size_t inputCount = 1 + rng() % 8;
+            size_t outputCount = rng() % 10;
+            checkTransaction("mixed " + to_string(i), randomTransaction(inputCount, outputCount, true));
+        }
+
+        checkTransaction("legacy only", randomTransaction(5, 5, false));
+        checkTransaction("no outputs", randomTransaction(3, 0, true));
+        checkTransaction("single output", randomTransaction(4, 1, true));
+
+        // Enough inputs for the input count to need a multibyte length prefix.
+        checkTransaction("many inputs", randomTransaction(300, 3, true));
+
+        // A SigHasher stays valid while signatures are added.
+        Transaction tx = randomTransaction(4, 2, true);
+        SigHasher sigHasher(tx);
+        uchar_vector script = randomScript();
+        uchar_vector before = sigHasher.getLegacySigHash(SIGHASH_ALL, 1, script);
+        tx.setScriptSig(0, randomScript());
+        tx.inputs[2].scriptWitness.push(randomBytes(72));
+        check("scripts changed", SigHasher(tx).getLegacySigHash(SIGHASH_ALL, 1, script), before);
+
+        for (uint32_t hashType: { 0x00u, 0x04u, 0x21u, 0x84u })
+        {
+            checks++;
+            try
+            {
+                sigHasher.getLegacySigHash(hashType, 0, script);
+                cout << "hash type " << hashType << " was not rejected." << endl;
+                failures++;
+            }
+            catch (const runtime_error&) { }
+        }
+    }
+    catch (const exception& e)
+    {
+        cout << "Exception: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << checks - failures << " of " << checks << " checks passed." << endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,298 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinSelection.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#include "CoinSelection.h"
+
+#include <algorithm>
+#include <random>
+
+using namespace CoinDB;
+
+// DER signatures are at most 72 bytes, plus the sighash type.
+const std::size_t MAX_SIGNATURE_SIZE = 73;
+
+static std::size_t varIntSize(uint64_t n)
+{
+    if (n < 0xfd)           return 1;
+    if (n <= 0xffff)        return 3;
+    if (n <= 0xffffffff)    return 5;
+    return 9;
+}
+
+static std::size_t pushSize(std::size_t n)
+{
+    if (n < 0x4c)           return 1 + n;
+    if (n <= 0xff)          return 2 + n;
+    if (n <= 0xffff)        return 3 + n;
+    return 5 + n;
+}
+
+// Bounds the knapsack search to about this many coin visits however many coins there are.
+const uint64_t KNAPSACK_WORK_LIMIT = 1000000;
+
+CoinSelector::CoinSelector(const std::vector<uint64_t>& values, uint64_t fee_per_input) : values_(values)
+{
+    effective_values_.reserve(values_.size());
+    for (auto value: values_) { effective_values_.push_back(value > fee_per_input ? value - fee_per_input : 0); }
+}
+
+uint64_t CoinSelector::total() const
+{
+    uint64_t total = 0;
+    for (auto value: values_) { total += value; }
+    return total;
+}
+
+uint64_t CoinSelector::total(const selection_t& selection) const
+{
+    uint64_t total = 0;
+    for (auto i: selection) { total += values_[i]; }
+    return total;
+}
+
+bool CoinSelector::branchAndBound(uint64_t target, uint64_t cost_of_change, selection_t& selection, std::size_t max_tries) const
+{
+    const std::vector<uint64_t>& values = effective_values_;
+
+    // Coins worth nothing after fees are all at the end.
+    std::size_t count = 0;
+    uint64_t available = 0;
+    while (count < values.size() && values[count] > 0) { available += values[count++]; }
+    if (available < target) return false;
+
+    selection_t current;
+    uint64_t current_value = 0;
+    selection_t best;
+    uint64_t best_excess = cost_of_change + 1;
+
+    // Each step either includes coin i or backtracks to the last included coin and moves on to
+    // the branch without it. available is what the coins after the current one could still add.
+    std::size_t i = 0;
+    for (std::size_t tries = 0; tries < max_tries; tries++, i++)
+    {
+        bool backtrack = false;
+        if (current_value + available < target || current_value > target + cost_of_change)
+        {
+            backtrack = true;
+        }
+        else if (current_value >= target)
+        {
+            if (current_value - target < best_excess)
+            {
+                best = current;
+                best_excess = current_value - target;
+                if (best_excess == 0) break;
+            }
+            backtrack = true;
+        }
+
+        if (backtrack)
+        {
+            if (current.empty()) break; // the whole tree has been searched
+
+            for (i--; i > current.back(); i--) { available += values[i]; }
+            current_value -= values[i];
+            current.pop_back();
+        }
+        else
+        {
+            available -= values[i];
+
+            // Leaving out a coin and then taking one of the same value leads to selections already tried.
+            if (current.empty() || i - 1 == current.back() || values[i] != values[i - 1])
+            {
+                current.push_back(i);
+                current_value += values[i];
+            }
+        }
+    }
+
+    if (best.empty()) return false;
+    selection.swap(best);
+    return true;
+}
+
+bool CoinSelector::knapsack(uint64_t target, uint64_t min_change, selection_t& selection, unsigned int iterations) const
+{
+    const std::vector<uint64_t>& values = effective_values_;
+
+    selection_t lesser;
+    uint64_t lesser_total = 0;
+    bool have_larger = false;
+    std::size_t lowest_larger = 0;
+    for (std::size_t i = 0; i < values.size() && values[i] > 0; i++)
+    {
+        if (values[i] == target)
+        {
+            selection.assign(1, i);
+            return true;
+        }
+        else if (values[i] < target + min_change)
+        {
+            lesser.push_back(i);
+            lesser_total += values[i];
+        }
+        else
+        {
+            // Values are sorted largest first, so the last one seen is the lowest.
+            have_larger = true;
+            lowest_larger = i;
+        }
+    }
+
+    if (lesser_total == target)
+    {
+        selection.swap(lesser);
+        return true;
+    }
+
+    if (lesser_total < target)
+    {
+        if (!have_larger) return false;
+        selection.assign(1, lowest_larger);
+        return true;
+    }
+
+    uint64_t max_iterations = std::max<uint64_t>(1, KNAPSACK_WORK_LIMIT / lesser.size());
+    if (iterations > max_iterations) { iterations = (unsigned int)max_iterations; }
+
+    std::random_device seed;
+    std::mt19937 rng(seed());
+
+    // Random subsets of the lesser coins, each tried in two passes: the first takes each coin with
+    // probability 1/2 and the second adds the ones left out. A coin that reaches the target is
+    // recorded and taken back out, so the pass goes on looking for a smaller total.
+    auto approximate = [&](uint64_t subset_target, std::vector<bool>& best_included) {
+        best_included.assign(lesser.size(), true);
+        uint64_t best_total = lesser_total;
+
+        std::vector<bool> included;
+        for (unsigned int n = 0; n < iterations && best_total != subset_target; n++)
+        {
+            included.assign(lesser.size(), false);
+            uint64_t subset_total = 0;
+            bool reached_target = false;
+            for (int pass = 0; pass < 2 && !reached_target; pass++)
+            {
+                for (std::size_t k = 0; k < lesser.size(); k++)
+                {
+                    if (pass == 0 ? (rng() & 1) : !included[k])
+                    {
+                        subset_total += values[lesser[k]];
+                        included[k] = true;
+                        if (subset_total >= subset_target)
+                        {
+                            reached_target = true;
+                            if (subset_total < best_total)
+                            {
+                                best_total = subset_total;
+                                best_included = included;
+                            }
+                            subset_total -= values[lesser[k]];
+                            included[k] = false;
+                        }
+                    }
+                }
+            }
+        }
+        return best_total;
+    };
+
+    std::vector<bool> best_included;
+    uint64_t best_total = approximate(target, best_included);
+    if (best_total != target && lesser_total >= target + min_change)
+    {
+        best_total = approximate(target + min_change, best_included);
+    }
+
+    // The single larger coin wins if the subset would leave change too small to keep, or if it is closer.
+    if (have_larger && ((best_total != target && best_total < target + min_change) || values[lowest_larger] <= best_total))
+    {
+        selection.assign(1, lowest_larger);
+        return true;
+    }
+
+    selection.clear();
+    for (std::size_t k = 0; k < lesser.size(); k++)
+    {
+        if (best_included[k]) { selection.push_back(lesser[k]); }
+    }
+    return true;
+}
+
+bool CoinSelector::largestFirst(uint64_t target, selection_t& selection) const
+{
+    selection_t chosen;
+    uint64_t chosen_value = 0;
+    for (std::size_t i = 0; i < effective_values_.size() && effective_values_[i] > 0; i++)
+    {
+        chosen.push_back(i);
+        chosen_value += effective_values_[i];
+        if (chosen_value >= target)
+        {
+            selection.swap(chosen);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*
+ * class TxSizeModel
+ */
+std::size_t TxSizeModel::txinSize(std::size_t redeemscript_size) const
+{
+    // outpoint and sequence
+    std::size_t size = 36 + 4;
+
+    if (use_witness_)
+    {
+        // P2SH wrapped inputs push the 34 byte witness program, native ones have an empty script.
+        std::size_t script_size = use_witness_p2sh_ ? pushSize(34) : 0;
+        size += varIntSize(script_size) + script_size;
+
+        // The witness stack has an empty item for CHECKMULTISIG, the signatures and the redeem script.
+        size += varIntSize(minsigs_ + 2) + 1;
+        size += minsigs_ * (varIntSize(MAX_SIGNATURE_SIZE) + MAX_SIGNATURE_SIZE);
+        size += varIntSize(redeemscript_size) + redeemscript_size;
+    }
+    else
+    {
+        // OP_0, the signatures and the redeem script.
+        std::size_t script_size = 1 + minsigs_ * pushSize(MAX_SIGNATURE_SIZE) + pushSize(redeemscript_size);
+        size += varIntSize(script_size) + script_size;
+    }
+
+    return size;
+}
+
+std::size_t TxSizeModel::txoutSize(std::size_t script_size) const
+{
+    return 8 + varIntSize(script_size) + script_size;
+}
+
+std::size_t TxSizeModel::overheadSize(std::size_t txin_count, std::size_t txout_count) const
+{
+    // version, counts, locktime and the segwit marker and flag
+    return 4 + varIntSize(txin_count) + varIntSize(txout_count) + 4 + (use_witness_ ? 2 : 0);
+}
+
+std::size_t TxSizeModel::changeScriptSize() const
+{
+    // OP_0 and a 32 byte script hash for native witness outputs, P2SH otherwise.
+    return (use_witness_ && !use_witness_p2sh_) ? 34 : 23;
+}
+
+std::size_t TxSizeModel::multisigRedeemscriptSize(std::size_t pubkey_count, bool compressed_keys)
+{
+    // OP_m, the pubkeys, OP_n and OP_CHECKMULTISIG
+    return 3 + pubkey_count * pushSize(compressed_keys ? 33 : 65);
+}
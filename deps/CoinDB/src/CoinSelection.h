@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinSelection.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+// Chooses which unspent outputs to spend. The selector only sees values, given largest first, and
+// returns positions in that list, so it can work from a view that holds nothing but ids and values.
+// The size model estimates how big the txs spending them will be.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace CoinDB
+{
+
+// Change smaller than this is not worth an output of its own.
+const uint64_t MIN_CHANGE = 5460;
+
+// Larger txs are not relayed by default.
+const std::size_t MAX_STANDARD_TX_SIZE = 100000;
+
+class CoinSelector
+{
+public:
+    typedef std::vector<std::size_t> selection_t;
+
+    // values must be sorted largest first. fee_per_input is what spending one coin adds to the fee -
+    // strategies compare coins by their value less this, and coins worth no more than it are never chosen.
+    explicit CoinSelector(const std::vector<uint64_t>& values, uint64_t fee_per_input = 0);
+
+    std::size_t size() const { return values_.size(); }
+    uint64_t total() const;
+    uint64_t total(const selection_t& selection) const;
+
+    // Each strategy fills selection with coins whose effective values add up to at least target and
+    // returns false if it finds none.
+
+    // Depth-first search for coins that overshoot target by no more than cost_of_change, so the tx
+    // needs no change output. Gives up after max_tries steps and returns the closest match found.
+    bool branchAndBound(uint64_t target, uint64_t cost_of_change, selection_t& selection, std::size_t max_tries = 100000) const;
+
+    // An exact match if there is one. Otherwise the smaller of the smallest coin leaving at least
+    // min_change and a random approximation of the smallest subset of lesser coins doing so.
+    bool knapsack(uint64_t target, uint64_t min_change, selection_t& selection, unsigned int iterations = 1000) const;
+
+    // The largest coins, fewest inputs.
+    bool largestFirst(uint64_t target, selection_t& selection) const;
+
+private:
+    std::vector<uint64_t> values_;
+    std::vector<uint64_t> effective_values_;
+};
+
+// Serialized sizes, witness data included, of the txs an account builds once they are fully signed.
+// Worked out from the script types, so a tx does not need to be built to know how big it will be.
+class TxSizeModel
+{
+public:
+    TxSizeModel(unsigned int minsigs, bool use_witness, bool use_witness_p2sh) : minsigs_(minsigs), use_witness_(use_witness), use_witness_p2sh_(use_witness_p2sh) { }
+
+    std::size_t txinSize(std::size_t redeemscript_size) const;
+    std::size_t txoutSize(std::size_t script_size) const;
+    std::size_t overheadSize(std::size_t txin_count, std::size_t txout_count) const; // everything but the txins and txouts
+
+    std::size_t changeScriptSize() const; // the account's own output scripts
+    static std::size_t multisigRedeemscriptSize(std::size_t pubkey_count, bool compressed_keys = true);
+
+private:
+    unsigned int minsigs_;
+    bool use_witness_;
+    bool use_witness_p2sh_;
+};
+
+}
@@ -1031,6 +1031,8 @@ void Tx::set(uint32_t version, const txins_t& txins, const txouts_t& txouts, uin
 
     conflicting_ = conflicting;
 
+    setRaw(coin_tx);
+
     coin_tx.clearScriptSigs();
     unsigned_hash_ = coin_tx.hash();
     updateTotals();
@@ -1048,6 +1050,8 @@ void Tx::set(Coin::Transaction coin_tx, uint32_t timestamp, status_t status, boo
 
     conflicting_ = conflicting;
 
+    setRaw(coin_tx);
+
     coin_tx.clearScriptSigs();
     unsigned_hash_ = coin_tx.hash();
     updateTotals();
@@ -1064,6 +1068,8 @@ void Tx::set(const bytes_t& raw, uint32_t timestamp, status_t status, bool confl
 
     conflicting_ = conflicting;
 
+    setRaw(coin_tx);
+
     coin_tx.clearScriptSigs();
     unsigned_hash_ = coin_tx.hash();
     updateTotals();
@@ -1141,7 +1147,21 @@ void Tx::blockheader(std::shared_ptr<BlockHeader> blockheader)
 
 bytes_t Tx::raw(bool withWitness) const
 {
-    return toCoinCore().getSerialized(withWitness);
+    // Rows from before schema 23 have nothing stored yet.
+    if (raw_.empty()) return toCoinCore().getSerialized(withWitness);
+    return withWitness || raw_nowitness_.empty() ? raw_ : raw_nowitness_;
+}
+
+void Tx::updateRaw()
+{
+    setRaw(toCoinCore());
+}
+
+void Tx::setRaw(const Coin::Transaction& coin_tx)
+{
+    raw_ = coin_tx.getSerialized(true);
+    raw_nowitness_ = coin_tx.getSerialized(false);
+    if (raw_nowitness_ == raw_) { raw_nowitness_.clear(); }
 }
 
 void Tx::updateTotals()
@@ -1173,6 +1193,7 @@ void Tx::shuffle_txins()
     int i = 0;
     std::random_shuffle(txins_.begin(), txins_.end());
     for (auto& txin: txins_) { txin->txindex(i++); }
+    updateRaw();
 }
 
 void Tx::shuffle_txouts()
@@ -1180,6 +1201,7 @@ void Tx::shuffle_txouts()
     int i = 0;
     std::random_shuffle(txouts_.begin(), txouts_.end());
     for (auto& txout: txouts_) { txout->txindex(i++); }
+    updateRaw();
 }
 
 void Tx::fromCoinCore(const Coin::Transaction& coin_tx)
@@ -1218,46 +1240,17 @@ void Tx::fromCoinCore(const Coin::Transaction& coin_tx)
 unsigned int Tx::missingSigCount() const
 {
     // Assume for now all inputs belong to the same account.
-    using namespace CoinQ::Script;
-    unsigned int count = 0;
-    Coin::Transaction cointx(toCoinCore());
-    for (auto& txin: txins_)
-    {
-        uint64_t outpointvalue = txin->outpoint() ? txin->outpoint()->value() : 0;
-        SignableTxIn signabletxin(cointx, txin->txindex(), outpointvalue);
-        unsigned int sigsneeded = signabletxin.sigsneeded();
-        if (sigsneeded > count) count = sigsneeded;
-    }
-    return count;
+    return TxSignatureState(*this).missingSigCount();
 }
 
 std::set<bytes_t> Tx::missingSigPubkeys() const
 {
-    using namespace CoinQ::Script;
-    std::set<bytes_t> pubkeys;
-    Coin::Transaction cointx = toCoinCore();
-    for (auto& txin: txins_)
-    {
-        uint64_t outpointvalue = txin->outpoint() ? txin->outpoint()->value() : 0;
-        SignableTxIn signabletxin(cointx, txin->txindex(), outpointvalue);
-        std::vector<bytes_t> txinpubkeys = signabletxin.missingsigs();
-        for (auto& txinpubkey: txinpubkeys) { pubkeys.insert(txinpubkey); }
-    } 
-    return pubkeys;
+    return TxSignatureState(*this).missingSigPubkeys();
 }
 
 std::set<bytes_t> Tx::presentSigPubkeys() const
 {
-    std::set<bytes_t> pubkeys;
-
-    using namespace CoinQ::Script;
-    Signer signer_(signer());
-    for (auto& signabletxin: signer_.getSignableTxIns())
-    {
-        std::vector<bytes_t> txinpubkeys = signabletxin.presentsigs();
-        for (auto& txinpubkey: txinpubkeys) { pubkeys.insert(txinpubkey); }
-    } 
-    return pubkeys;
+    return TxSignatureState(*this).presentSigPubkeys();
 }
 
 CoinQ::Script::Signer Tx::signer() const
@@ -1334,3 +1327,95 @@ void Tx::fromSerialized(const std::string& serialized)
     ia >> *this;
 }
 
+
+/*
+ * class TxSignatureState
+ */
+TxSignatureState::TxSignatureState(const Tx& tx) : cointx_(tx.toCoinCore())
+{
+    std::vector<uint64_t> outpointvalues;
+    for (auto& txin: tx.txins()) { outpointvalues.push_back(txin->outpoint() ? txin->outpoint()->value() : 0); }
+    parse(outpointvalues);
+}
+
+TxSignatureState::TxSignatureState(const Coin::Transaction& cointx, const std::vector<uint64_t>& outpointvalues) : cointx_(cointx)
+{
+    if (outpointvalues.size() != cointx_.inputs.size()) throw std::runtime_error("TxSignatureState - wrong number of outpoint values.");
+    parse(outpointvalues);
+}
+
+void TxSignatureState::parse(const std::vector<uint64_t>& outpointvalues)
+{
+    using namespace CoinQ::Script;
+
+    for (uint64_t outpointvalue: outpointvalues)
+    {
+        try
+        {
+            signabletxins_.push_back(std::make_shared<SignableTxIn>(cointx_, signabletxins_.size(), outpointvalue));
+            errors_.push_back(std::string());
+        }
+        catch (const std::exception& e)
+        {
+            signabletxins_.push_back(nullptr);
+            errors_.push_back(e.what());
+        }
+    }
+}
+
+const CoinQ::Script::SignableTxIn& TxSignatureState::signabletxin(std::size_t i) const
+{
+    if (!parsed(i)) throw std::runtime_error(errors_[i]);
+    return *signabletxins_[i];
+}
+
+bytes_t TxSignatureState::unsigned_script(std::size_t i) const
+{
+    CoinQ::Script::SignableTxIn signabletxin(this->signabletxin(i));
+    signabletxin.clearsigs();
+    return signabletxin.txinscript();
+}
+
+unsigned int TxSignatureState::missingSigCount() const
+{
+    checkParsed();
+    unsigned int count = 0;
+    for (auto& signabletxin: signabletxins_)
+    {
+        unsigned int sigsneeded = signabletxin->sigsneeded();
+        if (sigsneeded > count) count = sigsneeded;
+    }
+    return count;
+}
+
+std::set<bytes_t> TxSignatureState::missingSigPubkeys() const
+{
+    checkParsed();
+    std::set<bytes_t> pubkeys;
+    for (auto& signabletxin: signabletxins_)
+    {
+        std::vector<bytes_t> txinpubkeys = signabletxin->missingsigs();
+        pubkeys.insert(txinpubkeys.begin(), txinpubkeys.end());
+    }
+    return pubkeys;
+}
+
+std::set<bytes_t> TxSignatureState::presentSigPubkeys() const
+{
+    checkParsed();
+    std::set<bytes_t> pubkeys;
+    for (auto& signabletxin: signabletxins_)
+    {
+        std::vector<bytes_t> txinpubkeys = signabletxin->presentsigs();
+        pubkeys.insert(txinpubkeys.begin(), txinpubkeys.end());
+    }
+    return pubkeys;
+}
+
+void TxSignatureState::checkParsed() const
+{
+    for (std::size_t i = 0; i < signabletxins_.size(); i++)
+    {
+        if (!signabletxins_[i]) throw std::runtime_error(errors_[i]);
+    }
+}
@@ -57,7 +57,7 @@ typedef odb::nullable<unsigned long> null_id_t;
 ////////////////////
 
 #define SCHEMA_BASE_VERSION 12
-#define SCHEMA_VERSION      22
+#define SCHEMA_VERSION      26
 
 #ifdef ODB_COMPILER
 #pragma db model version(SCHEMA_BASE_VERSION, SCHEMA_VERSION, open)
@@ -1042,6 +1042,9 @@ private:
         id_column("object_id") value_column("value")
     std::vector<bytes_t> hashes_;
 
+    // Confirming a tx looks up the merkle block that contains its hash.
+    #pragma db index member(hashes_.value)
+
     bytes_t flags_;
 
     bool txsinserted_;
@@ -1301,6 +1304,9 @@ private:
     // Redundant but convenient for view queries.
     status_t status_;
 
+    // Coin selection reads an account's unspent txouts in order of value.
+    #pragma db index("utxo_i") members(receiving_account_, status_, value_)
+
     friend class boost::serialization::access;
     template<class Archive>
     void serialize(Archive& ar, const unsigned int /*version*/)
@@ -1368,6 +1374,9 @@ public:
     uint32_t locktime() const { return locktime_; }
     bytes_t raw(bool withWitness = true) const;
 
+    // Must be called after changing txins or txouts in place (the set methods already do).
+    void updateRaw();
+
     void timestamp(uint32_t timestamp) { timestamp_ = timestamp; }
     uint32_t timestamp() const { return timestamp_; }
 
@@ -1413,6 +1422,7 @@ private:
     friend class odb::access;
 
     void fromCoinCore(const Coin::Transaction& coin_tx);
+    void setRaw(const Coin::Transaction& coin_tx);
 
     #pragma db id auto
     unsigned long id_;
@@ -1451,6 +1461,10 @@ private:
     #pragma db null
     std::shared_ptr<BlockHeader> blockheader_;
 
+    // History is read in descending (blockheader, timestamp, id) order. Block headers are only ever
+    // deleted from the top of the chain, so their ids grow with height.
+    #pragma db index("history_i") members(blockheader_, timestamp_)
+
     #pragma db null
     odb::nullable<uint32_t> blockindex_;
 
@@ -1459,6 +1473,25 @@ private:
 
     std::string propagation_protocol_;
 
+    // Serialization of the transaction so it can be read back without loading txins and txouts.
+    // raw_nowitness_ stays empty unless the transaction has witness data. Both are empty for rows
+    // written before schema 23 until the transaction is next updated.
+    #pragma db null
+#if defined(DATABASE_MYSQL)
+    #pragma db type("MEDIUMBLOB")
+#else
+    #pragma db type("BLOB")
+#endif
+    bytes_t raw_;
+
+    #pragma db null
+#if defined(DATABASE_MYSQL)
+    #pragma db type("MEDIUMBLOB")
+#else
+    #pragma db type("BLOB")
+#endif
+    bytes_t raw_nowitness_;
+
     friend class boost::serialization::access;
     template<class Archive>
     void save(Archive& ar, const unsigned int v) const
@@ -1553,6 +1586,7 @@ private:
         coin_tx.clearScriptSigs();
         unsigned_hash_ = coin_tx.hash();
         updateTotals();
+        updateRaw();
 
         if (v >= 2)
         {
@@ -1577,6 +1611,40 @@ private:
 
 typedef std::vector<std::shared_ptr<Tx>> txs_t;
 
+// Signature state of every input of a transaction, from a single Coin::Transaction and a single
+// parse of each input script. Inputs whose script cannot be parsed are kept apart, so one bad
+// input only makes the calls that need it throw.
+class TxSignatureState
+{
+public:
+    explicit TxSignatureState(const Tx& tx);
+
+    // outpointvalues holds the value spent by each input, in input order. Witness signatures commit
+    // to it, so it has to be right for them to check out.
+    TxSignatureState(const Coin::Transaction& cointx, const std::vector<uint64_t>& outpointvalues);
+
+    const Coin::Transaction& cointx() const { return cointx_; }
+
+    std::size_t size() const { return signabletxins_.size(); }
+    bool parsed(std::size_t i) const { return (bool)signabletxins_.at(i); }
+    const CoinQ::Script::SignableTxIn& signabletxin(std::size_t i) const; // throws if the input script could not be parsed
+
+    bytes_t unsigned_script(std::size_t i) const; // throws exception if script type is not recognized
+
+    // These throw if any input script could not be parsed.
+    unsigned int missingSigCount() const; // the most signatures any one input still needs
+    std::set<bytes_t> missingSigPubkeys() const;
+    std::set<bytes_t> presentSigPubkeys() const;
+
+private:
+    void parse(const std::vector<uint64_t>& outpointvalues);
+    void checkParsed() const;
+
+    Coin::Transaction cointx_;
+    std::vector<std::shared_ptr<CoinQ::Script::SignableTxIn>> signabletxins_;
+    std::vector<std::string> errors_;
+};
+
 
 // Views
 #pragma db view \
@@ -1743,10 +1811,63 @@ struct TxView
 
     #pragma db column(BlockHeader::height_)
     uint32_t height;
+
+    #pragma db column(BlockHeader::id_)
+    unsigned long blockheader_id; // 0 if unconfirmed
+};
+
+// The stored serialization of a transaction, without loading its txins and txouts.
+#pragma db view \
+    object(Tx)
+struct TxRawView
+{
+    #pragma db column(Tx::id_)
+    unsigned long id;
+    #pragma db column(Tx::hash_)
+    bytes_t hash;
+    #pragma db column(Tx::unsigned_hash_)
+    bytes_t unsigned_hash;
+    #pragma db column(Tx::status_)
+    Tx::status_t status;
+    #pragma db column(Tx::raw_)
+    bytes_t raw;
+    #pragma db column(Tx::raw_nowitness_)
+    bytes_t raw_nowitness;
+
+    const bytes_t& tx_hash() const { return status == Tx::UNSIGNED ? unsigned_hash : hash; }
+    const bytes_t& tx_raw(bool withWitness = true) const { return withWitness || raw_nowitness.empty() ? raw : raw_nowitness; }
+};
+
+// The value of the output each input of a transaction spends. Inputs spending outputs the vault
+// does not know get a value of zero.
+#pragma db view \
+    object(TxIn) \
+    object(Tx: TxIn::tx_) \
+    object(TxOut = outpoint: TxIn::outpoint_)
+struct TxInOutpointView
+{
+    #pragma db column(TxIn::txindex_)
+    uint32_t txindex;
+    #pragma db column(outpoint::value_)
+    uint64_t value;
 };
 
 const std::string EMPTY_STRING = "";
 
+// Just enough of an unspent txout for coin selection, which only loads a TxOutView for the coins it picks.
+#pragma db view \
+    object(TxOut) \
+    object(Tx: TxOut::tx_) \
+    object(BlockHeader: Tx::blockheader_) \
+    object(Account = receiving_account: TxOut::receiving_account_)
+struct TxOutValueView
+{
+    #pragma db column(TxOut::id_)
+    unsigned long id;
+    #pragma db column(TxOut::value_)
+    uint64_t value;
+};
+
 #pragma db view \
     object(TxOut) \
     object(Tx: TxOut::tx_) \
@@ -1925,6 +2046,9 @@ struct TxOutView
 
     #pragma db column(BlockHeader::height_)
     uint32_t height;
+
+    #pragma db column(BlockHeader::id_)
+    unsigned long blockheader_id; // 0 if unconfirmed
 };
 
 #pragma db view \
@@ -1982,28 +2106,35 @@ struct HorizonTimestampView
     uint32_t timestamp;
 };
 
+#pragma db view \
+    table("MerkleBlock_hashes" = "t") \
+    object(MerkleBlock: "t.object_id = " + MerkleBlock::id_) \
+    object(BlockHeader: MerkleBlock::blockheader_)
+struct MerkleBlockHashView
+{
+    #pragma db column("t.value")
+    bytes_t tx_hash;
+
+    #pragma db column(BlockHeader::id_)
+    unsigned long blockheader_id;
+
+    #pragma db column(BlockHeader::height_)
+    uint32_t block_height;
+};
+
 #pragma db view \
     object(Tx) \
     table("MerkleBlock_hashes" = "t": "t.value = " + Tx::hash_) \
     object(MerkleBlock: "t.object_id = " + MerkleBlock::id_) \
     object(BlockHeader: MerkleBlock::blockheader_)
-struct ConfirmedTxView
+struct PendingConfirmationView
 {
-    #pragma db column(Tx::id_)
-    unsigned long tx_id;
-
     #pragma db column(Tx::hash_)
     bytes_t tx_hash;
 
-    #pragma db column(MerkleBlock::id_)
-    unsigned long merkleblock_id;
-
     #pragma db column(BlockHeader::id_)
     unsigned long blockheader_id;
 
-    #pragma db column(BlockHeader::hash_)
-    bytes_t block_hash;
-
     #pragma db column(BlockHeader::height_)
     uint32_t block_height;
 };
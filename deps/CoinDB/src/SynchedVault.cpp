@@ -12,10 +12,24 @@
 #include "SynchedVault.h"
 
 #include <logger/logger.h>
+#include <stdutils/tracing.h>
 
 using namespace CoinDB;
 using namespace CoinQ;
 
+// The vault returns null for txs it did not store or change - bloom filter false positives, for the
+// most part, along with txs it already had.
+struct MatchCounters
+{
+    explicit MatchCounters(const std::string& prefix)
+        : matched(stdutils::metrics::get_counter(prefix + ".matched")), unmatched(stdutils::metrics::get_counter(prefix + ".unmatched")) { }
+
+    void count(std::shared_ptr<Tx> tx) { (tx ? matched : unmatched).add(); }
+
+    stdutils::metrics::counter& matched;
+    stdutils::metrics::counter& unmatched;
+};
+
 const std::string SynchedVault::getStatusString(status_t status)
 {
     switch (status)
@@ -37,7 +51,9 @@ const std::string SynchedVault::getStatusString(status_t status)
 
 // Constructor
 SynchedVault::SynchedVault(const CoinQ::CoinParams& coinParams) :
+    m_vaultMutex("synchedvault.mutex"),
     m_vault(nullptr),
+    m_bAsyncNotifications(false),
     m_status(STOPPED),
     m_bestHeight(0),
     m_syncHeight(0),
@@ -188,13 +204,17 @@ SynchedVault::SynchedVault(const CoinQ::CoinParams& coinParams) :
     {
         LOGGER(trace) << "SynchedVault - Received new transaction " << cointx.hash().getHex() << std::endl;
 
+        TRACE_SPAN(span, "SynchedVault::onNewTx");
+        if (span) { span.arg("tx", cointx.hash().getHex()); }
+
         if (!m_vault) return;
-        std::lock_guard<std::mutex> lock(m_vaultMutex);
+        std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
         if (!m_vault) return;
 
         try
         {
-            m_vault->insertNewTx(cointx);
+            static MatchCounters counters("sync.newtxs");
+            counters.count(m_vault->insertNewTx(cointx));
         }
         catch (const VaultException& e)
         {
@@ -212,13 +232,17 @@ SynchedVault::SynchedVault(const CoinQ::CoinParams& coinParams) :
     {
         LOGGER(trace) << "SynchedVault - Received merkle transaction " << cointx.hash().getHex() << " in block " << chainmerkleblock.hash().getHex() << std::endl;
 
+        TRACE_SPAN(span, "SynchedVault::onMerkleTx");
+        if (span) { span.arg("tx", cointx.hash().getHex()).arg("block", chainmerkleblock.hash().getHex()).arg("height", chainmerkleblock.height); }
+
         if (!m_vault) return;
-        std::lock_guard<std::mutex> lock(m_vaultMutex);
+        std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
         if (!m_vault) return;
 
         try
         {
-            m_vault->insertMerkleTx(chainmerkleblock, cointx, txindex, txcount);
+            static MatchCounters counters("sync.merkletxs");
+            counters.count(m_vault->insertMerkleTx(chainmerkleblock, cointx, txindex, txcount));
         }
         catch (const VaultException& e)
         {
@@ -237,8 +261,11 @@ SynchedVault::SynchedVault(const CoinQ::CoinParams& coinParams) :
     {
         LOGGER(trace) << "SynchedVault - Received transaction confirmation " << uchar_vector(txhash).getHex() << " in block " << chainmerkleblock.hash().getHex() << std::endl;
 
+        TRACE_SPAN(span, "SynchedVault::onTxConfirmed");
+        if (span) { span.arg("tx", uchar_vector(txhash).getHex()).arg("block", chainmerkleblock.hash().getHex()).arg("height", chainmerkleblock.height); }
+
         if (!m_vault) return;
-        std::lock_guard<std::mutex> lock(m_vaultMutex);
+        std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
         if (!m_vault) return;
 
         try
@@ -261,9 +288,12 @@ SynchedVault::SynchedVault(const CoinQ::CoinParams& coinParams) :
     {
         LOGGER(trace) << "SynchedVault - received merkle block " << chainMerkleBlock.hash().getHex() << " height: " << chainMerkleBlock.height << std::endl;
 
+        TRACE_SPAN(span, "SynchedVault::onMerkleBlock");
+        if (span) { span.arg("hash", chainMerkleBlock.hash().getHex()).arg("height", chainMerkleBlock.height); }
+
         if (!m_vault) return;
         if (!m_bInsertMerkleBlocks) return;
-        std::lock_guard<std::mutex> lock(m_vaultMutex);
+        std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
         if (!m_vault) return;
         if (!m_bInsertMerkleBlocks) return;
 
@@ -272,6 +302,9 @@ SynchedVault::SynchedVault(const CoinQ::CoinParams& coinParams) :
             std::shared_ptr<MerkleBlock> merkleblock(new MerkleBlock(chainMerkleBlock));
 	    merkleblock->txsinserted(true);
             m_vault->insertMerkleBlock(merkleblock);
+
+            static stdutils::metrics::counter& merkleblocks = stdutils::metrics::get_counter("sync.merkleblocks");
+            merkleblocks.add();
         }
         catch (const VaultException& e)
         {
@@ -323,10 +356,19 @@ void SynchedVault::openVault(const std::string& dbuser, const std::string& dbpas
 {
     LOGGER(trace) << "SynchedVault::openVault(" << dbuser << ", ..., " << dbname << ", " << (bCreate ? "true" : "false") << ", " << version << ", " << network << ", " << (migrate ? "true" : "false") << ")" << std::endl;
 
+    std::lock_guard<std::mutex> lifetimeLock(m_vaultLifetimeMutex);
+
+    Vault* oldVault;
     {
-        std::lock_guard<std::mutex> lock(m_vaultMutex);
+        std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
         m_notifyVaultClosed();
-        if (m_vault) delete m_vault;
+        oldVault = m_vault;
+        m_vault = nullptr;
+    }
+    deleteVault(oldVault);
+
+    {
+        std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
         m_vault = new Vault;
         try
         {
@@ -357,9 +399,15 @@ void SynchedVault::openVault(const std::string& dbuser, const std::string& dbpas
             updateSyncHeader(merkleblock->blockheader()->height(), merkleblock->blockheader()->hash());
             m_notifyMerkleBlockInserted(merkleblock);
         });
+        m_vault->subscribeConfirmationsChanged([this](uint32_t height, const hashvector_t& txhashes)
+        {
+            for (auto& txhash: txhashes) { m_networkSync.addToMempool(txhash); }
+            m_notifyConfirmationsChanged(height, txhashes);
+        });
         m_vault->subscribeTxInsertionError([this](std::shared_ptr<Tx> tx, std::string description) { m_notifyTxInsertionError(tx, description); });
         m_vault->subscribeMerkleBlockInsertionError([this](std::shared_ptr<MerkleBlock> merkleblock, std::string description) { m_notifyMerkleBlockInsertionError(merkleblock, description); });
         m_vault->subscribeTxConfirmationError([this](std::shared_ptr<MerkleBlock> merkleblock, bytes_t txhash) { m_notifyTxConfirmationError(merkleblock, txhash); });
+        if (m_bAsyncNotifications) { m_vault->setSignalDispatcher(&m_signalDispatcher); }
     }
 
     m_notifyVaultOpened(m_vault);
@@ -370,22 +418,54 @@ void SynchedVault::closeVault()
 {
     LOGGER(trace) << "SynchedVault::closeVault()" << std::endl;
 
+    if (!m_vault) return;
+    std::lock_guard<std::mutex> lifetimeLock(m_vaultLifetimeMutex);
+
+    Vault* vault;
     {
-        if (!m_vault) return;
-        std::lock_guard<std::mutex> lock(m_vaultMutex);
+        std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
         if (!m_vault) return;
 
         m_bInsertMerkleBlocks = false;
         m_networkSync.stopSynchingBlocks();
-        delete m_vault;
+        vault = m_vault;
         m_vault = nullptr;
     }
+    deleteVault(vault);
 
     m_notifyVaultClosed();
     updateSyncHeader(0, bytes_t());
     if (m_networkSync.connected() && m_networkSync.headersSynched()) { updateStatus(SYNCHED); }
 }
 
+void SynchedVault::deleteVault(Vault* vault)
+{
+    if (!vault) return;
+
+    // Detaching the dispatcher waits for queued notifications to run, and their slots can take
+    // m_vaultMutex, so this must not be called with it held.
+    vault->setSignalDispatcher(nullptr);
+    delete vault;
+}
+
+void SynchedVault::setAsyncNotifications(bool async)
+{
+    LOGGER(trace) << "SynchedVault::setAsyncNotifications(" << (async ? "true" : "false") << ")" << std::endl;
+
+    std::lock_guard<std::mutex> lifetimeLock(m_vaultLifetimeMutex);
+
+    Vault* vault;
+    {
+        std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
+        if (async) { m_signalDispatcher.start(); }
+        m_bAsyncNotifications = async;
+        vault = m_vault;
+    }
+
+    // Detaching waits for queued notifications, whose slots can take m_vaultMutex.
+    if (vault) { vault->setSignalDispatcher(async ? &m_signalDispatcher : nullptr); }
+}
+
 // Peer to peer network operations
 void SynchedVault::startSync(const std::string& host, const std::string& port)
 {
@@ -415,7 +495,7 @@ void SynchedVault::suspendBlockUpdates()
 
     if (!m_vault) return;
     if (!m_bInsertMerkleBlocks) return;
-    std::lock_guard<std::mutex> lock(m_vaultMutex);
+    std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
     m_bInsertMerkleBlocks = false;
 }
 
@@ -426,7 +506,7 @@ void SynchedVault::syncBlocks()
     if (!m_bConnected) throw std::runtime_error("Not connected.");
 
     if (!m_vault) throw std::runtime_error("No vault is open.");
-    std::lock_guard<std::mutex> lock(m_vaultMutex);
+    std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
     if (!m_vault) throw std::runtime_error("No vault is open.");
 
     uint32_t startTime = m_vault->getMaxFirstBlockTimestamp();
@@ -456,7 +536,7 @@ void SynchedVault::updateBloomFilter()
     LOGGER(trace) << "SynchedVault::updateBloomFilter()" << std::endl;
 
     if (!m_vault) throw std::runtime_error("No vault is open.");
-    std::lock_guard<std::mutex> lock(m_vaultMutex);
+    std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
     if (!m_vault) throw std::runtime_error("No vault is open.");
 
     m_networkSync.setBloomFilter(m_vault->getBloomFilter(0.001, 0, 0));
@@ -464,25 +544,26 @@ void SynchedVault::updateBloomFilter()
 
 // This function recursively tries to send dependencies.
 // TODO: We might want to make recursive sending optional and allowing an exception to be thrown instead if any dependency is still unpropagated.
-void recursiveSendTx(Vault& vault, CoinQ::Network::NetworkSync& networkSync, std::shared_ptr<Tx>& tx)
+void recursiveSendTx(Vault& vault, CoinQ::Network::NetworkSync& networkSync, const TxRawView& view)
 {
-    if (tx->status() == Tx::UNSIGNED)
+    if (view.status == Tx::UNSIGNED)
         throw std::runtime_error("Transaction is missing signatures.");
 
+    Coin::Transaction coin_tx(view.tx_raw());
+
     // Send any unsent dependencies first.
-    // TODO: Write a new protected method to 
-    for (auto& txin: tx->txins())
+    for (auto& input: coin_tx.inputs)
     {
         try
         {
-            std::shared_ptr<Tx> dependencyTx = vault.getTx(txin->outhash());
-            if (dependencyTx->status() == Tx::UNSIGNED)
+            TxRawView dependency = vault.getTxRawView(input.getOutpointHash());
+            if (dependency.status == Tx::UNSIGNED)
                 throw std::runtime_error("Transaction depends on another transaction that is missing signatures.");
 
             // Only try sending dependencies that have not confirmed. 
-            if (dependencyTx->status() == Tx::UNSENT || dependencyTx->status() == Tx::PROPAGATED)
+            if (dependency.status == Tx::UNSENT || dependency.status == Tx::PROPAGATED)
             {
-                recursiveSendTx(vault, networkSync, dependencyTx);
+                recursiveSendTx(vault, networkSync, dependency);
             }
         }
         catch (const TxNotFoundException& e)
@@ -491,38 +572,37 @@ void recursiveSendTx(Vault& vault, CoinQ::Network::NetworkSync& networkSync, std
         }
     }
 
-    Coin::Transaction coin_tx = tx->toCoinCore();
     networkSync.sendTx(coin_tx);
-    uchar_vector txhash(tx->hash());
+    uchar_vector txhash(view.tx_hash());
     networkSync.getTx(txhash); // To ensure propagation
 }
 
-std::shared_ptr<Tx> SynchedVault::sendTx(const bytes_t& hash)
+TxRawView SynchedVault::sendTx(const bytes_t& hash)
 {
     LOGGER(trace) << "SynchedVault::sendTx(" << uchar_vector(hash).getHex() << ")" << std::endl;
     if (!m_bConnected) throw std::runtime_error("Not connected.");
 
     if (!m_vault) throw std::runtime_error("No vault is open.");
-    std::lock_guard<std::mutex> lock(m_vaultMutex);
+    std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
     if (!m_vault) throw std::runtime_error("No vault is open.");
 
-    std::shared_ptr<Tx> tx = m_vault->getTx(hash);
-    recursiveSendTx(*m_vault, m_networkSync, tx);
-    return tx;
+    TxRawView view = m_vault->getTxRawView(hash);
+    recursiveSendTx(*m_vault, m_networkSync, view);
+    return view;
 }
 
-std::shared_ptr<Tx> SynchedVault::sendTx(unsigned long tx_id)
+TxRawView SynchedVault::sendTx(unsigned long tx_id)
 {
     LOGGER(trace) << "SynchedVault::sendTx(" << tx_id << ")" << std::endl;
     if (!m_bConnected) throw std::runtime_error("Not connected.");
 
     if (!m_vault) throw std::runtime_error("No vault is open.");
-    std::lock_guard<std::mutex> lock(m_vaultMutex);
+    std::lock_guard<vault_mutex_t> lock(m_vaultMutex);
     if (!m_vault) throw std::runtime_error("No vault is open.");
 
-    std::shared_ptr<Tx> tx = m_vault->getTx(tx_id);
-    recursiveSendTx(*m_vault, m_networkSync, tx);
-    return tx;
+    TxRawView view = m_vault->getTxRawView(tx_id);
+    recursiveSendTx(*m_vault, m_networkSync, view);
+    return view;
 }
 
 void SynchedVault::sendTx(Coin::Transaction& coin_tx)
@@ -539,7 +619,7 @@ void SynchedVault::sendTx(Coin::Transaction& coin_tx)
 void SynchedVault::insertFakeMerkleBlock(unsigned int nExtraLeaves)
 {
     if (!m_vault) throw std::runtime_error("No vault is open.");
-    std::unique_lock<std::mutex> lock(m_vaultMutex);
+    std::unique_lock<vault_mutex_t> lock(m_vaultMutex);
     if (!m_vault) throw std::runtime_error("No vault is open.");
 
     txs_t txs = m_vault->getTxs(Tx::PROPAGATED);
@@ -580,6 +660,7 @@ void SynchedVault::clearAllSlots()
     m_notifyTxUpdated.clear();
     m_notifyTxDeleted.clear();
     m_notifyMerkleBlockInserted.clear();
+    m_notifyConfirmationsChanged.clear();
     m_notifyTxInsertionError.clear();
     m_notifyMerkleBlockInsertionError.clear();
     m_notifyProtocolError.clear();
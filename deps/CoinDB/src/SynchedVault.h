@@ -14,6 +14,8 @@
 #include "Vault.h"
 
 #include <Signals/Signals.h>
+#include <Signals/SignalDispatcher.h>
+#include <stdutils/metrics.h>
 
 #include <CoinQ/CoinQ_netsync.h>
 
@@ -57,6 +59,12 @@ public:
     void suspendBlockUpdates();
     void syncBlocks();
 
+    // Runs vault notifications on a dispatcher thread so that block and tx insertion does not wait on
+    // subscribers. Subscribers must then be thread-safe.
+    void setAsyncNotifications(bool async);
+    bool getAsyncNotifications() const { return m_bAsyncNotifications; }
+    Signals::SignalDispatcher::Stats getNotificationStats() const { return m_signalDispatcher.getStats(); }
+
     void setFilterParams(double falsePositiveRate, uint32_t nTweak, uint8_t nFlags);
     void updateBloomFilter();
 
@@ -66,8 +74,9 @@ public:
     uint32_t getSyncHeight() const { return m_syncHeight; }
     const bytes_t& getSyncHash() const { return m_syncHash; }
 
-    std::shared_ptr<Tx> sendTx(const bytes_t& hash);
-    std::shared_ptr<Tx> sendTx(unsigned long tx_id);
+    // Also sends any unconfirmed dependencies we have. Only the stored serializations are read.
+    TxRawView sendTx(const bytes_t& hash);
+    TxRawView sendTx(unsigned long tx_id);
     void sendTx(Coin::Transaction& coin_tx);
 
     // For testing
@@ -101,6 +110,7 @@ public:
     Signals::Connection subscribeTxUpdated(TxSignal::Slot slot) { return m_notifyTxUpdated.connect(slot); }
     Signals::Connection subscribeTxDeleted(TxSignal::Slot slot) { return m_notifyTxDeleted.connect(slot); }
     Signals::Connection subscribeMerkleBlockInserted(MerkleBlockSignal::Slot slot) { return m_notifyMerkleBlockInserted.connect(slot); }
+    Signals::Connection subscribeConfirmationsChanged(ConfirmationsChangedSignal::Slot slot) { return m_notifyConfirmationsChanged.connect(slot); }
     Signals::Connection subscribeTxInsertionError(TxErrorSignal::Slot slot) { return m_notifyTxInsertionError.connect(slot); }
     Signals::Connection subscribeMerkleBlockInsertionError(MerkleBlockErrorSignal::Slot slot) { return m_notifyMerkleBlockInsertionError.connect(slot); }
     Signals::Connection subscribeTxConfirmationError(TxConfirmationErrorSignal::Slot slot) { return m_notifyTxConfirmationError.connect(slot); }
@@ -111,8 +121,17 @@ public:
 private:
     friend class VaultLock;
 
-    mutable std::mutex          m_vaultMutex;
+    typedef stdutils::metrics::timed_mutex<std::mutex> vault_mutex_t;
+    mutable vault_mutex_t       m_vaultMutex;
     Vault*                      m_vault;
+    void                        deleteVault(Vault* vault);
+
+    // Held while the vault is opened, closed or has its dispatcher swapped, which wait on
+    // queued notifications and so cannot hold m_vaultMutex throughout.
+    std::mutex                  m_vaultLifetimeMutex;
+
+    Signals::SignalDispatcher   m_signalDispatcher;
+    bool                        m_bAsyncNotifications;
 
     status_t                    m_status;
     void                        updateStatus(status_t newStatus);
@@ -163,6 +182,7 @@ private:
     TxSignal                    m_notifyTxUpdated;
     TxSignal                    m_notifyTxDeleted;
     MerkleBlockSignal           m_notifyMerkleBlockInserted;
+    ConfirmationsChangedSignal  m_notifyConfirmationsChanged;
     TxErrorSignal               m_notifyTxInsertionError;
     MerkleBlockErrorSignal      m_notifyMerkleBlockInsertionError;
     TxConfirmationErrorSignal   m_notifyTxConfirmationError;
@@ -175,7 +195,7 @@ public:
     explicit VaultLock(const SynchedVault& synchedVault) : m_lock(synchedVault.m_vaultMutex) { }
 
 private:
-    std::lock_guard<std::mutex> m_lock;
+    std::lock_guard<SynchedVault::vault_mutex_t> m_lock;
 };
 
 }
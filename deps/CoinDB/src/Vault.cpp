@@ -28,6 +28,10 @@
 #include <odb/transaction.hxx>
 #include <odb/session.hxx>
 
+#if defined(DATABASE_SQLITE)
+    #include <sqlite3.h>
+#endif
+
 #include <CoinCore/hash.h>
 #include <CoinCore/aes.h>
 #include <CoinCore/MerkleTree.h>
@@ -37,13 +41,48 @@
 #include <logger/logger.h>
 
 #include <stdutils/stringutils.h>
+#include <stdutils/tracing.h>
 
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <atomic>
+#include <exception>
 
 using namespace CoinDB;
 
+const uint32_t VAULT_FILE_BATCH_SIZE = 100; // transactions loaded or inserted per session during export and import
+const unsigned int MAX_BACKUP_RESTARTS = 3; // after this many restarts caused by concurrent writes, backups copy the rest in one step
+const std::size_t MAX_QUERY_IDS = 500; // ids bound per IN clause, well under SQLite's limit of 999 host parameters
+
+// Coalescing key for tx update notifications - repeated updates of one tx that have not been delivered yet collapse into the latest.
+static std::string txUpdatedKey(const std::shared_ptr<Tx>& tx)
+{
+    const bytes_t& hash = tx->unsigned_hash();
+    return std::string("TxUpdated:") + std::string(hash.begin(), hash.end());
+}
+
+// Calls f(begin, end) for consecutive ranges of ids short enough to bind in a single query.
+template<typename F>
+static void forEachIdChunk(const ids_t& ids, F f)
+{
+    for (std::size_t i = 0; i < ids.size(); i += MAX_QUERY_IDS)
+    {
+        f(ids.begin() + i, ids.begin() + std::min(ids.size(), i + MAX_QUERY_IDS));
+    }
+}
+
+// Txs stored before schema 23 have no serialization yet - build it from their txins and txouts.
+static void fillTxRawView(odb::database& db, TxRawView& view)
+{
+    if (!view.raw.empty()) return;
+
+    std::shared_ptr<Tx> tx(db.load<Tx>(view.id));
+    view.raw = tx->raw(true);
+    view.raw_nowitness = tx->raw(false);
+    if (view.raw_nowitness == view.raw) { view.raw_nowitness.clear(); }
+}
+
 /*
  * data migration
 */
@@ -69,6 +108,7 @@ static const migration_entry<14> migrate_compressed_keys_entry(&migrate_compress
  * class Vault implementation
 */
 Vault::Vault(int argc, char** argv, bool create, uint32_t version, const std::string& network, bool migrate)
+    : mutex("vault.mutex"), pendingConfirmationsLoaded_(false)
 {
     LOGGER(trace) << "Vault::Vault(..., " << (create ? "true" : "false") << ", " << version << ", " << network << ", " << (migrate ? "true" : "false") << ")" << std::endl;
 
@@ -78,6 +118,7 @@ Vault::Vault(int argc, char** argv, bool create, uint32_t version, const std::st
 }
 
 Vault::Vault(const std::string& dbname, bool create, uint32_t version, const std::string& network, bool migrate)
+    : mutex("vault.mutex"), pendingConfirmationsLoaded_(false)
 {
     LOGGER(trace) << "Vault::Vault(" << dbname << ", " << (create ? "true" : "false") << ", " << version << ", " << network << ", " << (migrate ? "true" : "false") << ")" << std::endl;
 
@@ -87,6 +128,7 @@ Vault::Vault(const std::string& dbname, bool create, uint32_t version, const std
 }
 
 Vault::Vault(const std::string& dbuser, const std::string& dbpasswd, const std::string& dbname, bool create, uint32_t version, const std::string& network, bool migrate)
+    : mutex("vault.mutex"), pendingConfirmationsLoaded_(false)
 {
     LOGGER(trace) << "Vault::Vault(" << dbuser << ", ..., " << dbname << ", " << (create ? "true" : "false") << ", " << version << ", " << network << ", " << (migrate ? "true" : "false") << ")" << std::endl;
 
@@ -99,6 +141,8 @@ Vault::~Vault()
 {
     LOGGER(trace) << "Vault::~Vault()" << std::endl;
 
+    // Queued notifications refer to our signals - let them run before the signals go away.
+    signalQueue.setDispatcher(nullptr);
     close();
 }
 
@@ -153,7 +197,10 @@ void Vault::open(int argc, char** argv, bool create, uint32_t version, const std
 
     if (argc >= 2) name_ = argv[1];
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
+
+    pendingConfirmations_.clear();
+    pendingConfirmationsLoaded_ = false;
 
     try
     {
@@ -232,7 +279,10 @@ void Vault::open(const std::string& dbuser, const std::string& dbpasswd, const s
 
     name_ = dbname;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
+
+    pendingConfirmations_.clear();
+    pendingConfirmationsLoaded_ = false;
 
     try
     {
@@ -311,8 +361,10 @@ void Vault::close()
     LOGGER(trace) << "Vault::close()" << std::endl;
 
     if (!db_) return;
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     db_.reset();
+    pendingConfirmations_.clear();
+    pendingConfirmationsLoaded_ = false;
 }
 
 uint32_t Vault::getSchemaVersion() const
@@ -320,7 +372,7 @@ uint32_t Vault::getSchemaVersion() const
     LOGGER(trace) << "Vault::getSchemaVersion()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getSchemaVersion_unwrapped();
@@ -336,7 +388,7 @@ void Vault::setSchemaVersion(uint32_t version)
 {
     LOGGER(trace) << "Vault::setSchemaVersion(" << version << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     setSchemaVersion_unwrapped(version);
     t.commit();
@@ -363,7 +415,7 @@ std::string Vault::getNetwork() const
     LOGGER(trace) << "Vault::getNetwork()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getNetwork_unwrapped();
@@ -379,7 +431,7 @@ void Vault::setNetwork(const std::string& network)
 {
     LOGGER(trace) << "Vault::setNetwork(" << network << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     setNetwork_unwrapped(network);
     t.commit();
@@ -409,7 +461,7 @@ uint32_t Vault::getHorizonTimestamp() const
     LOGGER(trace) << "Vault::getHorizonTimestamp()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getHorizonTimestamp_unwrapped();
@@ -420,7 +472,7 @@ uint32_t Vault::getMaxFirstBlockTimestamp() const
     LOGGER(trace) << "Vault::getMaxFirstBlockTimestamp()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getMaxFirstBlockTimestamp_unwrapped();
@@ -445,7 +497,7 @@ uint32_t Vault::getHorizonHeight() const
     LOGGER(trace) << "Vault::getHorizonHeight()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getHorizonHeight_unwrapped();
@@ -462,7 +514,7 @@ std::vector<bytes_t> Vault::getLocatorHashes() const
     LOGGER(trace) << "Vault::getLocatorHashes()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getLocatorHashes_unwrapped();
@@ -496,9 +548,10 @@ std::vector<bytes_t> Vault::getLocatorHashes_unwrapped() const
 Coin::BloomFilter Vault::getBloomFilter(double falsePositiveRate, uint32_t nTweak, uint32_t nFlags) const
 {
     LOGGER(trace) << "Vault::getBloomFilter(" << falsePositiveRate << ", " << nTweak << ", " << nFlags << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.getBloomFilter");
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -573,7 +626,7 @@ hashvector_t Vault::getIncompleteBlockHashes() const
     LOGGER(trace) << "Vault::getIncompleteBlockHashes()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -588,18 +641,17 @@ hashvector_t Vault::getIncompleteBlockHashes_unwrapped() const
     return hashes;
 }
 
-void Vault::exportVault(const std::string& filepath, bool exportprivkeys) const
+void Vault::exportVault(const std::string& filepath, bool exportprivkeys, VaultFileFormat format) const
 {
-    LOGGER(trace) << "Vault::exportVault(" << filepath << ", " << (exportprivkeys ? "true" : "false") << std::endl;
+    LOGGER(trace) << "Vault::exportVault(" << filepath << ", " << (exportprivkeys ? "true" : "false") << ", " << format << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
-    std::ofstream ofs(filepath);
-    boost::archive::text_oarchive oa(ofs);
+    VaultOutputFile file(filepath, format);
+    boost::archive::polymorphic_oarchive& oa = file.archive();
 
     odb::core::transaction t(db_->begin());
-    odb::core::session s;
 
     odb::result<AccountCountView> count_r(db_->query<AccountCountView>());
     uint32_t n = count_r.empty() ? 0 : count_r.begin()->count;
@@ -607,11 +659,14 @@ void Vault::exportVault(const std::string& filepath, bool exportprivkeys) const
     oa << n;
     if (n > 0)
     {
-        // Export all accounts
-        odb::result<Account> account_r(db_->query<Account>());
-        for (auto& account: account_r)
         {
-            exportAccount_unwrapped(account, oa, exportprivkeys);
+            // Export all accounts
+            odb::core::session s;
+            odb::result<Account> account_r(db_->query<Account>());
+            for (auto& account: account_r)
+            {
+                exportAccount_unwrapped(account, oa, exportprivkeys);
+            }
         }
 
         // Export merkle blocks
@@ -620,6 +675,8 @@ void Vault::exportVault(const std::string& filepath, bool exportprivkeys) const
         // Export transactions
         exportTxs_unwrapped(oa, 0);
     }
+
+    file.close();
 }
  
 void Vault::importVault(const std::string& filepath, bool importprivkeys)
@@ -627,9 +684,9 @@ void Vault::importVault(const std::string& filepath, bool importprivkeys)
     LOGGER(trace) << "Vault::importVault(" << filepath << ", " << (importprivkeys ? "true" : "false") << std::endl;
 
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
-        std::ifstream ifs(filepath);
-        boost::archive::text_iarchive ia(ifs);
+        boost::lock_guard<mutex_t> lock(mutex);
+        VaultInputFile file(filepath);
+        boost::archive::polymorphic_iarchive& ia = file.archive();
 
         odb::core::transaction t(db_->begin());
 
@@ -660,6 +717,78 @@ void Vault::importVault(const std::string& filepath, bool importprivkeys)
     signalQueue.flush();
 }
 
+void Vault::backup(const std::string& filepath, int pages_per_step, unsigned int step_delay_ms) const
+{
+    LOGGER(trace) << "Vault::backup(" << filepath << ", " << pages_per_step << ", " << step_delay_ms << ")" << std::endl;
+
+    backup_unwrapped(filepath, pages_per_step, step_delay_ms);
+}
+
+void Vault::backup_unwrapped(const std::string& filepath, int pages_per_step, unsigned int step_delay_ms) const
+{
+#if defined(DATABASE_SQLITE)
+    std::string dbname;
+    {
+        boost::lock_guard<mutex_t> lock(mutex);
+        if (!db_) throw VaultBackupFailedException(name_, "Vault is not open.");
+        dbname = static_cast<odb::sqlite::database&>(*db_).name();
+    }
+
+    sqlite3* src = nullptr;
+    sqlite3* dest = nullptr;
+    sqlite3_backup* backup = nullptr;
+
+    auto fail = [&](sqlite3* handle)
+    {
+        std::string dberror = handle ? sqlite3_errmsg(handle) : "Out of memory.";
+        if (backup) sqlite3_backup_finish(backup);
+        sqlite3_close(dest);
+        sqlite3_close(src);
+        throw VaultBackupFailedException(name_, dberror);
+    };
+
+    // Use our own connections so the vault connection stays free for writers.
+    if (sqlite3_open_v2(dbname.c_str(), &src, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) fail(src);
+    if (sqlite3_open_v2(filepath.c_str(), &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) fail(dest);
+
+    backup = sqlite3_backup_init(dest, "main", src, "main");
+    if (!backup) fail(dest);
+
+    // A write from another connection restarts the copy. Keep stepping, but if writes keep winning,
+    // copy whatever is left in one step so the backup is guaranteed to finish.
+    unsigned int restarts = 0;
+    int remaining = -1;
+    int rc;
+    do
+    {
+        rc = sqlite3_backup_step(backup, restarts < MAX_BACKUP_RESTARTS ? pages_per_step : -1);
+        if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+        {
+            int now_remaining = sqlite3_backup_remaining(backup);
+            if (remaining >= 0 && now_remaining > remaining)
+            {
+                restarts++;
+                LOGGER(debug) << "Vault::backup_unwrapped - database changed, backup restarted. restarts: " << restarts << std::endl;
+            }
+            remaining = now_remaining;
+            sqlite3_sleep(step_delay_ms);
+        }
+    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+
+    int pagecount = sqlite3_backup_pagecount(backup);
+    rc = sqlite3_backup_finish(backup);
+    backup = nullptr;
+    if (rc != SQLITE_OK) fail(dest);
+
+    LOGGER(debug) << "Vault::backup_unwrapped - " << dbname << " backed up to " << filepath << ". pages: " << pagecount << std::endl;
+
+    sqlite3_close(dest);
+    sqlite3_close(src);
+#else
+    throw VaultBackupFailedException(name_, "Online backup is only supported for sqlite databases.");
+#endif
+}
+
 
 ////////////////////////
 // CONTACT OPERATIONS //
@@ -668,7 +797,7 @@ std::shared_ptr<Contact> Vault::newContact(const std::string& username)
 {
     LOGGER(trace) << "Vault::newContact(" << username << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Contact> contact = newContact_unwrapped(username);
     t.commit();
@@ -690,7 +819,7 @@ std::shared_ptr<Contact> Vault::getContact(const std::string& username) const
     LOGGER(trace) << "Vault::getContact(" << username << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getContact_unwrapped(username);
@@ -712,7 +841,7 @@ ContactVector Vault::getAllContacts() const
     LOGGER(trace) << "Vault::getAllContacts()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getAllContacts_unwrapped();
@@ -733,7 +862,7 @@ bool Vault::contactExists(const std::string& username) const
     LOGGER(trace) << "Vault::contactExists(" << username << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return contactExists_unwrapped(username);
@@ -751,7 +880,7 @@ std::shared_ptr<Contact> Vault::renameContact(const std::string& old_username, c
 {
     LOGGER(trace) << "Vault::renameContact(" << old_username << ", " << new_username << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Contact> contact = renameContact_unwrapped(old_username, new_username);
     t.commit();
@@ -782,7 +911,7 @@ void Vault::exportKeychain(const std::string& keychain_name, const std::string&
     LOGGER(trace) << "Vault::exportKeychain(" << keychain_name << ", " << filepath << ", " << (exportprivkeys ? "true" : "false") << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Keychain> keychain = getKeychain_unwrapped(keychain_name);
@@ -802,7 +931,7 @@ std::shared_ptr<Keychain> Vault::importKeychain(const std::string& filepath, boo
 {
     LOGGER(trace) << "Vault::importKeychain(" << filepath << ", " << (importprivkeys ? "true" : "false") << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Keychain> keychain = importKeychain_unwrapped(filepath, importprivkeys);
@@ -814,9 +943,8 @@ std::shared_ptr<Keychain> Vault::importKeychain_unwrapped(const std::string& fil
 {
     std::shared_ptr<Keychain> keychain(new Keychain());
     {
-        std::ifstream ifs(filepath);
-        boost::archive::text_iarchive ia(ifs);
-        ia >> *keychain;
+        VaultInputFile file(filepath);
+        file.archive() >> *keychain;
     }
 
     if (!keychain->isPrivate()) { importprivkeys = false; }
@@ -863,7 +991,7 @@ bool Vault::keychainExists(const std::string& keychain_name) const
     LOGGER(trace) << "Vault::keychainExists(" << keychain_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return keychainExists_unwrapped(keychain_name);
@@ -880,7 +1008,7 @@ bool Vault::keychainExists(const bytes_t& keychain_hash) const
     LOGGER(trace) << "Vault::keychainExists(@hash = " << uchar_vector(keychain_hash).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return keychainExists_unwrapped(keychain_hash);
@@ -922,7 +1050,7 @@ bool Vault::isKeychainPrivate(const std::string& keychain_name) const
     LOGGER(trace) << "Vault::isKeychainPrivate(" << keychain_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return isKeychainPrivate_unwrapped(keychain_name);
@@ -938,7 +1066,7 @@ std::shared_ptr<Keychain> Vault::newKeychain(const std::string& keychain_name, c
 {
     LOGGER(trace) << "Vault::newKeychain(" << keychain_name << ", ...)" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session session;
     odb::core::transaction t(db_->begin());
     {
@@ -962,7 +1090,7 @@ void Vault::renameKeychain(const std::string& old_name, const std::string& new_n
     LOGGER(trace) << "Vault::renameKeychain(" << old_name << ", " << new_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session session;
     odb::core::transaction t(db_->begin());
@@ -1003,7 +1131,7 @@ std::vector<KeychainView> Vault::getRootKeychainViews(const std::string& account
     LOGGER(trace) << "Vault::getRootKeychainViews(" << account_name << ", " << (get_hidden ? "true" : "false") << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getRootKeychainViews_unwrapped(account_name, get_hidden);
@@ -1036,7 +1164,7 @@ secure_bytes_t Vault::exportBIP32(const std::string& keychain_name, bool export_
     LOGGER(trace) << "Vault::exportBIP32(" << keychain_name << ", " << (export_private ? "true" : "false") << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Keychain> keychain = getKeychain_unwrapped(keychain_name);
@@ -1054,7 +1182,7 @@ std::shared_ptr<Keychain> Vault::importBIP32(const std::string& keychain_name, c
 {
     LOGGER(trace) << "Vault::importKeychainExtendedKey(" << keychain_name << ", ...)" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session session;
     odb::core::transaction t(db_->begin());
     odb::result<Keychain> r(db_->query<Keychain>(odb::query<Keychain>::name == keychain_name));
@@ -1074,7 +1202,7 @@ secure_bytes_t Vault::exportBIP39(const std::string& keychain_name) const
     LOGGER(trace) << "Vault::exportBIP39(" << keychain_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Keychain> keychain = getKeychain_unwrapped(keychain_name);
@@ -1086,7 +1214,7 @@ void Vault::encryptKeychain(const std::string& keychain_name, const secure_bytes
 {
     LOGGER(trace) << "Vault::encryptKeychain(" << keychain_name << ", ...)" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
 
@@ -1101,7 +1229,7 @@ void Vault::decryptKeychain(const std::string& keychain_name)
 {
     LOGGER(trace) << "Vault::unencryptKeychain(" << keychain_name << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
 
@@ -1116,7 +1244,7 @@ void Vault::refillAccountPool(const std::string& account_name)
 {
     LOGGER(trace) << "Vault::refillAccountPool(" << account_name << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Account> account = getAccount_unwrapped(account_name);
@@ -1134,7 +1262,7 @@ std::shared_ptr<Keychain> Vault::getKeychain(const std::string& keychain_name) c
     LOGGER(trace) << "Vault::getKeychain(" << keychain_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getKeychain_unwrapped(keychain_name);
@@ -1154,7 +1282,7 @@ std::vector<std::shared_ptr<Keychain>> Vault::getAllKeychains(bool root_only, bo
     LOGGER(trace) << "Vault::getAllKeychains()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     odb::query<Keychain> query(1 == 1);
@@ -1173,7 +1301,7 @@ void Vault::lockAllKeychains()
 {
     LOGGER(trace) << "Vault::lockAllKeychains()" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     mapPrivateKeyUnlock.clear();
     for (auto& item: mapPrivateKeyUnlock)
     {
@@ -1185,7 +1313,7 @@ void Vault::lockKeychain(const std::string& keychain_name)
 {
     LOGGER(trace) << "Vault::lockKeychain(" << keychain_name << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     mapPrivateKeyUnlock.erase(keychain_name);
     notifyKeychainLocked(keychain_name);
 }
@@ -1194,7 +1322,7 @@ void Vault::unlockKeychain(const std::string& keychain_name, const secure_bytes_
 {
     LOGGER(trace) << "Vault::unlockKeychain(" << keychain_name << ", ?)" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
 
@@ -1279,7 +1407,7 @@ bool Vault::isKeychainEncrypted(const std::string& keychain_name) const
 {
     LOGGER(trace) << "Vault::isKeychainEncrypted(" << keychain_name << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
 
@@ -1295,21 +1423,21 @@ void Vault::exportAccount(const std::string& account_name, const std::string& fi
     LOGGER(trace) << "Vault::exportAccount(" << account_name << ", " << filepath << ", " << (exportprivkeys ? "true" : "false") << ", ?)" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
 
     // TODO: disallow operation if file is already open
-    std::ofstream ofs(filepath);
-    boost::archive::text_oarchive oa(ofs);
+    VaultOutputFile file(filepath);
 
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<Account> account = getAccount_unwrapped(account_name);
 
-    exportAccount_unwrapped(*account, oa, exportprivkeys);
+    exportAccount_unwrapped(*account, file.archive(), exportprivkeys);
+    file.close();
 }
 
-void Vault::exportAccount_unwrapped(Account& account, boost::archive::text_oarchive& oa, bool exportprivkeys) const
+void Vault::exportAccount_unwrapped(Account& account, boost::archive::polymorphic_oarchive& oa, bool exportprivkeys) const
 {
     if (!exportprivkeys)
         for (auto& keychain: account.keychains()) { keychain->clearPrivateKey(); }
@@ -1321,15 +1449,14 @@ std::shared_ptr<Account> Vault::importAccount(const std::string& filepath, unsig
 {
     LOGGER(trace) << "Vault::importAccount(" << filepath << ", " << privkeysimported << ")" << std::endl;
 
-    std::ifstream ifs(filepath);
-    boost::archive::text_iarchive ia(ifs);
+    VaultInputFile file(filepath);
 
     std::shared_ptr<Account> account;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
-        account = importAccount_unwrapped(ia, privkeysimported);
+        account = importAccount_unwrapped(file.archive(), privkeysimported);
         t.commit();
     }
 
@@ -1337,7 +1464,7 @@ std::shared_ptr<Account> Vault::importAccount(const std::string& filepath, unsig
     return account; 
 }
 
-std::shared_ptr<Account> Vault::importAccount_unwrapped(boost::archive::text_iarchive& ia, unsigned int& privkeysimported)
+std::shared_ptr<Account> Vault::importAccount_unwrapped(boost::archive::polymorphic_iarchive& ia, unsigned int& privkeysimported)
 {
     std::shared_ptr<Account> account(new Account());
     ia >> *account;
@@ -1446,7 +1573,7 @@ bool Vault::accountExists(const std::string& account_name) const
     LOGGER(trace) << "Vault::accountExists(" << account_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return accountExists_unwrapped(account_name);
@@ -1488,7 +1615,7 @@ void Vault::newAccount(const std::string& account_name, unsigned int minsigs, co
 {
     LOGGER(trace) << "Vault::newAccount(" << account_name << ", " << minsigs << " of [" << stdutils::delimited_list(keychain_names, ", ") << "], " << unused_pool_size << ", " << time_created << (use_witness ? "true" : "false") << ", " << (use_witness_p2sh ? "true" : "false") << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     odb::result<Account> r(db_->query<Account>(odb::query<Account>::name == account_name));
@@ -1541,7 +1668,7 @@ void Vault::renameAccount(const std::string& old_name, const std::string& new_na
     LOGGER(trace) << "Vault::renameAccount(" << old_name << ", " << new_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session session;
     odb::core::transaction t(db_->begin());
@@ -1566,7 +1693,7 @@ std::shared_ptr<Account> Vault::getAccount(const std::string& account_name) cons
     LOGGER(trace) << "Vault::getAccount(" << account_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getAccount_unwrapped(account_name);
@@ -1584,9 +1711,10 @@ std::shared_ptr<Account> Vault::getAccount_unwrapped(const std::string& account_
 std::vector<TxOutView> Vault::getUnspentTxOutViews(const std::string& account_name, uint32_t min_confirmations) const
 {
     LOGGER(trace) << "Vault::getUnspentTxOutViews(" << account_name << ", " << min_confirmations << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.getUnspentTxOutViews");
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1612,12 +1740,61 @@ std::vector<TxOutView> Vault::getUnspentTxOutViews_unwrapped(std::shared_ptr<Acc
     return utxoviews;
 }
 
+unsigned int Vault::getUnspentTxOutViews(UnspentCursor& cursor, TxOutViewCallback callback, const std::string& account_name, uint32_t min_confirmations, int count) const
+{
+    LOGGER(trace) << "Vault::getUnspentTxOutViews(" << cursor.value << ":" << cursor.txout_id << ", ..., " << account_name << ", " << min_confirmations << ", " << count << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.getUnspentTxOutViews");
+
+    typedef odb::query<TxOutView> query_t;
+    query_t query(query_t::Tx::status > Tx::UNSIGNED && query_t::TxOut::status == TxOut::UNSPENT && query_t::receiving_account::name == account_name);
+
+    if (!cursor.isStart())
+    {
+        query = query && (
+            query_t::TxOut::value < cursor.value ||
+            (query_t::TxOut::value == cursor.value && query_t::TxOut::id < cursor.txout_id));
+    }
+
+#if defined(LOCK_ALL_CALLS)
+    boost::lock_guard<mutex_t> lock(mutex);
+#endif
+    odb::core::transaction t(db_->begin());
+    if (min_confirmations > 0)
+    {
+        uint32_t best_height = getBestHeight_unwrapped();
+        if (min_confirmations > best_height) return 0;
+        query = (query && query_t::BlockHeader::height <= best_height + 1 - min_confirmations);
+    }
+
+    query += "ORDER BY" + query_t::TxOut::value + "DESC," + query_t::TxOut::id + "DESC";
+    if (count != -1)
+    {
+        std::stringstream ss;
+        ss << "LIMIT " << count;
+        query = query + ss.str().c_str();
+    }
+
+    unsigned int n = 0;
+    odb::result<TxOutView> r(db_->query<TxOutView>(query));
+    for (auto it = r.begin(); it != r.end(); ++it)
+    {
+        TxOutView& view = *it;
+        cursor.value = view.value;
+        cursor.txout_id = view.id;
+        n++;
+
+        view.updateRole(TxOut::ROLE_RECEIVER);
+        if (!callback(view)) break;
+    }
+    return n;
+}
+
 AccountInfo Vault::getAccountInfo(const std::string& account_name) const
 {
     LOGGER(trace) << "Vault::getAccountInfo(" << account_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1630,7 +1807,7 @@ std::vector<AccountInfo> Vault::getAllAccountInfo() const
     LOGGER(trace) << "Vault::getAllAccountInfo()" << std::endl;
  
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1643,11 +1820,12 @@ std::vector<AccountInfo> Vault::getAllAccountInfo() const
 uint64_t Vault::getAccountBalance(const std::string& account_name, unsigned int min_confirmations, int tx_flags) const
 {
     LOGGER(trace) << "Vault::getAccountBalance(" << account_name << ", " << min_confirmations << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.getAccountBalance");
 
     std::vector<Tx::status_t> tx_statuses = Tx::getStatusFlags(tx_flags);
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     typedef odb::query<BalanceView> query_t;
@@ -1669,7 +1847,7 @@ std::shared_ptr<AccountBin> Vault::addAccountBin(const std::string& account_name
     if (bin_name.empty() || bin_name[0] == '@') throw std::runtime_error("Invalid account bin name.");
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1707,8 +1885,9 @@ std::shared_ptr<AccountBin> Vault::addAccountBin(const std::string& account_name
 std::shared_ptr<SigningScript> Vault::issueSigningScript(const std::string& account_name, const std::string& bin_name, const std::string& label, uint32_t index, const std::string& username)
 {
     LOGGER(trace) << "Vault::issueSigningScript(" << account_name << ", " << bin_name << ", " << label << ", " << index << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.issueSigningScript");
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     if (!accountExists_unwrapped(account_name)) throw AccountNotFoundException(account_name);
@@ -1832,7 +2011,7 @@ std::vector<SigningScriptView> Vault::getSigningScriptViews(const std::string& a
     query += "ORDER BY" + query_t::Account::name + "ASC," + query_t::AccountBin::name + "ASC," + query_t::SigningScript::status + "DESC," + query_t::SigningScript::index + "ASC";
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1845,7 +2024,16 @@ std::vector<SigningScriptView> Vault::getSigningScriptViews(const std::string& a
 
 std::vector<TxOutView> Vault::getTxOutViews(const std::string& account_name, const std::string& bin_name, int role_flags, int txout_status_flags, int tx_status_flags, bool hide_change) const
 {
-    LOGGER(trace) << "Vault::getTxOutViews(" << account_name << ", " << bin_name << ", " << TxOut::getRoleString(role_flags) << ", " << TxOut::getStatusString(txout_status_flags) << ", " << ", " << Tx::getStatusString(tx_status_flags) << ")" << std::endl;
+    std::vector<TxOutView> views;
+    HistoryCursor cursor;
+    getTxOutViews(cursor, [&](const TxOutView& view) { views.push_back(view); return true; }, account_name, bin_name, role_flags, txout_status_flags, tx_status_flags, hide_change);
+    return views;
+}
+
+unsigned int Vault::getTxOutViews(HistoryCursor& cursor, TxOutViewCallback callback, const std::string& account_name, const std::string& bin_name, int role_flags, int txout_status_flags, int tx_status_flags, bool hide_change, int count) const
+{
+    LOGGER(trace) << "Vault::getTxOutViews(" << cursor.blockheader_id << ":" << cursor.timestamp << ":" << cursor.tx_id << ":" << cursor.txout_id << ":" << cursor.txout_split << ", ..., " << account_name << ", " << bin_name << ", " << TxOut::getRoleString(role_flags) << ", " << TxOut::getStatusString(txout_status_flags) << ", " << Tx::getStatusString(tx_status_flags) << ", " << count << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.getTxOutViews");
 
     typedef odb::query<TxOutView> query_t;
     query_t query(query_t::receiving_account::id != 0 || query_t::sending_account::id != 0);
@@ -1868,21 +2056,72 @@ std::vector<TxOutView> Vault::getTxOutViews(const std::string& account_name, con
         query = (query && query_t::Tx::status.in_range(tx_statuses.begin(), tx_statuses.end()));
     }
 
-    query += "ORDER BY" + query_t::BlockHeader::height + "DESC," + query_t::Tx::timestamp + "DESC," + query_t::Tx::id + "DESC";
+    if (!cursor.isStart())
+    {
+        // Resume after the cursor's txout, or at it if some of its split views were not delivered yet.
+        query_t txout_query(query_t::TxOut::id < cursor.txout_id);
+        if (cursor.txout_split > 0) txout_query = (query_t::TxOut::id <= cursor.txout_id);
+
+        query_t tx_query(
+            query_t::Tx::timestamp < cursor.timestamp ||
+            (query_t::Tx::timestamp == cursor.timestamp && (
+                query_t::Tx::id < cursor.tx_id ||
+                (query_t::Tx::id == cursor.tx_id && txout_query))));
+
+        // Unconfirmed txs have no block header and come after all confirmed ones.
+        if (cursor.blockheader_id != 0)
+        {
+            query = query && (
+                query_t::Tx::blockheader.is_null() ||
+                query_t::Tx::blockheader < cursor.blockheader_id ||
+                (query_t::Tx::blockheader == cursor.blockheader_id && tx_query));
+        }
+        else
+        {
+            query = query && query_t::Tx::blockheader.is_null() && tx_query;
+        }
+    }
+
+    query += "ORDER BY" + query_t::Tx::blockheader + "DESC," + query_t::Tx::timestamp + "DESC," + query_t::Tx::id + "DESC," + query_t::TxOut::id + "DESC";
+    if (count != -1)
+    {
+        std::stringstream ss;
+        ss << "LIMIT " << count;
+        query = query + ss.str().c_str();
+    }
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
-    std::vector<TxOutView> views;
+    unsigned int n = 0;
     odb::result<TxOutView> r(db_->query<TxOutView>(query));
-    for (auto& view: r)
+    for (auto it = r.begin(); it != r.end(); ++it)
     {
+        TxOutView& view = *it;
         view.updateRole(role_flags);
         std::vector<TxOutView> split_views = view.getSplitRoles(TxOut::ROLE_RECEIVER, account_name);
-        for (auto& split_view: split_views) { views.push_back(split_view); }
+
+        // Skip the split views of the cursor's txout that an earlier call already delivered.
+        std::size_t split = (view.id == cursor.txout_id) ? cursor.txout_split : 0;
+
+        cursor.blockheader_id = view.blockheader_id;
+        cursor.timestamp = view.tx_timestamp;
+        cursor.tx_id = view.tx_id;
+        cursor.txout_id = view.id;
+        cursor.txout_split = 0;
+        n++;
+
+        for (; split < split_views.size(); split++)
+        {
+            if (!callback(split_views[split]))
+            {
+                if (split + 1 < split_views.size()) { cursor.txout_split = split + 1; }
+                return n;
+            }
+        }
     }
-    return views;
+    return n;
 }
 
 
@@ -1894,7 +2133,7 @@ std::shared_ptr<AccountBin> Vault::getAccountBin(const std::string& account_name
     LOGGER(trace) << "Vault::getAccountBin(" << account_name << ", " << bin_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1918,7 +2157,7 @@ std::vector<AccountBinView> Vault::getAllAccountBinViews() const
     LOGGER(trace) << "Vault::getAllAccountBinViews()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     odb::result<AccountBinView> r(db_->query<AccountBinView>());
@@ -1932,7 +2171,7 @@ void Vault::exportAccountBin(const std::string& account_name, const std::string&
     LOGGER(trace) << "Vault::exportAccountBin(" << account_name << ", " << bin_name << ", " << filepath << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -1952,7 +2191,7 @@ std::shared_ptr<AccountBin> Vault::importAccountBin(const std::string& filepath)
 {
     LOGGER(trace) << "Vault::importAccountBin(" << filepath << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<AccountBin> bin = importAccountBin_unwrapped(filepath);
@@ -2054,7 +2293,7 @@ std::shared_ptr<Tx> Vault::getTx(const bytes_t& hash) const
     LOGGER(trace) << "Vault::getTx(" << uchar_vector(hash).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -2075,7 +2314,7 @@ std::shared_ptr<Tx> Vault::getTx(unsigned long tx_id) const
     LOGGER(trace) << "Vault::getTx(" << tx_id << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -2091,12 +2330,57 @@ std::shared_ptr<Tx> Vault::getTx_unwrapped(unsigned long tx_id) const
     return tx;
 }
 
+TxRawView Vault::getTxRawView(const bytes_t& hash) const
+{
+    LOGGER(trace) << "Vault::getTxRawView(" << uchar_vector(hash).getHex() << ")" << std::endl;
+
+#if defined(LOCK_ALL_CALLS)
+    boost::lock_guard<mutex_t> lock(mutex);
+#endif
+    odb::core::session s;
+    odb::core::transaction t(db_->begin());
+    return getTxRawView_unwrapped(hash);
+}
+
+TxRawView Vault::getTxRawView_unwrapped(const bytes_t& hash) const
+{
+    typedef odb::query<TxRawView> query_t;
+    odb::result<TxRawView> r(db_->query<TxRawView>(query_t::hash == hash || query_t::unsigned_hash == hash));
+    if (r.empty()) throw TxNotFoundException(hash);
+
+    TxRawView view(*r.begin());
+    fillTxRawView(*db_, view);
+    return view;
+}
+
+TxRawView Vault::getTxRawView(unsigned long tx_id) const
+{
+    LOGGER(trace) << "Vault::getTxRawView(" << tx_id << ")" << std::endl;
+
+#if defined(LOCK_ALL_CALLS)
+    boost::lock_guard<mutex_t> lock(mutex);
+#endif
+    odb::core::session s;
+    odb::core::transaction t(db_->begin());
+    return getTxRawView_unwrapped(tx_id);
+}
+
+TxRawView Vault::getTxRawView_unwrapped(unsigned long tx_id) const
+{
+    odb::result<TxRawView> r(db_->query<TxRawView>(odb::query<TxRawView>::id == tx_id));
+    if (r.empty()) throw TxNotFoundException();
+
+    TxRawView view(*r.begin());
+    fillTxRawView(*db_, view);
+    return view;
+}
+
 txs_t Vault::getTxs(int tx_status_flags, unsigned long start, int count, uint32_t minheight) const
 {
     LOGGER(trace) << "Vault::getTxs(" << Tx::getStatusString(tx_status_flags) << ", " << start << ", " << count << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -2138,7 +2422,7 @@ std::vector<std::string> Vault::getSerializedUnsignedTxs(const std::string& acco
     LOGGER(trace) << "Vault::getSerializedUnsignedTxs(" << account_name << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -2166,7 +2450,7 @@ uint32_t Vault::getTxConfirmations(const bytes_t& hash) const
     LOGGER(trace) << "Vault::getTxConfirmations(" << uchar_vector(hash).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -2179,7 +2463,7 @@ uint32_t Vault::getTxConfirmations(unsigned long tx_id) const
     LOGGER(trace) << "Vault::getTxConfirmations(" << tx_id << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -2192,7 +2476,7 @@ uint32_t Vault::getTxConfirmations(std::shared_ptr<Tx> tx) const
     LOGGER(trace) << "Vault::getTxConfirmations(tx: " << uchar_vector(tx->hash()).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -2205,9 +2489,10 @@ uint32_t Vault::getTxConfirmations_unwrapped(std::shared_ptr<Tx> tx) const
     return (getBestHeight_unwrapped() + 1 - tx->blockheader()->height());
 }
  
-std::vector<TxView> Vault::getTxViews(int tx_status_flags, unsigned long start, int count, uint32_t minheight) const
+unsigned int Vault::getTxViews(HistoryCursor& cursor, TxViewCallback callback, int tx_status_flags, int count, uint32_t minheight) const
 {
-    LOGGER(trace) << "Vault::getTxViews(" << Tx::getStatusString(tx_status_flags) << ", " << start << ", " << count << ")" << std::endl;
+    LOGGER(trace) << "Vault::getTxViews(" << cursor.blockheader_id << ":" << cursor.timestamp << ":" << cursor.tx_id << ", ..., " << Tx::getStatusString(tx_status_flags) << ", " << count << ", " << minheight << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.getTxViews");
 
     typedef odb::query<TxView> query_t;
     query_t query (1 == 1);
@@ -2222,31 +2507,59 @@ std::vector<TxView> Vault::getTxViews(int tx_status_flags, unsigned long start,
         query = query && (query_t::BlockHeader::height >= minheight);
     }
 
-    query += "ORDER BY" + query_t::BlockHeader::height + "DESC," + query_t::Tx::timestamp + "DESC," + query_t::Tx::id + "DESC";
-    if (start != 0 || count != -1)
+    if (!cursor.isStart())
+    {
+        query_t tx_query(
+            query_t::Tx::timestamp < cursor.timestamp ||
+            (query_t::Tx::timestamp == cursor.timestamp && query_t::Tx::id < cursor.tx_id));
+
+        // Unconfirmed txs have no block header and come after all confirmed ones.
+        if (cursor.blockheader_id != 0)
+        {
+            query = query && (
+                query_t::Tx::blockheader.is_null() ||
+                query_t::Tx::blockheader < cursor.blockheader_id ||
+                (query_t::Tx::blockheader == cursor.blockheader_id && tx_query));
+        }
+        else
+        {
+            query = query && query_t::Tx::blockheader.is_null() && tx_query;
+        }
+    }
+
+    query += "ORDER BY" + query_t::Tx::blockheader + "DESC," + query_t::Tx::timestamp + "DESC," + query_t::Tx::id + "DESC";
+    if (count != -1)
     {
-        if (count == -1) { count = 0xffffffff; } // TODO: do this correctly
         std::stringstream ss;
-        ss << "LIMIT " << start << "," << count;
+        ss << "LIMIT " << count;
         query = query + ss.str().c_str();
     }
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
-    std::vector<TxView> views;
+    unsigned int n = 0;
     odb::result<TxView> r(db_->query<TxView>(query));
-    for (auto& view: r) { views.push_back(view); }
-    return views; 
+    for (auto& view: r)
+    {
+        cursor.blockheader_id = view.blockheader_id;
+        cursor.timestamp = view.timestamp;
+        cursor.tx_id = view.id;
+        n++;
+
+        if (!callback(view)) break;
+    }
+    return n; 
 }
 
 std::shared_ptr<Tx> Vault::insertTx(std::shared_ptr<Tx> tx, bool replace_labels)
 {
     LOGGER(trace) << "Vault::insertTx(...) - hash: " << uchar_vector(tx->hash()).getHex() << ", unsigned hash: " << uchar_vector(tx->unsigned_hash()).getHex() << ", replace_labels: " << (replace_labels ? "true" : "false") << std::endl;
+    METRICS_TIME_SCOPE("vault.insertTx");
 
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         tx = insertTx_unwrapped(tx, replace_labels);
@@ -2262,7 +2575,6 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx, bool repla
     try
     {
         tx->updateStatus();
-        Coin::Transaction cointx(tx->toCoinCore());
         std::string hashstr = uchar_vector(tx->hash()).getHex();
         std::string unsignedhashstr = uchar_vector(tx->unsigned_hash()).getHex();
         LOGGER(trace) << "Vault::insertTx_unwrapped(...) - hash: " << hashstr << ", unsigned hash: " << unsignedhashstr << std::endl;
@@ -2276,8 +2588,6 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx, bool repla
             LOGGER(debug) << "Vault::insertTx_unwrapped - We have a transaction with the same unsigned hash: " << unsignedhashstr << std::endl;
             std::shared_ptr<Tx> stored_tx(tx_r.begin().load());
 
-            Coin::Transaction stored_cointx(stored_tx->toCoinCore());
-
             // Sanity check: TxIn and TxOut counts should match
             if (tx->txins().size() != stored_tx->txins().size() ||
                 tx->txouts().size() != stored_tx->txouts().size())
@@ -2347,6 +2657,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx, bool repla
                         db_->update(txin);
                         i++;
                     }
+                    stored_tx->updateRaw();
                     stored_tx->updateStatus(tx->status(), true);
                     db_->update(stored_tx);
                     updated = true;
@@ -2356,14 +2667,13 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx, bool repla
                     // The transaction we received is unsigned but might have more signatures. Merge signatures
                     bool sigs_updated = false;
                     std::size_t i = 0;
-                    txins_t txins = tx->txins();
+                    TxSignatureState stored_sigstate(*stored_tx);
+                    TxSignatureState new_sigstate(*tx);
                     for (auto& txin: stored_tx->txins())
                     {
                         using namespace CoinQ::Script;
-                        uint64_t outpointvalue = txin->outpoint() ? txin->outpoint()->value() : 0;
-                        SignableTxIn stored_stxin(stored_cointx, i, outpointvalue);
-                        SignableTxIn new_stxin(cointx, i, outpointvalue); 
-                        unsigned int sigsadded = stored_stxin.mergesigs(new_stxin);
+                        SignableTxIn stored_stxin(stored_sigstate.signabletxin(i));
+                        unsigned int sigsadded = stored_stxin.mergesigs(new_sigstate.signabletxin(i));
                         if (sigsadded > 0)
                         {
                             int sigsneeded = stored_stxin.sigsneeded();
@@ -2380,6 +2690,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx, bool repla
 
                     if (sigs_updated)
                     {
+                        stored_tx->updateRaw();
                         stored_tx->updateStatus(Tx::NO_STATUS, true);
                         db_->update(stored_tx);
                         updated = true;
@@ -2412,7 +2723,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx, bool repla
             if (!updated) return nullptr;
 
             updateConfirmations_unwrapped(stored_tx);
-            signalQueue.push(notifyTxUpdated.bind(stored_tx));
+            signalQueue.push(notifyTxUpdated.bind(stored_tx), txUpdatedKey(stored_tx));
             return stored_tx;
         }
 
@@ -2427,6 +2738,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx, bool repla
         bool sent_from_vault = false; // whether any of the inputs belong to vault
         std::shared_ptr<Account> sending_account;
 
+        TxSignatureState sigstate(*tx);
         for (auto& txin: tx->txins())
         {
             // Check if inputs connect
@@ -2438,8 +2750,7 @@ std::shared_ptr<Tx> Vault::insertTx_unwrapped(std::shared_ptr<Tx> tx, bool repla
                 bytes_t txoutscript;
                 try
                 {
-                    CoinQ::Script::SignableTxIn signabletxin(cointx, txin->txindex(), 0);
-                    txoutscript = signabletxin.txoutscript();
+                    txoutscript = sigstate.signabletxin(txin->txindex()).txoutscript();
 LOGGER(trace) << "txoutscript!!! " << uchar_vector(txoutscript).getHex() << std::endl;
                 }
                 catch (const std::exception& e)
@@ -2573,7 +2884,7 @@ LOGGER(trace) << "txoutscript!!! " << uchar_vector(txoutscript).getHex() << std:
                 {
                     conflicting_tx->conflicting(true);
                     db_->update(conflicting_tx);
-                    signalQueue.push(notifyTxUpdated.bind(conflicting_tx));
+                    signalQueue.push(notifyTxUpdated.bind(conflicting_tx), txUpdatedKey(conflicting_tx));
                     //notifyTxUpdated(conflicting_tx);
                 }
             }
@@ -2607,6 +2918,7 @@ LOGGER(trace) << "txoutscript!!! " << uchar_vector(txoutscript).getHex() << std:
     }
     catch (...)
     {
+        pendingConfirmationsLoaded_ = false;
         signalQueue.clear();
         throw;
     }
@@ -2614,6 +2926,7 @@ LOGGER(trace) << "txoutscript!!! " << uchar_vector(txoutscript).getHex() << std:
 
 std::shared_ptr<Tx> Vault::insertNewTx(const Coin::Transaction& cointx, std::shared_ptr<BlockHeader> blockheader, bool verifysigs, bool isCoinbase)
 {
+    METRICS_TIME_SCOPE("vault.insertNewTx");
     std::stringstream ss;
     ss << "Vault::insertNewTx(" << cointx.hash().getHex() << ", ";
     if (blockheader)    { ss << uchar_vector(blockheader->hash()).getHex(); }
@@ -2623,7 +2936,7 @@ std::shared_ptr<Tx> Vault::insertNewTx(const Coin::Transaction& cointx, std::sha
 
     std::shared_ptr<Tx> tx;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         tx = insertNewTx_unwrapped(cointx, blockheader, verifysigs, isCoinbase);
@@ -2654,9 +2967,9 @@ std::shared_ptr<Tx> Vault::insertNewTx_unwrapped(const Coin::Transaction& cointx
                 for (auto& txin: stored_tx->txins())
                 {
                     outpointvalues.push_back(txin->outpoint() ? txin->outpoint()->value() : 0);
-                    Signer signer(cointx, outpointvalues);
-                    if (signer.sigsneeded()) throw TxNotSignedException(cointx.hash());
                 }
+                Signer signer(cointx, outpointvalues);
+                if (signer.sigsneeded()) throw TxNotSignedException(cointx.hash());
             }
 
             if (stored_tx->status() < Tx::CONFIRMED)
@@ -2676,10 +2989,11 @@ std::shared_ptr<Tx> Vault::insertNewTx_unwrapped(const Coin::Transaction& cointx
                     db_->update(txin);
                 }
 
+                stored_tx->updateRaw();
                 stored_tx->updateStatus(tx->status());
                 stored_tx->blockheader(blockheader);
                 db_->update(stored_tx);
-                signalQueue.push(notifyTxUpdated.bind(stored_tx));
+                signalQueue.push(notifyTxUpdated.bind(stored_tx), txUpdatedKey(stored_tx));
                 return stored_tx; 
             }
             return nullptr;
@@ -2696,12 +3010,13 @@ std::shared_ptr<Tx> Vault::insertNewTx_unwrapped(const Coin::Transaction& cointx
 
         if (!isCoinbase)
         {
+            TxSignatureState sigstate(*tx);
             for (auto& txin: tx->txins())
             {
                 bytes_t unsigned_script;
                 try
                 {
-                    unsigned_script = txin->unsigned_script();
+                    unsigned_script = sigstate.unsigned_script(txin->txindex());
                 }
                 catch (const std::exception& e)
                 {
@@ -2799,17 +3114,23 @@ std::shared_ptr<Tx> Vault::insertNewTx_unwrapped(const Coin::Transaction& cointx
 std::shared_ptr<Tx> Vault::insertMerkleTx(const ChainMerkleBlock& chainmerkleblock, const Coin::Transaction& cointx, unsigned int txindex, unsigned int txcount, bool verifysigs, bool isCoinbase)
 {
     LOGGER(trace) << "Vault::insertMerkleTx(" << chainmerkleblock.hash().getHex() << ", " << cointx.hash().getHex() << ", " << txindex << ", " << txcount << ", " << (verifysigs ? "true" : "false") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.insertMerkleTx");
+    TRACE_SPAN(span, "Vault::insertMerkleTx");
+    if (span) { span.arg("tx", cointx.hash().getHex()).arg("block", chainmerkleblock.hash().getHex()).arg("height", chainmerkleblock.height); }
 
     std::shared_ptr<Tx> tx;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         tx = insertMerkleTx_unwrapped(chainmerkleblock, cointx, txindex, txcount, verifysigs, isCoinbase);
         t.commit();
     }
 
-    signalQueue.flush();
+    {
+        TRACE_SPAN(flushSpan, "SignalQueue::flush");
+        signalQueue.flush();
+    }
     return tx;
 }
 
@@ -2853,7 +3174,7 @@ std::shared_ptr<Tx> Vault::insertMerkleTx_unwrapped(const ChainMerkleBlock& chai
                         std::shared_ptr<Tx> tx(it.load());
                         tx->blockheader(nullptr);
                         db_->update(tx);
-                        signalQueue.push(notifyTxUpdated.bind(tx));
+                        signalQueue.push(notifyTxUpdated.bind(tx), txUpdatedKey(tx));
                     }
                 }
 
@@ -2871,6 +3192,7 @@ std::shared_ptr<Tx> Vault::insertMerkleTx_unwrapped(const ChainMerkleBlock& chai
 
                 // TODO: test and use the following instead of the above three code blocks
                 //deleteMerkleBlock_unwrapped((uint32_t)chainmerkleblock.height);
+                prunePendingConfirmations_unwrapped((uint32_t)chainmerkleblock.height);
 
                 // Instantiate the new merkle block and store
                 merkleblock = std::make_shared<MerkleBlock>(chainmerkleblock);
@@ -2890,7 +3212,7 @@ std::shared_ptr<Tx> Vault::insertMerkleTx_unwrapped(const ChainMerkleBlock& chai
                 tx->status(Tx::CONFIRMED);
                 tx->conflicting(false);
                 db_->update(tx);
-                signalQueue.push(notifyTxUpdated.bind(tx));
+                signalQueue.push(notifyTxUpdated.bind(tx), txUpdatedKey(tx));
             }
             else
             {
@@ -2916,6 +3238,7 @@ std::shared_ptr<Tx> Vault::insertMerkleTx_unwrapped(const ChainMerkleBlock& chai
                         txin->fromCoinCore(cointx.inputs[i++]);
                         db_->update(txin);
                     }
+                    tx->updateRaw();
 
                     // Another sanity check - compare hashes
                     if (tx->toCoinCore().hash() != txhash)
@@ -2927,7 +3250,7 @@ std::shared_ptr<Tx> Vault::insertMerkleTx_unwrapped(const ChainMerkleBlock& chai
                     tx->status(Tx::CONFIRMED);
                     tx->conflicting(false);
                     db_->update(tx);
-                    signalQueue.push(notifyTxUpdated.bind(tx));
+                    signalQueue.push(notifyTxUpdated.bind(tx), txUpdatedKey(tx));
                 }
             } 
         }
@@ -2946,6 +3269,8 @@ std::shared_ptr<Tx> Vault::insertMerkleTx_unwrapped(const ChainMerkleBlock& chai
             }
         }
 
+        if (tx) { pendingConfirmations_.erase(txhash); }
+
         if (txindex + 1 == txcount)
         {
             merkleblock->txsinserted(true);
@@ -2957,6 +3282,7 @@ std::shared_ptr<Tx> Vault::insertMerkleTx_unwrapped(const ChainMerkleBlock& chai
     }
     catch (...)
     {
+        pendingConfirmationsLoaded_ = false;
         signalQueue.clear();
         throw;
     }
@@ -2965,10 +3291,11 @@ std::shared_ptr<Tx> Vault::insertMerkleTx_unwrapped(const ChainMerkleBlock& chai
 std::shared_ptr<Tx> Vault::confirmMerkleTx(const ChainMerkleBlock& chainmerkleblock, const bytes_t& txhash, unsigned int txindex, unsigned int txcount)
 {
     LOGGER(trace) << "Vault::confirmMerkleTx(" << chainmerkleblock.hash().getHex() << ", " << uchar_vector(txhash).getHex() << ", " << txindex << ", " << txcount << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.confirmMerkleTx");
 
     std::shared_ptr<Tx> tx;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         tx = confirmMerkleTx_unwrapped(chainmerkleblock, txhash, txindex, txcount);
@@ -3018,7 +3345,7 @@ std::shared_ptr<Tx> Vault::confirmMerkleTx_unwrapped(const ChainMerkleBlock& cha
                         std::shared_ptr<Tx> tx(it.load());
                         tx->status(Tx::PROPAGATED);
                         db_->update(tx);
-                        signalQueue.push(notifyTxUpdated.bind(tx));
+                        signalQueue.push(notifyTxUpdated.bind(tx), txUpdatedKey(tx));
                     }
                 }
 
@@ -3037,6 +3364,7 @@ std::shared_ptr<Tx> Vault::confirmMerkleTx_unwrapped(const ChainMerkleBlock& cha
 
                 // TODO: test and use the following instead of the above three code blocks
                 //deleteMerkleBlock_unwrapped((uint32_t)chainmerkleblock.height);
+                prunePendingConfirmations_unwrapped((uint32_t)chainmerkleblock.height);
 
                 // Instantiate the new merkle block and store
                 merkleblock = std::make_shared<MerkleBlock>(chainmerkleblock);
@@ -3054,9 +3382,11 @@ std::shared_ptr<Tx> Vault::confirmMerkleTx_unwrapped(const ChainMerkleBlock& cha
             tx->status(Tx::CONFIRMED);
             tx->conflicting(false);
             db_->update(tx);
-            signalQueue.push(notifyTxUpdated.bind(tx));
+            signalQueue.push(notifyTxUpdated.bind(tx), txUpdatedKey(tx));
         }
 
+        if (tx) { pendingConfirmations_.erase(txhash); }
+
         if (txindex + 1 == txcount)
         {
             merkleblock->txsinserted(true);
@@ -3068,6 +3398,7 @@ std::shared_ptr<Tx> Vault::confirmMerkleTx_unwrapped(const ChainMerkleBlock& cha
     }
     catch (...)
     {
+        pendingConfirmationsLoaded_ = false;
         signalQueue.clear();
         throw;
     }
@@ -3076,10 +3407,11 @@ std::shared_ptr<Tx> Vault::confirmMerkleTx_unwrapped(const ChainMerkleBlock& cha
 std::shared_ptr<Tx> Vault::createTx(const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, txouts_t txouts, uint64_t fee, unsigned int maxchangeouts, bool insert)
 {
     LOGGER(trace) << "Vault::createTx(" << account_name << ", " << tx_version << ", " << tx_locktime << ", " << txouts.size() << " txout(s), " << fee << ", " << maxchangeouts << ", " << (insert ? "insert" : "no insert") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.createTx");
 
     std::shared_ptr<Tx> tx;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         tx = createTx_unwrapped(account_name, tx_version, tx_locktime, txouts, fee, maxchangeouts);
@@ -3108,17 +3440,9 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& account_name, u
     }
 
     std::shared_ptr<Account> account = getAccount_unwrapped(account_name);
-
-    // TODO: Better coin selection
-    typedef odb::query<TxOutView> query_t;
-    odb::result<TxOutView> utxoview_r(db_->query<TxOutView>(query_t::Tx::status > Tx::UNSIGNED && query_t::TxOut::status == TxOut::UNSPENT && query_t::receiving_account::id == account->id()));
-    std::vector<TxOutView> utxoviews;
-    for (auto& utxoview: utxoview_r) { utxoviews.push_back(utxoview); }
-   
-    std::random_shuffle(utxoviews.begin(), utxoviews.end(), [](int i) { return std::rand() % i; });
+    std::vector<TxOutView> utxoviews = selectCoins_unwrapped(account, desired_total, fee, txouts);
 
     txins_t txins;
-    int i = 0;
     uint64_t total = 0;
     for (auto& utxoview: utxoviews)
     {
@@ -3133,15 +3457,13 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& account_name, u
             txin->scriptwitnessstack(stack);
         }
         txins.push_back(txin);
-        i++;
-        if (total >= desired_total) break;
     }
-    if (total < desired_total) throw AccountInsufficientFundsException(account_name, desired_total, total); 
+    std::random_shuffle(txins.begin(), txins.end(), [](int i) { return std::rand() % i; });
 
-    utxoviews.resize(i);
+    // Change too small to be worth spending is left to the fee.
     uint64_t change = total - desired_total;
 
-    if (change > 0)
+    if (change >= MIN_CHANGE)
     {
         std::shared_ptr<AccountBin> bin = getAccountBin_unwrapped(account_name, CHANGE_BIN_NAME);
         std::shared_ptr<SigningScript> changescript = issueAccountBinSigningScript_unwrapped(bin);
@@ -3157,13 +3479,78 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& account_name, u
     return tx;
 }
 
+std::vector<TxOutView> Vault::selectCoins_unwrapped(std::shared_ptr<Account> account, uint64_t desired_total, uint64_t fee, const txouts_t& txouts, uint32_t min_confirmations, const ids_t& txin_ids) const
+{
+    // Everything in the tx but the coins picked here: the outputs, a change output and the inputs it already has.
+    TxSizeModel size_model(account->minsigs(), account->use_witness(), account->use_witness_p2sh());
+    std::size_t txin_size = size_model.txinSize(TxSizeModel::multisigRedeemscriptSize(account->keychains().size(), account->compressed_keys()));
+    std::size_t fixed_size = size_model.txoutSize(size_model.changeScriptSize()) + txin_ids.size() * txin_size;
+    for (auto& txout: txouts) { fixed_size += size_model.txoutSize(txout->script().empty() ? size_model.changeScriptSize() : txout->script().size()); }
+    auto txSize = [&](std::size_t txin_count) { return size_model.overheadSize(txin_ids.size() + txin_count, txouts.size() + 1) + fixed_size + txin_count * txin_size; };
+
+    // Each coin is charged what its input adds to the fee, at the rate the fee pays for the smallest tx with these outputs,
+    // so coins worth less than that are never picked and fewer inputs are preferred.
+    uint64_t fee_per_input = fee * txin_size / txSize(1);
+
+    typedef odb::query<TxOutValueView> query_t;
+    query_t query(query_t::Tx::status > Tx::UNSIGNED && query_t::TxOut::status == TxOut::UNSPENT && query_t::receiving_account::id == account->id());
+
+    if (min_confirmations > 0)
+    {
+        uint32_t best_height = getBestHeight_unwrapped();
+        if (min_confirmations > best_height) throw AccountInsufficientFundsException(account->name(), desired_total, 0);
+        query = (query && query_t::BlockHeader::height <= best_height + 1 - min_confirmations);
+    }
+
+    query += "ORDER BY" + query_t::TxOut::value + "DESC";
+
+    // Coins already spent are skipped here rather than bound into the query, which could exceed the parameter limit.
+    std::set<unsigned long> excluded(txin_ids.begin(), txin_ids.end());
+
+    ids_t ids;
+    std::vector<uint64_t> values;
+    odb::result<TxOutValueView> r(db_->query<TxOutValueView>(query));
+    for (auto& view: r)
+    {
+        if (excluded.count(view.id)) continue;
+        ids.push_back(view.id);
+        values.push_back(view.value);
+    }
+
+    // Prefer an exact enough match that needs no change, then fall back to the closest set that leaves enough change to be worth keeping.
+    CoinSelector selector(values, fee_per_input);
+    CoinSelector::selection_t selection;
+    if (!selector.branchAndBound(desired_total, MIN_CHANGE, selection) && !selector.knapsack(desired_total, MIN_CHANGE, selection))
+        throw AccountInsufficientFundsException(account->name(), desired_total, selector.total());
+
+    // Too many inputs to relay - the largest coins are the fewest that can do it.
+    if (txSize(selection.size()) > MAX_STANDARD_TX_SIZE)
+    {
+        selector.largestFirst(desired_total, selection);
+        if (txSize(selection.size()) > MAX_STANDARD_TX_SIZE) throw TxTooLargeException(txSize(selection.size()));
+    }
+
+    LOGGER(debug) << "Vault::selectCoins_unwrapped - selected " << selection.size() << " of " << values.size() << " coins, " << selector.total(selection) << " for " << desired_total << std::endl;
+
+    ids_t selected_ids;
+    for (auto i: selection) { selected_ids.push_back(ids[i]); }
+
+    std::vector<TxOutView> utxoviews;
+    forEachIdChunk(selected_ids, [&](ids_t::const_iterator begin, ids_t::const_iterator end) {
+        odb::result<TxOutView> utxoview_r(db_->query<TxOutView>(odb::query<TxOutView>::TxOut::id.in_range(begin, end)));
+        for (auto& utxoview: utxoview_r) { utxoviews.push_back(utxoview); }
+    });
+    return utxoviews;
+}
+
 std::shared_ptr<Tx> Vault::createTx(const std::string& username, const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, txouts_t txouts, uint64_t fee, unsigned int maxchangeouts, bool insert)
 {
     LOGGER(trace) << "Vault::createTx(" << username << ", " << account_name << ", " << tx_version << ", " << tx_locktime << ", " << txouts.size() << " txout(s), " << fee << ", " << maxchangeouts << ", " << (insert ? "insert" : "no insert") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.createTx");
 
     std::shared_ptr<Tx> tx;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         tx = createTx_unwrapped(username, account_name, tx_version, tx_locktime, txouts, fee, maxchangeouts);
@@ -3208,10 +3595,11 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& username, const
 std::shared_ptr<Tx> Vault::createTx(const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, txouts_t txouts, uint64_t fee, uint32_t min_confirmations, bool insert)
 {
     LOGGER(trace) << "Vault::createTx(" << account_name << ", " << tx_version << ", " << tx_locktime << ", " << coin_ids.size() << " txin(s), " << txouts.size() << " txout(s), " << fee << ", " << min_confirmations << ", " << (insert ? "insert" : "no insert") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.createTx");
 
     std::shared_ptr<Tx> tx;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         tx = createTx_unwrapped(account_name, tx_version, tx_locktime, coin_ids, txouts, fee, min_confirmations);
@@ -3252,35 +3640,30 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& account_name, u
     txins_t txins;
     if (!coin_ids.empty())
     {
-        odb::result<TxOutView> utxoview_r(db_->query<TxOutView>(base_query && query_t::TxOut::id.in_range(coin_ids.begin(), coin_ids.end())));
-        for (auto& utxoview: utxoview_r)
-        {
-            std::shared_ptr<TxIn> txin(new TxIn(utxoview.tx_hash, utxoview.tx_index, utxoview.signingscript_txinscript, 0xffffffff));
-            if (account->use_witness())
+        forEachIdChunk(coin_ids, [&](ids_t::const_iterator begin, ids_t::const_iterator end) {
+            odb::result<TxOutView> utxoview_r(db_->query<TxOutView>(base_query && query_t::TxOut::id.in_range(begin, end)));
+            for (auto& utxoview: utxoview_r)
             {
-                using namespace CoinQ::Script;
-                scriptstack_t stack;
-                for (std::size_t k = 0; k <= account->keychains().size(); k++) { stack.push_back(bytes_t()); }
-                stack.push_back(utxoview.signingscript_redeemscript); 
-                txin->scriptwitnessstack(stack);
+                std::shared_ptr<TxIn> txin(new TxIn(utxoview.tx_hash, utxoview.tx_index, utxoview.signingscript_txinscript, 0xffffffff));
+                if (account->use_witness())
+                {
+                    using namespace CoinQ::Script;
+                    scriptstack_t stack;
+                    for (std::size_t k = 0; k <= account->keychains().size(); k++) { stack.push_back(bytes_t()); }
+                    stack.push_back(utxoview.signingscript_redeemscript); 
+                    txin->scriptwitnessstack(stack);
+                }
+                txins.push_back(txin);
+                input_total += utxoview.value;
             }
-            txins.push_back(txin);
-            input_total += utxoview.value;
-        }
+        });
         if (txins.size() < coin_ids.size()) throw TxInvalidInputsException();
     }
 
     // If the supplied inputs are insufficient, automatically add more
-    // TODO; Better coin selection heuristics
     if (input_total < desired_total)
     {
-        query_t query(base_query);
-        if (!coin_ids.empty()) { query = (query && !query_t::TxOut::id.in_range(coin_ids.begin(), coin_ids.end())); }
-        odb::result<TxOutView> utxoview_r(db_->query<TxOutView>(query));
-        std::vector<TxOutView> utxoviews;
-        for (auto& utxoview: utxoview_r) { utxoviews.push_back(utxoview); }
-        std::random_shuffle(utxoviews.begin(), utxoviews.end(), [](int i) { return std::rand() % i; });
-
+        std::vector<TxOutView> utxoviews = selectCoins_unwrapped(account, desired_total - input_total, fee, txouts, min_confirmations, coin_ids);
         for (auto& utxoview: utxoviews)
         {
             std::shared_ptr<TxIn> txin(new TxIn(utxoview.tx_hash, utxoview.tx_index, utxoview.signingscript_txinscript, 0xffffffff));
@@ -3294,9 +3677,7 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& account_name, u
             }
             txins.push_back(txin);
             input_total += utxoview.value;
-            if (input_total >= desired_total) break;
         }
-        if (input_total < desired_total) throw AccountInsufficientFundsException(account_name, desired_total, input_total);
     }
  
     // Use supplied outputs first
@@ -3312,8 +3693,9 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& account_name, u
     }
 
     // If supplied change amounts are insufficient, add another change output
+    // Change too small to be worth spending is left to the fee.
     uint64_t change = input_total - desired_total;
-    if (change > 0)
+    if (change >= MIN_CHANGE)
     {
         if (!change_bin) { change_bin = getAccountBin_unwrapped(account_name, CHANGE_BIN_NAME); }
         std::shared_ptr<SigningScript> changescript = issueAccountBinSigningScript_unwrapped(change_bin);
@@ -3334,10 +3716,11 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& account_name, u
 std::shared_ptr<Tx> Vault::createTx(const std::string& username, const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, txouts_t txouts, uint64_t fee, uint32_t min_confirmations, bool insert)
 {
     LOGGER(trace) << "Vault::createTx(" << username << ", " << account_name << ", " << tx_version << ", " << tx_locktime << ", " << coin_ids.size() << " txin(s), " << txouts.size() << " txout(s), " << fee << ", " << min_confirmations << ", " << (insert ? "insert" : "no insert") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.createTx");
 
     std::shared_ptr<Tx> tx;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         tx = createTx_unwrapped(username, account_name, tx_version, tx_locktime, coin_ids, txouts, fee, min_confirmations);
@@ -3369,146 +3752,218 @@ std::shared_ptr<Tx> Vault::createTx_unwrapped(const std::string& username, const
     return tx;
 }
 
-txs_t Vault::consolidateTxOuts(const std::string& account_name, uint32_t max_tx_size, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations, bool insert)
+txs_t Vault::consolidateTxOuts(const std::string& account_name, uint32_t max_tx_size, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations, bool insert, ConsolidationProgressCallback progress)
 {
     LOGGER(trace) << "Vault::consolidateTxOuts(" << account_name << ", " << max_tx_size << ", " << tx_version << ", " << tx_locktime << ", " << coin_ids.size() << " txin(s), " << uchar_vector(txoutscript).getHex() << ", " << min_fee << ", " << min_confirmations << ", " << (insert ? "insert" : "no insert") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.consolidateTxOuts");
 
-    txs_t txs;
+    std::shared_ptr<Account> account;
+    std::vector<std::vector<TxOutView>> plan;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
-        txs = consolidateTxOuts_unwrapped(account_name, max_tx_size, tx_version, tx_locktime, coin_ids, txoutscript, min_fee, min_confirmations);
-        if (insert)
-        {
-            bool bInserted = false;
-            for (auto& tx: txs)
-            {
-                tx = insertTx_unwrapped(tx);
-                if (tx) { bInserted = true; }
-            }
-            if (bInserted) t.commit();
-        }
+        account = getAccount_unwrapped(account_name);
+        plan = planConsolidation_unwrapped(account, max_tx_size, coin_ids, txoutscript, min_fee, min_confirmations);
+    }
+
+    txs_t txs = buildConsolidationTxs(account, plan, tx_version, tx_locktime, txoutscript, min_fee, progress);
+
+    if (insert)
+    {
+        boost::lock_guard<mutex_t> lock(mutex);
+        odb::core::session s;
+        odb::core::transaction t(db_->begin());
+        if (insertConsolidationTxs_unwrapped(txs, progress)) t.commit();
     }
 
     signalQueue.flush();
     return txs;
 }
 
-txs_t Vault::consolidateTxOuts(const std::string& username, const std::string& account_name, uint32_t max_tx_size, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations, bool insert)
+txs_t Vault::consolidateTxOuts(const std::string& username, const std::string& account_name, uint32_t max_tx_size, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations, bool insert, ConsolidationProgressCallback progress)
 {
     LOGGER(trace) << "Vault::consolidateTxOuts(" << username << ", " << account_name << ", " << max_tx_size << ", " << tx_version << ", " << tx_locktime << ", " << coin_ids.size() << " txin(s), " << uchar_vector(txoutscript).getHex() << ", " << min_fee << ", " << min_confirmations << ", " << (insert ? "insert" : "no insert") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.consolidateTxOuts");
 
-    std::shared_ptr<User> user = getUser_unwrapped(username);
+    std::shared_ptr<User> user;
+    std::shared_ptr<Account> account;
+    std::vector<std::vector<TxOutView>> plan;
+    {
+        boost::lock_guard<mutex_t> lock(mutex);
+        odb::core::session s;
+        odb::core::transaction t(db_->begin());
+        user = getUser_unwrapped(username);
+        account = getAccount_unwrapped(account_name);
+        plan = planConsolidation_unwrapped(account, max_tx_size, coin_ids, txoutscript, min_fee, min_confirmations);
+    }
 
-    txs_t txs;
+    txs_t txs = buildConsolidationTxs(account, plan, tx_version, tx_locktime, txoutscript, min_fee, progress);
+    for (auto& tx: txs) { tx->user(user); }
+
+    if (insert)
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
-        txs = consolidateTxOuts_unwrapped(account_name, max_tx_size, tx_version, tx_locktime, coin_ids, txoutscript, min_fee, min_confirmations);
-        bool bInserted = false;
-        for (auto& tx: txs)
-        {
-            tx->user(user); 
-            if (insert)
-            {
-                tx = insertTx_unwrapped(tx);
-                if (tx) { bInserted = true; }
-            }
-        }
-        if (bInserted) t.commit();
+        if (insertConsolidationTxs_unwrapped(txs, progress)) t.commit();
     }
 
     signalQueue.flush();
     return txs;
 }
 
-txs_t Vault::consolidateTxOuts_unwrapped(const std::string& account_name, uint32_t max_tx_size, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations)
+std::vector<std::vector<TxOutView>> Vault::planConsolidation_unwrapped(std::shared_ptr<Account> account, uint32_t max_tx_size, const ids_t& coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations) const
 {
-    std::shared_ptr<Account> account = getAccount_unwrapped(account_name);
-
     typedef odb::query<TxOutView> query_t;
-    query_t base_query(query_t::Tx::status > Tx::UNSIGNED && query_t::TxOut::status == TxOut::UNSPENT && query_t::receiving_account::id == account->id());
+    query_t query(query_t::Tx::status > Tx::UNSIGNED && query_t::TxOut::status == TxOut::UNSPENT && query_t::receiving_account::id == account->id());
 
     if (min_confirmations > 0)
     {
         uint32_t best_height = getBestHeight_unwrapped();
-        if (min_confirmations > best_height) throw AccountInsufficientFundsException(account_name, 0, 0);
-        base_query = (base_query && query_t::BlockHeader::height <= best_height + 1 - min_confirmations);
+        if (min_confirmations > best_height) throw AccountInsufficientFundsException(account->name(), 0, 0);
+        query = (query && query_t::BlockHeader::height <= best_height + 1 - min_confirmations);
     }
 
-    odb::result<TxOutView> utxoview_r;
-    if (coin_ids.empty())
-    {
-        utxoview_r = db_->query<TxOutView>(base_query);
-    }
-    else
-    {
-        utxoview_r = db_->query<TxOutView>(base_query && query_t::TxOut::id.in_range(coin_ids.begin(), coin_ids.end()));
+    // Largest first, so each tx gathers as much value as it can within max_tx_size.
+    if (!coin_ids.empty()) { query = (query && query_t::TxOut::id.in_range(coin_ids.begin(), coin_ids.end())); }
+    query += "ORDER BY" + query_t::TxOut::value + "DESC";
+
+    TxSizeModel size_model(account->minsigs(), account->use_witness(), account->use_witness_p2sh());
+    std::size_t txout_size = size_model.txoutSize(txoutscript.size());
+
+    std::vector<std::vector<TxOutView>> plan;
+    std::vector<TxOutView> txins;
+    std::size_t txins_size = 0;
+    uint64_t input_total = 0;
+    std::size_t coin_count = 0;
+
+    // Tx groups that would not cover min_fee are dropped. Coins come largest first, so only the last ones can be short.
+    auto closeTx = [&]() {
+        if (input_total > min_fee) { plan.push_back(std::move(txins)); }
+        else { LOGGER(debug) << "Vault::planConsolidation_unwrapped - leaving out " << txins.size() << " coin(s) worth " << input_total << ", not more than the fee." << std::endl; }
+        txins.clear();
+        txins_size = 0;
+        input_total = 0;
+    };
+
+    odb::result<TxOutView> utxoview_r(db_->query<TxOutView>(query));
+    for (auto& utxoview: utxoview_r)
+    {
+        coin_count++;
+        std::size_t txin_size = size_model.txinSize(utxoview.signingscript_redeemscript.size());
+        if (size_model.overheadSize(txins.size() + 1, 1) + txins_size + txin_size + txout_size > max_tx_size)
+        {
+            if (txins.empty()) throw std::runtime_error("Vault::planConsolidation_unwrapped() - maximum transaction size is too small.");
+            closeTx();
+        }
+
+        txins.push_back(utxoview);
+        txins_size += txin_size;
+        input_total += utxoview.value;
     }
+    if (coin_count < coin_ids.size()) throw TxInvalidInputsException();
+    if (!txins.empty()) { closeTx(); }
 
-    std::vector<TxOutView> utxoviews;
-    for (auto& utxoview: utxoview_r) { utxoviews.push_back(utxoview); }
-    if (utxoviews.size() < coin_ids.size()) throw TxInvalidInputsException();
+    LOGGER(debug) << "Vault::planConsolidation_unwrapped - " << coin_count << " coin(s) in " << plan.size() << " tx(s)." << std::endl;
+    return plan;
+}
 
-    // TODO: Better rng seeding
-    std::srand(std::time(0));
-    std::random_shuffle(utxoviews.begin(), utxoviews.end(), [](int i) { return std::rand() % i; });
+txs_t Vault::buildConsolidationTxs(std::shared_ptr<Account> account, const std::vector<std::vector<TxOutView>>& plan, uint32_t tx_version, uint32_t tx_locktime, const bytes_t& txoutscript, uint64_t min_fee, const ConsolidationProgressCallback& progress) const
+{
+    bool use_witness = account->use_witness();
+    std::size_t keychain_count = account->keychains().size();
+    uint32_t timestamp = time(NULL);
 
-    txins_t txins;
-    uint64_t input_total = 0;
+    // Tx::set serializes and hashes the whole tx, which is what takes the time with thousands of inputs.
+    auto buildTx = [&](const std::vector<TxOutView>& utxoviews) {
+        txins_t txins;
+        uint64_t input_total = 0;
+        for (auto& utxoview: utxoviews)
+        {
+            std::shared_ptr<TxIn> txin(new TxIn(utxoview.tx_hash, utxoview.tx_index, utxoview.signingscript_txinscript, 0xffffffff));
+            if (use_witness)
+            {
+                using namespace CoinQ::Script;
+                scriptstack_t stack;
+                for (std::size_t k = 0; k <= keychain_count; k++) { stack.push_back(bytes_t()); }
+                stack.push_back(utxoview.signingscript_redeemscript);
+                txin->scriptwitnessstack(stack);
+            }
+            txins.push_back(txin);
+            input_total += utxoview.value;
+        }
 
-    std::shared_ptr<Tx> test_tx = std::make_shared<Tx>();
-    txs_t txs;
-    std::shared_ptr<TxOut> txout = std::make_shared<TxOut>(0, txoutscript);
-    txouts_t txouts;
-    txouts.push_back(txout);
-    for (auto& utxoview: utxoviews)
-    {
-        std::shared_ptr<TxIn> txin(new TxIn(utxoview.tx_hash, utxoview.tx_index, utxoview.signingscript_txinscript, 0xffffffff));
-        if (account->use_witness())
+        txouts_t txouts;
+        txouts.push_back(std::make_shared<TxOut>(input_total - min_fee, txoutscript));
+
+        std::shared_ptr<Tx> tx = std::make_shared<Tx>();
+        tx->set(tx_version, txins, txouts, tx_locktime, timestamp, Tx::UNSIGNED);
+        return tx;
+    };
+
+    txs_t txs(plan.size());
+    std::atomic<std::size_t> next(0);
+    std::size_t built = 0;
+    boost::mutex progress_mutex;
+    std::exception_ptr error;
+
+    auto worker = [&]() {
+        while (true)
         {
-            using namespace CoinQ::Script;
-            scriptstack_t stack;
-            for (std::size_t k = 0; k <= account->keychains().size(); k++) { stack.push_back(bytes_t()); }
-            stack.push_back(utxoview.signingscript_redeemscript); 
-            txin->scriptwitnessstack(stack);
+            std::size_t i = next++;
+            if (i >= plan.size()) return;
+
+            try
+            {
+                txs[i] = buildTx(plan[i]);
+            }
+            catch (...)
+            {
+                boost::lock_guard<boost::mutex> lock(progress_mutex);
+                if (!error) { error = std::current_exception(); }
+                next = plan.size();
+                return;
+            }
+
+            boost::lock_guard<boost::mutex> lock(progress_mutex);
+            built++;
+            if (progress && !error) { progress(ConsolidationProgress { ConsolidationProgress::BUILDING, built, plan.size() }); }
         }
-        txins.push_back(txin);
-        test_tx->set(tx_version, txins, txouts, tx_locktime, time(NULL), Tx::UNSIGNED);
-        if (test_tx->raw().size() > max_tx_size)
+    };
+
+    std::size_t thread_count = std::min<std::size_t>(std::max(boost::thread::hardware_concurrency(), 1u), plan.size());
+    boost::thread_group threads;
+    for (std::size_t i = 1; i < thread_count; i++) { threads.create_thread(worker); }
+    worker();
+    threads.join_all();
+
+    if (error) std::rethrow_exception(error);
+    return txs;
+}
+
+bool Vault::insertConsolidationTxs_unwrapped(txs_t& txs, const ConsolidationProgressCallback& progress)
+{
+    // The coins were chosen before the vault was unlocked - make sure nothing has spent them since.
+    typedef odb::query<TxOut> query_t;
+    for (auto& tx: txs)
+    {
+        for (auto& txin: tx->txins())
         {
-            txins.pop_back();
-            if (txins.empty()) throw std::runtime_error("Vault::consolidateTxOuts_unwrapped() - txins empty.");
-            if (input_total <= min_fee) throw std::runtime_error("Vault::consolidateTxOuts_unwrapped() - input total is not greater than fee.");
-            txouts_t txouts;
-            std::shared_ptr<TxOut> txout = std::make_shared<TxOut>(input_total - min_fee, txoutscript);
-            txouts.push_back(txout);
-            std::shared_ptr<Tx> tx = std::make_shared<Tx>();
-            tx->set(tx_version, txins, txouts, tx_locktime, time(NULL), Tx::UNSIGNED);
-            if (tx->raw().size() > max_tx_size) throw std::runtime_error("Vault::consolidateTxOuts_unwrapped() - maximum transaction size is too small.");
-
-            txs.push_back(tx);
-            input_total = 0;
-            txins.clear();
-            txins.push_back(txin);
+            odb::result<TxOut> r(db_->query<TxOut>(query_t::tx->hash == txin->outhash() && query_t::txindex == txin->outindex() && query_t::status == TxOut::UNSPENT));
+            if (r.empty()) throw std::runtime_error("Vault::insertConsolidationTxs_unwrapped() - coins were spent while the consolidation was being built.");
         }
-            
-        input_total += utxoview.value;
     }
-    
-    if (!txins.empty() && input_total >= min_fee)
+
+    bool inserted = false;
+    std::size_t done = 0;
+    for (auto& tx: txs)
     {
-        txouts_t txouts;
-        std::shared_ptr<TxOut> txout = std::make_shared<TxOut>(input_total - min_fee, txoutscript);
-        txouts.push_back(txout);
-        std::shared_ptr<Tx> tx = std::make_shared<Tx>();
-        tx->set(tx_version, txins, txouts, tx_locktime, time(NULL), Tx::UNSIGNED);
-        if (tx->raw().size() < max_tx_size) { txs.push_back(tx); }
+        tx = insertTx_unwrapped(tx);
+        if (tx) { inserted = true; }
+        if (progress) { progress(ConsolidationProgress { ConsolidationProgress::INSERTING, ++done, txs.size() }); }
     }
-    
-    return txs;
+    return inserted;
 }
 
 void Vault::updateTx_unwrapped(std::shared_ptr<Tx> tx)
@@ -3522,7 +3977,7 @@ void Vault::deleteTx(const bytes_t& tx_hash)
 {
     LOGGER(trace) << "Vault::deleteTx(" << uchar_vector(tx_hash).getHex() << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     odb::result<Tx> r(db_->query<Tx>(odb::query<Tx>::hash == tx_hash || odb::query<Tx>::unsigned_hash == tx_hash));
@@ -3539,7 +3994,7 @@ void Vault::deleteTx(unsigned long tx_id)
 {
     LOGGER(trace) << "Vault::deleteTx(" << tx_id << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     odb::result<Tx> r(db_->query<Tx>(odb::query<Tx>::id == tx_id));
@@ -3596,15 +4051,11 @@ SigningRequest Vault::getSigningRequest(const bytes_t& hash, bool include_raw_tx
     LOGGER(trace) << "Vault::getSigningRequest(" << uchar_vector(hash).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
-    odb::result<Tx> r(db_->query<Tx>(odb::query<Tx>::hash == hash || odb::query<Tx>::unsigned_hash == hash));
-    if (r.empty()) throw TxNotFoundException(hash);
-
-    std::shared_ptr<Tx> tx(r.begin().load());
-    return getSigningRequest_unwrapped(tx, include_raw_tx);
+    return getSigningRequest_unwrapped(getTxRawView_unwrapped(hash), include_raw_tx);
 }
 
 SigningRequest Vault::getSigningRequest(unsigned long tx_id, bool include_raw_tx) const
@@ -3612,21 +4063,28 @@ SigningRequest Vault::getSigningRequest(unsigned long tx_id, bool include_raw_tx
     LOGGER(trace) << "Vault::getSigningRequest(" << tx_id << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
-    odb::result<Tx> r(db_->query<Tx>(odb::query<Tx>::id == tx_id));
-    if (r.empty()) throw TxNotFoundException();
+    return getSigningRequest_unwrapped(getTxRawView_unwrapped(tx_id), include_raw_tx);
+}
 
-    std::shared_ptr<Tx> tx(r.begin().load());
-    return getSigningRequest_unwrapped(tx, include_raw_tx);
+std::vector<uint64_t> Vault::getOutpointValues_unwrapped(unsigned long tx_id) const
+{
+    typedef odb::query<TxInOutpointView> query_t;
+    odb::result<TxInOutpointView> r(db_->query<TxInOutpointView>((query_t::Tx::id == tx_id) + "ORDER BY" + query_t::TxIn::txindex));
+
+    std::vector<uint64_t> outpointvalues;
+    for (auto& view: r) { outpointvalues.push_back(view.value); }
+    return outpointvalues;
 }
 
-SigningRequest Vault::getSigningRequest_unwrapped(std::shared_ptr<Tx> tx, bool include_raw_tx) const
+SigningRequest Vault::getSigningRequest_unwrapped(const TxRawView& view, bool include_raw_tx) const
 {
-    unsigned int sigs_needed = tx->missingSigCount();
-    std::set<bytes_t> pubkeys = tx->missingSigPubkeys();
+    TxSignatureState sigstate(Coin::Transaction(view.raw), getOutpointValues_unwrapped(view.id));
+    unsigned int sigs_needed = sigstate.missingSigCount();
+    std::set<bytes_t> pubkeys = sigstate.missingSigPubkeys();
     std::set<SigningRequest::keychain_info_t> keychain_info;
     odb::result<Key> key_r(db_->query<Key>(odb::query<Key>::pubkey.in_range(pubkeys.begin(), pubkeys.end())));
     for (auto& keychain: key_r)
@@ -3636,8 +4094,8 @@ SigningRequest Vault::getSigningRequest_unwrapped(std::shared_ptr<Tx> tx, bool i
     }
 
     bytes_t rawtx;
-    if (include_raw_tx) rawtx = tx->raw();
-    return SigningRequest(tx->hash(), sigs_needed, keychain_info, rawtx);
+    if (include_raw_tx) rawtx = view.raw;
+    return SigningRequest(view.tx_hash(), sigs_needed, keychain_info, rawtx);
 }
 
 SignatureInfo Vault::getSignatureInfo(const bytes_t& hash) const
@@ -3645,7 +4103,7 @@ SignatureInfo Vault::getSignatureInfo(const bytes_t& hash) const
     LOGGER(trace) << "Vault::getSignatureInfo(" << uchar_vector(hash).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -3661,7 +4119,7 @@ SignatureInfo Vault::getSignatureInfo(unsigned long tx_id) const
     LOGGER(trace) << "Vault::getSignatureInfo(" << tx_id << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -3723,8 +4181,9 @@ SignatureInfo Vault::getSignatureInfo_unwrapped(std::shared_ptr<Tx> tx) const
 std::shared_ptr<Tx> Vault::signTx(const bytes_t& hash, std::vector<std::string>& keychain_names, bool update)
 {
     LOGGER(trace) << "Vault::signTx(" << uchar_vector(hash).getHex() << ", [" << stdutils::delimited_list(keychain_names, ", ") << "], " << (update ? "update" : "no update") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.signTx");
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
 
@@ -3752,8 +4211,9 @@ std::shared_ptr<Tx> Vault::signTx(const bytes_t& hash, std::vector<std::string>&
 std::shared_ptr<Tx> Vault::signTx(unsigned long tx_id, std::vector<std::string>& keychain_names, bool update)
 {
     LOGGER(trace) << "Vault::signTx(" << tx_id << ", [" << stdutils::delimited_list(keychain_names, ", ") << "], " << (update ? "update" : "no update") << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.signTx");
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
 
@@ -3775,7 +4235,8 @@ unsigned int Vault::signTx_unwrapped(std::shared_ptr<Tx> tx, std::vector<std::st
     using namespace CoinQ::Script;
     using namespace CoinCrypto;
 
-    Coin::Transaction coin_tx = tx->toCoinCore();
+    TxSignatureState sigstate(*tx);
+    const Coin::Transaction& coin_tx = sigstate.cointx();
 
     // No point in trying nonprivate keys
     odb::query<Key> privkey_query(odb::query<Key>::is_private != 0);
@@ -3790,7 +4251,7 @@ unsigned int Vault::signTx_unwrapped(std::shared_ptr<Tx> tx, std::vector<std::st
     for (auto& txin: tx->txins())
     {
         uint64_t outpointvalue = txin->outpoint() ? txin->outpoint()->value() : 0;
-        SignableTxIn signableTxIn(coin_tx, txin->txindex(), outpointvalue);
+        SignableTxIn signableTxIn(sigstate.signabletxin(txin->txindex()));
 
         unsigned int sigsneeded = signableTxIn.sigsneeded();
         if (sigsneeded == 0) continue;
@@ -3839,10 +4300,14 @@ unsigned int Vault::signTx_unwrapped(std::shared_ptr<Tx> tx, std::vector<std::st
         txin->scriptwitnessstack(stack);
     }
 
+    static stdutils::metrics::counter& signatures = stdutils::metrics::get_counter("vault.signatures");
+    signatures.add(sigsadded);
+
     keychain_names.clear();
     if (!sigsadded) return 0;
 
     for (auto& keychain: keychains_signed) { keychain_names.push_back(keychain->name()); }
+    tx->updateRaw();
     tx->updateStatus(Tx::NO_STATUS, true);
     return sigsadded;
 }
@@ -3852,7 +4317,7 @@ std::shared_ptr<TxOut> Vault::getTxOut(const bytes_t& outhash, uint32_t outindex
     LOGGER(trace) << "Vault::getTxOut(" << uchar_vector(outhash).getHex() << ", " << outindex << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -3871,7 +4336,7 @@ std::shared_ptr<TxOut> Vault::setSendingLabel(const bytes_t& outhash, uint32_t o
 {
     LOGGER(trace) << "Vault::setSendingLabel(" << uchar_vector(outhash).getHex() << ", " << outindex << ", " << label << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<TxOut> txout = setSendingLabel_unwrapped(outhash, outindex, label);
@@ -3891,7 +4356,7 @@ std::shared_ptr<TxOut> Vault::setReceivingLabel(const bytes_t& outhash, uint32_t
 {
     LOGGER(trace) << "Vault::setReceivingLabel(" << uchar_vector(outhash).getHex() << ", " << outindex << ", " << label << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::session s;
     odb::core::transaction t(db_->begin());
     std::shared_ptr<TxOut> txout = setReceivingLabel_unwrapped(outhash, outindex, label);
@@ -3913,7 +4378,7 @@ std::shared_ptr<Tx> Vault::exportTx(const bytes_t& hash, const std::string& file
     LOGGER(trace) << "Vault::exportTx(" << uchar_vector(hash).getHex() << ", " << filepath << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
 
     std::shared_ptr<Tx> tx;
@@ -3931,7 +4396,7 @@ std::shared_ptr<Tx> Vault::exportTx(unsigned long tx_id, const std::string& file
     LOGGER(trace) << "Vault::exportTx(" << tx_id << ", " << filepath << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
 
     std::shared_ptr<Tx> tx;
@@ -3959,7 +4424,7 @@ std::string Vault::exportTx(const bytes_t& hash) const
     LOGGER(trace) << "Vault::exportTx(" << uchar_vector(hash).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
 
     std::shared_ptr<Tx> tx;
@@ -3976,7 +4441,7 @@ std::string Vault::exportTx(unsigned long tx_id) const
     LOGGER(trace) << "Vault::exportTx(" << tx_id << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
 
     std::shared_ptr<Tx> tx;
@@ -4007,7 +4472,7 @@ std::shared_ptr<Tx> Vault::importTx(const std::string& filepath)
 
     std::shared_ptr<Tx> tx(new Tx());
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         ia >> *tx;
@@ -4029,7 +4494,7 @@ std::shared_ptr<Tx> Vault::importTxFromString(const std::string& txstr)
 
     std::shared_ptr<Tx> tx(new Tx());
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         ia >> *tx;
@@ -4041,41 +4506,50 @@ std::shared_ptr<Tx> Vault::importTxFromString(const std::string& txstr)
     return tx;
 }
 
-unsigned int Vault::exportTxs(const std::string& filepath, uint32_t minheight) const
+unsigned int Vault::exportTxs(const std::string& filepath, uint32_t minheight, VaultFileFormat format) const
 {
-    LOGGER(trace) << "Vault::exportTxs(" << filepath << ", " << minheight << ")" << std::endl;
+    LOGGER(trace) << "Vault::exportTxs(" << filepath << ", " << minheight << ", " << format << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
 
     //TODO: disable opetation if file is already open
-    std::ofstream ofs(filepath);
-    boost::archive::text_oarchive oa(ofs);
+    VaultOutputFile file(filepath, format);
 
-    odb::core::session s;
     odb::core::transaction t(db_->begin());
-    return exportTxs_unwrapped(oa, minheight);
+    unsigned int n = exportTxs_unwrapped(file.archive(), minheight);
+    file.close();
+    return n;
 }
 
-unsigned int Vault::exportTxs_unwrapped(boost::archive::text_oarchive& oa, uint32_t minheight) const
+unsigned int Vault::exportTxs_unwrapped(boost::archive::polymorphic_oarchive& oa, uint32_t minheight) const
 {
     typedef odb::query<Tx> tx_query_t;
     odb::result<Tx> r;
 
-    std::vector<std::shared_ptr<Tx>> txs;
+    // Only the ids are kept in memory - transactions are loaded and written out a batch at a time.
+    ids_t tx_ids;
 
     // First the confirmed transactions
     r = db_->query<Tx>((tx_query_t::blockheader.is_not_null() && tx_query_t::blockheader->height >= minheight) + "ORDER BY" + tx_query_t::blockheader + "ASC, " + tx_query_t::timestamp + "ASC");
-    for (auto it(r.begin()); it != r.end (); ++it) { txs.push_back(it.load()); }
+    for (auto it(r.begin()); it != r.end (); ++it) { tx_ids.push_back(it.id()); }
 
     // Then the unconfirmed
     r = db_->query<Tx>(tx_query_t::blockheader.is_null() + "ORDER BY" + tx_query_t::blockheader + "ASC, " + tx_query_t::timestamp + "ASC");
-    for (auto it(r.begin()); it != r.end (); ++it) { txs.push_back(it.load()); }
+    for (auto it(r.begin()); it != r.end (); ++it) { tx_ids.push_back(it.id()); }
 
-    uint32_t n = txs.size();
+    uint32_t n = tx_ids.size();
     oa << n;
-    for (auto& tx: txs) { oa << *tx; }
+    for (uint32_t i = 0; i < n; i += VAULT_FILE_BATCH_SIZE)
+    {
+        odb::core::session s;
+        for (uint32_t j = i; j < n && j < i + VAULT_FILE_BATCH_SIZE; j++)
+        {
+            std::shared_ptr<Tx> tx(db_->load<Tx>(tx_ids[j]));
+            oa << *tx;
+        }
+    }
     return n;
 }
 
@@ -4083,14 +4557,13 @@ unsigned int Vault::importTxs(const std::string& filepath)
 {
     LOGGER(trace) << "Vault::importTxs(" << filepath << ")" << std::endl;
 
-    std::ifstream ifs(filepath);
-    boost::archive::text_iarchive ia(ifs);
+    VaultInputFile file(filepath);
 
     uint32_t n;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::transaction t(db_->begin());
-        n = importTxs_unwrapped(ia);
+        n = importTxs_unwrapped(file.archive());
         t.commit();
     }
 
@@ -4098,16 +4571,26 @@ unsigned int Vault::importTxs(const std::string& filepath)
     return n;
 }
 
-unsigned int Vault::importTxs_unwrapped(boost::archive::text_iarchive& ia)
+unsigned int Vault::importTxs_unwrapped(boost::archive::polymorphic_iarchive& ia)
 {
     uint32_t n;
     ia >> n;
-    for (uint32_t i = 0; i < n; i++)
+
+    // Decode a batch at a time. The file reader keeps inflating chunks ahead while the batch is inserted.
+    std::vector<std::shared_ptr<Tx>> batch;
+    batch.reserve(VAULT_FILE_BATCH_SIZE);
+    for (uint32_t i = 0; i < n; i += VAULT_FILE_BATCH_SIZE)
     {
-        std::shared_ptr<Tx> tx(new Tx());
-        ia >> *tx;
+        batch.clear();
+        for (uint32_t j = i; j < n && j < i + VAULT_FILE_BATCH_SIZE; j++)
+        {
+            std::shared_ptr<Tx> tx(new Tx());
+            ia >> *tx;
+            batch.push_back(tx);
+        }
+
         odb::core::session s;
-        insertTx_unwrapped(tx);
+        for (auto& tx: batch) { insertTx_unwrapped(tx); }
     }
     return n;
 }
@@ -4120,7 +4603,7 @@ std::shared_ptr<SigningScript> Vault::getSigningScript(const bytes_t& script) co
     LOGGER(trace) << "Vault::getSigningScript(" << uchar_vector(script).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::session s;
     odb::core::transaction t(db_->begin());
@@ -4144,7 +4627,7 @@ uint32_t Vault::getBestHeight() const
     LOGGER(trace) << "Vault::getBestHeight()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getBestHeight_unwrapped();
@@ -4162,7 +4645,7 @@ std::shared_ptr<BlockHeader> Vault::getBlockHeader(const bytes_t& hash) const
     LOGGER(trace) << "Vault::getBlockHeader(" << uchar_vector(hash).getHex() << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getBlockHeader_unwrapped(hash);
@@ -4173,7 +4656,7 @@ std::shared_ptr<BlockHeader> Vault::getBlockHeader(uint32_t height) const
     LOGGER(trace) << "Vault::getBlockHeader(" << height << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getBlockHeader_unwrapped(height);
@@ -4198,7 +4681,7 @@ std::shared_ptr<BlockHeader> Vault::getBestBlockHeader() const
     LOGGER(trace) << "Vault::getBestBlockHeader()" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getBestBlockHeader_unwrapped();
@@ -4214,16 +4697,22 @@ std::shared_ptr<BlockHeader> Vault::getBestBlockHeader_unwrapped() const
 std::shared_ptr<MerkleBlock> Vault::insertMerkleBlock(std::shared_ptr<MerkleBlock> merkleblock)
 {
     LOGGER(trace) << "Vault::insertMerkleBlock(" << uchar_vector(merkleblock->blockheader()->hash()).getHex() << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.insertMerkleBlock");
+    TRACE_SPAN(span, "Vault::insertMerkleBlock");
+    if (span) { span.arg("hash", uchar_vector(merkleblock->blockheader()->hash()).getHex()).arg("height", merkleblock->blockheader()->height()); }
 
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         merkleblock = insertMerkleBlock_unwrapped(merkleblock);
         t.commit();
     }
 
-    signalQueue.flush();
+    {
+        TRACE_SPAN(flushSpan, "SignalQueue::flush");
+        signalQueue.flush();
+    }
     return merkleblock;
 }
 
@@ -4301,7 +4790,7 @@ std::shared_ptr<MerkleBlock> Vault::insertMerkleBlock_unwrapped(std::shared_ptr<
         db_->persist(merkleblock);
         signalQueue.push(notifyMerkleBlockInserted.bind(merkleblock));
 
-        // Confirm transactions
+        // Confirm transactions. A tx we don't have yet is looked up in the stored blocks when it arrives.
         bool confirmations_updated = false;
         const auto& hashes = merkleblock->hashes();
         odb::result<Tx> tx_r(db_->query<Tx>(odb::query<Tx>::hash.in_range(hashes.begin(), hashes.end())));
@@ -4315,8 +4804,10 @@ std::shared_ptr<MerkleBlock> Vault::insertMerkleBlock_unwrapped(std::shared_ptr<
             LOGGER(debug) << "Vault::insertMerkleBlock_unwrapped - confirming transaction. hash: " << uchar_vector(tx.hash()).getHex() << std::endl;
             tx.blockheader(new_blockheader);
             db_->update(tx);
+            pendingConfirmations_.erase(tx.hash());
             confirmations_updated = true;
-            signalQueue.push(notifyTxUpdated.bind(std::make_shared<Tx>(tx)));
+            std::shared_ptr<Tx> updated_tx = std::make_shared<Tx>(tx);
+            signalQueue.push(notifyTxUpdated.bind(updated_tx), txUpdatedKey(updated_tx));
         }
 
         if (confirmations_updated)
@@ -4328,6 +4819,7 @@ std::shared_ptr<MerkleBlock> Vault::insertMerkleBlock_unwrapped(std::shared_ptr<
     }
     catch (...)
     {
+        pendingConfirmationsLoaded_ = false;
         signalQueue.clear();
         throw;
     }
@@ -4341,10 +4833,11 @@ unsigned int Vault::deleteMerkleBlock(const bytes_t& hash)
 unsigned int Vault::deleteMerkleBlock(uint32_t height)
 {
     LOGGER(trace) << "Vault::deleteMerkleBlock(" << height << ")" << std::endl;
+    METRICS_TIME_SCOPE("vault.deleteMerkleBlock");
 
     unsigned int count;
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
         count = deleteMerkleBlock_unwrapped(height);
@@ -4359,67 +4852,46 @@ unsigned int Vault::deleteMerkleBlock_unwrapped(uint32_t height)
 {
     try
     {
+        // Collect the txs that lose their confirmations so subscribers get a single notification.
+        hashvector_t txhashes;
+        odb::result<TxView> txview_r(db_->query<TxView>(odb::query<TxView>::BlockHeader::height >= height));
+        for (auto& txview: txview_r) { txhashes.push_back(txview.hash); }
 
-    /*
-        unsigned int count = 0;
+        std::stringstream blockheader_ids;
+        blockheader_ids << "SELECT id FROM BlockHeader WHERE height >= " << height;
 
-        typedef odb::query<ConfirmedTxView> query_t;
-        odb::result<ConfirmedTxView> r(db_->query<ConfirmedTxView>((query_t::BlockHeader::height >= height) + "ORDER BY" + query_t::BlockHeader::height));
-        for (auto& view: r)
+        // Remove tx confirmations
+        if (!txhashes.empty())
         {
-            std::shared_ptr<Tx> tx(db_->find<Tx>(view.tx_id));
-            if (tx)
-            {
-                tx->blockheader(nullptr);
-                db_->update(tx);
-                signalQueue.push(notifyTxUpdated.bind(tx));
-            }
-
-            std::shared_ptr<MerkleBlock> merkleblock(db_->find<MerkleBlock>(view.merkleblock_id));
-            if (merkleblock) { db_->erase(merkleblock); }
+            LOGGER(debug) << "Vault::deleteMerkleBlock_unwrapped - unconfirming " << txhashes.size() << " transaction(s) at height >= " << height << "." << std::endl;
 
-            std::shared_ptr<BlockHeader> blockheader(db_->find<BlockHeader>(view.blockheader_id));
-            if (blockheader)
-            {
-                db_->erase(blockheader);
-                count++;
-            }
+            std::stringstream sql;
+            sql << "UPDATE Tx SET status = CASE WHEN status = " << Tx::CONFIRMED << " THEN " << Tx::PROPAGATED << " ELSE status END, blockheader = NULL"
+                << " WHERE blockheader IN (" << blockheader_ids.str() << ")";
+            db_->execute(sql.str());
         }
 
-        return count;
-    */
+        // Delete merkle blocks (hashes are removed by cascade)
+        db_->execute("DELETE FROM MerkleBlock WHERE blockheader IN (" + blockheader_ids.str() + ")");
 
-        typedef odb::query<BlockHeader> query_t;
-        odb::result<BlockHeader> r(db_->query<BlockHeader>((query_t::height >= height) + "ORDER BY" + query_t::height + "DESC"));
-        unsigned int count = 0;
-        for (auto& blockheader: r)
+        // Delete block headers
+        unsigned int count = db_->erase_query<BlockHeader>(odb::query<BlockHeader>::height >= height);
+        prunePendingConfirmations_unwrapped(height);
+        if (count > 0)
         {
-            LOGGER(debug) << "Vault::deleteMerkleBlock_unwrapped - deleting block. hash: " << uchar_vector(blockheader.hash()).getHex() << ", height: " << blockheader.height() << std::endl;
-
-            // Remove tx confirmations
-            odb::result<Tx> tx_r(db_->query<Tx>(odb::query<Tx>::blockheader == blockheader.id()));
-            for (auto& tx: tx_r)
-            {
-    //            LOGGER(debug) << "Vault::deleteMerkleBlock_unwrapped - unconfirming transaction. hash: " << uchar_vector(tx.hash()).getHex() << std::endl;
-                tx.blockheader(nullptr);
-                db_->update(tx);
-                signalQueue.push(notifyTxUpdated.bind(std::make_shared<Tx>(tx)));
-                //notifyTxUpdated(std::make_shared<Tx>(tx));
-            }
-
-            // Delete merkle block
-            db_->erase_query<MerkleBlock>(odb::query<MerkleBlock>::blockheader == blockheader.id());
-
-            // Delete block header
-            db_->erase(blockheader);
+            LOGGER(debug) << "Vault::deleteMerkleBlock_unwrapped - deleted " << count << " block(s) at height >= " << height << "." << std::endl;
+        }
 
-            count++;
+        if (!txhashes.empty())
+        {
+            signalQueue.push(notifyConfirmationsChanged.bind(height, txhashes));
         }
 
         return count;
     }
     catch (...)
     {
+        pendingConfirmationsLoaded_ = false;
         signalQueue.clear();
         throw;
     }
@@ -4427,58 +4899,97 @@ unsigned int Vault::deleteMerkleBlock_unwrapped(uint32_t height)
 
 unsigned int Vault::updateConfirmations_unwrapped(std::shared_ptr<Tx> tx)
 {
-    LOGGER(debug) << "Vault::updateConfirmations(" << (tx ? uchar_vector(tx->hash()).getHex() : std::string("...")) << ")" << std::endl;
+    LOGGER(debug) << "Vault::updateConfirmations(" << uchar_vector(tx->hash()).getHex() << ")" << std::endl;
 
     try
     {
-        unsigned int count = 0;
-        typedef odb::query<ConfirmedTxView> query_t;
-        query_t query(query_t::Tx::blockheader.is_null());
-        if (tx) query = (query && query_t::Tx::hash == tx->hash());
+        if (tx->blockheader()) return 0;
 
-        odb::result<ConfirmedTxView> r(db_->query<ConfirmedTxView>(query));
-        for (auto& view: r)
+        loadPendingConfirmations_unwrapped();
+        PendingConfirmation pending;
+        auto it = pendingConfirmations_.find(tx->hash());
+        if (it != pendingConfirmations_.end())
         {
-            if (view.blockheader_id == 0) continue;
-
-            std::shared_ptr<Tx> tx(db_->load<Tx>(view.tx_id));
-            std::shared_ptr<BlockHeader> blockheader(db_->load<BlockHeader>(view.blockheader_id));
-            std::shared_ptr<MerkleBlock> merkleblock(db_->load<MerkleBlock>(view.merkleblock_id));
-
-            tx->blockheader(blockheader);
-            db_->update(tx);
-            signalQueue.push(notifyTxUpdated.bind(tx));
-            count++;
-            LOGGER(debug) << "Vault::updateConfirmations_unwrapped - transaction " << uchar_vector(tx->hash()).getHex() << " confirmed in block " << uchar_vector(tx->blockheader()->hash()).getHex() << " height: " << tx->blockheader()->height() << std::endl;
+            pending = it->second;
+            pendingConfirmations_.erase(it);
+        }
+        else
+        {
+            // Not a tx we had when the index was loaded - see whether a stored block names it.
+            typedef odb::query<MerkleBlockHashView> query_t;
+            odb::result<MerkleBlockHashView> r(db_->query<MerkleBlockHashView>(query_t("t.value =" + query_t::_val(tx->hash()))));
+            if (r.empty()) return 0;
+            pending.blockheader_id = r.begin()->blockheader_id;
+            pending.height = r.begin()->block_height;
         }
 
-        return count;
+        std::shared_ptr<BlockHeader> blockheader(db_->find<BlockHeader>(pending.blockheader_id));
+        if (!blockheader || blockheader->height() != pending.height) return 0; // stale - the block has been removed
+
+        tx->blockheader(blockheader);
+        db_->update(tx);
+        signalQueue.push(notifyTxUpdated.bind(tx), txUpdatedKey(tx));
+        LOGGER(debug) << "Vault::updateConfirmations_unwrapped - transaction " << uchar_vector(tx->hash()).getHex() << " confirmed in block " << uchar_vector(blockheader->hash()).getHex() << " height: " << blockheader->height() << std::endl;
+        return 1;
     }
     catch (...)
     {
+        pendingConfirmationsLoaded_ = false;
         signalQueue.clear();
         throw;
     }
 }
 
-void Vault::exportMerkleBlocks(const std::string& filepath) const
+void Vault::loadPendingConfirmations_unwrapped() const
+{
+    if (pendingConfirmationsLoaded_) return;
+
+    // Only unconfirmed txs we have that stored blocks name. Blocks confirm the txs we already have as
+    // they are inserted, so anything else in them is either confirmed or not ours.
+    pendingConfirmations_.clear();
+    typedef odb::query<PendingConfirmationView> query_t;
+    odb::result<PendingConfirmationView> r(db_->query<PendingConfirmationView>(query_t::Tx::blockheader.is_null()));
+    for (auto& view: r)
+    {
+        PendingConfirmation pending;
+        pending.blockheader_id = view.blockheader_id;
+        pending.height = view.block_height;
+        pendingConfirmations_[view.tx_hash] = pending;
+    }
+    pendingConfirmationsLoaded_ = true;
+
+    LOGGER(debug) << "Vault::loadPendingConfirmations_unwrapped - indexed " << pendingConfirmations_.size() << " pending confirmation(s)." << std::endl;
+}
+
+void Vault::prunePendingConfirmations_unwrapped(uint32_t height) const
+{
+    if (!pendingConfirmationsLoaded_) return;
+
+    for (auto it = pendingConfirmations_.begin(); it != pendingConfirmations_.end();)
+    {
+        if (it->second.height >= height)    { it = pendingConfirmations_.erase(it); }
+        else                                { ++it; }
+    }
+}
+
+void Vault::exportMerkleBlocks(const std::string& filepath, VaultFileFormat format) const
 {
-    LOGGER(trace) << "Vault::exportMerkleBlocks(" << filepath << ")" << std::endl;
+    LOGGER(trace) << "Vault::exportMerkleBlocks(" << filepath << ", " << format << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
 
     // TODO: Disable operation if file is already open
-    std::ofstream ofs(filepath);
-    boost::archive::text_oarchive oa(ofs);
+    VaultOutputFile file(filepath, format);
 
     odb::core::session s;
     odb::core::transaction t(db_->begin());
-    exportMerkleBlocks_unwrapped(oa);
+    exportMerkleBlocks_unwrapped(file.archive());
+    file.close();
 }
 
-void Vault::exportMerkleBlocks_unwrapped(boost::archive::text_oarchive& oa) const
+void Vault::exportMerkleBlocks_unwrapped(boost::archive::polymorphic_oarchive& oa) const
 {
     odb::result<MerkleBlockCountView> count_r(db_->query<MerkleBlockCountView>());
     uint32_t n = count_r.empty() ? 0 : count_r.begin()->count;
@@ -4493,21 +5004,20 @@ void Vault::importMerkleBlocks(const std::string& filepath)
 {
     LOGGER(trace) << "Vault::importMerkleBlocks(" << filepath << ")" << std::endl;
 
-    std::ifstream ifs(filepath);
-    boost::archive::text_iarchive ia(ifs);
+    VaultInputFile file(filepath);
 
     {
-        boost::lock_guard<boost::mutex> lock(mutex);
+        boost::lock_guard<mutex_t> lock(mutex);
         odb::core::session s;
         odb::core::transaction t(db_->begin());
-        importMerkleBlocks_unwrapped(ia);
+        importMerkleBlocks_unwrapped(file.archive());
         t.commit();
     }
 
     signalQueue.flush();
 }
 
-void Vault::importMerkleBlocks_unwrapped(boost::archive::text_iarchive& ia)
+void Vault::importMerkleBlocks_unwrapped(boost::archive::polymorphic_iarchive& ia)
 {
     uint32_t n;
     ia >> n;
@@ -4526,7 +5036,7 @@ std::shared_ptr<User> Vault::addUser(const std::string& username, bool txoutscri
 {
     LOGGER(trace) << "Vault::addUser(" << username << ", " << (txoutscript_whitelist_enabled ? "true" : "false") << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     std::shared_ptr<User> user = addUser_unwrapped(username, txoutscript_whitelist_enabled);
     t.commit();
@@ -4550,7 +5060,7 @@ std::shared_ptr<User> Vault::getUser(const std::string& username) const
     LOGGER(trace) << "Vault::getUser(" << username << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
     return getUser_unwrapped(username);
@@ -4570,7 +5080,7 @@ const std::set<bytes_t>& Vault::getTxOutScriptWhitelist(const std::string& usern
     LOGGER(trace) << "Vault::getTxOutScriptWhitelist(" << username << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
 
@@ -4582,7 +5092,7 @@ std::shared_ptr<User> Vault::setTxOutScriptWhitelist(const std::string& username
 {
     LOGGER(trace) << "Vault::setTxOutScriptWhitelist(" << username << ", ...)" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     std::shared_ptr<User> user = getUser_unwrapped(username);
     user->txoutscript_whitelist(txoutscripts);
@@ -4596,7 +5106,7 @@ std::shared_ptr<User> Vault::addTxOutScriptToWhitelist(const std::string& userna
 {
     LOGGER(trace) << "Vault::addTxOutScriptToWhitelist(" << username << ", " << uchar_vector(txoutscript).getHex() << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     std::shared_ptr<User> user = getUser_unwrapped(username);
     user->addTxOutScriptToWhitelist(txoutscript);
@@ -4610,7 +5120,7 @@ std::shared_ptr<User> Vault::removeTxOutScriptFromWhitelist(const std::string& u
 {
     LOGGER(trace) << "Vault::removeTxOutScriptToWhitelist(" << username << ", " << uchar_vector(txoutscript).getHex() << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     std::shared_ptr<User> user = getUser_unwrapped(username);
     if (user->removeTxOutScriptFromWhitelist(txoutscript))
@@ -4626,7 +5136,7 @@ std::shared_ptr<User> Vault::clearTxOutScriptWhitelist(const std::string& userna
 {
     LOGGER(trace) << "Vault::clearTxOutScriptWhitelist()" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     std::shared_ptr<User> user = getUser_unwrapped(username);
     user->clearTxOutScriptWhitelist();
@@ -4640,7 +5150,7 @@ std::shared_ptr<User> Vault::enableTxOutScriptWhitelist(const std::string& usern
 {
     LOGGER(trace) << "Vault::enableTxOutScriptWhitelist(" << username << ", " << (enable ? "true" : "false") << ")" << std::endl;
 
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
     odb::core::transaction t(db_->begin());
     std::shared_ptr<User> user = getUser_unwrapped(username);
     if (user->isTxOutScriptWhitelistEnabled() != enable)
@@ -4658,7 +5168,7 @@ bool Vault::isTxOutScriptWhitelistEnabled(const std::string& username) const
     LOGGER(trace) << "Vault::isTxOutScriptWhitelistEnabled(" << username << ")" << std::endl;
 
 #if defined(LOCK_ALL_CALLS)
-    boost::lock_guard<boost::mutex> lock(mutex);
+    boost::lock_guard<mutex_t> lock(mutex);
 #endif
     odb::core::transaction t(db_->begin());
 
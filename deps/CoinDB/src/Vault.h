@@ -12,12 +12,15 @@
 #pragma once
 
 #include "Schema.h"
+#include "CoinSelection.h"
 #include "VaultExceptions.h"
 #include "SigningRequest.h"
 #include "SignatureInfo.h"
+#include "VaultFile.h"
 
 #include <Signals/Signals.h>
 #include <Signals/SignalQueue.h>
+#include <stdutils/metrics.h>
 
 #include <CoinQ/CoinQ_blocks.h>
 
@@ -43,10 +46,58 @@ typedef Signals::Signal<std::shared_ptr<MerkleBlock>, const std::string& /*descr
 
 typedef Signals::Signal<std::shared_ptr<MerkleBlock>, bytes_t> TxConfirmationErrorSignal;
 
+// Emitted once per reorg or block deletion with the hashes of all txs that lost their confirmations.
+typedef Signals::Signal<uint32_t /*height*/, const hashvector_t& /*txhashes*/> ConfirmationsChangedSignal;
+
+// Keyset cursor for walking history in descending (block header id, timestamp, id) order, which
+// is served by the Tx history index. Block header ids grow with height. A default constructed cursor
+// starts at the most recent entry. Unconfirmed txs have no block header and come last.
+struct HistoryCursor
+{
+    HistoryCursor() : blockheader_id(0), timestamp(0), tx_id(0), txout_id(0), txout_split(0) { }
+
+    bool isStart() const { return tx_id == 0; }
+
+    unsigned long   blockheader_id; // 0 if unconfirmed
+    uint32_t        timestamp;
+    unsigned long   tx_id;
+    unsigned long   txout_id;       // only used for txout history
+    unsigned int    txout_split;    // split role views of txout_id already delivered, 0 once all were
+};
+
+// Keyset cursor for walking unspent outputs in descending (value, id) order.
+struct UnspentCursor
+{
+    UnspentCursor() : value(0), txout_id(0) { }
+
+    bool isStart() const { return txout_id == 0; }
+
+    uint64_t        value;
+    unsigned long   txout_id;
+};
+
+// History callbacks are invoked while the vault is locked, so they must not call back into the vault.
+// Return false to stop iterating.
+typedef std::function<bool(const TxView&)> TxViewCallback;
+typedef std::function<bool(const TxOutView&)> TxOutViewCallback;
+
+// Consolidation reports each tx as it is built, from worker threads without the vault locked, and
+// again as it is inserted, with the vault locked. Calls are never concurrent.
+struct ConsolidationProgress
+{
+    enum stage_t { BUILDING, INSERTING };
+
+    stage_t         stage;
+    std::size_t     done;
+    std::size_t     total;
+};
+
+typedef std::function<void(const ConsolidationProgress&)> ConsolidationProgressCallback;
+
 class Vault
 {
 public:
-    Vault() : db_(nullptr) { }
+    Vault() : db_(nullptr), pendingConfirmationsLoaded_(false) { }
     Vault(int argc, char** argv, bool create = false, uint32_t version = SCHEMA_VERSION, const std::string& network = "", bool migrate = false);
     Vault(const std::string& dbname, bool create = false, uint32_t version = SCHEMA_VERSION, const std::string& network = "", bool migrate = false);
     Vault(const std::string& dbuser, const std::string& dbpasswd, const std::string& dbname, bool create = false, uint32_t version = SCHEMA_VERSION, const std::string& network = "", bool migrate = false);
@@ -82,9 +133,14 @@ public:
     Coin::BloomFilter                       getBloomFilter(double falsePositiveRate, uint32_t nTweak, uint32_t nFlags) const;
     hashvector_t                            getIncompleteBlockHashes() const;
 
-    void                                    exportVault(const std::string& filepath, bool exportprivkeys = true) const;
+    void                                    exportVault(const std::string& filepath, bool exportprivkeys = true, VaultFileFormat format = TEXT_FORMAT) const;
+
+    void                                    importVault(const std::string& filepath, bool importprivkeys = true); // Reads text and binary formats.
 
-    void                                    importVault(const std::string& filepath, bool importprivkeys = true);
+    // Copies the open database to filepath with the SQLite online backup API from a separate connection, so it can
+    // run while the vault is syncing. A few pages are copied per step, with a sleep between steps to let writers in.
+    // This is the only supported way to copy an open vault.
+    void                                    backup(const std::string& filepath, int pages_per_step = 256, unsigned int step_delay_ms = 10) const;
 
     ////////////////////////
     // CONTACT OPERATIONS //
@@ -147,7 +203,11 @@ public:
     // empty account_name or bin_name means do not filter on those fields
     std::vector<SigningScriptView>          getSigningScriptViews(const std::string& account_name = "", const std::string& bin_name = "", int flags = SigningScript::ALL) const;
     std::vector<TxOutView>                  getTxOutViews(const std::string& account_name = "", const std::string& bin_name = "", int role_flags = TxOut::ROLE_BOTH, int txout_status_flags = TxOut::BOTH, int tx_status_flags = Tx::ALL, bool hide_change = true) const;
+    // Streams up to count txouts (count = -1 means all) following the cursor and advances it. Returns the number of txouts read.
+    unsigned int                            getTxOutViews(HistoryCursor& cursor, TxOutViewCallback callback, const std::string& account_name = "", const std::string& bin_name = "", int role_flags = TxOut::ROLE_BOTH, int txout_status_flags = TxOut::BOTH, int tx_status_flags = Tx::ALL, bool hide_change = true, int count = -1) const;
     std::vector<TxOutView>                  getUnspentTxOutViews(const std::string& account_name, uint32_t min_confirmations = 0) const;
+    // Streams up to count unspent outputs (count = -1 means all) following the cursor and advances it. Returns the number of outputs read.
+    unsigned int                            getUnspentTxOutViews(UnspentCursor& cursor, TxOutViewCallback callback, const std::string& account_name, uint32_t min_confirmations = 0, int count = -1) const;
 
     ////////////////////////////
     // ACCOUNT BIN OPERATIONS //
@@ -162,11 +222,15 @@ public:
     ///////////////////
     std::shared_ptr<Tx>                     getTx(const bytes_t& hash) const; // Tries both signed and unsigned hashes. Throws TxNotFoundException.
     std::shared_ptr<Tx>                     getTx(unsigned long tx_id) const; // Uses the database id. Throws TxNotFoundException.
+    // Status, hashes and serialization of a tx without loading its txins and txouts.
+    TxRawView                               getTxRawView(const bytes_t& hash) const; // Tries both signed and unsigned hashes. Throws TxNotFoundException.
+    TxRawView                               getTxRawView(unsigned long tx_id) const; // Uses the database id. Throws TxNotFoundException.
     txs_t                                   getTxs(int tx_status_flags = Tx::ALL, unsigned long start = 0, int count = -1, uint32_t minheight = 0) const;
     uint32_t                                getTxConfirmations(const bytes_t& hash) const;
     uint32_t                                getTxConfirmations(unsigned long tx_id) const;
     uint32_t                                getTxConfirmations(std::shared_ptr<Tx> tx) const;
-    std::vector<TxView>                     getTxViews(int tx_status_flags = Tx::ALL, unsigned long start = 0, int count = -1, uint32_t minheight = 0) const; // count = -1 means display all
+    // Streams up to count txs (count = -1 means all) following the cursor and advances it. Returns the number of txs read.
+    unsigned int                            getTxViews(HistoryCursor& cursor, TxViewCallback callback, int tx_status_flags = Tx::ALL, int count = -1, uint32_t minheight = 0) const;
     std::vector<std::string>                getSerializedUnsignedTxs(const std::string& account_name) const;
     std::shared_ptr<Tx>                     insertTx(std::shared_ptr<Tx> tx, bool replace_labels = false); // Inserts transaction only if it affects one of our accounts. Returns transaction in vault if change occured. Otherwise returns nullptr.
     std::shared_ptr<Tx>                     insertNewTx(const Coin::Transaction& cointx, std::shared_ptr<BlockHeader> blockheader = nullptr, bool verifysigs = false, bool isCoinbase = false);
@@ -176,8 +240,9 @@ public:
     std::shared_ptr<Tx>                     createTx(const std::string& username, const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, txouts_t txouts, uint64_t fee, unsigned int maxchangeouts = 1, bool insert = false);
     std::shared_ptr<Tx>                     createTx(const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, txouts_t txouts, uint64_t fee, uint32_t min_confirmations, bool insert = false); // Pass empty output scripts to generate change outputs.
     std::shared_ptr<Tx>                     createTx(const std::string& username, const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, txouts_t txouts, uint64_t fee, uint32_t min_confirmations, bool insert = false); // Pass empty output scripts to generate change outputs.
-    txs_t                                   consolidateTxOuts(const std::string& account_name, uint32_t max_tx_size /* in bytes */, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations, bool insert = false);
-    txs_t                                   consolidateTxOuts(const std::string& username, const std::string& account_name, uint32_t max_tx_size /* in bytes */, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations, bool insert = false);
+    // Spends the coins in as few txs of at most max_tx_size bytes, once signed, as it can. The vault is only locked while choosing the coins and while inserting.
+    txs_t                                   consolidateTxOuts(const std::string& account_name, uint32_t max_tx_size /* in bytes */, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations, bool insert = false, ConsolidationProgressCallback progress = nullptr);
+    txs_t                                   consolidateTxOuts(const std::string& username, const std::string& account_name, uint32_t max_tx_size /* in bytes */, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations, bool insert = false, ConsolidationProgressCallback progress = nullptr);
     void                                    deleteTx(const bytes_t& tx_hash); // Tries both signed and unsigned hashes. Throws TxNotFoundException.
     void                                    deleteTx(unsigned long tx_id); // Throws TxNotFoundException.
     SigningRequest                          getSigningRequest(const bytes_t& hash, bool include_raw_tx = false) const; // Tries both signed and unsigned hashes. Throws TxNotFoundException.
@@ -200,7 +265,7 @@ public:
     std::string                             exportTx(std::shared_ptr<Tx> tx) const;
     std::shared_ptr<Tx>                     importTx(const std::string& filepath);
     std::shared_ptr<Tx>                     importTxFromString(const std::string& txstr);
-    unsigned int                            exportTxs(const std::string& filepath, uint32_t minheight = 0) const;
+    unsigned int                            exportTxs(const std::string& filepath, uint32_t minheight = 0, VaultFileFormat format = TEXT_FORMAT) const;
     unsigned int                            importTxs(const std::string& filepath);
 
     //////////////////////////////
@@ -218,7 +283,7 @@ public:
     std::shared_ptr<MerkleBlock>            insertMerkleBlock(std::shared_ptr<MerkleBlock> merkleblock);
     unsigned int                            deleteMerkleBlock(const bytes_t& hash);
     unsigned int                            deleteMerkleBlock(uint32_t height);
-    void                                    exportMerkleBlocks(const std::string& filepath) const;
+    void                                    exportMerkleBlocks(const std::string& filepath, VaultFileFormat format = TEXT_FORMAT) const;
     void                                    importMerkleBlocks(const std::string& filepath);
 
     /////////////////////
@@ -244,12 +309,17 @@ public:
     Signals::Connection subscribeTxUpdated(TxSignal::Slot slot) { return notifyTxUpdated.connect(slot); }
     Signals::Connection subscribeTxDeleted(TxSignal::Slot slot) { return notifyTxDeleted.connect(slot); }
     Signals::Connection subscribeMerkleBlockInserted(MerkleBlockSignal::Slot slot) { return notifyMerkleBlockInserted.connect(slot); }
+    Signals::Connection subscribeConfirmationsChanged(ConfirmationsChangedSignal::Slot slot) { return notifyConfirmationsChanged.connect(slot); }
 
     Signals::Connection subscribeTxInsertionError(TxErrorSignal::Slot slot) { return notifyTxInsertionError.connect(slot); }
     Signals::Connection subscribeMerkleBlockInsertionError(MerkleBlockErrorSignal::Slot slot) { return notifyMerkleBlockInsertionError.connect(slot); }
 
     Signals::Connection subscribeTxConfirmationError(TxConfirmationErrorSignal::Slot slot) { return notifyTxConfirmationError.connect(slot); }
 
+    // Notifications normally run on the thread that made the change once it has committed. With a
+    // dispatcher they run on its thread instead. Passing nullptr waits for the dispatcher to finish.
+    void setSignalDispatcher(Signals::SignalDispatcher* dispatcher) { signalQueue.setDispatcher(dispatcher); }
+
     void clearAllSlots()
     {
         notifyKeychainUnlocked.clear();
@@ -259,6 +329,7 @@ public:
         notifyTxUpdated.clear();
         notifyTxDeleted.clear();
         notifyMerkleBlockInserted.clear();
+        notifyConfirmationsChanged.clear();
 
         notifyTxInsertionError.clear();
         notifyMerkleBlockInsertionError.clear();
@@ -283,6 +354,8 @@ protected:
     Coin::BloomFilter                       getBloomFilter_unwrapped(double falsePositiveRate, uint32_t nTweak, uint32_t nFlags) const;
     hashvector_t                            getIncompleteBlockHashes_unwrapped() const;
 
+    void                                    backup_unwrapped(const std::string& filepath, int pages_per_step, unsigned int step_delay_ms) const; // Does not touch the vault connection - safe without the lock.
+
     ////////////////////////
     // CONTACT OPERATIONS //
     ////////////////////////
@@ -317,8 +390,8 @@ protected:
     ////////////////////////
     // Account operations //
     ////////////////////////
-    void                                    exportAccount_unwrapped(Account& account, boost::archive::text_oarchive& oa, bool exportprivkeys) const;
-    std::shared_ptr<Account>                importAccount_unwrapped(boost::archive::text_iarchive& ia, unsigned int& privkeysimported);
+    void                                    exportAccount_unwrapped(Account& account, boost::archive::polymorphic_oarchive& oa, bool exportprivkeys) const;
+    std::shared_ptr<Account>                importAccount_unwrapped(boost::archive::polymorphic_iarchive& ia, unsigned int& privkeysimported);
 
     void                                    refillAccountPool_unwrapped(std::shared_ptr<Account> account);
 
@@ -342,6 +415,8 @@ protected:
     ///////////////////
     std::shared_ptr<Tx>                     getTx_unwrapped(const bytes_t& hash) const; // Tries both signed and unsigned hashes. Throws TxNotFoundException.
     std::shared_ptr<Tx>                     getTx_unwrapped(unsigned long tx_id) const; // Uses database id. Throws TxNotFoundException.
+    TxRawView                               getTxRawView_unwrapped(const bytes_t& hash) const; // Tries both signed and unsigned hashes. Throws TxNotFoundException.
+    TxRawView                               getTxRawView_unwrapped(unsigned long tx_id) const; // Uses database id. Throws TxNotFoundException.
     txs_t                                   getTxs_unwrapped(int tx_status_flags = Tx::ALL, unsigned long start = 0, int count = -1, uint32_t minheight = 0) const;
     std::vector<std::string>                getSerializedUnsignedTxs_unwrapped(const std::string& account_name) const;
     uint32_t                                getTxConfirmations_unwrapped(std::shared_ptr<Tx> tx) const;
@@ -349,14 +424,21 @@ protected:
     std::shared_ptr<Tx>                     insertNewTx_unwrapped(const Coin::Transaction& cointx, std::shared_ptr<BlockHeader> blockheader = nullptr, bool verifysigs = false, bool isCoinbase = false);
     std::shared_ptr<Tx>                     insertMerkleTx_unwrapped(const ChainMerkleBlock& chainmerkleblock, const Coin::Transaction& cointx, unsigned int txindex, unsigned int txcount, bool verifysigs = false, bool isCoinbase = false);
     std::shared_ptr<Tx>                     confirmMerkleTx_unwrapped(const ChainMerkleBlock& chainmerkleblock, const bytes_t& txhash, unsigned int txindex, unsigned int txcount);
+    // Picks unspent txouts of the account worth at least desired_total, without a change output if it can, for a tx paying fee to txouts
+    // and already spending txin_ids. Throws AccountInsufficientFundsException, or TxTooLargeException past MAX_STANDARD_TX_SIZE.
+    std::vector<TxOutView>                  selectCoins_unwrapped(std::shared_ptr<Account> account, uint64_t desired_total, uint64_t fee, const txouts_t& txouts, uint32_t min_confirmations = 0, const ids_t& txin_ids = ids_t()) const;
     std::shared_ptr<Tx>                     createTx_unwrapped(const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, txouts_t txouts, uint64_t fee, unsigned int maxchangeouts = 1);
     std::shared_ptr<Tx>                     createTx_unwrapped(const std::string& username, const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, txouts_t txouts, uint64_t fee, unsigned int maxchangeouts = 1);
     std::shared_ptr<Tx>                     createTx_unwrapped(const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, txouts_t txouts, uint64_t fee, uint32_t min_confirmations);
     std::shared_ptr<Tx>                     createTx_unwrapped(const std::string& username, const std::string& account_name, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, txouts_t txouts, uint64_t fee, uint32_t min_confirmations);
-    txs_t                                   consolidateTxOuts_unwrapped(const std::string& account_name, uint32_t max_tx_size /* in bytes */, uint32_t tx_version, uint32_t tx_locktime, ids_t coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations);
+    // Consolidation in three steps: grouping the coins into txs, building the txs, which needs no lock, and inserting them.
+    std::vector<std::vector<TxOutView>>     planConsolidation_unwrapped(std::shared_ptr<Account> account, uint32_t max_tx_size, const ids_t& coin_ids, const bytes_t& txoutscript, uint64_t min_fee, uint32_t min_confirmations) const;
+    txs_t                                   buildConsolidationTxs(std::shared_ptr<Account> account, const std::vector<std::vector<TxOutView>>& plan, uint32_t tx_version, uint32_t tx_locktime, const bytes_t& txoutscript, uint64_t min_fee, const ConsolidationProgressCallback& progress) const;
+    bool                                    insertConsolidationTxs_unwrapped(txs_t& txs, const ConsolidationProgressCallback& progress); // Returns true if any tx was inserted.
     void                                    deleteTx_unwrapped(std::shared_ptr<Tx> tx);
     void                                    updateTx_unwrapped(std::shared_ptr<Tx> tx);
-    SigningRequest                          getSigningRequest_unwrapped(std::shared_ptr<Tx> tx, bool include_raw_tx = false) const;
+    std::vector<uint64_t>                   getOutpointValues_unwrapped(unsigned long tx_id) const; // in input order, zero for unknown outpoints
+    SigningRequest                          getSigningRequest_unwrapped(const TxRawView& view, bool include_raw_tx = false) const;
     SignatureInfo                           getSignatureInfo_unwrapped(std::shared_ptr<Tx> tx) const;
     unsigned int                            signTx_unwrapped(std::shared_ptr<Tx> tx, std::vector<std::string>& keychain_names); // Tries to sign as many as it can with the unlocked keychains.
 
@@ -364,8 +446,8 @@ protected:
     std::shared_ptr<TxOut>                  setSendingLabel_unwrapped(const bytes_t& outhash, uint32_t outindex, const std::string& label);
     std::shared_ptr<TxOut>                  setReceivingLabel_unwrapped(const bytes_t& outhash, uint32_t outindex, const std::string& label);
 
-    unsigned int                            exportTxs_unwrapped(boost::archive::text_oarchive& oa, uint32_t minheight) const;
-    unsigned int                            importTxs_unwrapped(boost::archive::text_iarchive& ia);
+    unsigned int                            exportTxs_unwrapped(boost::archive::polymorphic_oarchive& oa, uint32_t minheight) const; // Must not be called within a session.
+    unsigned int                            importTxs_unwrapped(boost::archive::polymorphic_iarchive& ia);
 
     //////////////////////////////
     // SIGNINGSCRIPT OPERATIONS //
@@ -382,11 +464,16 @@ protected:
     std::shared_ptr<MerkleBlock>            insertMerkleBlock_unwrapped(std::shared_ptr<MerkleBlock> merkleblock);
     unsigned int                            deleteMerkleBlock_unwrapped(std::shared_ptr<MerkleBlock> merkleblock);
     unsigned int                            deleteMerkleBlock_unwrapped(uint32_t height);
-    unsigned int                            updateConfirmations_unwrapped(std::shared_ptr<Tx> tx = nullptr); // If parameter is null, updates all unconfirmed transactions.
-                                                                                                     // Returns the number of transaction previously unconfirmed that are now confirmed.
+    unsigned int                            updateConfirmations_unwrapped(std::shared_ptr<Tx> tx); // Confirms tx if a stored merkle block names it.
+                                                                                           // Returns the number of transaction previously unconfirmed that are now confirmed.
+
+    // Pending confirmation index - maps unconfirmed txs we have that stored merkle blocks name to their
+    // block. Txs not in it when it was loaded are looked up by hash. Loaded lazily and discarded on error.
+    void                                    loadPendingConfirmations_unwrapped() const;
+    void                                    prunePendingConfirmations_unwrapped(uint32_t height) const;
 
-    void                                    exportMerkleBlocks_unwrapped(boost::archive::text_oarchive& oa) const;
-    void                                    importMerkleBlocks_unwrapped(boost::archive::text_iarchive& ia);
+    void                                    exportMerkleBlocks_unwrapped(boost::archive::polymorphic_oarchive& oa) const;
+    void                                    importMerkleBlocks_unwrapped(boost::archive::polymorphic_iarchive& ia);
 
     /////////////////////
     // USER OPERATIONS //
@@ -406,6 +493,7 @@ protected:
     TxSignal                                notifyTxUpdated;
     TxSignal                                notifyTxDeleted;
     MerkleBlockSignal                       notifyMerkleBlockInserted;
+    ConfirmationsChangedSignal              notifyConfirmationsChanged;
 
     TxErrorSignal                           notifyTxInsertionError;
     MerkleBlockErrorSignal                  notifyMerkleBlockInsertionError;
@@ -413,11 +501,20 @@ protected:
     TxConfirmationErrorSignal               notifyTxConfirmationError;
 
 private:
-    mutable boost::mutex mutex;
+    typedef stdutils::metrics::timed_mutex<boost::mutex> mutex_t;
+    mutable mutex_t mutex;
     std::shared_ptr<odb::core::database> db_;
     std::string name_;
 
     mutable std::map<std::string, secure_bytes_t> mapPrivateKeyUnlock;
+
+    struct PendingConfirmation
+    {
+        unsigned long blockheader_id;
+        uint32_t height;
+    };
+    mutable std::map<bytes_t, PendingConfirmation> pendingConfirmations_;
+    mutable bool pendingConfirmationsLoaded_;
 };
 
 }
@@ -26,6 +26,7 @@ enum ErrorCodes
     VAULT_FAILED_TO_OPEN_DATABASE,
     VAULT_MISSING_TXS,
     VAULT_NEEDS_SCHEMA_MIGRATION,
+    VAULT_BACKUP_FAILED,
 
     // Chain code errors
     CHAINCODE_LOCKED = 201,
@@ -62,6 +63,7 @@ enum ErrorCodes
     TX_NOT_SIGNED,
     TX_INVALID_OUTPUTS,
     TX_OUTPUT_SCRIPT_NOT_IN_USER_WHITELIST,
+    TX_TOO_LARGE,
 
     // Block header errors
     BLOCKHEADER_NOT_FOUND = 701,
@@ -86,7 +88,13 @@ enum ErrorCodes
     // Contact errors
     CONTACT_NOT_FOUND = 1201,
     CONTACT_ALREADY_EXISTS,
-    CONTACT_INVALID_USERNAME
+    CONTACT_INVALID_USERNAME,
+
+    // Vault file errors
+    VAULTFILE_OPEN_FAILED = 1301,
+    VAULTFILE_UNSUPPORTED_VERSION,
+    VAULTFILE_CORRUPT,
+    VAULTFILE_WRITE_FAILED
 };
 
 // VAULT EXCEPTIONS
@@ -135,6 +143,17 @@ private:
     std::string dberror_;
 };
 
+class VaultBackupFailedException : public VaultException
+{
+public:
+    explicit VaultBackupFailedException(const std::string& vault_name, const std::string& dberror) : VaultException("Database backup failed.", VAULT_BACKUP_FAILED, vault_name), dberror_(dberror) { }
+
+    const std::string&  dberror() const { return dberror_; }
+
+private:
+    std::string dberror_;
+};
+
 class VaultMissingTxsException : public VaultException
 {
 public:
@@ -411,6 +430,16 @@ protected:
     bytes_t txoutscript_;
 };
 
+class TxTooLargeException : public TxException
+{
+public:
+    explicit TxTooLargeException(std::size_t size) : TxException("Transaction is too large.", TX_TOO_LARGE, bytes_t()), size_(size) { }
+    std::size_t size() const { return size_; }
+
+private:
+    std::size_t size_;
+};
+
 // BLOCK HEADER EXCEPTIONS
 class BlockHeaderException : public stdutils::custom_error
 {
@@ -581,4 +610,46 @@ public:
     explicit ContactInvalidUsernameException(const std::string& username) : ContactException("Invalid contact username.", CONTACT_INVALID_USERNAME, username) { }
 };
 
+// VAULT FILE EXCEPTIONS
+class VaultFileException : public stdutils::custom_error
+{
+public:
+    virtual ~VaultFileException() throw() { }
+    const std::string& filepath() const { return filepath_; }
+
+protected:
+    explicit VaultFileException(const std::string& what, int code, const std::string& filepath) : stdutils::custom_error(what, code), filepath_(filepath) { }
+
+    std::string filepath_;
+};
+
+class VaultFileOpenFailedException : public VaultFileException
+{
+public:
+    explicit VaultFileOpenFailedException(const std::string& filepath) : VaultFileException("Failed to open vault file.", VAULTFILE_OPEN_FAILED, filepath) { }
+};
+
+class VaultFileUnsupportedVersionException : public VaultFileException
+{
+public:
+    explicit VaultFileUnsupportedVersionException(const std::string& filepath, uint32_t version) : VaultFileException("Unsupported vault file version.", VAULTFILE_UNSUPPORTED_VERSION, filepath), version_(version) { }
+
+    uint32_t version() const { return version_; }
+
+private:
+    uint32_t version_;
+};
+
+class VaultFileCorruptException : public VaultFileException
+{
+public:
+    explicit VaultFileCorruptException(const std::string& filepath) : VaultFileException("Vault file is corrupt.", VAULTFILE_CORRUPT, filepath) { }
+};
+
+class VaultFileWriteFailedException : public VaultFileException
+{
+public:
+    explicit VaultFileWriteFailedException(const std::string& filepath) : VaultFileException("Failed to write vault file.", VAULTFILE_WRITE_FAILED, filepath) { }
+};
+
 }
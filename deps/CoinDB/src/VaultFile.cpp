@@ -0,0 +1,522 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// VaultFile.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#include "VaultFile.h"
+#include "VaultExceptions.h"
+
+#include <logger/logger.h>
+
+#include <boost/archive/polymorphic_text_oarchive.hpp>
+#include <boost/archive/polymorphic_text_iarchive.hpp>
+#include <boost/archive/polymorphic_binary_iarchive.hpp>
+#include <boost/archive/basic_binary_oprimitive.hpp>
+#include <boost/archive/basic_binary_iprimitive.hpp>
+#include <boost/archive/detail/common_oarchive.hpp>
+#include <boost/archive/detail/common_iarchive.hpp>
+#include <boost/archive/detail/polymorphic_oarchive_route.hpp>
+#include <boost/archive/detail/polymorphic_iarchive_route.hpp>
+#include <boost/archive/archive_exception.hpp>
+#include <boost/archive/impl/basic_binary_oprimitive.ipp>
+#include <boost/archive/impl/basic_binary_iprimitive.ipp>
+#include <boost/serialization/string.hpp>
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace CoinDB;
+
+namespace
+{
+
+const char          VAULT_FILE_MAGIC[4]         = { 'C', 'D', 'B', 'V' };
+const uint32_t      VAULT_FILE_VERSION          = 2;   // 1 wrote a native boost binary archive
+const uint32_t      VAULT_FILE_COMPRESSED       = 0x01;
+
+const std::size_t   CHUNK_SIZE                  = 1 << 20;
+const uint32_t      MAX_CHUNK_SIZE              = 1 << 26;  // reject absurd sizes before allocating
+const std::size_t   MAX_READAHEAD_CHUNKS        = 4;
+
+uint8_t hostByteOrder()
+{
+    const uint16_t one = 1;
+    return *reinterpret_cast<const uint8_t*>(&one);
+}
+
+void writeUInt32(std::ostream& os, uint32_t n)
+{
+    char bytes[4] = { (char)(n & 0xff), (char)((n >> 8) & 0xff), (char)((n >> 16) & 0xff), (char)((n >> 24) & 0xff) };
+    os.write(bytes, 4);
+}
+
+bool readUInt32(std::istream& is, uint32_t& n)
+{
+    unsigned char bytes[4];
+    if (!is.read(reinterpret_cast<char*>(bytes), 4)) return false;
+    n = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return true;
+}
+
+}
+
+namespace CoinDB
+{
+
+// Binary archive that writes every integer as 8 little endian bytes, whatever its width on the host, so
+// a vault file reads back on any platform. Single bytes and strings are written as they are.
+class PortableBinaryOArchive :
+    public boost::archive::basic_binary_oprimitive<PortableBinaryOArchive, char, std::char_traits<char>>,
+    public boost::archive::detail::common_oarchive<PortableBinaryOArchive>
+{
+    typedef boost::archive::basic_binary_oprimitive<PortableBinaryOArchive, char, std::char_traits<char>> primitive_base_t;
+    typedef boost::archive::detail::common_oarchive<PortableBinaryOArchive> archive_base_t;
+
+    friend archive_base_t;
+    friend primitive_base_t;
+    friend class boost::archive::detail::interface_oarchive<PortableBinaryOArchive>;
+    friend class boost::archive::save_access;
+
+public:
+    PortableBinaryOArchive(std::ostream& os, unsigned int /*flags*/ = 0)
+        : primitive_base_t(*os.rdbuf(), true), archive_base_t(boost::archive::no_header)
+    {
+        save(static_cast<uint32_t>(boost::archive::BOOST_ARCHIVE_VERSION()));
+    }
+
+    struct use_array_optimization
+    {
+        template<class T> struct apply : public boost::mpl::false_ { };
+    };
+
+protected:
+    template<class T>
+    void save(const T& t) { saveInt(static_cast<int64_t>(t)); }
+
+    void save(const bool t) { saveByte(t ? 1 : 0); }
+    void save(const char t) { saveByte(static_cast<unsigned char>(t)); }
+    void save(const signed char t) { saveByte(static_cast<unsigned char>(t)); }
+    void save(const unsigned char t) { saveByte(t); }
+
+    void save(const float t)
+    {
+        uint32_t bits;
+        memcpy(&bits, &t, sizeof(bits));
+        saveInt(bits);
+    }
+
+    void save(const double t)
+    {
+        uint64_t bits;
+        memcpy(&bits, &t, sizeof(bits));
+        saveInt(static_cast<int64_t>(bits));
+    }
+
+    void save(const std::string& t) { primitive_base_t::save(t); }
+    void save(const std::wstring& t) { primitive_base_t::save(t); }
+
+    void save_override(const boost::archive::class_name_type& t)
+    {
+        const std::string s(t);
+        *this << s;
+    }
+
+    void save_override(const boost::archive::class_id_optional_type&) { }
+
+    template<class T>
+    void save_override(T& t) { archive_base_t::save_override(t); }
+
+private:
+    void saveByte(unsigned char b) { save_binary(&b, 1); }
+
+    void saveInt(int64_t n)
+    {
+        uint64_t u = static_cast<uint64_t>(n);
+        unsigned char bytes[8];
+        for (int i = 0; i < 8; i++) { bytes[i] = (unsigned char)(u >> (8 * i)); }
+        save_binary(bytes, 8);
+    }
+};
+
+class PortableBinaryIArchive :
+    public boost::archive::basic_binary_iprimitive<PortableBinaryIArchive, char, std::char_traits<char>>,
+    public boost::archive::detail::common_iarchive<PortableBinaryIArchive>
+{
+    typedef boost::archive::basic_binary_iprimitive<PortableBinaryIArchive, char, std::char_traits<char>> primitive_base_t;
+    typedef boost::archive::detail::common_iarchive<PortableBinaryIArchive> archive_base_t;
+
+    friend archive_base_t;
+    friend primitive_base_t;
+    friend class boost::archive::detail::interface_iarchive<PortableBinaryIArchive>;
+    friend class boost::archive::load_access;
+
+public:
+    PortableBinaryIArchive(std::istream& is, unsigned int /*flags*/ = 0)
+        : primitive_base_t(*is.rdbuf(), true), archive_base_t(boost::archive::no_header)
+    {
+        uint32_t library_version;
+        load(library_version);
+        set_library_version(boost::serialization::library_version_type(library_version));
+    }
+
+    struct use_array_optimization
+    {
+        template<class T> struct apply : public boost::mpl::false_ { };
+    };
+
+protected:
+    template<class T>
+    void load(T& t)
+    {
+        int64_t n = loadInt();
+        t = T(n);
+        if (static_cast<int64_t>(t) != n) throw boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error);
+    }
+
+    void load(boost::archive::class_id_type& t) { t = boost::archive::class_id_type(static_cast<int>(loadInt())); }
+
+    void load(bool& t) { t = (loadByte() != 0); }
+    void load(char& t) { t = static_cast<char>(loadByte()); }
+    void load(signed char& t) { t = static_cast<signed char>(loadByte()); }
+    void load(unsigned char& t) { t = loadByte(); }
+
+    void load(float& t)
+    {
+        uint32_t bits;
+        load(bits);
+        memcpy(&t, &bits, sizeof(t));
+    }
+
+    void load(double& t)
+    {
+        uint64_t bits = static_cast<uint64_t>(loadInt());
+        memcpy(&t, &bits, sizeof(t));
+    }
+
+    void load(std::string& t) { primitive_base_t::load(t); }
+    void load(std::wstring& t) { primitive_base_t::load(t); }
+
+    void load_override(boost::archive::class_name_type& t)
+    {
+        std::string s;
+        *this >> s;
+        if (s.size() > BOOST_SERIALIZATION_MAX_KEY_SIZE - 1) throw boost::archive::archive_exception(boost::archive::archive_exception::invalid_class_name);
+        memcpy(t, s.data(), s.size());
+        t.t[s.size()] = '\0';
+    }
+
+    void load_override(boost::archive::class_id_optional_type&) { }
+
+    template<class T>
+    void load_override(T& t) { archive_base_t::load_override(t); }
+
+private:
+    unsigned char loadByte()
+    {
+        unsigned char b;
+        load_binary(&b, 1);
+        return b;
+    }
+
+    int64_t loadInt()
+    {
+        unsigned char bytes[8];
+        load_binary(bytes, 8);
+        uint64_t u = 0;
+        for (int i = 0; i < 8; i++) { u |= (uint64_t)bytes[i] << (8 * i); }
+        return static_cast<int64_t>(u);
+    }
+};
+
+typedef boost::archive::detail::polymorphic_oarchive_route<PortableBinaryOArchive> PolymorphicPortableBinaryOArchive;
+typedef boost::archive::detail::polymorphic_iarchive_route<PortableBinaryIArchive> PolymorphicPortableBinaryIArchive;
+
+}
+
+template class boost::archive::basic_binary_oprimitive<CoinDB::PortableBinaryOArchive, char, std::char_traits<char>>;
+template class boost::archive::basic_binary_iprimitive<CoinDB::PortableBinaryIArchive, char, std::char_traits<char>>;
+
+/*
+ * class ChunkedOutputBuffer implementation
+*/
+ChunkedOutputBuffer::ChunkedOutputBuffer(std::ostream& os, bool compress, std::size_t chunk_size)
+    : os_(os), compress_(compress), buffer_(chunk_size)
+{
+    setp(&buffer_[0], &buffer_[0] + buffer_.size());
+}
+
+void ChunkedOutputBuffer::finish()
+{
+    writeChunk();
+    writeUInt32(os_, 0);
+    writeUInt32(os_, 0);
+    os_.flush();
+}
+
+ChunkedOutputBuffer::int_type ChunkedOutputBuffer::overflow(int_type ch)
+{
+    writeChunk();
+    if (!os_) return traits_type::eof();
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int ChunkedOutputBuffer::sync()
+{
+    writeChunk();
+    return os_ ? 0 : -1;
+}
+
+void ChunkedOutputBuffer::writeChunk()
+{
+    uint32_t raw_size = pptr() - pbase();
+    if (raw_size == 0) return;
+
+    if (compress_)
+    {
+        uLongf stored_size = compressBound(raw_size);
+        compressed_.resize(stored_size);
+        if (compress2(&compressed_[0], &stored_size, reinterpret_cast<const Bytef*>(pbase()), raw_size, Z_DEFAULT_COMPRESSION) != Z_OK)
+            throw std::runtime_error("ChunkedOutputBuffer - compression failed.");
+
+        writeUInt32(os_, raw_size);
+        writeUInt32(os_, stored_size);
+        os_.write(reinterpret_cast<const char*>(&compressed_[0]), stored_size);
+    }
+    else
+    {
+        writeUInt32(os_, raw_size);
+        writeUInt32(os_, raw_size);
+        os_.write(pbase(), raw_size);
+    }
+
+    setp(&buffer_[0], &buffer_[0] + buffer_.size());
+}
+
+/*
+ * class ChunkedInputBuffer implementation
+*/
+ChunkedInputBuffer::ChunkedInputBuffer(std::istream& is, bool compressed, const std::string& filepath)
+    : is_(is), compressed_(compressed), filepath_(filepath), done_(false), stop_(false)
+{
+    setg(nullptr, nullptr, nullptr);
+    thread_ = boost::thread(&ChunkedInputBuffer::readChunks, this);
+}
+
+ChunkedInputBuffer::~ChunkedInputBuffer()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+ChunkedInputBuffer::int_type ChunkedInputBuffer::underflow()
+{
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (chunks_.empty() && !done_ && !error_) { cond_.wait(lock); }
+
+    if (chunks_.empty())
+    {
+        if (error_) std::rethrow_exception(error_);
+        return traits_type::eof();
+    }
+
+    current_.swap(chunks_.front());
+    chunks_.pop_front();
+    lock.unlock();
+    cond_.notify_all();
+
+    setg(&current_[0], &current_[0], &current_[0] + current_.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+void ChunkedInputBuffer::readChunks()
+{
+    try
+    {
+        std::vector<unsigned char> stored;
+        while (true)
+        {
+            uint32_t raw_size, stored_size;
+            if (!readUInt32(is_, raw_size) || !readUInt32(is_, stored_size)) throw VaultFileCorruptException(filepath_);
+            if (raw_size == 0) break;
+            if (raw_size > MAX_CHUNK_SIZE || stored_size > MAX_CHUNK_SIZE + (MAX_CHUNK_SIZE >> 8) + 64) throw VaultFileCorruptException(filepath_);
+
+            std::vector<char> chunk(raw_size);
+            if (compressed_)
+            {
+                stored.resize(stored_size);
+                if (!is_.read(reinterpret_cast<char*>(&stored[0]), stored_size)) throw VaultFileCorruptException(filepath_);
+
+                uLongf inflated_size = raw_size;
+                if (uncompress(reinterpret_cast<Bytef*>(&chunk[0]), &inflated_size, &stored[0], stored_size) != Z_OK || inflated_size != raw_size)
+                    throw VaultFileCorruptException(filepath_);
+            }
+            else
+            {
+                if (stored_size != raw_size || !is_.read(&chunk[0], raw_size)) throw VaultFileCorruptException(filepath_);
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (chunks_.size() >= MAX_READAHEAD_CHUNKS && !stop_) { cond_.wait(lock); }
+            if (stop_) return;
+            chunks_.push_back(std::move(chunk));
+            lock.unlock();
+            cond_.notify_all();
+        }
+    }
+    catch (...)
+    {
+        LOGGER(error) << "ChunkedInputBuffer::readChunks - failed reading " << filepath_ << std::endl;
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        error_ = std::current_exception();
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        done_ = true;
+    }
+    cond_.notify_all();
+}
+
+/*
+ * class VaultOutputFile implementation
+*/
+VaultOutputFile::VaultOutputFile(const std::string& filepath, VaultFileFormat format)
+    : filepath_(filepath), ofs_(filepath, std::ios::out | std::ios::binary | std::ios::trunc)
+{
+    if (!ofs_) throw VaultFileOpenFailedException(filepath);
+
+    if (format == TEXT_FORMAT)
+    {
+        archive_.reset(new boost::archive::polymorphic_text_oarchive(ofs_));
+        return;
+    }
+
+    bool compress = (format == COMPRESSED_BINARY_FORMAT);
+    ofs_.write(VAULT_FILE_MAGIC, sizeof(VAULT_FILE_MAGIC));
+    writeUInt32(ofs_, VAULT_FILE_VERSION);
+    writeUInt32(ofs_, compress ? VAULT_FILE_COMPRESSED : 0);
+    ofs_.put((char)sizeof(std::size_t));  // informational since version 2
+    ofs_.put((char)hostByteOrder());
+
+    buffer_.reset(new ChunkedOutputBuffer(ofs_, compress, CHUNK_SIZE));
+    os_.reset(new std::ostream(buffer_.get()));
+    os_->exceptions(std::ios::badbit);
+    archive_.reset(new PolymorphicPortableBinaryOArchive(*os_));
+}
+
+VaultOutputFile::~VaultOutputFile()
+{
+    // Not closed, so the export did not finish. Don't leave a file behind that would read as complete.
+    if (archive_)
+    {
+        LOGGER(error) << "VaultOutputFile::~VaultOutputFile - export did not complete, removing " << filepath_ << std::endl;
+        discard();
+    }
+}
+
+void VaultOutputFile::close()
+{
+    if (!archive_) return;
+
+    try
+    {
+        archive_.reset();
+
+        if (buffer_)
+        {
+            os_->flush();
+            buffer_->finish();
+            os_.reset();
+            buffer_.reset();
+        }
+
+        ofs_.close();
+        if (ofs_.fail()) throw VaultFileWriteFailedException(filepath_);
+    }
+    catch (const VaultFileWriteFailedException&)
+    {
+        discard();
+        throw;
+    }
+    catch (const std::exception& e)
+    {
+        LOGGER(error) << "VaultOutputFile::close - " << e.what() << std::endl;
+        discard();
+        throw VaultFileWriteFailedException(filepath_);
+    }
+}
+
+void VaultOutputFile::discard()
+{
+    // The archive is dropped without the chunk stream being finished, so no terminator is written.
+    try
+    {
+        archive_.reset();
+    }
+    catch (...) { }
+    os_.reset();
+    buffer_.reset();
+    ofs_.close();
+    std::remove(filepath_.c_str());
+}
+
+/*
+ * class VaultInputFile implementation
+*/
+VaultInputFile::VaultInputFile(const std::string& filepath)
+    : filepath_(filepath), ifs_(filepath, std::ios::in | std::ios::binary)
+{
+    if (!ifs_) throw VaultFileOpenFailedException(filepath);
+
+    char magic[sizeof(VAULT_FILE_MAGIC)];
+    if (!ifs_.read(magic, sizeof(magic)) || memcmp(magic, VAULT_FILE_MAGIC, sizeof(magic)) != 0)
+    {
+        // Legacy text archive
+        ifs_.clear();
+        ifs_.seekg(0);
+        format_ = TEXT_FORMAT;
+        archive_.reset(new boost::archive::polymorphic_text_iarchive(ifs_));
+        return;
+    }
+
+    uint32_t version, flags;
+    if (!readUInt32(ifs_, version) || !readUInt32(ifs_, flags)) throw VaultFileCorruptException(filepath);
+    if (version > VAULT_FILE_VERSION) throw VaultFileUnsupportedVersionException(filepath, version);
+
+    int size_width = ifs_.get();
+    int byte_order = ifs_.get();
+    if (!ifs_) throw VaultFileCorruptException(filepath);
+
+    // Version 1 payloads are native boost binary archives and only read back on a host like the writer.
+    bool native = (version < 2);
+    if (native && (size_width != (int)sizeof(std::size_t) || byte_order != (int)hostByteOrder())) throw VaultFileUnsupportedVersionException(filepath, version);
+
+    bool compressed = (flags & VAULT_FILE_COMPRESSED);
+    format_ = compressed ? COMPRESSED_BINARY_FORMAT : BINARY_FORMAT;
+
+    buffer_.reset(new ChunkedInputBuffer(ifs_, compressed, filepath));
+    is_.reset(new std::istream(buffer_.get()));
+    is_->exceptions(std::ios::badbit);
+    if (native)
+        archive_.reset(new boost::archive::polymorphic_binary_iarchive(*is_));
+    else
+        archive_.reset(new PolymorphicPortableBinaryIArchive(*is_));
+}
@@ -0,0 +1,134 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// VaultFile.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#pragma once
+
+#include <boost/archive/polymorphic_oarchive.hpp>
+#include <boost/archive/polymorphic_iarchive.hpp>
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace CoinDB
+{
+
+enum VaultFileFormat
+{
+    TEXT_FORMAT,                // boost text archive - readable by older versions
+    BINARY_FORMAT,              // chunked boost binary archive
+    COMPRESSED_BINARY_FORMAT    // chunked boost binary archive with zlib-compressed chunks
+};
+
+// Binary vault files are laid out as:
+//
+//   "CDBV" | uint32 version | uint32 flags | uint8 sizeof(size_t) | uint8 byte order
+//   chunk* | terminator
+//
+// Each chunk is uint32 raw size | uint32 stored size | stored bytes, and the terminator is a chunk header
+// with zero raw size. All header integers are little endian. The chunk payloads concatenate to a boost
+// archive that stores every integer as 8 little endian bytes, so files move between hosts of any word size
+// or byte order. The size_t width and byte order bytes only matter for version 1 files, whose payload is a
+// native boost binary archive. Files without the magic are read as boost text archives.
+
+class ChunkedOutputBuffer : public std::streambuf
+{
+public:
+    ChunkedOutputBuffer(std::ostream& os, bool compress, std::size_t chunk_size);
+
+    void finish(); // writes the last partial chunk and the terminator
+
+protected:
+    int_type overflow(int_type ch);
+    int sync();
+
+private:
+    std::ostream& os_;
+    bool compress_;
+    std::vector<char> buffer_;
+    std::vector<unsigned char> compressed_;
+
+    void writeChunk();
+};
+
+// Reads and inflates chunks on a background thread so decoding and inserts are not stalled on disk and zlib.
+// Decoding the archive itself still happens on the caller's thread.
+class ChunkedInputBuffer : public std::streambuf
+{
+public:
+    ChunkedInputBuffer(std::istream& is, bool compressed, const std::string& filepath);
+    ~ChunkedInputBuffer();
+
+protected:
+    int_type underflow();
+
+private:
+    std::istream& is_;
+    bool compressed_;
+    std::string filepath_;
+
+    boost::mutex mutex_;
+    boost::condition_variable cond_;
+    std::deque<std::vector<char>> chunks_;
+    std::vector<char> current_;
+    bool done_;
+    bool stop_;
+    std::exception_ptr error_;
+    boost::thread thread_;
+
+    void readChunks();
+};
+
+class VaultOutputFile
+{
+public:
+    VaultOutputFile(const std::string& filepath, VaultFileFormat format = TEXT_FORMAT);
+    ~VaultOutputFile();
+
+    boost::archive::polymorphic_oarchive& archive() { return *archive_; }
+
+    // Finishes the file once everything has been written. A file destroyed without being closed is
+    // removed, so an export that throws partway leaves nothing behind.
+    void close();
+
+private:
+    void discard();
+
+    std::string filepath_;
+    std::ofstream ofs_;
+    std::unique_ptr<ChunkedOutputBuffer> buffer_;
+    std::unique_ptr<std::ostream> os_;
+    std::unique_ptr<boost::archive::polymorphic_oarchive> archive_;
+};
+
+class VaultInputFile
+{
+public:
+    explicit VaultInputFile(const std::string& filepath);
+
+    boost::archive::polymorphic_iarchive& archive() { return *archive_; }
+
+    VaultFileFormat format() const { return format_; }
+
+private:
+    std::string filepath_;
+    VaultFileFormat format_;
+    std::ifstream ifs_;
+    std::unique_ptr<ChunkedInputBuffer> buffer_;
+    std::unique_ptr<std::istream> is_;
+    std::unique_ptr<boost::archive::polymorphic_iarchive> archive_;
+};
+
+}
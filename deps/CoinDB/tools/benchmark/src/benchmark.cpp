@@ -0,0 +1,451 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// benchmark.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+// Micro benchmarks for CoinCore, CoinQ and coin selection and macro benchmarks for CoinDB, the latter on a
+// synthetic vault of configurable size.
+//
+// Results can be written as JSON and later passed back with --baseline, in which case every
+// benchmark that got slower by more than --threshold percent is reported and the exit code is 1.
+//
+
+#include <Vault.h>
+#include <CoinSelection.h>
+
+#include <CoinCore/Base58Check.h>
+#include <CoinCore/BloomFilter.h>
+#include <CoinCore/CoinNodeData.h>
+#include <CoinCore/MerkleTree.h>
+#include <CoinCore/hash.h>
+#include <CoinCore/hdkeys.h>
+#include <CoinCore/secp256k1_openssl.h>
+#include <CoinQ/CoinQ_script.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <regex>
+#include <sstream>
+
+using namespace CoinDB;
+using namespace std;
+
+const std::string VERSION_INFO = "v0.1.0";
+
+const unsigned int DEFAULT_VAULT_SIZE = 1000;   // synthetic transactions
+const unsigned int TXS_PER_BLOCK = 10;
+const unsigned int COIN_SELECTION_POOL_SIZE = 100000;
+const double DEFAULT_MIN_TIME = 1.0;            // seconds per micro benchmark
+const double DEFAULT_THRESHOLD = 10.0;          // percent
+
+struct BenchmarkResult
+{
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+};
+
+class Benchmarks
+{
+public:
+    Benchmarks(const std::string& filter, double minTime, bool quiet) : m_filter(filter), m_minTime(minTime), m_quiet(quiet) { }
+
+    bool selected(const std::string& name) const { return m_filter.empty() || name.find(m_filter) != std::string::npos; }
+
+    // Doubles the iteration count until a run takes at least the minimum time.
+    template<typename Function>
+    void run(const std::string& name, Function f)
+    {
+        if (!selected(name)) return;
+
+        uint64_t iterations = 1;
+        while (true)
+        {
+            auto start = chrono::steady_clock::now();
+            for (uint64_t i = 0; i < iterations; i++) { f(); }
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (seconds >= m_minTime || iterations >= (1ull << 40))
+            {
+                add(name, iterations, seconds);
+                return;
+            }
+            iterations *= 2;
+        }
+    }
+
+    // Runs f(0) ... f(iterations - 1) once each, for operations that change the vault.
+    template<typename Function>
+    void runOnce(const std::string& name, uint64_t iterations, Function f)
+    {
+        if (!selected(name) || iterations == 0) return;
+
+        auto start = chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; i++) { f(i); }
+        add(name, iterations, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+
+    const std::vector<BenchmarkResult>& results() const { return m_results; }
+
+private:
+    void add(const std::string& name, uint64_t iterations, double seconds)
+    {
+        BenchmarkResult result = { name, iterations, seconds * 1e9 / iterations };
+        m_results.push_back(result);
+        if (!m_quiet)
+        {
+            cout << left << setw(40) << name << right << setw(14) << iterations << setw(18) << fixed << setprecision(1) << result.nsPerOp << " ns/op" << endl;
+        }
+    }
+
+    std::string m_filter;
+    double m_minTime;
+    bool m_quiet;
+    std::vector<BenchmarkResult> m_results;
+};
+
+std::string toJson(const std::vector<BenchmarkResult>& results, unsigned int vaultSize)
+{
+    stringstream ss;
+    ss << "{" << endl << "  \"version\": \"" << VERSION_INFO << "\"," << endl << "  \"vault_size\": " << vaultSize << "," << endl << "  \"benchmarks\": [";
+    bool first = true;
+    for (auto& result: results)
+    {
+        ss << (first ? "" : ",") << endl << "    { \"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+           << ", \"ns_per_op\": " << fixed << setprecision(1) << result.nsPerOp << " }";
+        first = false;
+    }
+    ss << endl << "  ]" << endl << "}" << endl;
+    return ss.str();
+}
+
+// Reads back the name and ns_per_op of each entry in a file written by toJson().
+std::map<std::string, double> readBaseline(const std::string& filename)
+{
+    ifstream file(filename);
+    if (!file) throw runtime_error("Could not open baseline file " + filename + ".");
+
+    stringstream contents;
+    contents << file.rdbuf();
+    std::string json = contents.str();
+
+    std::map<std::string, double> baseline;
+    std::regex entry("\"name\":\\s*\"([^\"]*)\"[^}]*\"ns_per_op\":\\s*([0-9.eE+-]+)");
+    for (std::sregex_iterator it(json.begin(), json.end(), entry), end; it != end; ++it)
+    {
+        baseline[(*it)[1].str()] = stod((*it)[2].str());
+    }
+    return baseline;
+}
+
+// Returns the number of regressions.
+unsigned int compareToBaseline(const std::vector<BenchmarkResult>& results, const std::map<std::string, double>& baseline, double threshold)
+{
+    cout << endl << left << setw(40) << "benchmark" << right << setw(18) << "baseline ns/op" << setw(18) << "ns/op" << setw(10) << "change" << endl;
+
+    unsigned int regressions = 0;
+    for (auto& result: results)
+    {
+        auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0.0) continue;
+
+        double change = (result.nsPerOp - it->second) * 100.0 / it->second;
+        bool regressed = change > threshold;
+        if (regressed) { regressions++; }
+
+        cout << left << setw(40) << result.name << right << fixed << setprecision(1) << setw(18) << it->second << setw(18) << result.nsPerOp
+             << setw(9) << showpos << change << noshowpos << "%" << (regressed ? "  REGRESSION" : "") << endl;
+    }
+    return regressions;
+}
+
+bytes_t syntheticHash(uint64_t n, unsigned char domain)
+{
+    uchar_vector data;
+    data.push_back(domain);
+    for (int i = 0; i < 8; i++) { data.push_back((n >> (8 * i)) & 0xff); }
+    return sha256_2(data);
+}
+
+// A transaction spending 2-of-3 multisig inputs that carry one signature each, like the ones
+// mSIGNA passes around while collecting signatures.
+Coin::Transaction multisigTx(unsigned int nInputs, const std::vector<bytes_t>& pubkeys, const bytes_t& sig)
+{
+    using namespace CoinQ::Script;
+
+    Script script(Script::PAY_TO_MULTISIG_SCRIPT_HASH, 2, pubkeys);
+    script.addSig(pubkeys[0], sig);
+
+    Coin::Transaction tx;
+    for (unsigned int i = 0; i < nInputs; i++)
+    {
+        tx.addInput(Coin::TxIn(Coin::OutPoint(syntheticHash(i, 0), i % 4), script.txinscript(Script::EDIT), 0xffffffff));
+    }
+    tx.addOutput(Coin::TxOut(100000, script.txoutscript()));
+    tx.addOutput(Coin::TxOut(250000, script.txoutscript()));
+    return tx;
+}
+
+void runMicroBenchmarks(Benchmarks& benchmarks)
+{
+    using namespace Coin;
+    using namespace CoinCrypto;
+    using namespace CoinQ::Script;
+
+    // Keys
+    std::vector<bytes_t> pubkeys;
+    secp256k1_key signingKey;
+    signingKey.newKey();
+    for (int i = 0; i < 3; i++)
+    {
+        secp256k1_key key;
+        key.newKey();
+        pubkeys.push_back(key.getPubKey());
+    }
+
+    bytes_t digest = syntheticHash(0, 1);
+    bytes_t sig = secp256k1_sign(signingKey, digest);
+    sig.push_back(Coin::SIGHASH_ALL);
+
+    // Hashing
+    uchar_vector header(80, 0x5a);
+    uchar_vector pubkey(pubkeys[0]);
+    benchmarks.run("sha256_2", [&]() { sha256_2(header); });
+    benchmarks.run("hash160", [&]() { hash160(pubkey); });
+
+    // Transactions
+    Transaction tx = multisigTx(2, pubkeys, sig);
+    uchar_vector rawtx = tx.getSerialized();
+    benchmarks.run("Transaction::getSerialized", [&]() { tx.getSerialized(); });
+    benchmarks.run("Transaction::setSerialized", [&]() { Transaction t; t.setSerialized(rawtx); });
+
+    Transaction bigtx = multisigTx(50, pubkeys, sig);
+    bytes_t redeemscript = Script(Script::PAY_TO_MULTISIG_SCRIPT_HASH, 2, pubkeys).redeemscript();
+    benchmarks.run("Transaction::getSigHash (50 inputs)", [&]() { bigtx.getSigHash(Coin::SIGHASH_ALL, 25, redeemscript); });
+
+    benchmarks.run("SignableTxIn", [&]() { SignableTxIn txin(tx, 0); });
+
+    // Merkle trees and blocks
+    std::vector<uchar_vector> txhashes;
+    for (uint64_t i = 0; i < 2000; i++) { txhashes.push_back(syntheticHash(i, 2)); }
+    MerkleTree tree(txhashes);
+    benchmarks.run("MerkleTree::getRoot (2000 txs)", [&]() { tree.getRoot(); });
+
+    std::vector<uchar_vector> matched(txhashes.begin(), txhashes.begin() + 20);
+    Coin::MerkleBlock merkleblock(randomPartialMerkleTree(matched, txhashes.size()), 2, uchar_vector(32, 0), 1400000000, 0x1d00ffff, 0);
+    uchar_vector rawmerkleblock = merkleblock.getSerialized();
+    benchmarks.run("MerkleBlock::getSerialized", [&]() { merkleblock.getSerialized(); });
+    benchmarks.run("MerkleBlock::setSerialized", [&]() { Coin::MerkleBlock m; m.setSerialized(rawmerkleblock); });
+
+    // Bloom filters
+    BloomFilter filter(1000, 0.001, 0, 0);
+    uint64_t element = 0;
+    benchmarks.run("BloomFilter::insert", [&]() { filter.insert(txhashes[element++ % txhashes.size()]); });
+    benchmarks.run("BloomFilter::match", [&]() { filter.match(txhashes[element++ % txhashes.size()]); });
+
+    // BIP32
+    HDSeed seed(syntheticHash(0, 3));
+    HDKeychain keychain(seed.getMasterKey(), seed.getMasterChainCode());
+    HDKeychain pubkeychain = keychain.getPublic();
+    uint32_t child = 0;
+    benchmarks.run("HDKeychain::getChild (private)", [&]() { keychain.getChild(child++ & 0x7fffffff); });
+    benchmarks.run("HDKeychain::getChild (public)", [&]() { pubkeychain.getChild(child++ & 0x7fffffff); });
+
+    // ECDSA
+    sig.pop_back();
+    benchmarks.run("secp256k1_sign", [&]() { secp256k1_sign(signingKey, digest); });
+    benchmarks.run("secp256k1_verify", [&]() { secp256k1_verify(signingKey, digest, sig); });
+
+    // Base58Check
+    bytes_t payload = hash160(pubkey);
+    std::string address = toBase58Check(payload, 0x05);
+    benchmarks.run("toBase58Check", [&]() { toBase58Check(payload, 0x05); });
+    benchmarks.run("fromBase58Check", [&]() { std::vector<unsigned char> p; unsigned int version; fromBase58Check(address, p, version); });
+}
+
+// Synthetic unspent output values, largest first. "uniform" spreads them evenly, "exponential" is
+// mostly small coins with a long tail of large ones and "bimodal" mixes dust with a few big coins.
+std::vector<uint64_t> syntheticCoins(const std::string& distribution, unsigned int count)
+{
+    std::mt19937_64 rng(count);
+    std::exponential_distribution<double> exponential(1.0 / 200000);
+
+    std::vector<uint64_t> values;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (distribution == "uniform")          { values.push_back(10000 + rng() % 10000000); }
+        else if (distribution == "exponential") { values.push_back(1000 + (uint64_t)exponential(rng)); }
+        else if (rng() % 10)                    { values.push_back(5000 + rng() % 20000); }
+        else                                    { values.push_back(50000000 + rng() % 50000000); }
+    }
+    std::sort(values.rbegin(), values.rend());
+    return values;
+}
+
+void runCoinSelectionBenchmarks(Benchmarks& benchmarks)
+{
+    for (const std::string distribution: { "uniform", "exponential", "bimodal" })
+    {
+        std::vector<uint64_t> values = syntheticCoins(distribution, COIN_SELECTION_POOL_SIZE);
+        CoinSelector selector(values, 1000);
+        uint64_t target = selector.total() / 1000;
+        CoinSelector::selection_t selection;
+
+        std::string suffix = " (" + distribution + ")";
+        benchmarks.run("CoinSelector::branchAndBound" + suffix, [&]() { selector.branchAndBound(target, MIN_CHANGE, selection); });
+        benchmarks.run("CoinSelector::knapsack" + suffix, [&]() { selector.knapsack(target, MIN_CHANGE, selection); });
+        benchmarks.run("CoinSelector::largestFirst" + suffix, [&]() { selector.largestFirst(target, selection); });
+    }
+}
+
+// Builds the vault as it goes: the insert benchmarks populate it for the query benchmarks, so
+// these always run in full even when filtered out.
+void runVaultBenchmarks(Benchmarks& benchmarks, Vault& vault, unsigned int vaultSize)
+{
+    const std::string ACCOUNT_NAME = "benchmark";
+
+    std::vector<std::string> keychainNames;
+    for (unsigned char i = 1; i <= 3; i++)
+    {
+        std::string keychainName = "benchmark" + std::to_string(i);
+        vault.newKeychain(keychainName, secure_bytes_t(32, i));
+        vault.unlockKeychain(keychainName);
+        keychainNames.push_back(keychainName);
+    }
+    vault.newAccount(ACCOUNT_NAME, 2, keychainNames);
+
+    // Scripts to pay to
+    std::vector<bytes_t> txoutscripts(vaultSize);
+    Benchmarks all("", 0.0, true);
+    Benchmarks& issue = benchmarks.selected("Vault::issueSigningScript") ? benchmarks : all;
+    issue.runOnce("Vault::issueSigningScript", vaultSize, [&](uint64_t i) {
+        txoutscripts[i] = vault.issueSigningScript(ACCOUNT_NAME)->txoutscript();
+    });
+
+    // Payments into the vault
+    std::vector<Coin::Transaction> cointxs(vaultSize);
+    for (unsigned int i = 0; i < vaultSize; i++)
+    {
+        cointxs[i].addInput(Coin::TxIn(Coin::OutPoint(syntheticHash(i, 4), 0), uchar_vector(107, 0x01), 0xffffffff));
+        cointxs[i].addOutput(Coin::TxOut(100000 + i, txoutscripts[i]));
+    }
+
+    Benchmarks& insertTxs = benchmarks.selected("Vault::insertNewTx") ? benchmarks : all;
+    insertTxs.runOnce("Vault::insertNewTx", vaultSize, [&](uint64_t i) { vault.insertNewTx(cointxs[i]); });
+
+    // A chain of merkle blocks confirming the payments, starting early enough to be accepted as
+    // the horizon block.
+    unsigned int blockCount = (vaultSize + TXS_PER_BLOCK - 1) / TXS_PER_BLOCK;
+    uint32_t timestamp = time(NULL) - 600 * (blockCount + 1) - 86400;
+    bytes_t prevhash(32, 0);
+    Benchmarks& insertBlocks = benchmarks.selected("Vault::insertMerkleBlock") ? benchmarks : all;
+    insertBlocks.runOnce("Vault::insertMerkleBlock", blockCount, [&](uint64_t i) {
+        std::vector<uchar_vector> txhashes;
+        for (unsigned int j = i * TXS_PER_BLOCK; j < (i + 1) * TXS_PER_BLOCK && j < vaultSize; j++) { txhashes.push_back(cointxs[j].getHash()); }
+
+        Coin::MerkleBlock coinmerkleblock(Coin::randomPartialMerkleTree(txhashes, txhashes.size() + 100), 2, prevhash, timestamp + 600 * i, 0x1d00ffff, i);
+        std::shared_ptr<MerkleBlock> merkleblock(new MerkleBlock());
+        merkleblock->fromCoinCore(coinmerkleblock, 100000 + i);
+        vault.insertMerkleBlock(merkleblock);
+        prevhash = merkleblock->blockheader()->hash();
+    });
+
+    benchmarks.run("Vault::getAccountBalance", [&]() { vault.getAccountBalance(ACCOUNT_NAME, 0); });
+    benchmarks.run("Vault::getTxViews", [&]() {
+        HistoryCursor cursor;
+        vault.getTxViews(cursor, [](const TxView&) { return true; });
+    });
+
+    if (benchmarks.selected("Vault::signTx"))
+    {
+        txouts_t txouts;
+        txouts.push_back(std::make_shared<TxOut>(50000, txoutscripts[0]));
+        std::shared_ptr<Tx> tx = vault.createTx(ACCOUNT_NAME, 1, 0, txouts, 10000, 1, true);
+        benchmarks.run("Vault::signTx", [&]() { vault.signTx(tx->id(), keychainNames, false); });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    namespace po = boost::program_options;
+
+    unsigned int vaultSize;
+    double minTime;
+    double threshold;
+    std::string filter;
+    std::string jsonFile;
+    std::string baselineFile;
+    std::string dbName;
+    std::string dbUser;
+    std::string dbPasswd;
+
+    po::options_description options("Options");
+    options.add_options()
+        ("help", "display help message")
+        ("size", po::value<unsigned int>(&vaultSize)->default_value(DEFAULT_VAULT_SIZE), "number of transactions in the synthetic vault, 0 to skip vault benchmarks")
+        ("mintime", po::value<double>(&minTime)->default_value(DEFAULT_MIN_TIME), "minimum seconds per micro benchmark")
+        ("filter", po::value<std::string>(&filter), "only run benchmarks whose name contains this")
+        ("json", po::value<std::string>(&jsonFile), "write results as JSON to this file")
+        ("baseline", po::value<std::string>(&baselineFile), "compare results to a JSON file written by an earlier run")
+        ("threshold", po::value<double>(&threshold)->default_value(DEFAULT_THRESHOLD), "percent slowdown reported as a regression")
+        ("db", po::value<std::string>(&dbName)->default_value("benchmark.db"), "database for the synthetic vault, replaced if it exists")
+        ("dbuser", po::value<std::string>(&dbUser), "database user")
+        ("dbpasswd", po::value<std::string>(&dbPasswd), "database password")
+    ;
+
+    try
+    {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, options), vm);
+        po::notify(vm);
+
+        if (vm.count("help"))
+        {
+            cout << "benchmark " << VERSION_INFO << endl << endl << options << endl;
+            return 0;
+        }
+
+        std::map<std::string, double> baseline;
+        if (!baselineFile.empty()) { baseline = readBaseline(baselineFile); }
+
+        Benchmarks benchmarks(filter, minTime, false);
+        runMicroBenchmarks(benchmarks);
+        runCoinSelectionBenchmarks(benchmarks);
+
+        if (vaultSize > 0)
+        {
+            boost::filesystem::remove(dbName);
+            {
+                Vault vault(dbUser, dbPasswd, dbName, true);
+                runVaultBenchmarks(benchmarks, vault, vaultSize);
+            }
+            boost::filesystem::remove(dbName);
+        }
+
+        if (!jsonFile.empty())
+        {
+            ofstream file(jsonFile);
+            file << toJson(benchmarks.results(), vaultSize);
+        }
+
+        if (!baselineFile.empty() && compareToBaseline(benchmarks.results(), baseline, threshold) > 0) return 1;
+    }
+    catch (const exception& e)
+    {
+        cerr << "Error: " << e.what() << endl;
+        return 2;
+    }
+
+    return 0;
+}
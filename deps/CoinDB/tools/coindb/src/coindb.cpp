@@ -46,6 +46,14 @@ using namespace CoinDB;
 std::string g_dbuser;
 std::string g_dbpasswd;
 
+VaultFileFormat getVaultFileFormat(const std::string& format)
+{
+    if (format == "text")       return TEXT_FORMAT;
+    if (format == "binary")     return BINARY_FORMAT;
+    if (format == "compressed") return COMPRESSED_BINARY_FORMAT;
+    throw std::runtime_error("Invalid file format. Use text, binary or compressed.");
+}
+
 // Global operations
 cli::result_t cmd_create(const cli::params_t& params)
 {
@@ -98,7 +106,8 @@ cli::result_t cmd_exportvault(const cli::params_t& params)
     bool exportprivkeys = params.size() <= 1 || params[1] == "true";
 
     std::string output_file = params.size() > 2 ? params[2] : (params[0] + ".portable");
-    vault.exportVault(output_file, exportprivkeys);
+    VaultFileFormat format = params.size() > 3 ? getVaultFileFormat(params[3]) : TEXT_FORMAT;
+    vault.exportVault(output_file, exportprivkeys, format);
 
     stringstream ss;
     ss << "Vault " << params[0] << " exported to " << output_file << ".";
@@ -118,6 +127,18 @@ cli::result_t cmd_importvault(const cli::params_t& params)
     return ss.str();
 }
 
+cli::result_t cmd_backup(const cli::params_t& params)
+{
+    Vault vault(g_dbuser, g_dbpasswd, params[0], false);
+
+    std::string output_file = params.size() > 1 ? params[1] : (params[0] + ".backup");
+    vault.backup(output_file);
+
+    stringstream ss;
+    ss << "Vault " << params[0] << " backed up to " << output_file << ".";
+    return ss.str();
+}
+
 // Contact operations
 cli::result_t cmd_contactinfo(const cli::params_t& params)
 {
@@ -638,12 +659,14 @@ cli::result_t cmd_history(const cli::params_t& params)
     const CoinQ::CoinParams& coinParams = networkSelector.getCoinParams();
 
     uint32_t best_height = vault.getBestHeight();
-    vector<TxOutView> txOutViews = vault.getTxOutViews(account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
-    stringstream ss;
-    ss << formattedTxOutViewHeader();
-    for (auto& txOutView: txOutViews)
-        ss << endl << formattedTxOutView(txOutView, best_height, coinParams);
-    return ss.str();
+    // Rows are written as they are read rather than collected, so large histories don't have to fit in memory.
+    cout << formattedTxOutViewHeader();
+    HistoryCursor cursor;
+    vault.getTxOutViews(cursor, [&](const TxOutView& txOutView) {
+        cout << '\n' << formattedTxOutView(txOutView, best_height, coinParams);
+        return true;
+    }, account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
+    return "";
 }
 
 cli::result_t cmd_historycsv(const cli::params_t& params)
@@ -661,16 +684,15 @@ cli::result_t cmd_historycsv(const cli::params_t& params)
     const CoinQ::CoinParams& coinParams = networkSelector.getCoinParams();
 
     uint32_t best_height = vault.getBestHeight();
-    vector<TxOutView> txOutViews = vault.getTxOutViews(account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
-    stringstream ss;
     bool bNewLine = false;
-    for (auto& txOutView: txOutViews)
-    {
-        if (bNewLine)   { ss << endl; }
+    HistoryCursor cursor;
+    vault.getTxOutViews(cursor, [&](const TxOutView& txOutView) {
+        if (bNewLine)   { cout << '\n'; }
         else            { bNewLine = true; }
-        ss << formattedTxOutViewCSV(txOutView, best_height, coinParams);
-    }
-    return ss.str();
+        cout << formattedTxOutViewCSV(txOutView, best_height, coinParams);
+        return true;
+    }, account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
+    return "";
 }
 
 cli::result_t cmd_unspent(const cli::params_t& params)
@@ -787,12 +809,13 @@ cli::result_t cmd_listtxs(const cli::params_t& params)
     uint32_t minheight = params.size() > 2 ? strtoul(params[2].c_str(), NULL, 0) : 0;
     Vault vault(g_dbuser, g_dbpasswd, params[0], false);
     uint32_t best_height = vault.getBestHeight();
-    std::vector<TxView> txViews = vault.getTxViews(tx_status_flags, 0, -1, minheight);
-    stringstream ss;
-    ss << formattedTxViewHeader();
-    for (auto& txView: txViews)
-        ss << endl << formattedTxView(txView, best_height);
-    return ss.str();
+    cout << formattedTxViewHeader();
+    HistoryCursor cursor;
+    vault.getTxViews(cursor, [&](const TxView& txView) {
+        cout << '\n' << formattedTxView(txView, best_height);
+        return true;
+    }, tx_status_flags, -1, minheight);
+    return "";
 }
 
 cli::result_t cmd_txinfo(const cli::params_t& params)
@@ -1119,7 +1142,8 @@ cli::result_t cmd_exporttxs(const cli::params_t& params)
 
     uint32_t minheight = params.size() > 1 ? strtoul(params[1].c_str(), NULL, 0) : 0;
     std::string output_file = params.size() > 2 ? params[2] : (params[0] + ".txs");
-    vault.exportTxs(output_file, minheight);
+    VaultFileFormat format = params.size() > 3 ? getVaultFileFormat(params[3]) : TEXT_FORMAT;
+    vault.exportTxs(output_file, minheight, format);
 
     stringstream ss;
     ss << "Transactions exported to " << output_file << ".";
@@ -1254,7 +1278,8 @@ cli::result_t cmd_exportmerkleblocks(const cli::params_t& params)
     Vault vault(g_dbuser, g_dbpasswd, params[0], false);
 
     std::string output_file = params.size() > 1 ? params[1] : (params[0] + ".chain");
-    vault.exportMerkleBlocks(output_file);
+    VaultFileFormat format = params.size() > 2 ? getVaultFileFormat(params[2]) : TEXT_FORMAT;
+    vault.exportMerkleBlocks(output_file, format);
 
     stringstream ss;
     ss << "Merkle blocks exported to " << output_file << ".";
@@ -1323,13 +1348,19 @@ int main(int argc, char* argv[])
         "exportvault",
         "export vault contents to portable file",
         command::params(1, "db file"),
-        command::params(2, "export private keys = true", "output file = *.portable")));
+        command::params(3, "export private keys = true", "output file = *.portable", "format = text")));
     shell.add(command(
         &cmd_importvault,
         "importvault",
         "import vault contents from portable file",
         command::params(2, "db file", "portable file"),
         command::params(1, "import private keys = true")));
+    shell.add(command(
+        &cmd_backup,
+        "backup",
+        "copy database file while it is in use",
+        command::params(1, "db file"),
+        command::params(1, "output file = *.backup")));
 
     // Contact operations
     shell.add(command(
@@ -1615,7 +1646,7 @@ int main(int argc, char* argv[])
         "exporttxs",
         "export transactions to file",
         command::params(1, "db file"),
-        command::params(2, "minheight = 0", "output file = *.txs")));
+        command::params(3, "minheight = 0", "output file = *.txs", "format = text")));
     shell.add(command(
         &cmd_importtxs,
         "importtxs",
@@ -1672,7 +1703,7 @@ int main(int argc, char* argv[])
         "exportmerkleblocks",
         "export all merkle blocks to file",
         command::params(1, "db file"),
-        command::params(1, "output file = *.chain")));
+        command::params(2, "output file = *.chain", "format = text")));
     shell.add(command(
         &cmd_importmerkleblocks,
         "importmerkleblocks",
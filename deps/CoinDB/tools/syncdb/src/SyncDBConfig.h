@@ -16,6 +16,7 @@
 const double DEFAULT_FILTER_FALSE_POSITIVE_RATE = 0.001;
 const uint32_t DEFAULT_FILTER_TWEAK = 0;
 const uint8_t DEFAULT_FILTER_FLAGS = 0;
+const unsigned int DEFAULT_METRICS_INTERVAL = 60; // seconds
 
 class SyncDBConfig : public CoinDBConfig
 {
@@ -27,11 +28,15 @@ public:
     double getFilterFalsePositiveRate() const { return m_filterFalsePositiveRate; }
     uint32_t getFilterTweak() const { return m_filterTweak; }
     uint8_t getFilterFlags() const { return m_filterFlags; }
+    unsigned int getMetricsInterval() const { return m_metricsInterval; }
+    const std::string& getTraceFile() const { return m_traceFile; }
 
 protected:
     double m_filterFalsePositiveRate;
     uint32_t m_filterTweak;
     uint8_t m_filterFlags;
+    unsigned int m_metricsInterval;
+    std::string m_traceFile;
 };
 
 inline SyncDBConfig::SyncDBConfig() : CoinDBConfig()
@@ -42,6 +47,8 @@ inline SyncDBConfig::SyncDBConfig() : CoinDBConfig()
         ("filterfpr", po::value<double>(&m_filterFalsePositiveRate), "filter false positive rate")
         ("filtertweak", po::value<uint32_t>(&m_filterTweak), "filter tweak")
         ("filterflags", po::value<uint8_t>(&m_filterFlags), "filter flags")
+        ("metricsinterval", po::value<unsigned int>(&m_metricsInterval), "seconds between metrics dumps, 0 to disable")
+        ("tracefile", po::value<std::string>(&m_traceFile), "write a Chrome trace of the sync to this file")
     ;
 }
 
@@ -52,6 +59,7 @@ inline bool SyncDBConfig::parseParams(int argc, char* argv[])
     if (!m_vm.count("filterfpr"))   { m_filterFalsePositiveRate = DEFAULT_FILTER_FALSE_POSITIVE_RATE; }
     if (!m_vm.count("filtertweak")) { m_filterTweak = DEFAULT_FILTER_TWEAK; }
     if (!m_vm.count("filterflags")) { m_filterFlags = DEFAULT_FILTER_FLAGS; }
+    if (!m_vm.count("metricsinterval")) { m_metricsInterval = DEFAULT_METRICS_INTERVAL; }
 
     return true;
 }
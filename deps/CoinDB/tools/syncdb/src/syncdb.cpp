@@ -19,12 +19,13 @@
 
 #include <logger/logger.h>
 #include <stdutils/stringutils.h>
+#include <stdutils/metrics.h>
+#include <stdutils/tracing.h>
 
 #include <iostream>
 #include <signal.h>
 
-#include <thread>
-#include <chrono>
+#include <boost/asio.hpp>
 
 using namespace CoinDB;
 using namespace CoinQ;
@@ -34,10 +35,14 @@ const std::string VERSION_INFO = "v0.2.0";
 
 bool g_bShutdown = false;
 
-void finish(int sig)
+// Delivers SIGINT and SIGTERM. main() runs it once the sync has started and returns when it stops.
+boost::asio::io_service g_shutdownService;
+
+void finish()
 {
     LOGGER(debug) << "Stopping..." << endl;
     g_bShutdown = true;
+    g_shutdownService.stop();
 }
 
 void subscribeHandlers(SynchedVault& synchedVault)
@@ -47,7 +52,7 @@ void subscribeHandlers(SynchedVault& synchedVault)
         ss << "Sync status: " << SynchedVault::getStatusString(status);
         LOGGER(info) << ss.str() << endl;
         cout << ss.str() << endl;
-        if (status == SynchedVault::STOPPED) { g_bShutdown = true; }
+        if (status == SynchedVault::STOPPED) { finish(); }
     });
 
     synchedVault.subscribeTxInserted([](std::shared_ptr<Tx> tx)
@@ -74,6 +79,14 @@ void subscribeHandlers(SynchedVault& synchedVault)
         cout << ss.str() << endl;
     });
 
+    synchedVault.subscribeConfirmationsChanged([](uint32_t height, const hashvector_t& txhashes)
+    {
+        stringstream ss;
+        ss << "Confirmations removed: " << txhashes.size() << " transaction(s) from height " << height;
+        LOGGER(info) << ss.str() << endl;
+        cout << ss.str() << endl;
+    });
+
     synchedVault.subscribeTxInsertionError([](std::shared_ptr<Tx> tx, const std::string& description)
     {
         stringstream ss;
@@ -170,10 +183,22 @@ int main(int argc, char* argv[])
     string logfile = config.getDataDir() + "/syncdb.log";    
     INIT_LOGGER(logfile.c_str());
 
+    if (config.getMetricsInterval())
+    {
+        string metricsfile = config.getDataDir() + "/syncdb_metrics.log";
+        stdutils::metrics::get_registry().start_dump(metricsfile, config.getMetricsInterval());
+    }
+
+    if (!config.getTraceFile().empty())
+    {
+        cout << "Writing trace to " << config.getTraceFile() << endl;
+        stdutils::tracing::start(config.getTraceFile());
+    }
+
     string blocktreefile = config.getDataDir() + "/" + coinParams.network_name() + "_headers.dat";
 
-    signal(SIGINT, &finish);
-    signal(SIGTERM, &finish);
+    boost::asio::signal_set signals(g_shutdownService, SIGINT, SIGTERM);
+    signals.async_wait([](const boost::system::error_code& ec, int /*sig*/) { if (!ec) { finish(); } });
 
     LOGGER(trace) << "foo" << endl;
     SynchedVault synchedVault(coinParams);
@@ -190,6 +215,7 @@ int main(int argc, char* argv[])
         LOGGER(info) << "Loading block tree " << blocktreefile << endl;
         synchedVault.loadHeaders(blocktreefile, false, [&](const CoinQBlockTreeMem& blockTree) {
             cout << "  " << blockTree.getBestHash().getHex() << " height: " << blockTree.getBestHeight() << endl;
+            g_shutdownService.poll();
             return !g_bShutdown;
         });
 
@@ -226,9 +252,11 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    while (!g_bShutdown) { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
+    g_shutdownService.run();
 
     synchedVault.stopSync();
+    stdutils::tracing::stop();
+    stdutils::metrics::get_registry().stop_dump();
 
     return 0;
 
@@ -23,7 +23,7 @@ BlockchainDownload::BlockchainDownload(const CoinQ::CoinParams& coinParams, bool
     m_coinParams(coinParams),
     m_bCheckProofOfWork(bCheckProofOfWork),
     m_bStarted(false),
-    m_bIOServiceStarted(false),
+    m_ioServicePool(m_ioService),
     m_work(m_ioService),
     m_bConnected(false),
     m_peer(m_ioService)
@@ -159,7 +159,7 @@ void BlockchainDownload::start(const string& host, const string& port, const vec
     
         LOGGER(trace) << "BlockchainDownload::start(" << host << ", " << port << ")" << std::endl;
 
-        startIOServiceThread();
+        m_ioServicePool.start();
         m_bStarted = true;
 
         string port_ = port.empty() ? m_coinParams.default_port() : port;
@@ -201,7 +201,7 @@ void BlockchainDownload::stop()
 
         m_bConnected = false;
         m_peer.stop();
-        stopIOServiceThread();
+        m_ioServicePool.stop();
 
         m_bStarted = false;
     }
@@ -209,29 +209,3 @@ void BlockchainDownload::stop()
     notifyStopped();
 }
 
-void BlockchainDownload::startIOServiceThread()
-{
-    if (m_bIOServiceStarted) throw std::runtime_error("BlockchainDownload - io service already started.");
-    boost::lock_guard<boost::mutex> lock(m_ioServiceMutex);
-    if (m_bIOServiceStarted) throw std::runtime_error("BlockchainDownload - io service already started.");
-
-    LOGGER(trace) << "Starting IO service thread..." << endl;
-    m_bIOServiceStarted = true;
-    m_ioServiceThread = boost::thread(boost::bind(&CoinQ::io_service_t::run, &m_ioService));
-    LOGGER(trace) << "IO service thread started." << endl;
-}
-
-void BlockchainDownload::stopIOServiceThread()
-{
-    if (!m_bIOServiceStarted) return;
-    boost::lock_guard<boost::mutex> lock(m_ioServiceMutex);
-    if (!m_bIOServiceStarted) return;
-
-    LOGGER(trace) << "Stopping IO service thread..." << endl;
-    m_ioService.stop();
-    m_ioServiceThread.join();
-    m_ioService.reset();
-    m_bIOServiceStarted = false;
-    LOGGER(trace) << "IO service thread stopped." << endl; 
-}
-
@@ -16,6 +16,7 @@
 #endif
 
 #include "CoinQ_peer_io.h"
+#include "CoinQ_iopool.h"
 
 #include <boost/thread.hpp>
 
@@ -46,6 +47,10 @@ public:
 
     void enableCheckProofOfWork(bool bCheckProofOfWork = true) { m_bCheckProofOfWork = bCheckProofOfWork; }
 
+    // Threads running the network io_service. Takes effect on the next start().
+    void setIOThreadCount(unsigned int threadCount) { m_ioServicePool.setThreadCount(threadCount); }
+    unsigned int getIOThreadCount() const { return m_ioServicePool.getThreadCount(); }
+
     int getBestHeight() const { return m_blockTree.getBestHeight(); }
     const bytes_t& getBestHash() const { return m_blockTree.getBestHash(); }
 
@@ -88,12 +93,8 @@ private:
     bool m_bStarted;
     boost::mutex m_startMutex;
 
-    bool m_bIOServiceStarted;
-    boost::mutex m_ioServiceMutex;
-    void startIOServiceThread();
-    void stopIOServiceThread();
     CoinQ::io_service_t m_ioService;
-    boost::thread m_ioServiceThread;
+    CoinQ::IOServicePool m_ioServicePool;
     CoinQ::io_service_t::work m_work;
 
     bool m_bConnected;
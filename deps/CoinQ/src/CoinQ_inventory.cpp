@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_inventory.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#include "CoinQ_inventory.h"
+
+#include <stdutils/uchar_vector.h>
+#include <logger/logger.h>
+
+using namespace CoinQ;
+
+InventoryScheduler::InventoryScheduler(std::size_t maxInFlight, duration_t timeout, duration_t retryDelay, unsigned int maxAttempts) :
+    m_maxInFlight(maxInFlight), m_timeout(timeout), m_retryDelay(retryDelay), m_maxAttempts(maxAttempts), m_inFlight(0)
+{
+}
+
+bool InventoryScheduler::add(const bytes_t& hash)
+{
+    Item item;
+    item.bInFlight = false;
+    item.attempts = 0;
+    item.time = time_point_t();
+    if (!m_items.insert(std::make_pair(hash, item)).second) return false;
+
+    m_fresh.push_back(hash);
+    return true;
+}
+
+bool InventoryScheduler::received(const bytes_t& hash)
+{
+    items_t::iterator it = m_items.find(hash);
+    if (it == m_items.end()) return false;
+
+    // A hash still queued stays in its queue and is skipped when it comes up.
+    bool bInFlight = it->second.bInFlight;
+    if (bInFlight) { m_inFlight--; }
+    m_items.erase(it);
+    return bInFlight;
+}
+
+void InventoryScheduler::notFound(const bytes_t& hash, time_point_t now)
+{
+    items_t::iterator it = m_items.find(hash);
+    if (it == m_items.end() || !it->second.bInFlight) return;
+
+    retry(it, now);
+}
+
+hashvector_t InventoryScheduler::next(time_point_t now)
+{
+    if (m_inFlight > 0)
+    {
+        for (items_t::iterator it = m_items.begin(); it != m_items.end();)
+        {
+            items_t::iterator current = it++;
+            if (current->second.bInFlight && now - current->second.time >= m_timeout) { retry(current, now); }
+        }
+    }
+
+    hashvector_t hashes;
+    auto take = [&](std::deque<bytes_t>& queue, bool bRetries) {
+        while (!queue.empty() && m_inFlight < m_maxInFlight)
+        {
+            items_t::iterator it = m_items.find(queue.front());
+            if (it != m_items.end() && !it->second.bInFlight)
+            {
+                if (bRetries && it->second.time > now) break;
+
+                it->second.bInFlight = true;
+                it->second.attempts++;
+                it->second.time = now;
+                m_inFlight++;
+                hashes.push_back(queue.front());
+            }
+            queue.pop_front();
+        }
+    };
+
+    take(m_retries, true);
+    take(m_fresh, false);
+    return hashes;
+}
+
+bool InventoryScheduler::ready(time_point_t now) const
+{
+    if (m_inFlight >= m_maxInFlight) return false;
+    if (!m_fresh.empty()) return true;
+    if (m_retries.empty()) return false;
+
+    items_t::const_iterator it = m_items.find(m_retries.front());
+    return it == m_items.end() || it->second.time <= now;
+}
+
+void InventoryScheduler::clear()
+{
+    m_items.clear();
+    m_inFlight = 0;
+    m_fresh.clear();
+    m_retries.clear();
+}
+
+void InventoryScheduler::retry(items_t::iterator it, time_point_t now)
+{
+    it->second.bInFlight = false;
+    m_inFlight--;
+
+    if (it->second.attempts >= m_maxAttempts)
+    {
+        LOGGER(debug) << "InventoryScheduler - giving up on " << uchar_vector(it->first).getHex() << " after " << it->second.attempts << " attempt(s)." << std::endl;
+        m_items.erase(it);
+        return;
+    }
+
+    it->second.time = now + m_retryDelay;
+    m_retries.push_back(it->first);
+}
@@ -0,0 +1,91 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_inventory.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+// Decides which announced txs to ask a peer for and when. Hashes are queued as they are announced
+// and handed out in batches, each at most once while a request for it is outstanding, with no more
+// than a fixed number outstanding at a time. Requests the peer answers with notfound or not at all
+// are queued again after a delay, up to a maximum number of attempts.
+//
+// One scheduler per peer. Not thread safe - NetworkSync guards it with its inventory mutex.
+//
+
+#pragma once
+
+#include <CoinCore/typedefs.h>
+
+#include <chrono>
+#include <deque>
+#include <map>
+
+namespace CoinQ
+{
+
+class InventoryScheduler
+{
+public:
+    typedef std::chrono::steady_clock clock_t;
+    typedef clock_t::time_point time_point_t;
+    typedef clock_t::duration duration_t;
+
+    static const std::size_t DEFAULT_MAX_IN_FLIGHT = 1000;
+    static const unsigned int DEFAULT_MAX_ATTEMPTS = 3;
+
+    explicit InventoryScheduler(
+        std::size_t maxInFlight = DEFAULT_MAX_IN_FLIGHT,
+        duration_t timeout = std::chrono::seconds(30),
+        duration_t retryDelay = std::chrono::seconds(2),
+        unsigned int maxAttempts = DEFAULT_MAX_ATTEMPTS);
+
+    // Returns false if the hash is already queued or in flight.
+    bool add(const bytes_t& hash);
+
+    // Returns false if the hash was not in flight, as with txs a peer sends unasked.
+    bool received(const bytes_t& hash);
+
+    void notFound(const bytes_t& hash, time_point_t now = clock_t::now());
+
+    // Queues requests that have timed out for another attempt, then takes as many queued hashes
+    // as there is room in flight for and marks them in flight.
+    hashvector_t next(time_point_t now = clock_t::now());
+
+    // Whether next() would return anything at the given time.
+    bool ready(time_point_t now = clock_t::now()) const;
+
+    std::size_t queued() const { return m_fresh.size() + m_retries.size(); }
+    std::size_t inFlight() const { return m_inFlight; }
+    bool idle() const { return m_items.empty(); }
+
+    void clear();
+
+private:
+    struct Item
+    {
+        bool bInFlight;
+        unsigned int attempts;
+        time_point_t time; // when it was requested if in flight, when it may be retried otherwise
+    };
+
+    typedef std::map<bytes_t, Item> items_t;
+
+    void retry(items_t::iterator it, time_point_t now);
+
+    std::size_t m_maxInFlight;
+    duration_t m_timeout;
+    duration_t m_retryDelay;
+    unsigned int m_maxAttempts;
+
+    items_t m_items;
+    std::size_t m_inFlight;
+
+    // Retries all wait the same delay, so both queues stay in the order their hashes become due.
+    std::deque<bytes_t> m_fresh;
+    std::deque<bytes_t> m_retries;
+};
+
+}
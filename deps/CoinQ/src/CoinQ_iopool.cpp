@@ -0,0 +1,97 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_iopool.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#include "CoinQ_iopool.h"
+
+#include <logger/logger.h>
+
+#include <stdexcept>
+
+using namespace CoinQ;
+
+namespace
+{
+    thread_local const IOServicePool* t_currentPool = nullptr;
+}
+
+IOServicePool::IOServicePool(boost::asio::io_service& io_service, unsigned int threadCount) :
+    m_ioService(io_service), m_threadCount(threadCount ? threadCount : 1), m_bRunning(false)
+{
+}
+
+IOServicePool::~IOServicePool()
+{
+    stop();
+    if (!isPoolThread()) { joinThreads(); }
+}
+
+void IOServicePool::setThreadCount(unsigned int threadCount)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_threadCount = threadCount ? threadCount : 1;
+}
+
+void IOServicePool::start()
+{
+    if (isPoolThread()) throw std::runtime_error("IOServicePool - cannot be started from one of its own threads.");
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_bRunning) throw std::runtime_error("IOServicePool - already started.");
+
+    joinThreads();
+    m_ioService.reset();
+
+    LOGGER(trace) << "IOServicePool - starting " << m_threadCount << " thread(s)..." << std::endl;
+    for (unsigned int i = 0; i < m_threadCount; i++)
+    {
+        m_threads.push_back(std::make_shared<boost::thread>(boost::bind(&IOServicePool::run, this)));
+    }
+    m_bRunning = true;
+}
+
+void IOServicePool::stop()
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (!m_bRunning) return;
+
+    m_ioService.stop();
+    m_bRunning = false;
+
+    if (isPoolThread())
+    {
+        LOGGER(trace) << "IOServicePool - stopped from a pool thread, not waiting for the others." << std::endl;
+        return;
+    }
+
+    LOGGER(trace) << "IOServicePool - joining threads..." << std::endl;
+    joinThreads();
+    LOGGER(trace) << "IOServicePool - threads stopped." << std::endl;
+}
+
+bool IOServicePool::isPoolThread() const
+{
+    return t_currentPool == this;
+}
+
+void IOServicePool::run()
+{
+    t_currentPool = this;
+    m_ioService.run();
+    t_currentPool = nullptr;
+}
+
+void IOServicePool::joinThreads()
+{
+    for (auto& thread: m_threads)
+    {
+        if (thread->joinable()) { thread->join(); }
+    }
+    m_threads.clear();
+}
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_iopool.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+// Runs an io_service on a pool of threads. Handlers that must not run concurrently, such as those
+// of one Peer, go through a strand - the pool only lets different connections and timers proceed
+// in parallel.
+//
+
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace CoinQ
+{
+
+class IOServicePool
+{
+public:
+    static const unsigned int DEFAULT_THREAD_COUNT = 2;
+
+    explicit IOServicePool(boost::asio::io_service& io_service, unsigned int threadCount = DEFAULT_THREAD_COUNT);
+    ~IOServicePool();
+
+    // Takes effect the next time the pool is started.
+    void setThreadCount(unsigned int threadCount);
+    unsigned int getThreadCount() const { return m_threadCount; }
+
+    // Throws if called from one of the pool's own handlers: that thread is still inside run() and
+    // the io_service cannot be reset under it.
+    void start();
+
+    // Stops the io_service and waits for the threads to exit. Called from one of the pool's own
+    // handlers, it returns without waiting - the handler may hold locks the others are waiting on.
+    // Those threads are joined when the pool is started again.
+    void stop();
+
+    bool isRunning() const { return m_bRunning; }
+
+    // Needs no lock, so handlers can ask while another thread is stopping the pool.
+    bool isPoolThread() const;
+
+private:
+    void run();
+    void joinThreads();
+
+    boost::asio::io_service& m_ioService;
+    unsigned int m_threadCount;
+    std::atomic<bool> m_bRunning;
+    mutable boost::mutex m_mutex;
+
+    typedef std::vector<std::shared_ptr<boost::thread>> threads_t;
+    threads_t m_threads;
+};
+
+}
@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_mempool.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#include "CoinQ_mempool.h"
+
+#include <cstring>
+#include <random>
+#include <stdexcept>
+
+#include <time.h>
+
+using namespace CoinQ;
+
+Mempool::Mempool(std::size_t capacity, uint32_t maxAge) :
+    m_maxAge(maxAge), m_size(0), m_nextSeq(1)
+{
+    if (capacity == 0) throw std::runtime_error("Mempool - capacity must be greater than zero.");
+
+    // Salted so that peers cannot pick tx hashes that all land in the same part of the table.
+    std::random_device seed;
+    m_salt = ((uint64_t)seed() << 32) | seed();
+
+    std::size_t tableSize = 2;
+    while (tableSize < 2 * capacity) { tableSize <<= 1; }
+    m_capacity = capacity;
+    m_table.resize(tableSize);
+    m_mask = tableSize - 1;
+    clear();
+}
+
+bool Mempool::insert(const bytes_t& hash, uint32_t now)
+{
+    hash_t key;
+    if (!toHash(hash, key)) return false;
+    if (now == 0) { now = time(NULL); }
+
+    if (find(key) != m_table.size()) return false;
+
+    expire(now);
+    if (m_size == m_capacity) { evictOldest(); }
+
+    std::size_t i = bucket(key);
+    while (m_table[i].seq != 0) { i = (i + 1) & m_mask; }
+
+    Entry& entry = m_table[i];
+    entry.hash = key;
+    entry.seq = m_nextSeq++;
+    entry.time = now;
+    m_size++;
+
+    m_ageQueue.push_back(std::make_pair(entry.seq, key));
+    if (m_ageQueue.size() > 2 * m_capacity) { compactAgeQueue(); }
+    return true;
+}
+
+bool Mempool::contains(const bytes_t& hash) const
+{
+    hash_t key;
+    return toHash(hash, key) && find(key) != m_table.size();
+}
+
+bool Mempool::erase(const bytes_t& hash)
+{
+    hash_t key;
+    if (!toHash(hash, key)) return false;
+
+    std::size_t i = find(key);
+    if (i == m_table.size()) return false;
+
+    eraseAt(i);
+    return true;
+}
+
+void Mempool::clear()
+{
+    for (auto& entry: m_table) { entry.seq = 0; }
+    m_size = 0;
+    m_ageQueue.clear();
+}
+
+void Mempool::expire(uint32_t now)
+{
+    if (now == 0) { now = time(NULL); }
+    if (now < m_maxAge) return;
+
+    uint32_t cutoff = now - m_maxAge;
+    while (!m_ageQueue.empty())
+    {
+        std::size_t i = find(m_ageQueue.front().second);
+        if (i != m_table.size() && m_table[i].seq == m_ageQueue.front().first)
+        {
+            if (m_table[i].time >= cutoff) break;
+            eraseAt(i);
+        }
+        m_ageQueue.pop_front();
+    }
+}
+
+bool Mempool::toHash(const bytes_t& bytes, hash_t& hash)
+{
+    if (bytes.size() != hash.size()) return false;
+    std::memcpy(hash.data(), bytes.data(), hash.size());
+    return true;
+}
+
+std::size_t Mempool::bucket(const hash_t& hash) const
+{
+    // Tx hashes are already uniformly distributed, so one 64 bit word mixed with the salt is enough.
+    uint64_t h;
+    std::memcpy(&h, hash.data(), sizeof(h));
+    h ^= m_salt;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (std::size_t)h & m_mask;
+}
+
+std::size_t Mempool::find(const hash_t& hash) const
+{
+    for (std::size_t i = bucket(hash); m_table[i].seq != 0; i = (i + 1) & m_mask)
+    {
+        if (m_table[i].hash == hash) return i;
+    }
+    return m_table.size();
+}
+
+void Mempool::eraseAt(std::size_t i)
+{
+    m_table[i].seq = 0;
+    m_size--;
+
+    // Backward shift deletion: move later entries of the probe sequence up into the gap so that
+    // lookups never need tombstones.
+    std::size_t gap = i;
+    for (std::size_t j = (i + 1) & m_mask; m_table[j].seq != 0; j = (j + 1) & m_mask)
+    {
+        std::size_t home = bucket(m_table[j].hash);
+        if (((j - home) & m_mask) >= ((j - gap) & m_mask))
+        {
+            m_table[gap] = m_table[j];
+            m_table[j].seq = 0;
+            gap = j;
+        }
+    }
+}
+
+void Mempool::evictOldest()
+{
+    while (!m_ageQueue.empty())
+    {
+        std::pair<uint64_t, hash_t> oldest = m_ageQueue.front();
+        m_ageQueue.pop_front();
+
+        std::size_t i = find(oldest.second);
+        if (i != m_table.size() && m_table[i].seq == oldest.first)
+        {
+            eraseAt(i);
+            return;
+        }
+    }
+}
+
+void Mempool::compactAgeQueue()
+{
+    std::deque<std::pair<uint64_t, hash_t>> ageQueue;
+    for (auto& item: m_ageQueue)
+    {
+        std::size_t i = find(item.second);
+        if (i != m_table.size() && m_table[i].seq == item.first) { ageQueue.push_back(item); }
+    }
+    m_ageQueue.swap(ageQueue);
+}
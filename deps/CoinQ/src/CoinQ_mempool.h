@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CoinQ_mempool.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+// The hashes of the unconfirmed txs a peer has sent us, so that their confirmations can be
+// recognized when a merkle block lists them.
+//
+// Hashes are kept in an open addressing table sized once at construction and never rehashed.
+// When it is full, or an entry is older than the maximum age, the oldest entries are dropped - a
+// tx confirmed after being dropped is still found, just through the slower missing tx path.
+//
+// Not thread safe - NetworkSync guards it with its mempool mutex.
+//
+
+#pragma once
+
+#include "CoinQ_typedefs.h"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace CoinQ
+{
+
+class Mempool
+{
+public:
+    typedef std::array<unsigned char, 32> hash_t;
+
+    static const std::size_t DEFAULT_CAPACITY = 1 << 16;
+    static const uint32_t DEFAULT_MAX_AGE = 14 * 24 * 60 * 60; // seconds
+
+    explicit Mempool(std::size_t capacity = DEFAULT_CAPACITY, uint32_t maxAge = DEFAULT_MAX_AGE);
+
+    std::size_t size() const { return m_size; }
+    std::size_t capacity() const { return m_capacity; }
+    bool empty() const { return m_size == 0; }
+
+    // Returns false if the hash was already there.
+    bool insert(const bytes_t& hash, uint32_t now = 0);
+
+    bool contains(const bytes_t& hash) const;
+    bool erase(const bytes_t& hash);
+    void clear();
+
+    // Drops entries inserted more than the maximum age before now.
+    void expire(uint32_t now = 0);
+
+private:
+    struct Entry
+    {
+        hash_t hash;
+        uint64_t seq;   // 0 for an empty slot
+        uint32_t time;
+    };
+
+    static bool toHash(const bytes_t& bytes, hash_t& hash);
+
+    std::size_t bucket(const hash_t& hash) const;
+    std::size_t find(const hash_t& hash) const; // m_table.size() if not found
+    void eraseAt(std::size_t i);
+    void evictOldest();
+    void compactAgeQueue();
+
+    std::size_t m_capacity;
+    uint32_t m_maxAge;
+    uint64_t m_salt;
+
+    std::vector<Entry> m_table; // twice the capacity, so probe sequences stay short
+    std::size_t m_mask;
+    std::size_t m_size;
+    uint64_t m_nextSeq;
+
+    // Insertion order. Entries erased some other way are left here and skipped when they come up.
+    std::deque<std::pair<uint64_t, hash_t>> m_ageQueue;
+};
+
+}
@@ -18,24 +18,31 @@
 #include <stdint.h>
 
 #include <logger/logger.h>
-
-#include <thread>
-#include <chrono>
+#include <stdutils/metrics.h>
+#include <stdutils/tracing.h>
 
 using namespace CoinQ::Network;
 using namespace std;
 
+// How long announcements are collected before they are requested, and how often requests in
+// flight are checked for timeouts.
+const boost::posix_time::time_duration INV_BATCH_WINDOW = boost::posix_time::milliseconds(100);
+const boost::posix_time::time_duration INV_CHECK_INTERVAL = boost::posix_time::seconds(1);
+
 NetworkSync::NetworkSync(const CoinQ::CoinParams& coinParams, bool bCheckProofOfWork) :
     m_coinParams(coinParams),
     m_bCheckProofOfWork(bCheckProofOfWork),
     m_bStarted(false),
-    m_bIOServiceStarted(false),
+    m_bStopping(false),
+    m_ioServicePool(m_ioService),
     m_work(m_ioService),
     m_bConnected(false),
     m_peer(m_ioService),
     m_bFlushingToFile(false),
     m_bHeadersSynched(false),
-    m_bMissingTxs(false)
+    m_bMissingTxs(false),
+    m_invTimer(m_ioService),
+    m_bInvTimerArmed(false)
 {
     // Select hash functions
     Coin::CoinBlockHeader::setHashFunc(m_coinParams.block_header_hash_function());
@@ -113,12 +120,13 @@ NetworkSync::NetworkSync(const CoinQ::CoinParams& coinParams, bool bCheckProofOf
 
         using namespace Coin;
         GetDataMessage getData;
+        hashvector_t txHashes;
         for (auto& item: inv.items)
         {
             switch (item.itemType)
             {
             case MSG_TX:
-                getData.items.push_back(InventoryItem(MSG_TX | peer.inv_flags(), item.hash));
+                txHashes.push_back(bytes_t(item.hash, item.hash + 32));
                 break;
             case MSG_BLOCK:
                 getData.items.push_back(InventoryItem(MSG_FILTERED_BLOCK | peer.inv_flags(), item.hash));
@@ -129,18 +137,37 @@ NetworkSync::NetworkSync(const CoinQ::CoinParams& coinParams, bool bCheckProofOf
         }
 
         if (!getData.items.empty()) { m_peer.send(getData); }
+        if (!txHashes.empty()) { requestTxs(txHashes, true); }
+    });
+
+    m_peer.subscribeNotFound([&](CoinQ::Peer& /*peer*/, const Coin::Inventory& inv)
+    {
+        LOGGER(trace) << "Received notfound message:" << std::endl << inv.toIndentedString(2) << std::endl;
+
+        boost::lock_guard<boost::mutex> invLock(m_invMutex);
+        for (auto& item: inv.items)
+        {
+            if ((item.itemType & ~MSG_WITNESS_FLAG) == MSG_TX) { m_invScheduler.notFound(bytes_t(item.hash, item.hash + 32)); }
+        }
     });
 
     m_peer.subscribeTx([&](CoinQ::Peer& /*peer*/, const Coin::Transaction& tx)
     {
+        static stdutils::metrics::gauge& mempoolSize = stdutils::metrics::get_gauge("netsync.mempool.txs");
         LOGGER(trace) << "Received transaction: " << tx.hash().getHex() << endl;
 
+        {
+            boost::lock_guard<boost::mutex> invLock(m_invMutex);
+            if (m_invScheduler.received(tx.hash()) && m_invScheduler.ready()) { scheduleInvFlush(INV_BATCH_WINDOW); }
+        }
+
         boost::unique_lock<boost::mutex> syncLock(m_syncMutex);
         if (m_currentMerkleTxHashes.empty())
         {
             {
                 boost::lock_guard<boost::mutex> mempoolLock(m_mempoolMutex);
-                m_mempoolTxs.insert(tx.hash());
+                m_mempool.insert(tx.hash());
+                mempoolSize.set(m_mempool.size());
             }
 
             syncLock.unlock();
@@ -250,7 +277,7 @@ NetworkSync::NetworkSync(const CoinQ::CoinParams& coinParams, bool bCheckProofOf
 
                     {
                         boost::lock_guard<boost::mutex> mempoolLock(m_mempoolMutex);
-                        m_mempoolTxs.erase(tx.hash());
+                        m_mempool.erase(tx.hash());
                     }
                 }
             }
@@ -306,6 +333,9 @@ NetworkSync::NetworkSync(const CoinQ::CoinParams& coinParams, bool bCheckProofOf
         uchar_vector merkleBlockHash = merkleBlock.hash();
         LOGGER(trace) << "Received merkle block: " << merkleBlockHash.getHex() << endl;
 
+        TRACE_SPAN(span, "NetworkSync::onMerkleBlock");
+        if (span) { span.arg("hash", merkleBlockHash.getHex()); }
+
         const ChainHeader& chainTip = m_blockTree.getHeader(-1);
         uchar_vector chainTipHash = chainTip.hash();
         LOGGER(trace) << "Current chain tip: " << chainTipHash.getHex() << " Height: " << chainTip.height << endl;
@@ -541,7 +571,7 @@ void NetworkSync::do_syncBlocks(int startHeight)
     m_lastSynchedMerkleBlockHash.clear();
     m_lastRequestedMerkleBlockHash = m_blockTree.getHeader(startHeight).hash();
 
-    LOGGER(trace) "Resynching blocks " << startHeight << " - " << m_blockTree.getTipHeight() << endl;
+    LOGGER(trace) << "Resynching blocks " << startHeight << " - " << m_blockTree.getTipHeight() << endl;
     notifySynchingBlocks();
 
     LOGGER(trace) << "Asking for filtered block (3) " << m_lastRequestedMerkleBlockHash.getHex() << endl;
@@ -559,14 +589,14 @@ void NetworkSync::stopSynchingBlocks(bool bClearFilter)
 void NetworkSync::addToMempool(const uchar_vector& txHash)
 {
     boost::lock_guard<boost::mutex> mempoolLock(m_mempoolMutex);
-    m_mempoolTxs.insert(txHash);
+    m_mempool.insert(txHash);
 }
 
 void NetworkSync::insertTx(const Coin::Transaction& tx)
 {
     {
         boost::lock_guard<boost::mutex> mempoolLock(m_mempoolMutex);
-        m_mempoolTxs.insert(tx.hash());
+        m_mempool.insert(tx.hash());
     }
 
     notifyNewTx(tx);
@@ -602,7 +632,7 @@ void NetworkSync::insertMerkleBlock(const Coin::MerkleBlock& merkleBlock, const
 
             {
                 boost::lock_guard<boost::mutex> mempoolLock(m_mempoolMutex);
-                m_mempoolTxs.erase(tx.hash());
+                m_mempool.erase(tx.hash());
             }
         }
     }
@@ -617,8 +647,9 @@ void NetworkSync::start(const std::string& host, const std::string& port)
     
         LOGGER(trace) << "NetworkSync::start(" << host << ", " << port << ")" << std::endl;
         startFileFlushThread();
-        startIOServiceThread();
+        m_ioServicePool.start();
 
+        m_bStopping = false;
         m_bStarted = true;
 
         std::string port_ = port.empty() ? m_coinParams.default_port() : port;
@@ -643,15 +674,31 @@ void NetworkSync::stop()
 {
     {
         if (!m_bStarted) return;
+
+        // The flag is raised before taking m_startMutex so a handler on one of the pool's threads
+        // (e.g. a peer close) never waits on it: whoever holds the mutex may be joining that thread.
+        bool bAlreadyStopping = m_bStopping.exchange(true);
+        if (bAlreadyStopping && m_ioServicePool.isPoolThread()) return;
+
         boost::lock_guard<boost::mutex> lock(m_startMutex);
         if (!m_bStarted) return;
 
         m_bConnected = false;
+        {
+            boost::lock_guard<boost::mutex> invLock(m_invMutex);
+            m_invScheduler.clear();
+            m_invTimer.cancel();
+            m_bInvTimerArmed = false;
+        }
         m_peer.stop();
-        stopIOServiceThread();
+        m_ioServicePool.stop();
         stopFileFlushThread();
 
         m_bStarted = false;
+
+        // When stopped from a pool thread the other pool threads have not been joined and might
+        // still be processing a block.
+        boost::lock_guard<boost::mutex> syncLock(m_syncMutex);
         m_bHeadersSynched = false;
         m_lastRequestedMerkleBlockHash.clear();
         while (!m_currentMerkleTxHashes.empty()) { m_currentMerkleTxHashes.pop(); }
@@ -667,11 +714,75 @@ void NetworkSync::sendTx(Coin::Transaction& tx)
 
 void NetworkSync::getTx(const bytes_t& hash)
 {
-    m_peer.getTx(hash);
+    requestTxs(hashvector_t(1, hash), false);
 }
 
 void NetworkSync::getTxs(const hashvector_t& hashes)
 {
+    requestTxs(hashes, false);
+}
+
+void NetworkSync::requestTxs(const hashvector_t& hashes, bool bSkipMempool)
+{
+    static stdutils::metrics::counter& duplicates = stdutils::metrics::get_counter("netsync.inv.duplicates");
+
+    hashvector_t wanted;
+    {
+        // Txs we were announced but already have are not requested again. Explicit requests are
+        // always sent - they are how we check that a tx we sent has propagated.
+        boost::unique_lock<boost::mutex> mempoolLock(m_mempoolMutex, boost::defer_lock);
+        if (bSkipMempool) { mempoolLock.lock(); }
+        for (auto& hash: hashes)
+        {
+            if (hash.size() != 32)
+            {
+                LOGGER(error) << "NetworkSync::requestTxs() - Invalid transaction hash requested: " << uchar_vector(hash).getHex() << endl;
+                continue;
+            }
+
+            if (bSkipMempool && m_mempool.contains(hash)) { duplicates.add(); }
+            else { wanted.push_back(hash); }
+        }
+    }
+
+    boost::lock_guard<boost::mutex> invLock(m_invMutex);
+    for (auto& hash: wanted)
+    {
+        if (!m_invScheduler.add(hash)) { duplicates.add(); }
+    }
+    if (m_invScheduler.ready()) { scheduleInvFlush(INV_BATCH_WINDOW); }
+}
+
+void NetworkSync::scheduleInvFlush(const boost::posix_time::time_duration& delay)
+{
+    // An earlier deadline replaces a later one. Rearming cancels the pending wait.
+    if (m_bInvTimerArmed && m_invTimer.expires_from_now() <= delay) return;
+
+    m_bInvTimerArmed = true;
+    m_invTimer.expires_from_now(delay);
+    m_invTimer.async_wait(boost::bind(&NetworkSync::flushInv, this, boost::asio::placeholders::error));
+}
+
+void NetworkSync::flushInv(const boost::system::error_code& ec)
+{
+    static stdutils::metrics::counter& requested = stdutils::metrics::get_counter("netsync.inv.requested");
+
+    if (ec == boost::asio::error::operation_aborted) return;
+
+    hashvector_t hashes;
+    {
+        boost::lock_guard<boost::mutex> invLock(m_invMutex);
+        m_bInvTimerArmed = false;
+        hashes = m_invScheduler.next();
+
+        // Keep checking in flight requests for timeouts and queued retries for when they are due.
+        if (!m_invScheduler.idle()) { scheduleInvFlush(m_invScheduler.ready() ? INV_BATCH_WINDOW : INV_CHECK_INTERVAL); }
+    }
+
+    if (hashes.empty() || !m_bConnected) return;
+
+    LOGGER(trace) << "Requesting " << hashes.size() << " transaction(s)." << endl;
+    requested.add(hashes.size());
     m_peer.getTxs(hashes);
 }
 
@@ -703,36 +814,6 @@ void NetworkSync::clearBloomFilter()
     m_peer.send(filterClear);
 }
 
-void NetworkSync::startIOServiceThread()
-{
-    if (m_bIOServiceStarted) throw std::runtime_error("NetworkSync - io service already started.");
-    boost::lock_guard<boost::mutex> lock(m_ioServiceMutex);
-    if (m_bIOServiceStarted) throw std::runtime_error("NetworkSync - io service already started.");
-
-    LOGGER(trace) << "Starting IO service thread..." << endl;
-    m_bIOServiceStarted = true;
-    m_ioServiceThread = boost::thread(boost::bind(&CoinQ::io_service_t::run, &m_ioService));
-    LOGGER(trace) << "IO service thread started." << endl;
-}
-
-void NetworkSync::stopIOServiceThread()
-{
-    if (!m_bIOServiceStarted) return;
-    boost::lock_guard<boost::mutex> lock(m_ioServiceMutex);
-    if (!m_bIOServiceStarted) return;
-
-    LOGGER(trace) << "Stopping IO service thread..." << endl;
-    m_ioService.stop();
-    LOGGER(trace) << "Waiting for io_service::run() to exit..." << endl;
-    while (!m_ioService.stopped()) { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
-    //LOGGER(trace) << "Joining IO service thread..." << endl;
-    //m_ioServiceThread.join();
-    LOGGER(trace) << "Resetting IO service..." << endl;
-    m_ioService.reset();
-    m_bIOServiceStarted = false;
-    LOGGER(trace) << "IO service thread stopped." << endl; 
-}
-
 void NetworkSync::startFileFlushThread()
 {
     if (m_bFlushingToFile) throw std::runtime_error("NetworkSync - file flush thread already started.");
@@ -773,30 +854,39 @@ void NetworkSync::fileFlushLoop()
             m_blockTree.flushToFile(m_blockTreeFile);
             LOGGER(trace) << "Finished flushing blocktree file." << endl;
         }
-        // TODO: use async timer
         catch (const BlockTreeException& e)
         {
             lock.unlock();
             LOGGER(error) << "Blocktree file flush error: " << e.what() << endl;
             notifyBlockTreeError(e.what(), e.code());
-            LOGGER(trace) << "Retrying blocktree file flush in 5 seconds..." << endl;
-            std::this_thread::sleep_for(std::chrono::seconds(5));
+            lock.lock();
+            waitToRetryFileFlush(lock);
         }
         catch (const exception& e)
         {
             lock.unlock();
             LOGGER(error) << "Blocktree file flush error: " << e.what() << endl;
             notifyBlockTreeError(e.what(), -1);
-            LOGGER(trace) << "Retrying blocktree file flush in 5 seconds..." << endl;
-            std::this_thread::sleep_for(std::chrono::seconds(5));
+            lock.lock();
+            waitToRetryFileFlush(lock);
         }
     }
 }
 
+void NetworkSync::waitToRetryFileFlush(boost::unique_lock<boost::mutex>& lock)
+{
+    // New headers notify the condition too but must not cut the wait short - only stopping does.
+    LOGGER(trace) << "Retrying blocktree file flush in 5 seconds..." << endl;
+    m_fileFlushCond.wait_for(lock, boost::chrono::seconds(5), [this]() { return !m_bFlushingToFile; });
+}
+
 void NetworkSync::syncMerkleBlock(const ChainMerkleBlock& merkleBlock, const Coin::PartialMerkleTree& merkleTree)
 {
     LOGGER(trace) << "Synchronizing merkle block: " << merkleBlock.hash().getHex() << " height: " << merkleBlock.height << endl;
 
+    TRACE_SPAN(span, "NetworkSync::syncMerkleBlock");
+    if (span) { span.arg("hash", merkleBlock.hash().getHex()).arg("height", merkleBlock.height); }
+
     while (!m_currentMerkleTxHashes.empty()) { m_currentMerkleTxHashes.pop(); }
 
     // The byte order of the tx hashes must be reversed when moving between merkle trees and the block chain
@@ -829,6 +919,9 @@ void NetworkSync::processBlockTx(const Coin::Transaction& tx)
 {
     string txHashHex = tx.hash().getHex();
     LOGGER(trace) << "NetworkSync::processBlockTx(" << txHashHex << ")" << endl;
+
+    TRACE_SPAN(span, "NetworkSync::processBlockTx");
+    if (span) { span.arg("tx", txHashHex); }
     try
     {
         boost::unique_lock<boost::mutex> syncLock(m_syncMutex);
@@ -909,8 +1002,8 @@ void NetworkSync::processBlockTx(const Coin::Transaction& tx)
 void NetworkSync::processMempoolConfirmations()
 {
     boost::unique_lock<boost::mutex> mempoolLock(m_mempoolMutex);
-    LOGGER(trace) << "Confirming " << m_currentMerkleTxHashes.size() << " merkle block transactions from " << m_mempoolTxs.size() << " mempool transactions..." << endl;
-    while (!m_currentMerkleTxHashes.empty() && m_mempoolTxs.count(m_currentMerkleTxHashes.front()))
+    LOGGER(trace) << "Confirming " << m_currentMerkleTxHashes.size() << " merkle block transactions from " << m_mempool.size() << " mempool transactions..." << endl;
+    while (!m_currentMerkleTxHashes.empty() && m_mempool.contains(m_currentMerkleTxHashes.front()))
     {
         const uchar_vector& txHash = m_currentMerkleTxHashes.front();
         LOGGER(trace) << "  Confirming tx (" << (m_currentMerkleTxIndex + 1) << " of " << m_currentMerkleTxCount << "): " << txHash.getHex() << endl;
@@ -918,7 +1011,7 @@ void NetworkSync::processMempoolConfirmations()
         notifyTxConfirmed(m_currentMerkleBlock, txHash, m_currentMerkleTxIndex++, m_currentMerkleTxCount);
 
         mempoolLock.lock();
-        m_mempoolTxs.erase(txHash);
+        m_mempool.erase(txHash);
         m_currentMerkleTxHashes.pop();
     }
     LOGGER(trace) << "Done processing mempool confirmations." << endl;
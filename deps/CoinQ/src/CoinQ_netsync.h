@@ -16,8 +16,11 @@
 #endif
 
 #include "CoinQ_peer_io.h"
+#include "CoinQ_iopool.h"
 #include "CoinQ_blocks.h"
 #include "CoinQ_filter.h"
+#include "CoinQ_inventory.h"
+#include "CoinQ_mempool.h"
 
 #include "CoinQ_signals.h"
 #include "CoinQ_slots.h"
@@ -30,6 +33,7 @@
 #include <CoinCore/typedefs.h>
 #include <CoinCore/BloomFilter.h>
 
+#include <atomic>
 #include <queue>
 
 typedef Coin::Transaction coin_tx_t;
@@ -61,6 +65,10 @@ public:
 
     void enableCheckProofOfWork(bool bCheckProofOfWork = true) { m_bCheckProofOfWork = bCheckProofOfWork; }
 
+    // Threads running the network io_service. Takes effect on the next start().
+    void setIOThreadCount(unsigned int threadCount) { m_ioServicePool.setThreadCount(threadCount); }
+    unsigned int getIOThreadCount() const { return m_ioServicePool.getThreadCount(); }
+
     void loadHeaders(const std::string& blockTreeFile, bool bCheckProofOfWork = true, CoinQBlockTreeMem::callback_t callback = nullptr);
     bool headersSynched() const { return m_bHeadersSynched; }
     int getBestHeight() const;
@@ -136,14 +144,11 @@ private:
     bool m_bCheckProofOfWork;
 
     bool m_bStarted;
+    std::atomic<bool> m_bStopping;
     boost::mutex m_startMutex;
 
-    bool m_bIOServiceStarted;
-    boost::mutex m_ioServiceMutex;
-    void startIOServiceThread();
-    void stopIOServiceThread();
     CoinQ::io_service_t m_ioService;
-    boost::thread m_ioServiceThread;
+    CoinQ::IOServicePool m_ioServicePool;
     CoinQ::io_service_t::work m_work;
 
     bool m_bConnected;
@@ -156,6 +161,7 @@ private:
     void startFileFlushThread();
     void stopFileFlushThread();
     void fileFlushLoop();
+    void waitToRetryFileFlush(boost::unique_lock<boost::mutex>& lock);
 
     mutable boost::mutex m_syncMutex;
     std::string m_blockTreeFile;
@@ -175,7 +181,7 @@ private:
 
     // Merkle block state
     mutable boost::mutex m_mempoolMutex;
-    std::set<bytes_t> m_mempoolTxs;
+    CoinQ::Mempool m_mempool;
     ChainMerkleBlock m_currentMerkleBlock;
     std::queue<bytes_t> m_currentMerkleTxHashes;
     unsigned int m_currentMerkleTxIndex;
@@ -186,6 +192,16 @@ private:
     void processBlockTx(const Coin::Transaction& tx);
     void processMempoolConfirmations();
 
+    // Inventory state - tx requests are batched and sent from the io service thread
+    boost::mutex m_invMutex;
+    CoinQ::InventoryScheduler m_invScheduler;
+    boost::asio::deadline_timer m_invTimer;
+    bool m_bInvTimerArmed;
+
+    void requestTxs(const hashvector_t& hashes, bool bSkipMempool);
+    void scheduleInvFlush(const boost::posix_time::time_duration& delay); // call with m_invMutex held
+    void flushInv(const boost::system::error_code& ec);
+
     // Sync signals
     CoinQSignal<void> notifyStarted;
     CoinQSignal<void> notifyStopped;
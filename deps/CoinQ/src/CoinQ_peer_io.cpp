@@ -11,11 +11,60 @@
 
 #include "CoinQ_peer_io.h"
 
+#include <stdutils/metrics.h>
+#include <stdutils/tracing.h>
+
+#include <CoinCore/hash.h>
+
+#include <cstring>
+#include <map>
 #include <sstream>
 
 using namespace CoinQ;
 using namespace std;
 
+// Message and byte counts per command, e.g. peer.rx.merkleblock.messages and peer.rx.merkleblock.bytes.
+// A registry lookup takes its mutex and builds both names, so the counters for the protocol's commands
+// are looked up once. Anything else a peer sends still goes through the registry.
+typedef std::map<std::string, std::pair<stdutils::metrics::counter*, stdutils::metrics::counter*>> message_counters_t;
+
+static message_counters_t getMessageCounters(const std::string& direction)
+{
+    static const char* const commands[] = {
+        "version", "verack", "addr", "getaddr", "inv", "getdata", "notfound", "getblocks", "getheaders",
+        "headers", "block", "merkleblock", "tx", "mempool", "ping", "pong", "reject", "alert",
+        "filterload", "filteradd", "filterclear", "sendheaders", "feefilter", "sendcmpct"
+    };
+
+    message_counters_t counters;
+    for (auto command: commands)
+    {
+        counters[command] = std::make_pair(
+            &stdutils::metrics::get_counter(direction + command + ".messages"),
+            &stdutils::metrics::get_counter(direction + command + ".bytes"));
+    }
+    return counters;
+}
+
+static void countMessage(bool received, const std::string& command, std::size_t bytes)
+{
+    static const message_counters_t rxCounters = getMessageCounters("peer.rx.");
+    static const message_counters_t txCounters = getMessageCounters("peer.tx.");
+
+    const message_counters_t& counters = received ? rxCounters : txCounters;
+    auto it = counters.find(command);
+    if (it != counters.end())
+    {
+        it->second.first->add();
+        it->second.second->add(bytes);
+        return;
+    }
+
+    const std::string direction(received ? "peer.rx." : "peer.tx.");
+    stdutils::metrics::get_counter(direction + command + ".messages").add();
+    stdutils::metrics::get_counter(direction + command + ".bytes").add(bytes);
+}
+
 const unsigned char Peer::DEFAULT_Ipv6[] = {0,0,0,0,0,0,0,0,0,0,255,255,127,0,0,1};
 
 void Peer::do_handshake()
@@ -26,14 +75,13 @@ void Peer::do_handshake()
     Coin::NetworkAddress peerAddress;
     peerAddress.set(NODE_NETWORK, DEFAULT_Ipv6, strtoul(port_.c_str(), NULL, 0));
     Coin::VersionMessage versionMessage(protocol_version_, NODE_NETWORK, time(NULL), peerAddress, peerAddress, getRandomNonce64(), user_agent_.c_str(), start_height_, relay_);
-    Coin::CoinNodeMessage msg(magic_bytes_, &versionMessage);
 
     LOGGER(trace) << "Sending version message." << endl;
-    do_send(msg);
+    do_send(versionMessage);
 
     // Give peer 5 seconds to respond
     timer_.expires_from_now(boost::posix_time::seconds(5));
-    timer_.async_wait([this](const boost::system::error_code& ec) {
+    timer_.async_wait(strand_.wrap([this](const boost::system::error_code& ec) {
         if (!bRunning) return;
         LOGGER(trace) << "Peer timer handler" << std::endl;
 
@@ -44,8 +92,8 @@ void Peer::do_handshake()
         if (bHandshakeComplete) return;
     
         do_stop();
-        notifyTimeout(*this);
-    });
+        decode_strand_.dispatch([this]() { notifyTimeout(*this); });
+    }));
 }
 
 void Peer::do_read()
@@ -67,10 +115,13 @@ void Peer::do_read()
             stringstream err;
             err << "Peer read error: " << ec.message();
             LOGGER(debug) << "Peer::do_read() handler - " << err.str() << std::endl;
-            notifyConnectionError(*this, err.str(), ec.value());
+            do_notifyConnectionError(err.str(), ec.value());
             return;
         }
 
+        static stdutils::metrics::counter& bytesReceived = stdutils::metrics::get_counter("peer.rx.bytes");
+        bytesReceived.add(bytes_read);
+
         read_message += uchar_vector(read_buffer, bytes_read);
 
         while (true)
@@ -99,12 +150,6 @@ void Peer::do_read()
                 break;
             }
 
-            // Get command
-            unsigned char command[13];
-            command[12] = 0;
-            uchar_vector(read_message.begin() + 4, read_message.begin() + 16).copyToArray(command);
-            LOGGER(debug) << "Peer read handler - command: " << command << endl;
-
             // Get payload size
             unsigned int payloadSize = vch_to_uint<uint32_t>(uchar_vector(read_message.begin() + 16, read_message.begin() + 20), LITTLE_ENDIAN_);
             LOGGER(debug) << "Peer read handler - payload size: " << payloadSize << endl;
@@ -116,146 +161,287 @@ void Peer::do_read()
                 break;
             }
 
-            try
-            {
-                Coin::CoinNodeMessage peerMessage(read_message);
-
-                if (!peerMessage.isChecksumValid()) throw std::runtime_error("Invalid checksum.");
-
-                std::string command = peerMessage.getCommand();
-                if (command == "verack") {
-                    LOGGER(trace) << "Peer read handler - VERACK" << std::endl;
-
-                    // Signal completion of handshake
-                    if (bHandshakeComplete) throw std::runtime_error("Second verack received.");
-                    boost::unique_lock<boost::mutex> lock(handshakeMutex);
-                    if (bHandshakeComplete) throw std::runtime_error("Second verack received.");
-                    timer_.cancel();
-                    bHandshakeComplete = true;
-                    lock.unlock();
-                    bWriteReady = true;
-                    notifyOpen(*this);
-                }
-                else if (command == "version")
-                {
-                    LOGGER(trace) << "Peer read handler - VERSION" << std::endl;
-
-                    // TODO: Check version information
-                    Coin::VerackMessage verackMessage;
-                    Coin::CoinNodeMessage msg(magic_bytes_, &verackMessage);
-                    do_send(msg);
-                }
-                else if (command == "inv")
-                {
-                    LOGGER(trace) << "Peer read handler - INV" << std::endl;
-
-                    Coin::Inventory* pInventory = static_cast<Coin::Inventory*>(peerMessage.getPayload());
-                    notifyInv(*this, *pInventory);
-                }
-                else if (command == "tx")
-                {
-                    LOGGER(trace) << "Peer read handler - TX" << std::endl;
-
-                    Coin::Transaction* pTx = static_cast<Coin::Transaction*>(peerMessage.getPayload());
-                    notifyTx(*this, *pTx);
-                }
-                else if (command == "block")
-                {
-                    LOGGER(trace) << "Peer read handler - BLOCK" << std::endl;
-
-                    Coin::CoinBlock* pBlock = static_cast<Coin::CoinBlock*>(peerMessage.getPayload());
-                    notifyBlock(*this, *pBlock);
-                }
-                else if (command == "merkleblock")
-                {
-                    LOGGER(trace) << "Peer read handler - MERKLEBLOCK" << std::endl;
-
-                    Coin::MerkleBlock* pMerkleBlock = static_cast<Coin::MerkleBlock*>(peerMessage.getPayload());
-                    notifyMerkleBlock(*this, *pMerkleBlock);
-                }
-                else if (command == "addr")
-                {
-                    LOGGER(trace) << "Peer read handler - ADDR" << std::endl;
-
-                    Coin::AddrMessage* pAddr = static_cast<Coin::AddrMessage*>(peerMessage.getPayload());
-                    notifyAddr(*this, *pAddr);
-                }
-                else if (command == "headers")
-                {
-                    LOGGER(trace) << "Peer read handler - HEADERS" << std::endl;
-
-                    Coin::HeadersMessage* pHeaders = static_cast<Coin::HeadersMessage*>(peerMessage.getPayload());
-                    notifyHeaders(*this, *pHeaders);
-                }
-                else if (command == "ping")
-                {
-                    LOGGER(trace) << "Peer read handler - PING" << std::endl;
-
-                    Coin::PingMessage* pPing = static_cast<Coin::PingMessage*>(peerMessage.getPayload());
-                    Coin::PongMessage pongMessage(pPing->nonce);
-                    Coin::CoinNodeMessage msg(magic_bytes_, &pongMessage);
-                    do_send(msg);
-                }
-                else
-                {
-                    LOGGER(error) << "Peer read handler - command not implemented: " << command << std::endl;
-
-                    std::stringstream err;
-                    err << "Command type not implemented: " << command;
-                    notifyProtocolError(*this, err.str(), -1);
-                }
-
-                notifyMessage(*this, peerMessage);
-            }
-            catch (const std::exception& e)
-            {
-                std::stringstream err;
-                err << "Message decode error: " << e.what();
-                LOGGER(error) << "Peer read handler error: " << err.str() << std::endl;
-                notifyProtocolError(*this, err.str(), -1);
-                min_read_bytes = MIN_MESSAGE_HEADER_SIZE;
-            }
+            // Checking and parsing the message is left to the decode strand so the socket can go on
+            // being read meanwhile.
+            std::size_t messageSize = MIN_MESSAGE_HEADER_SIZE + payloadSize;
+            boost::shared_ptr<uchar_vector> message(new uchar_vector(read_message.begin(), read_message.begin() + messageSize));
+            pendingDecodeBytes_ += messageSize;
+            decode_strand_.post(boost::bind(&Peer::do_decode, this, message, (unsigned int)connection_));
 
-            read_message.assign(read_message.begin() + MIN_MESSAGE_HEADER_SIZE + payloadSize, read_message.end());
+            read_message.assign(read_message.begin() + messageSize, read_message.end());
             LOGGER(debug) << "Peer read handler - remaining message bytes: " << read_message.size() << endl;
         }
 
+        // Stop reading while too much is waiting to be decoded. do_decode() starts reading again once
+        // the backlog has come down - checking again after setting the flag catches it having already.
+        if (pendingDecodeBytes_ > MAX_PENDING_DECODE_BYTES)
+        {
+            bReadPaused_ = true;
+            if (pendingDecodeBytes_ > MAX_PENDING_DECODE_BYTES / 2 || !bReadPaused_.exchange(false)) return;
+        }
+
         do_read();
     }));
 }
 
-void Peer::do_write(boost::shared_ptr<uchar_vector> data)
+void Peer::do_decode(boost::shared_ptr<uchar_vector> message, unsigned int connection)
+{
+    // Left over from before a restart if the io service was stopped with it still queued.
+    std::size_t messageSize = message->size();
+    if (connection == connection_) { do_handleMessage(*message); }
+    message.reset();
+
+    pendingDecodeBytes_ -= messageSize;
+    if (bRunning && bReadPaused_ && pendingDecodeBytes_ <= MAX_PENDING_DECODE_BYTES / 2 && bReadPaused_.exchange(false))
+    {
+        strand_.post(boost::bind(&Peer::do_read, this));
+    }
+}
+
+void Peer::do_handleMessage(const uchar_vector& message)
 {
     if (!bRunning) return;
 
-    boost::asio::async_write(socket_, boost::asio::buffer(*data), boost::asio::transfer_all(),
-    strand_.wrap([this](const boost::system::error_code& ec, std::size_t bytes_written) {
-        if (!bRunning) return;
+    // Get command
+    unsigned char command[13];
+    command[12] = 0;
+    uchar_vector(message.begin() + 4, message.begin() + 16).copyToArray(command);
+    LOGGER(debug) << "Peer read handler - command: " << command << endl;
+
+    TRACE_SPAN(span, "Peer::handleMessage");
+    if (span) { span.arg("command", command).arg("size", message.size()); }
+
+    try
+    {
+        Coin::CoinNodeMessage peerMessage(message);
+
+        if (!peerMessage.isChecksumValid()) throw std::runtime_error("Invalid checksum.");
+
+        std::string command = peerMessage.getCommand();
+        countMessage(true, command, message.size());
+        if (command == "verack") {
+            LOGGER(trace) << "Peer read handler - VERACK" << std::endl;
+
+            // Signal completion of handshake
+            if (bHandshakeComplete) throw std::runtime_error("Second verack received.");
+            boost::unique_lock<boost::mutex> lock(handshakeMutex);
+            if (bHandshakeComplete) throw std::runtime_error("Second verack received.");
+            strand_.post([this]() { timer_.cancel(); });
+            bHandshakeComplete = true;
+            lock.unlock();
+            bWriteReady = true;
+            notifyOpen(*this);
+        }
+        else if (command == "version")
+        {
+            LOGGER(trace) << "Peer read handler - VERSION" << std::endl;
+
+            // TODO: Check version information
+            Coin::VerackMessage verackMessage;
+            do_send(verackMessage);
+        }
+        else if (command == "inv")
+        {
+            LOGGER(trace) << "Peer read handler - INV" << std::endl;
+
+            Coin::Inventory* pInventory = static_cast<Coin::Inventory*>(peerMessage.getPayload());
+            notifyInv(*this, *pInventory);
+        }
+        else if (command == "notfound")
+        {
+            LOGGER(trace) << "Peer read handler - NOTFOUND" << std::endl;
+
+            Coin::Inventory* pInventory = static_cast<Coin::Inventory*>(peerMessage.getPayload());
+            notifyNotFound(*this, *pInventory);
+        }
+        else if (command == "tx")
+        {
+            LOGGER(trace) << "Peer read handler - TX" << std::endl;
+
+            Coin::Transaction* pTx = static_cast<Coin::Transaction*>(peerMessage.getPayload());
+            notifyTx(*this, *pTx);
+        }
+        else if (command == "block")
+        {
+            LOGGER(trace) << "Peer read handler - BLOCK" << std::endl;
+
+            Coin::CoinBlock* pBlock = static_cast<Coin::CoinBlock*>(peerMessage.getPayload());
+            notifyBlock(*this, *pBlock);
+        }
+        else if (command == "merkleblock")
+        {
+            LOGGER(trace) << "Peer read handler - MERKLEBLOCK" << std::endl;
+
+            Coin::MerkleBlock* pMerkleBlock = static_cast<Coin::MerkleBlock*>(peerMessage.getPayload());
+            notifyMerkleBlock(*this, *pMerkleBlock);
+        }
+        else if (command == "addr")
+        {
+            LOGGER(trace) << "Peer read handler - ADDR" << std::endl;
+
+            Coin::AddrMessage* pAddr = static_cast<Coin::AddrMessage*>(peerMessage.getPayload());
+            notifyAddr(*this, *pAddr);
+        }
+        else if (command == "headers")
+        {
+            LOGGER(trace) << "Peer read handler - HEADERS" << std::endl;
+
+            Coin::HeadersMessage* pHeaders = static_cast<Coin::HeadersMessage*>(peerMessage.getPayload());
+            notifyHeaders(*this, *pHeaders);
+        }
+        else if (command == "ping")
+        {
+            LOGGER(trace) << "Peer read handler - PING" << std::endl;
+
+            Coin::PingMessage* pPing = static_cast<Coin::PingMessage*>(peerMessage.getPayload());
+            Coin::PongMessage pongMessage(pPing->nonce);
+            do_send(pongMessage);
+        }
+        else
+        {
+            LOGGER(error) << "Peer read handler - command not implemented: " << command << std::endl;
+
+            std::stringstream err;
+            err << "Command type not implemented: " << command;
+            notifyProtocolError(*this, err.str(), -1);
+        }
+
+        notifyMessage(*this, peerMessage);
+    }
+    catch (const std::exception& e)
+    {
+        std::stringstream err;
+        err << "Message decode error: " << e.what();
+        LOGGER(error) << "Peer read handler error: " << err.str() << std::endl;
+        notifyProtocolError(*this, err.str(), -1);
+    }
+}
+
+void Peer::do_write()
+{
+    do_recycleWriteBatch();
+
+    // Everything queued, up to a batch limit, goes out in a single gathered write. bWriting_ is only
+    // cleared here and in the write handler, on the strand, so a write still in flight when the
+    // peer is stopped and restarted cannot end up running alongside a new one.
+    std::vector<boost::asio::const_buffer> buffers;
+    std::size_t batchBytes = 0;
+    unsigned int connection = connection_;
+    {
+        boost::lock_guard<boost::mutex> sendLock(sendMutex);
+        while (bRunning && !sendQueue.empty() && writeBatch_.size() < MAX_WRITE_BATCH_MESSAGES && (writeBatch_.empty() || batchBytes + sendQueue.front()->size() <= MAX_WRITE_BATCH_BYTES))
+        {
+            writeBatch_.push_back(sendQueue.front());
+            batchBytes += sendQueue.front()->size();
+            sendQueue.pop_front();
+        }
+
+        if (writeBatch_.empty())
+        {
+            bWriting_ = false;
+            return;
+        }
+
+        sendQueueBytes_ -= batchBytes;
+    }
+
+    static stdutils::metrics::gauge& queuedMessages = stdutils::metrics::get_gauge("peer.tx.queue.messages");
+    static stdutils::metrics::gauge& queuedBytes = stdutils::metrics::get_gauge("peer.tx.queue.bytes");
+    queuedMessages.add(-(int64_t)writeBatch_.size());
+    queuedBytes.add(-(int64_t)batchBytes);
+
+    buffers.reserve(writeBatch_.size());
+    for (auto& data: writeBatch_) { buffers.push_back(boost::asio::buffer(*data)); }
+
+    boost::asio::async_write(socket_, buffers, boost::asio::transfer_all(),
+    strand_.wrap([this, connection](const boost::system::error_code& ec, std::size_t bytes_written) {
         LOGGER(trace) << "Peer write handler." << std::endl;
 
-        if (ec)
+        if (ec && bRunning && connection == connection_)
         {
+            do_recycleWriteBatch();
+            {
+                // Nothing more goes out on this connection.
+                boost::lock_guard<boost::mutex> sendLock(sendMutex);
+                bWriting_ = false;
+            }
             if (ec == boost::asio::error::operation_aborted) return;
 
             stringstream err;
             err << "Peer write error: " << ec.message();
-            notifyConnectionError(*this, err.str(), ec.value());
+            do_notifyConnectionError(err.str(), ec.value());
             return;
         }
 
-        boost::lock_guard<boost::mutex> sendLock(sendMutex);
-        sendQueue.pop();
-        if (!sendQueue.empty()) { do_write(sendQueue.front()); }
+        if (!ec)
+        {
+            static stdutils::metrics::counter& writes = stdutils::metrics::get_counter("peer.tx.writes");
+            writes.add();
+        }
+
+        // Also after a stop - do_write clears bWriting_, or carries on with a restarted connection's queue.
+        do_write();
     }));
 }
 
-void Peer::do_send(const Coin::CoinNodeMessage& message)
+void Peer::do_recycleWriteBatch()
 {
-    boost::shared_ptr<uchar_vector> data(new uchar_vector(message.getSerialized()));
-    // LOGGER(trace) << "do_send() - data: " << data->getHex() << std::endl;
+    if (writeBatch_.empty()) return;
+
     boost::lock_guard<boost::mutex> sendLock(sendMutex);
-    sendQueue.push(data);
-    if (sendQueue.size() == 1) { strand_.post(boost::bind(&Peer::do_write, this, data)); }
+    for (auto& data: writeBatch_)
+    {
+        if (sendBufferPool_.size() >= MAX_POOLED_SEND_BUFFERS || data->capacity() > MAX_POOLED_SEND_BUFFER_SIZE) continue;
+        data->clear();
+        sendBufferPool_.push_back(data);
+    }
+    writeBatch_.clear();
+}
+
+void Peer::do_send(const Coin::CoinNodeStructure& payload)
+{
+    uchar_vector serializedPayload = payload.getSerialized();
+    uchar_vector checksum = sha256_2(serializedPayload);
+
+    const char* cmd = payload.getCommand();
+    char command[12] = { 0 };
+    memcpy(command, cmd, strnlen(cmd, 12));
+    countMessage(false, payload.getCommand(), MIN_MESSAGE_HEADER_SIZE + serializedPayload.size());
+
+    boost::lock_guard<boost::mutex> sendLock(sendMutex);
+
+    // The header is written straight into the buffer rather than wrapping the payload in a
+    // CoinNodeMessage, which would copy it and serialize it again for the checksum.
+    boost::shared_ptr<uchar_vector> data;
+    if (sendBufferPool_.empty())
+    {
+        data.reset(new uchar_vector());
+    }
+    else
+    {
+        data = sendBufferPool_.back();
+        sendBufferPool_.pop_back();
+    }
+    data->reserve(MIN_MESSAGE_HEADER_SIZE + serializedPayload.size());
+    *data += magic_bytes_vector_;
+    data->insert(data->end(), command, command + 12);
+    *data += uint_to_vch((uint32_t)serializedPayload.size(), LITTLE_ENDIAN_);
+    data->insert(data->end(), checksum.begin(), checksum.begin() + 4);
+    *data += serializedPayload;
+    // LOGGER(trace) << "do_send() - data: " << data->getHex() << std::endl;
+
+    static stdutils::metrics::gauge& queuedMessages = stdutils::metrics::get_gauge("peer.tx.queue.messages");
+    static stdutils::metrics::gauge& queuedBytes = stdutils::metrics::get_gauge("peer.tx.queue.bytes");
+    queuedMessages.add(1);
+    queuedBytes.add(data->size());
+
+    sendQueue.push_back(data);
+    sendQueueBytes_ += data->size();
+    if (!bWriting_)
+    {
+        bWriting_ = true;
+        strand_.post(boost::bind(&Peer::do_write, this));
+    }
 }
 
 void Peer::do_connect(tcp::resolver::iterator iter)
@@ -272,7 +458,7 @@ void Peer::do_connect(tcp::resolver::iterator iter)
 
             stringstream err;
             err << "Peer connect error: " << ec.message();
-            notifyConnectionError(*this, err.str(), ec.value());
+            do_notifyConnectionError(err.str(), ec.value());
             return;
         }
 
@@ -284,12 +470,12 @@ void Peer::do_connect(tcp::resolver::iterator iter)
         catch (const boost::system::error_code& ec)
         {
             do_stop();
-            notifyConnectionError(*this, ec.message(), ec.value());
+            do_notifyConnectionError(ec.message(), ec.value());
         }
         catch (const std::exception& e)
         {
             do_stop();
-            notifyConnectionError(*this, e.what(), -1);
+            do_notifyConnectionError(e.what(), -1);
         }
     }));
 }
@@ -299,8 +485,21 @@ void Peer::do_stop()
     bRunning = false;
     bHandshakeComplete = false;
     bWriteReady = false;
-    notifyClose(*this);
-    notifyStop(*this);
+    do_notifyStop();
+}
+
+void Peer::do_notifyStop()
+{
+    // Messages already read are still being decoded - these have to come after them.
+    decode_strand_.dispatch([this]() {
+        notifyClose(*this);
+        notifyStop(*this);
+    });
+}
+
+void Peer::do_notifyConnectionError(const std::string& error, int code)
+{
+    decode_strand_.dispatch([this, error, code]() { notifyConnectionError(*this, error, code); });
 }
 
 
@@ -317,10 +516,12 @@ void Peer::start()
     bWriteReady = false;
     read_message.clear();
     min_read_bytes = MIN_MESSAGE_HEADER_SIZE;
+    bReadPaused_ = false;
+    connection_++;
 
     tcp::resolver::query query(host_, port_);
 
-    resolver_.async_resolve(query, [this](const boost::system::error_code& ec, tcp::resolver::iterator iterator) {
+    resolver_.async_resolve(query, strand_.wrap([this](const boost::system::error_code& ec, tcp::resolver::iterator iterator) {
         if (!bRunning) return;
         LOGGER(trace) << "Peer resolve handler." << std::endl;
 
@@ -332,13 +533,13 @@ void Peer::start()
 
             stringstream err;
             err << "Peer resolve error: " << ec.message();
-            notifyConnectionError(*this, err.str(), ec.value());
+            do_notifyConnectionError(err.str(), ec.value());
             return;
         }
 
         endpoint_ = *iterator;
-        strand_.post(boost::bind(&Peer::do_connect, this, iterator)); 
-    }); 
+        do_connect(iterator);
+    }));
 }
 
 void Peer::stop()
@@ -356,7 +557,7 @@ void Peer::stop()
         {
             stringstream err;
             err << "Peer shutdown error: " << ec.message();
-            notifyConnectionError(*this, err.str(), ec.value());
+            do_notifyConnectionError(err.str(), ec.value());
         }
 
         socket_.close();
@@ -365,8 +566,7 @@ void Peer::stop()
         bWriteReady = false;
     }
 
-    notifyClose(*this);
-    notifyStop(*this);
+    do_notifyStop();
 }
 
 bool Peer::send(Coin::CoinNodeStructure& message)
@@ -374,15 +574,17 @@ bool Peer::send(Coin::CoinNodeStructure& message)
     boost::shared_lock<boost::shared_mutex> runLock(mutex);
     if (!bRunning || !bWriteReady) return false;
 
-    Coin::CoinNodeMessage wrappedMessage(magic_bytes_, &message);
     // LOGGER(trace) << "message: " << message.getSerialized().getHex() << std::endl;
-    do_send(wrappedMessage);
+    do_send(message);
     return true;
 }
 
 void Peer::do_clearSendQueue()
 {
     boost::lock_guard<boost::mutex> sendLock(sendMutex);
-    while (!sendQueue.empty()) { sendQueue.pop(); }
+    stdutils::metrics::get_gauge("peer.tx.queue.messages").add(-(int64_t)sendQueue.size());
+    stdutils::metrics::get_gauge("peer.tx.queue.bytes").add(-(int64_t)sendQueueBytes_);
+    sendQueue.clear();
+    sendQueueBytes_ = 0;
 }
 
@@ -19,7 +19,9 @@
 
 #include <logger/logger.h>
 
-#include <queue>
+#include <atomic>
+#include <deque>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
@@ -68,6 +70,7 @@ public:
     Peer(io_service_t& io_service, const std::string& host = "", const std::string& port = "", uint32_t magic_bytes = 0, uint32_t protocol_version = 0, const std::string& user_agent = std::string(), uint32_t start_height = 0, bool relay = true, uint32_t invFlags = DEFAULT_INV_FLAGS) :
         //io_service_(io_service),
         strand_(io_service),
+        decode_strand_(io_service),
         resolver_(io_service),
         socket_(io_service),
         timer_(io_service),
@@ -79,7 +82,12 @@ public:
         start_height_(start_height),
         relay_(relay),
         invFlags_(invFlags),
-        bRunning(false)
+        bRunning(false),
+        pendingDecodeBytes_(0),
+        bReadPaused_(false),
+        connection_(0),
+        sendQueueBytes_(0),
+        bWriting_(false)
     {
         magic_bytes_vector_ = uint_to_vch(magic_bytes_, LITTLE_ENDIAN_);
     }
@@ -109,8 +117,11 @@ public:
     void subscribeTx(peer_tx_slot_t slot) { notifyTx.connect(slot); }
     void subscribeAddr(peer_addr_slot_t slot) { notifyAddr.connect(slot); }
     void subscribeInv(peer_inv_slot_t slot) { notifyInv.connect(slot); }
+    void subscribeNotFound(peer_inv_slot_t slot) { notifyNotFound.connect(slot); }
     void subscribeProtocolError(peer_error_slot_t slot) { notifyProtocolError.connect(slot); }
 
+    // Stop, close and connection error events are delivered on the decode strand, after any
+    // message already read, even when stop() is called from another thread.
     void subscribeStart(peer_slot_t slot) { notifyStart.connect(slot); }
     void subscribeStop(peer_slot_t slot) { notifyStop.connect(slot); }
     void subscribeOpen(peer_slot_t slot) { notifyOpen.connect(slot); }
@@ -293,7 +304,8 @@ public:
 private:
     // ASIO environment
     //io_service_t& io_service_;
-    io_service_t::strand strand_;
+    io_service_t::strand strand_;           // socket, resolver and timer handlers
+    io_service_t::strand decode_strand_;    // message decoding and all notifications, in the order received
     tcp::resolver resolver_;
     tcp::socket socket_;
     tcp::endpoint endpoint_;
@@ -331,6 +343,7 @@ private:
     CoinQSignal<Peer&, const Coin::Transaction&>        notifyTx;
     CoinQSignal<Peer&, const Coin::AddrMessage&>        notifyAddr;
     CoinQSignal<Peer&, const Coin::Inventory&>          notifyInv;
+    CoinQSignal<Peer&, const Coin::Inventory&>          notifyNotFound;
     CoinQSignal<Peer&, const std::string&, int>         notifyProtocolError;
 
     CoinQSignal<Peer&>                                  notifyStart;
@@ -346,16 +359,38 @@ private:
     std::size_t min_read_bytes;
 
     uchar_vector read_message;
-    uchar_vector write_message;
-    std::queue<boost::shared_ptr<uchar_vector>> sendQueue;
-    boost::mutex sendMutex;
+
+    // Reading stops while more than this is waiting to be decoded and starts again below half of it.
+    static const std::size_t MAX_PENDING_DECODE_BYTES = 32 * 1024 * 1024;
+    std::atomic<std::size_t> pendingDecodeBytes_;
+    std::atomic<bool> bReadPaused_;
+    std::atomic<unsigned int> connection_; // counts start() calls
+
+    // Messages are serialized into pooled buffers and queued. Whatever has queued up while a write
+    // was in progress is sent with the next one, as a single gathered write.
+    static const std::size_t MAX_WRITE_BATCH_MESSAGES = 64;
+    static const std::size_t MAX_WRITE_BATCH_BYTES = 1024 * 1024;
+    static const std::size_t MAX_POOLED_SEND_BUFFERS = 64;
+    static const std::size_t MAX_POOLED_SEND_BUFFER_SIZE = 64 * 1024;
+
+    std::deque<boost::shared_ptr<uchar_vector>> sendQueue;
+    std::size_t sendQueueBytes_;
+    bool bWriting_;                                             // a do_write is posted or in progress
+    std::vector<boost::shared_ptr<uchar_vector>> sendBufferPool_;
+    boost::mutex sendMutex;                                     // guards the above
+    std::vector<boost::shared_ptr<uchar_vector>> writeBatch_;   // only touched from the strand
 
     void do_connect(tcp::resolver::iterator iter);
     void do_read();
-    void do_write(boost::shared_ptr<uchar_vector> data);
-    void do_send(const Coin::CoinNodeMessage& message); // calls do_write from the strand thread 
+    void do_decode(boost::shared_ptr<uchar_vector> message, unsigned int connection);
+    void do_handleMessage(const uchar_vector& message);
+    void do_write();
+    void do_recycleWriteBatch();
+    void do_send(const Coin::CoinNodeStructure& payload); // calls do_write from the strand thread
     void do_handshake();
     void do_stop();
+    void do_notifyStop();
+    void do_notifyConnectionError(const std::string& error, int code);
     void do_clearSendQueue();
 };
 
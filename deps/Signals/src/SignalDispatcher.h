@@ -0,0 +1,266 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// SignalDispatcher.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Signals
+{
+
+// Runs queued slots on a thread of its own so that whoever emits does not wait on the subscribers.
+//
+// Producers push onto a lock-free multiple producer, single consumer list. A slot posted with a
+// non-empty key supersedes any slot with the same key that has not run yet - only the most recent
+// one runs, at its own position in the queue.
+class SignalDispatcher
+{
+public:
+    struct Stats
+    {
+        uint64_t    posted;
+        uint64_t    dispatched;
+        uint64_t    coalesced;  // superseded by a later slot with the same key
+        uint64_t    failed;     // threw an exception
+        std::size_t pending;    // posted but not yet run
+        std::size_t maxPending; // high-water mark of pending
+    };
+
+    SignalDispatcher();
+    ~SignalDispatcher();
+
+    void start();
+    void stop();  // runs whatever is still queued first - must not be called from a slot
+    bool isRunning() const { return thread_.joinable(); }
+
+    // Safe to call from any thread. Slots posted before start() run once it is called.
+    void post(std::function<void()> f, const std::string& key = std::string());
+
+    // Blocks until everything posted so far has run. Returns immediately on the dispatcher thread.
+    void waitUntilIdle();
+
+    Stats getStats() const;
+
+private:
+    struct Node
+    {
+        Node() : next(nullptr), sequence(0) { }
+
+        std::atomic<Node*>      next;
+        std::function<void()>   f;
+        std::string             key;
+        uint64_t                sequence;
+    };
+
+    void push(Node* node);
+    Node* pop();
+    void run();
+    void dispatch(Node* node);
+
+    // Intrusive MPSC list - producers swap head_, the consumer alone walks tail_.
+    std::atomic<Node*>          head_;
+    Node*                       tail_;
+    Node                        stub_;
+
+    std::mutex                  keysMutex_;
+    std::map<std::string, uint64_t> latest_; // sequence of the slot that should run for each key
+
+    std::atomic<uint64_t>       sequence_;
+    std::atomic<uint64_t>       posted_;
+    std::atomic<uint64_t>       dispatched_;
+    std::atomic<uint64_t>       coalesced_;
+    std::atomic<uint64_t>       failed_;
+    std::atomic<std::size_t>    pending_;
+    std::atomic<std::size_t>    maxPending_;
+
+    std::mutex                  wakeMutex_;
+    std::condition_variable     wake_;
+    std::condition_variable     idle_;
+    std::atomic<bool>           sleeping_;
+    std::atomic<bool>           stopping_;
+    std::thread                 thread_;
+};
+
+inline SignalDispatcher::SignalDispatcher()
+    : head_(&stub_), tail_(&stub_), sequence_(0), posted_(0), dispatched_(0), coalesced_(0), failed_(0), pending_(0), maxPending_(0), sleeping_(false), stopping_(false)
+{
+}
+
+inline SignalDispatcher::~SignalDispatcher()
+{
+    stop();
+
+    // Anything posted after stop() never ran.
+    while (Node* node = pop()) { delete node; }
+}
+
+inline void SignalDispatcher::start()
+{
+    if (thread_.joinable()) return;
+    stopping_ = false;
+    thread_ = std::thread(&SignalDispatcher::run, this);
+}
+
+inline void SignalDispatcher::stop()
+{
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+inline void SignalDispatcher::post(std::function<void()> f, const std::string& key)
+{
+    Node* node = new Node;
+    node->f = std::move(f);
+    node->key = key;
+    node->sequence = ++sequence_;
+
+    if (!key.empty())
+    {
+        std::lock_guard<std::mutex> lock(keysMutex_);
+        latest_[key] = node->sequence;
+    }
+
+    posted_++;
+    std::size_t pending = ++pending_;
+    std::size_t maxPending = maxPending_;
+    while (pending > maxPending && !maxPending_.compare_exchange_weak(maxPending, pending));
+
+    push(node);
+
+    if (sleeping_)
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wake_.notify_one();
+    }
+}
+
+inline void SignalDispatcher::waitUntilIdle()
+{
+    if (!thread_.joinable() || thread_.get_id() == std::this_thread::get_id()) return;
+
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    idle_.wait(lock, [this]() { return pending_ == 0 || stopping_; });
+}
+
+inline SignalDispatcher::Stats SignalDispatcher::getStats() const
+{
+    Stats stats;
+    stats.posted = posted_;
+    stats.dispatched = dispatched_;
+    stats.coalesced = coalesced_;
+    stats.failed = failed_;
+    stats.pending = pending_;
+    stats.maxPending = maxPending_;
+    return stats;
+}
+
+inline void SignalDispatcher::push(Node* node)
+{
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+inline SignalDispatcher::Node* SignalDispatcher::pop()
+{
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_)
+    {
+        if (!next) return nullptr;
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next)
+    {
+        tail_ = next;
+        return tail;
+    }
+
+    // The last node can only be taken once the stub is queued behind it.
+    if (tail != head_.load(std::memory_order_acquire)) return nullptr;
+    push(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (!next) return nullptr;
+
+    tail_ = next;
+    return tail;
+}
+
+inline void SignalDispatcher::run()
+{
+    while (true)
+    {
+        Node* node = pop();
+        if (node)
+        {
+            dispatch(node);
+            continue;
+        }
+
+        if (pending_ > 0)
+        {
+            // A producer is halfway through linking its node.
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        idle_.notify_all();
+        if (stopping_) break;
+
+        sleeping_ = true;
+        wake_.wait(lock, [this]() { return pending_ > 0 || stopping_; });
+        sleeping_ = false;
+    }
+}
+
+inline void SignalDispatcher::dispatch(Node* node)
+{
+    bool superseded = false;
+    if (!node->key.empty())
+    {
+        std::lock_guard<std::mutex> lock(keysMutex_);
+        auto it = latest_.find(node->key);
+        if (it != latest_.end() && it->second != node->sequence) { superseded = true; }
+        else if (it != latest_.end())                            { latest_.erase(it); }
+    }
+
+    if (superseded)
+    {
+        coalesced_++;
+    }
+    else
+    {
+        // There is no caller left to report to.
+        try                 { node->f(); }
+        catch (...)         { failed_++; }
+        dispatched_++;
+    }
+
+    delete node;
+    pending_--;
+}
+
+}
@@ -1,6 +1,6 @@
 ///////////////////////////////////////////////////////////////////////////////
 //
-// SignalQueue.h 
+// SignalQueue.h
 //
 // Copyright (c) 2012-2014 Eric Lombrozo
 // Copyright (c) 2011-2016 Ciphrex Corp.
@@ -11,9 +11,13 @@
 
 #pragma once
 
+#include "SignalDispatcher.h"
+
+#include <deque>
 #include <functional>
-#include <queue>
+#include <map>
 #include <mutex>
+#include <string>
 
 namespace Signals
 {
@@ -21,38 +25,85 @@ namespace Signals
 class SignalQueue
 {
 public:
-    void push(std::function<void()> f);
+    SignalQueue() : dispatcher_(nullptr) { }
+    ~SignalQueue() { setDispatcher(nullptr); }
+
+    // A slot pushed with a non-empty key replaces a queued slot with the same key.
+    void push(std::function<void()> f, const std::string& key = std::string());
     void flush();
     void clear();
 
+    // With a dispatcher, flush() hands the queued slots over to the dispatcher thread instead of
+    // running them. Switching dispatchers waits for the previous one to run what it was given.
+    void setDispatcher(SignalDispatcher* dispatcher);
+    SignalDispatcher* getDispatcher() const { return dispatcher_; }
+
 private:
+    struct Item
+    {
+        std::function<void()> f;
+        std::string key;
+    };
+
     std::mutex mutex_;
-    std::queue<std::function<void()>> queue_;
+    std::deque<Item> queue_;
+    std::map<std::string, std::size_t> keys_; // key -> position in queue_
+    SignalDispatcher* dispatcher_;
 };
 
-inline void SignalQueue::push(std::function<void()> f)
+inline void SignalQueue::push(std::function<void()> f, const std::string& key)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    queue_.push(f);
+    if (!key.empty())
+    {
+        auto it = keys_.find(key);
+        if (it != keys_.end())
+        {
+            queue_[it->second].f = f;
+            return;
+        }
+        keys_[key] = queue_.size();
+    }
+    queue_.push_back(Item{f, key});
 }
 
 inline void SignalQueue::flush()
 {
     std::lock_guard<std::mutex> lock(mutex_);
+    keys_.clear();
+    if (dispatcher_)
+    {
+        for (auto& item: queue_) { dispatcher_->post(std::move(item.f), item.key); }
+        queue_.clear();
+        return;
+    }
+
     while (!queue_.empty())
     {
-        queue_.front()();
-        queue_.pop();
-    } 
+        queue_.front().f();
+        queue_.pop_front();
+    }
 }
 
 inline void SignalQueue::clear()
 {
-    std::queue<std::function<void()>> empty;
+    std::deque<Item> empty;
     {
         std::lock_guard<std::mutex> lock(mutex_);
         std::swap(queue_, empty);
+        keys_.clear();
+    }
+}
+
+inline void SignalQueue::setDispatcher(SignalDispatcher* dispatcher)
+{
+    SignalDispatcher* previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        previous = dispatcher_;
+        dispatcher_ = dispatcher;
     }
+    if (previous && previous != dispatcher) { previous->waitUntilIdle(); }
 }
 
 }
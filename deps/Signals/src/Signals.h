@@ -11,16 +11,24 @@
 
 #pragma once
 
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include <set>
-#include <map>
 #include <mutex>
+#include <utility>
+#include <vector>
 
 namespace Signals
 {
 
 typedef uint64_t Connection;
 
+// Slots are kept in an immutable list, sorted by connection, that connect() and disconnect() replace
+// with a modified copy. Emitting walks whichever list is current without holding the lock, so slots
+// can connect and disconnect re-entrantly and several threads can emit at once. A slot disconnected
+// while an emit is in progress on another thread can still be called by that emit.
+
 template<typename... Values>
 class Signal
 {
@@ -44,7 +52,7 @@ public:
         ss << "next_: " << next_ << std::endl << "available_:";
         for (auto n: available_) ss << " " << n;
         ss << std::endl << "slots_:";
-        for (auto& slot: slots_) ss << " " << slot.first;
+        for (auto& slot: *slots_) ss << " " << slot.first;
         ss << std::endl;
         return ss.str(); 
     }
@@ -53,14 +61,16 @@ public:
 private:
     void exec(Values... values) const;
 
-    mutable std::mutex mutex_;
+    typedef std::vector<std::pair<Connection, Slot>> SlotList;
+
+    mutable std::mutex mutex_; // serializes writers only
     Connection next_;
     std::set<Connection> available_;
-    std::map<Connection, Slot> slots_;
+    std::shared_ptr<const SlotList> slots_; // accessed with std::atomic_load and std::atomic_store
 };
 
 template<typename... Values>
-inline Signal<Values...>::Signal() : next_(0)
+inline Signal<Values...>::Signal() : next_(0), slots_(std::make_shared<SlotList>())
 {
 }
 
@@ -85,7 +95,11 @@ inline Connection Signal<Values...>::connect(Slot slot)
         connection = *it;
         available_.erase(it);
     }
-    slots_.insert(std::pair<Connection, Slot>(connection, slot));
+    auto slots = std::make_shared<SlotList>(*slots_);
+    auto pos = std::lower_bound(slots->begin(), slots->end(), connection,
+        [](const std::pair<Connection, Slot>& item, Connection connection) { return item.first < connection; });
+    slots->insert(pos, std::make_pair(connection, std::move(slot)));
+    std::atomic_store(&slots_, std::shared_ptr<const SlotList>(std::move(slots)));
     return connection;
 }
 
@@ -93,10 +107,13 @@ template<typename... Values>
 inline bool Signal<Values...>::disconnect(Connection connection)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    const auto& it = slots_.find(connection);
-    if (it == slots_.end()) return false;
+    auto it = std::find_if(slots_->begin(), slots_->end(),
+        [=](const std::pair<Connection, Slot>& item) { return item.first == connection; });
+    if (it == slots_->end()) return false;
 
-    slots_.erase(it);
+    auto slots = std::make_shared<SlotList>(slots_->begin(), it);
+    slots->insert(slots->end(), it + 1, slots_->end());
+    std::atomic_store(&slots_, std::shared_ptr<const SlotList>(std::move(slots)));
     available_.insert(connection);
 
     // remove contiguous available connections from end
@@ -110,7 +127,7 @@ template<typename... Values>
 inline void Signal<Values...>::clear()
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    slots_.clear();
+    std::atomic_store(&slots_, std::shared_ptr<const SlotList>(std::make_shared<SlotList>()));
     available_.clear();
     next_ = 0;
 }
@@ -118,8 +135,8 @@ inline void Signal<Values...>::clear()
 template<typename... Values>
 inline void Signal<Values...>::exec(Values... values) const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto slot: slots_) slot.second(values...); 
+    std::shared_ptr<const SlotList> slots = std::atomic_load(&slots_);
+    for (auto& slot: *slots) slot.second(values...);
 }
 
 template<typename... Values>
@@ -151,7 +168,7 @@ public:
         ss << "next_: " << next_ << std::endl << "available_:";
         for (auto n: available_) ss << " " << n;
         ss << std::endl << "slots_:";
-        for (auto& slot: slots_) ss << " " << slot.first;
+        for (auto& slot: *slots_) ss << " " << slot.first;
         ss << std::endl;
         return ss.str(); 
     }
@@ -160,14 +177,16 @@ public:
 private:
     void exec() const;
 
-    mutable std::mutex mutex_;
+    typedef std::vector<std::pair<Connection, Slot>> SlotList;
+
+    mutable std::mutex mutex_; // serializes writers only
     Connection next_;
     std::set<Connection> available_;
-    std::map<Connection, Slot> slots_;
+    std::shared_ptr<const SlotList> slots_; // accessed with std::atomic_load and std::atomic_store
 };
 
 template<>
-inline Signal<>::Signal() : next_(0)
+inline Signal<>::Signal() : next_(0), slots_(std::make_shared<SlotList>())
 {
 }
 
@@ -192,7 +211,11 @@ inline Connection Signal<>::connect(Slot slot)
         connection = *it;
         available_.erase(it);
     }
-    slots_.insert(std::pair<Connection, Slot>(connection, slot));
+    auto slots = std::make_shared<SlotList>(*slots_);
+    auto pos = std::lower_bound(slots->begin(), slots->end(), connection,
+        [](const std::pair<Connection, Slot>& item, Connection connection) { return item.first < connection; });
+    slots->insert(pos, std::make_pair(connection, std::move(slot)));
+    std::atomic_store(&slots_, std::shared_ptr<const SlotList>(std::move(slots)));
     return connection;
 }
 
@@ -200,10 +223,13 @@ template<>
 inline bool Signal<>::disconnect(Connection connection)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    const auto& it = slots_.find(connection);
-    if (it == slots_.end()) return false;
+    auto it = std::find_if(slots_->begin(), slots_->end(),
+        [=](const std::pair<Connection, Slot>& item) { return item.first == connection; });
+    if (it == slots_->end()) return false;
 
-    slots_.erase(it);
+    auto slots = std::make_shared<SlotList>(slots_->begin(), it);
+    slots->insert(slots->end(), it + 1, slots_->end());
+    std::atomic_store(&slots_, std::shared_ptr<const SlotList>(std::move(slots)));
     available_.insert(connection);
 
     // remove contiguous available connections from end
@@ -217,7 +243,7 @@ template<>
 inline void Signal<>::clear()
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    slots_.clear();
+    std::atomic_store(&slots_, std::shared_ptr<const SlotList>(std::make_shared<SlotList>()));
     available_.clear();
     next_ = 0;
 }
@@ -225,8 +251,8 @@ inline void Signal<>::clear()
 template<>
 inline void Signal<>::exec() const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    for (auto slot: slots_) slot.second(); 
+    std::shared_ptr<const SlotList> slots = std::atomic_load(&slots_);
+    for (auto& slot: *slots) slot.second();
 }
 
 template<>
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// bench.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+// Emit throughput of Signals::Signal with several threads emitting at once, optionally while
+// another thread keeps connecting and disconnecting a slot.
+//
+// usage: bench [emits per thread] [slots]
+//
+
+#include <Signals.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace Signals;
+using namespace std;
+
+// Roughly what CoinDB passes per tx.
+struct Payload
+{
+    unsigned char hash[32];
+};
+
+static double run(unsigned int threads, uint64_t emits, unsigned int slots, bool churn)
+{
+    Signal<const Payload&> notify;
+    atomic<uint64_t> calls(0);
+    for (unsigned int i = 0; i < slots; i++)
+    {
+        notify.connect([&](const Payload& payload) { calls.fetch_add(payload.hash[0] + 1, memory_order_relaxed); });
+    }
+
+    atomic<bool> done(false);
+    thread churner;
+    if (churn)
+    {
+        churner = thread([&]() {
+            while (!done) { notify.disconnect(notify.connect([](const Payload&) { })); }
+        });
+    }
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> emitters;
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        emitters.push_back(thread([&]() {
+            Payload payload = {};
+            for (uint64_t i = 0; i < emits; i++) { notify(payload); }
+        }));
+    }
+    for (auto& emitter: emitters) { emitter.join(); }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    done = true;
+    if (churner.joinable()) { churner.join(); }
+
+    if (calls != threads * emits * slots)
+    {
+        cerr << "Expected " << threads * emits * slots << " slot calls, got " << calls << "." << endl;
+        exit(1);
+    }
+
+    return threads * emits / seconds;
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t emits = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    unsigned int slots = argc > 2 ? strtoul(argv[2], nullptr, 10) : 4;
+    unsigned int maxThreads = max(thread::hardware_concurrency(), 1u);
+
+    cout << "emits per thread: " << emits << " slots: " << slots << endl;
+    cout << setw(8) << "threads" << setw(20) << "emits/s" << setw(20) << "emits/s (churn)" << endl;
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        cout << setw(8) << threads << fixed << setprecision(0)
+             << setw(20) << run(threads, emits, slots, false)
+             << setw(20) << run(threads, emits, slots, true) << endl;
+    }
+
+    return 0;
+}
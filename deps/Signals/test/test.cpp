@@ -5,19 +5,15 @@
 #include <SignalQueue.h>
 
 #include <iostream>
+#include <stdexcept>
+#include <vector>
 
 using namespace Signals;
 using namespace std;
 
-void coutInt(int i)
-{
-    cout << i << endl;
-}
+static int failures = 0;
 
-void coutString(const string& str)
-{
-    cout << str << endl;
-}
+#define CHECK(cond) do { if (!(cond)) { cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << endl; failures++; } } while (0)
 
 int main()
 {
@@ -62,14 +58,81 @@ int main()
     cout << endl << "notifyInt state:" << endl << notifyInt.getTextualState();
     cout << endl << "notifyVoid state:" << endl << notifyVoid.getTextualState();
 
+    cout << endl << "connecting a slot that disconnects itself..." << endl;
+    Connection once = notifyInt.connect([&](int i) { cout << "once: " << i << endl; notifyInt.disconnect(once); });
+    notifyInt(1);
+    notifyInt(2);
+    cout << endl << "notifyInt state:" << endl << notifyInt.getTextualState();
+
     cout << endl << "SignalQueue test:" << endl;
+    vector<string> results;
+    auto record = [&](const string& str) { cout << str << endl; results.push_back(str); };
     SignalQueue signalQueue;
-    signalQueue.push(std::bind(&coutInt, 13));
-    signalQueue.push(std::bind(&coutString, "foo"));
-    signalQueue.push(std::bind(&coutInt, 26));
-    signalQueue.push(std::bind(&coutString, "bar"));
+    signalQueue.push(std::bind(record, "13"));
+    signalQueue.push(std::bind(record, "foo"));
+    signalQueue.push(std::bind(record, "tx 1 update 1"), "tx1");
+    signalQueue.push(std::bind(record, "bar"));
+    signalQueue.push(std::bind(record, "tx 1 update 2"), "tx1");
+    signalQueue.flush();
+    CHECK(results == vector<string>({ "13", "foo", "tx 1 update 2", "bar" }));
     signalQueue.flush();
+    CHECK(results.size() == 4);
+
+    cout << endl << "SignalQueue with dispatcher test:" << endl;
+    results.clear();
+    SignalDispatcher dispatcher;
+    dispatcher.start();
+    signalQueue.setDispatcher(&dispatcher);
+    signalQueue.push(std::bind(record, "tx 1 update 1"), "tx1");
+    signalQueue.push(std::bind(record, "39"));
+    signalQueue.push(std::bind(record, "tx 1 update 2"), "tx1");
     signalQueue.flush();
+    signalQueue.setDispatcher(nullptr);
+    CHECK(results == vector<string>({ "tx 1 update 2", "39" }));
+
+    SignalDispatcher::Stats stats = dispatcher.getStats();
+    CHECK(stats.posted == 2);
+    CHECK(stats.dispatched == 2);
+    CHECK(stats.coalesced == 0);
+    CHECK(stats.pending == 0);
+    dispatcher.stop();
+
+    cout << endl << "SignalDispatcher coalescing test:" << endl;
+    // Nothing runs before start(), so every keyed slot but the last is superseded.
+    SignalDispatcher coalescing;
+    int last = -1;
+    int unkeyed = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        coalescing.post([&last, i]() { last = i; }, "same");
+        if (i % 100 == 0) { coalescing.post([&unkeyed]() { unkeyed++; }); }
+    }
+    coalescing.post([]() { throw runtime_error("slot failed"); });
+    coalescing.start();
+    coalescing.waitUntilIdle();
+
+    stats = coalescing.getStats();
+    cout << "posted: " << stats.posted << " dispatched: " << stats.dispatched << " coalesced: " << stats.coalesced
+         << " failed: " << stats.failed << " pending: " << stats.pending << " max pending: " << stats.maxPending << endl;
+    CHECK(last == 999);
+    CHECK(unkeyed == 10);
+    CHECK(stats.posted == 1011);
+    CHECK(stats.coalesced == 999);
+    CHECK(stats.dispatched == 12);
+    CHECK(stats.failed == 1);
+    CHECK(stats.pending == 0);
+    CHECK(stats.maxPending == 1011);
+    coalescing.stop();
+
+    // Slots posted while the dispatcher is running still run in order.
+    coalescing.start();
+    results.clear();
+    coalescing.post(std::bind(record, "a"), "key");
+    coalescing.post(std::bind(record, "b"));
+    coalescing.waitUntilIdle();
+    CHECK(results == vector<string>({ "a", "b" }));
+    coalescing.stop();
 
-    return 0;
+    if (failures) { cout << endl << failures << " check(s) failed." << endl; }
+    return failures ? 1 : 0;
 }
@@ -15,6 +15,9 @@
 
 int main()
 {
+    INIT_LOGGER("simple.log");
+    logger::set_level(logger::severity::trace);
+
     LOGGER(trace) << "trace test" << std::endl;
     LOGGER(debug) << "debug test" << std::endl;
     LOGGER(info) << "info test" << std::endl;
@@ -11,14 +11,327 @@
 
 #include "logger.h"
 
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <mutex>
+#include <thread>
 #include <time.h>
 
 namespace logger {
-    std::ofstream file;
-    void init_logger(const char* filename)
+    std::atomic<int> threshold(static_cast<int>(severity::none));
+
+    namespace {
+        const char* const severity_names[] = { "trace", "debug", "info", "warning", "error", "fatal" };
+
+        const std::size_t RING_SIZE = 8192; // must be a power of two
+
+        struct entry
+        {
+            severity level;
+            std::chrono::system_clock::time_point time;
+            std::string text;
+        };
+
+        // Bounded multiple producer, multiple consumer ring buffer - each cell's sequence number says
+        // whose turn it is to use it.
+        class ring
+        {
+        public:
+            ring() : head_(0), tail_(0)
+            {
+                for (std::size_t i = 0; i < RING_SIZE; i++) { cells_[i].sequence.store(i, std::memory_order_relaxed); }
+            }
+
+            bool push(entry& e)
+            {
+                std::size_t pos = head_.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    cell& c = cells_[pos & (RING_SIZE - 1)];
+                    std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+                    intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+                    if (diff == 0)
+                    {
+                        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            c.e = std::move(e);
+                            c.sequence.store(pos + 1, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = head_.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            bool pop(entry& e)
+            {
+                std::size_t pos = tail_.load(std::memory_order_relaxed);
+                while (true)
+                {
+                    cell& c = cells_[pos & (RING_SIZE - 1)];
+                    std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+                    intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+                    if (diff == 0)
+                    {
+                        if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            e = std::move(c.e);
+                            c.sequence.store(pos + RING_SIZE, std::memory_order_release);
+                            return true;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = tail_.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+        private:
+            struct cell
+            {
+                std::atomic<std::size_t> sequence;
+                entry e;
+            };
+
+            cell cells_[RING_SIZE];
+            std::atomic<std::size_t> head_;
+            std::atomic<std::size_t> tail_;
+        };
+
+        class writer
+        {
+        public:
+            writer() : queued_(0), written_(0), sleeping_(false), stopping_(false), max_file_size_(0), max_files_(0), file_size_(0), last_second_(0) { }
+            ~writer() { stop(); }
+
+            void start(const char* filename, std::size_t max_file_size, unsigned int max_files)
+            {
+                stop();
+
+                filename_ = filename;
+                max_file_size_ = max_file_size;
+                max_files_ = max_files;
+                open();
+
+                stopping_ = false;
+                thread_ = std::thread(&writer::run, this);
+            }
+
+            void stop()
+            {
+                if (!thread_.joinable()) return;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopping_ = true;
+                }
+                wake_.notify_one();
+                thread_.join();
+                file_.close();
+            }
+
+            bool running() const { return thread_.joinable(); }
+
+            void post(entry& e)
+            {
+                // Only waits when the writer has fallen a whole ring behind, in which case writing
+                // directly would not have been any faster.
+                while (!ring_.push(e))
+                {
+                    if (!running()) return;
+                    wake_.notify_one();
+                    std::this_thread::yield();
+                }
+
+                queued_++;
+                if (sleeping_)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    wake_.notify_one();
+                }
+            }
+
+            void flush()
+            {
+                if (!running() || thread_.get_id() == std::this_thread::get_id()) return;
+
+                uint64_t target = queued_;
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.notify_one();
+                flushed_.wait(lock, [&]() { return written_ >= target || stopping_; });
+            }
+
+        private:
+            void run()
+            {
+                entry e;
+                while (true)
+                {
+                    if (ring_.pop(e))
+                    {
+                        write(e);
+                        continue;
+                    }
+
+                    file_.flush();
+
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    flushed_.notify_all();
+                    if (stopping_ && written_ >= queued_) break;
+
+                    // The timeout covers a producer that queued just before sleeping_ was set.
+                    sleeping_ = true;
+                    wake_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return written_ < queued_ || stopping_; });
+                    sleeping_ = false;
+                }
+            }
+
+            void write(const entry& e)
+            {
+                std::string prefix = format_time(e.time) + " [" + severity_names[static_cast<int>(e.level)] + "] ";
+                file_ << prefix << e.text;
+                file_size_ += prefix.size() + e.text.size();
+                written_++;
+
+                if (max_file_size_ && file_size_ >= max_file_size_) rotate();
+            }
+
+            // Only the writer thread calls this, so the formatted second can be reused.
+            const std::string& format_time(std::chrono::system_clock::time_point time)
+            {
+                time_t rawtime = std::chrono::system_clock::to_time_t(time);
+                if (rawtime != last_second_ || last_time_.empty())
+                {
+                    struct tm* timeinfo = gmtime(&rawtime);
+                    char buffer[20];
+                    strftime(buffer, 20, "%F %T", timeinfo);
+                    last_time_ = buffer;
+                    last_second_ = rawtime;
+                }
+                return last_time_;
+            }
+
+            void open()
+            {
+                file_.open(filename_.c_str(), std::ios_base::app);
+                file_.seekp(0, std::ios_base::end);
+                std::streamoff pos = file_.tellp();
+                file_size_ = pos > 0 ? (std::size_t)pos : 0;
+            }
+
+            void rotate()
+            {
+                file_.close();
+                if (max_files_ == 0)
+                {
+                    std::remove(filename_.c_str());
+                }
+                else
+                {
+                    std::remove((filename_ + "." + std::to_string(max_files_)).c_str());
+                    for (unsigned int i = max_files_ - 1; i > 0; i--)
+                    {
+                        std::rename((filename_ + "." + std::to_string(i)).c_str(), (filename_ + "." + std::to_string(i + 1)).c_str());
+                    }
+                    std::rename(filename_.c_str(), (filename_ + ".1").c_str());
+                }
+                open();
+            }
+
+            ring ring_;
+            std::atomic<uint64_t> queued_;
+            std::atomic<uint64_t> written_;
+
+            std::mutex mutex_;
+            std::condition_variable wake_;
+            std::condition_variable flushed_;
+            std::atomic<bool> sleeping_;
+            std::atomic<bool> stopping_;
+            std::thread thread_;
+
+            std::string filename_;
+            std::size_t max_file_size_;
+            unsigned int max_files_;
+            std::ofstream file_;
+            std::size_t file_size_;
+
+            time_t last_second_;
+            std::string last_time_;
+        };
+
+        writer& get_writer()
+        {
+            static writer w;
+            return w;
+        }
+
+        // Reused by every log statement on the thread. in_use is set while a statement is being
+        // formatted so that one logging from inside its own arguments does not clobber it.
+        struct thread_buffer
+        {
+            thread_buffer() : in_use(false) { }
+
+            std::ostringstream stream;
+            bool in_use;
+        };
+
+        thread_local thread_buffer buffer;
+
+        severity initial_level()
+        {
+            const char* env = std::getenv("LOGGER_LEVEL");
+            if (env)
+            {
+                for (int i = 0; i < static_cast<int>(severity::none); i++)
+                {
+                    if (std::string(env) == severity_names[i]) return static_cast<severity>(i);
+                }
+            }
+            return severity::debug;
+        }
+    }
+
+    void init_logger(const char* filename, std::size_t max_file_size, unsigned int max_files)
+    {
+        get_writer().start(filename, max_file_size, max_files);
+        set_level(initial_level());
+    }
+
+    void set_level(severity level)
+    {
+        // Nothing is written before init_logger() or after shutdown().
+        if (!get_writer().running()) level = severity::none;
+        threshold = static_cast<int>(level);
+    }
+
+    severity get_level()
+    {
+        return static_cast<severity>(threshold.load());
+    }
+
+    void flush()
+    {
+        get_writer().flush();
+    }
+
+    void shutdown()
     {
-        file.open(filename, std::ios_base::app);
+        threshold = static_cast<int>(severity::none);
+        get_writer().stop();
     }
 
     std::string timestamp()
@@ -32,6 +345,38 @@ namespace logger {
         return std::string(buffer);
     }
 
-    std::ostream out(file.rdbuf());
-    std::ostream no_out(NULL);
+    record::record(severity level) : level_(level), time_(std::chrono::system_clock::now())
+    {
+        if (buffer.in_use)
+        {
+            stream_ = new std::ostringstream();
+            owned_ = true;
+        }
+        else
+        {
+            buffer.in_use = true;
+            buffer.stream.str(std::string());
+            buffer.stream.clear();
+            buffer.stream.flags(std::ios_base::dec | std::ios_base::skipws);
+            buffer.stream.precision(6);
+            buffer.stream.width(0);
+            buffer.stream.fill(' ');
+            stream_ = &buffer.stream;
+            owned_ = false;
+        }
+    }
+
+    record::~record()
+    {
+        entry e;
+        e.level = level_;
+        e.time = time_;
+        e.text = stream_->str();
+
+        if (owned_) { delete stream_; }
+        else        { buffer.in_use = false; }
+
+        get_writer().post(e);
+        if (level_ == severity::fatal) { get_writer().flush(); }
+    }
 }
@@ -12,14 +12,63 @@
 #ifndef _LOGGER_H__
 #define _LOGGER_H__
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <sstream>
 #include <string>
 
+// LOGGER(level) << ... << std::endl;
+//
+// The level is checked before anything to the right of LOGGER(level) is evaluated, so disabled
+// statements cost a load and a compare. Enabled ones are formatted into a buffer belonging to the
+// calling thread and handed to a background writer, which adds the timestamp and does the file I/O.
+//
+// The LOGGER_TRACE ... LOGGER_FATAL defines set the lowest level that is compiled in at all. Within
+// that, the level can be changed at runtime with set_level(), and init_logger() starts from the
+// LOGGER_LEVEL environment variable (trace, debug, info, warning, error or fatal) or debug.
+
 namespace logger {
-    void init_logger(const char* filename);
+    enum class severity { trace, debug, info, warning, error, fatal, none };
+
+    // Rotates the file once it reaches max_file_size bytes, keeping up to max_files old files as
+    // filename.1 (newest) through filename.<max_files>. A max_file_size of zero never rotates.
+    void init_logger(const char* filename, std::size_t max_file_size = 0, unsigned int max_files = 5);
+
+    void set_level(severity level);
+    severity get_level();
+
+    // Blocks until everything logged so far has been written.
+    void flush();
+
+    // Writes out what is queued and closes the file. Nothing is logged after this.
+    void shutdown();
+
     std::string timestamp();
-    extern "C" std::ostream out;
-    extern "C" std::ostream no_out;
+
+    extern std::atomic<int> threshold;
+
+    inline bool enabled(severity level) { return static_cast<int>(level) >= threshold.load(std::memory_order_relaxed); }
+
+    // One log statement. The text is queued for the writer when the record goes out of scope at the
+    // end of the statement.
+    class record
+    {
+    public:
+        explicit record(severity level);
+        ~record();
+
+        std::ostream& stream() { return *stream_; }
+
+    private:
+        record(const record&);
+        record& operator=(const record&);
+
+        severity level_;
+        std::chrono::system_clock::time_point time_;
+        std::ostringstream* stream_;
+        bool owned_; // a nested log statement got its own stream
+    };
 }
 
 #define INIT_LOGGER(filename) logger::init_logger(filename)
@@ -30,36 +79,39 @@ namespace logger {
 
 #define LOGGER(level) LOGGER_##level
 
+#define LOGGER_ON(level) if (!logger::enabled(logger::severity::level)) ; else logger::record(logger::severity::level).stream()
+#define LOGGER_OFF(level) if (true) ; else logger::record(logger::severity::level).stream()
+
 #if defined(LOGGER_TRACE)
-    #define LOGGER_trace logger::out << logger::timestamp() << " [trace] "
+    #define LOGGER_trace LOGGER_ON(trace)
 #else
-    #define LOGGER_trace logger::no_out
+    #define LOGGER_trace LOGGER_OFF(trace)
 #endif
 
 #if defined(LOGGER_TRACE) || defined(LOGGER_DEBUG)
-    #define LOGGER_debug logger::out << logger::timestamp() << " [debug] "
+    #define LOGGER_debug LOGGER_ON(debug)
 #else
-    #define LOGGER_debug logger::no_out
+    #define LOGGER_debug LOGGER_OFF(debug)
 #endif
 
 #if defined(LOGGER_TRACE) || defined(LOGGER_DEBUG) || defined(LOGGER_INFO)
-    #define LOGGER_info logger::out << logger::timestamp() << " [info] "
+    #define LOGGER_info LOGGER_ON(info)
 #else
-    #define LOGGER_info logger::no_out
+    #define LOGGER_info LOGGER_OFF(info)
 #endif
 
 #if defined(LOGGER_TRACE) || defined(LOGGER_DEBUG) || defined(LOGGER_INFO) || defined(LOGGER_WARNING)
-    #define LOGGER_warning logger::out << logger::timestamp() << " [warning] "
+    #define LOGGER_warning LOGGER_ON(warning)
 #else
-    #define LOGGER_warning logger::no_out
+    #define LOGGER_warning LOGGER_OFF(warning)
 #endif
 
 #if defined(LOGGER_TRACE) || defined(LOGGER_DEBUG) || defined(LOGGER_INFO) || defined(LOGGER_WARNING) || defined(LOGGER_ERROR)
-    #define LOGGER_error logger::out << logger::timestamp() << " [error] "
+    #define LOGGER_error LOGGER_ON(error)
 #else
-    #define LOGGER_error logger:no_out
+    #define LOGGER_error LOGGER_OFF(error)
 #endif
 
-#define LOGGER_fatal logger::out << logger::timestamp() << " [fatal] "
+#define LOGGER_fatal LOGGER_ON(fatal)
 
 #endif // _LOGGER_H__
@@ -0,0 +1,343 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// metrics.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+// Process-wide counters, gauges and latency histograms.
+//
+// Metrics are created by name on first use and live until the process exits, so hot paths can look
+// one up once and keep the reference:
+//
+//   static stdutils::metrics::counter& bytes = stdutils::metrics::get_counter("peer.rx.bytes");
+//   bytes.add(n);
+//
+//   METRICS_TIME_SCOPE("vault.insertTx"); // records how long the rest of the scope takes
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <time.h>
+
+namespace stdutils
+{
+namespace metrics
+{
+
+class counter
+{
+public:
+    counter() : value_(0) { }
+
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_;
+};
+
+class gauge
+{
+public:
+    gauge() : value_(0) { }
+
+    void set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t get() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> value_;
+};
+
+// Log-linear buckets in the style of HDR histograms: 16 linear sub-buckets per power of two, so any
+// recorded value is reported to within about 6% over the whole 64 bit range. Recording is lock-free.
+class histogram
+{
+public:
+    histogram() : count_(0), sum_(0), min_(UINT64_MAX), max_(0)
+    {
+        for (auto& bucket: buckets_) { bucket.store(0, std::memory_order_relaxed); }
+    }
+
+    void record(uint64_t value)
+    {
+        buckets_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t min = min_.load(std::memory_order_relaxed);
+        while (value < min && !min_.compare_exchange_weak(min, value, std::memory_order_relaxed));
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed));
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t min() const { return count() ? min_.load(std::memory_order_relaxed) : 0; }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    double mean() const { uint64_t n = count(); return n ? (double)sum() / n : 0.0; }
+
+    // Upper bound of the bucket holding the given fraction (0.0 to 1.0) of the recorded values.
+    uint64_t percentile(double fraction) const
+    {
+        uint64_t n = count();
+        if (!n) return 0;
+
+        uint64_t target = (uint64_t)(fraction * n + 0.5);
+        if (target < 1) target = 1;
+
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKETS; i++)
+        {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= target) return std::min(bucket_upper_bound(i), max());
+        }
+        return max();
+    }
+
+private:
+    enum { SUB_BUCKET_BITS = 4, SUB_BUCKETS = 1 << SUB_BUCKET_BITS, BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS };
+
+    static int msb(uint64_t value)
+    {
+        int bit = 0;
+        while (value >>= 1) { bit++; }
+        return bit;
+    }
+
+    static std::size_t bucket_index(uint64_t value)
+    {
+        if (value < 2 * SUB_BUCKETS) return (std::size_t)value;
+        int shift = msb(value) - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + (std::size_t)(value >> shift) - SUB_BUCKETS;
+    }
+
+    static uint64_t bucket_upper_bound(std::size_t index)
+    {
+        if (index < 2 * SUB_BUCKETS) return index;
+        int shift = (int)(index / SUB_BUCKETS) - 1;
+        uint64_t sub_bucket = index % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+    std::atomic<uint64_t> buckets_[BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+// Records the lifetime of the object in microseconds.
+class scoped_timer
+{
+public:
+    explicit scoped_timer(histogram& h) : histogram_(h), start_(std::chrono::steady_clock::now()) { }
+    ~scoped_timer() { histogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count()); }
+
+private:
+    scoped_timer(const scoped_timer&);
+    scoped_timer& operator=(const scoped_timer&);
+
+    histogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+class registry
+{
+public:
+    registry() : dump_interval_(0), stopping_(false) { }
+    ~registry() { stop_dump(); }
+
+    counter& get_counter(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<counter>& c = counters_[name];
+        if (!c) { c.reset(new counter()); }
+        return *c;
+    }
+
+    gauge& get_gauge(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<gauge>& g = gauges_[name];
+        if (!g) { g.reset(new gauge()); }
+        return *g;
+    }
+
+    histogram& get_histogram(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<histogram>& h = histograms_[name];
+        if (!h) { h.reset(new histogram()); }
+        return *h;
+    }
+
+    // One line per metric, sorted by kind and then by name. Histograms are in microseconds.
+    std::string report() const { return report(nullptr, 0.0); }
+
+    // Appends a timestamped report to filename every interval seconds, with counters also shown as
+    // a rate over the interval. Replaces any dump already running.
+    void start_dump(const std::string& filename, unsigned int interval)
+    {
+        stop_dump();
+        dump_filename_ = filename;
+        dump_interval_ = interval;
+        stopping_ = false;
+        dump_thread_ = std::thread(&registry::run_dump, this);
+    }
+
+    void stop_dump()
+    {
+        if (!dump_thread_.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(dump_mutex_);
+            stopping_ = true;
+        }
+        dump_wake_.notify_one();
+        dump_thread_.join();
+    }
+
+private:
+    typedef std::map<std::string, uint64_t> counter_values_t;
+
+    counter_values_t counter_values() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        counter_values_t values;
+        for (auto& c: counters_) { values[c.first] = c.second->get(); }
+        return values;
+    }
+
+    std::string report(const counter_values_t* previous, double seconds) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        for (auto& c: counters_)
+        {
+            uint64_t value = c.second->get();
+            ss << "counter " << c.first << " " << value;
+            if (previous && seconds > 0.0)
+            {
+                auto it = previous->find(c.first);
+                uint64_t last = it != previous->end() ? it->second : 0;
+                ss << " " << (value - last) / seconds << "/s";
+            }
+            ss << std::endl;
+        }
+        for (auto& g: gauges_)
+        {
+            ss << "gauge " << g.first << " " << g.second->get() << std::endl;
+        }
+        for (auto& h: histograms_)
+        {
+            const histogram& hist = *h.second;
+            ss << "histogram " << h.first << " count=" << hist.count() << " mean=" << hist.mean()
+               << " min=" << hist.min() << " p50=" << hist.percentile(0.5) << " p90=" << hist.percentile(0.9)
+               << " p99=" << hist.percentile(0.99) << " max=" << hist.max() << std::endl;
+        }
+        return ss.str();
+    }
+
+    void run_dump()
+    {
+        counter_values_t previous = counter_values();
+        auto last = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(dump_mutex_);
+        while (!dump_wake_.wait_for(lock, std::chrono::seconds(dump_interval_), [this]() { return (bool)stopping_; }))
+        {
+            auto now = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(now - last).count();
+
+            time_t rawtime;
+            time(&rawtime);
+            char timestamp[20];
+            strftime(timestamp, 20, "%F %T", gmtime(&rawtime));
+
+            std::ofstream file(dump_filename_.c_str(), std::ios_base::app);
+            file << "# " << timestamp << std::endl << report(&previous, seconds) << std::endl;
+
+            previous = counter_values();
+            last = now;
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<counter>> counters_;
+    std::map<std::string, std::unique_ptr<gauge>> gauges_;
+    std::map<std::string, std::unique_ptr<histogram>> histograms_;
+
+    std::string dump_filename_;
+    unsigned int dump_interval_;
+    std::mutex dump_mutex_;
+    std::condition_variable dump_wake_;
+    std::atomic<bool> stopping_;
+    std::thread dump_thread_;
+};
+
+inline registry& get_registry()
+{
+    static registry r;
+    return r;
+}
+
+inline counter& get_counter(const std::string& name) { return get_registry().get_counter(name); }
+inline gauge& get_gauge(const std::string& name) { return get_registry().get_gauge(name); }
+inline histogram& get_histogram(const std::string& name) { return get_registry().get_histogram(name); }
+
+// A mutex that records how long contended lock() calls wait, in <name>.wait, and how many of them
+// there were, in <name>.contended. Uncontended locking costs one extra try_lock.
+template<class Mutex>
+class timed_mutex
+{
+public:
+    explicit timed_mutex(const std::string& name)
+        : wait_(get_histogram(name + ".wait")), contended_(get_counter(name + ".contended")) { }
+
+    void lock()
+    {
+        if (mutex_.try_lock()) return;
+
+        scoped_timer timer(wait_);
+        mutex_.lock();
+        contended_.add();
+    }
+
+    bool try_lock() { return mutex_.try_lock(); }
+    void unlock() { mutex_.unlock(); }
+
+private:
+    timed_mutex(const timed_mutex&);
+    timed_mutex& operator=(const timed_mutex&);
+
+    Mutex mutex_;
+    histogram& wait_;
+    counter& contended_;
+};
+
+}
+}
+
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+
+#define METRICS_TIME_SCOPE(name) \
+    static stdutils::metrics::histogram& METRICS_CONCAT(metrics_histogram_, __LINE__) = stdutils::metrics::get_histogram(name); \
+    stdutils::metrics::scoped_timer METRICS_CONCAT(metrics_timer_, __LINE__)(METRICS_CONCAT(metrics_histogram_, __LINE__))
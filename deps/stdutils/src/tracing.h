@@ -0,0 +1,232 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// tracing.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+// Scoped spans written in the Chrome trace event format, for chrome://tracing or Perfetto.
+//
+//   TRACE_SPAN(span, "Vault::insertMerkleBlock");
+//   if (span) { span.arg("height", height); }
+//
+// Tracing is off until start() is called. While it is off a span costs one atomic load, and the
+// if (span) test keeps annotations from being formatted. While it is on, each thread collects its
+// events in a buffer of its own and appends them to the file in batches.
+//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace stdutils
+{
+namespace tracing
+{
+
+namespace detail
+{
+    inline std::string escape(const std::string& str)
+    {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (char c: str)
+        {
+            if (c == '"' || c == '\\')  { escaped += '\\'; escaped += c; }
+            else if ((unsigned char)c < 0x20) { escaped += ' '; }
+            else                        { escaped += c; }
+        }
+        return escaped;
+    }
+
+    // Events recorded on one thread. The lock is only contended while the trace is being flushed.
+    struct thread_buffer
+    {
+        explicit thread_buffer(unsigned int tid_) : tid(tid_) { }
+
+        enum { FLUSH_SIZE = 256 };
+
+        std::mutex mutex;
+        unsigned int tid;
+        std::vector<std::string> events;
+    };
+}
+
+class trace_file
+{
+public:
+    trace_file() : enabled_(false), start_ticks_(0), generation_(0), next_tid_(1), first_event_(true) { }
+    ~trace_file() { stop(); }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Starts a new trace, replacing any trace in progress.
+    void start(const std::string& filename)
+    {
+        stop();
+
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        file_.open(filename.c_str(), std::ios_base::out | std::ios_base::trunc);
+        file_ << "[";
+        first_event_ = true;
+        start_ticks_ = std::chrono::steady_clock::now().time_since_epoch().count();
+        generation_++;
+        enabled_ = true;
+    }
+
+    // Writes out what every thread has buffered and closes the file.
+    void stop()
+    {
+        if (!enabled_.exchange(false)) return;
+
+        std::vector<std::shared_ptr<detail::thread_buffer>> buffers;
+        {
+            std::lock_guard<std::mutex> lock(buffers_mutex_);
+            buffers = buffers_;
+        }
+        for (auto& buffer: buffers)
+        {
+            std::lock_guard<std::mutex> lock(buffer->mutex);
+            write(buffer->events);
+        }
+
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        file_ << "\n]\n";
+        file_.close();
+    }
+
+    uint64_t now() const
+    {
+        std::chrono::steady_clock::duration start(start_ticks_.load());
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch() - start).count();
+    }
+
+    // Changes on every start, so a span begun under an earlier trace can tell its times no longer apply.
+    unsigned int generation() const { return generation_.load(); }
+
+    void record(const char* name, uint64_t start, uint64_t duration, const std::string& args)
+    {
+        detail::thread_buffer& buffer = get_thread_buffer();
+
+        std::stringstream ss;
+        ss << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"ts\":" << start << ",\"dur\":" << duration
+           << ",\"pid\":1,\"tid\":" << buffer.tid;
+        if (!args.empty()) { ss << ",\"args\":{" << args << "}"; }
+        ss << "}";
+
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        buffer.events.push_back(ss.str());
+        if (buffer.events.size() >= detail::thread_buffer::FLUSH_SIZE) { write(buffer.events); }
+    }
+
+private:
+    detail::thread_buffer& get_thread_buffer()
+    {
+        // Buffers are shared with the trace so that stop() can reach those of threads that are gone.
+        thread_local std::shared_ptr<detail::thread_buffer> buffer;
+        if (!buffer)
+        {
+            std::lock_guard<std::mutex> lock(buffers_mutex_);
+            buffer = std::make_shared<detail::thread_buffer>(next_tid_++);
+            buffers_.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    void write(std::vector<std::string>& events)
+    {
+        std::lock_guard<std::mutex> lock(file_mutex_);
+        if (file_.is_open())
+        {
+            for (auto& event: events)
+            {
+                file_ << (first_event_ ? "\n" : ",\n") << event;
+                first_event_ = false;
+            }
+        }
+        events.clear();
+    }
+
+    std::atomic<bool> enabled_;
+
+    // Read by spans on any thread without a lock, and reset by start().
+    std::atomic<std::chrono::steady_clock::rep> start_ticks_;
+    std::atomic<unsigned int> generation_;
+
+    std::mutex buffers_mutex_;
+    std::vector<std::shared_ptr<detail::thread_buffer>> buffers_;
+    unsigned int next_tid_;
+
+    std::mutex file_mutex_;
+    std::ofstream file_;
+    bool first_event_;
+};
+
+inline trace_file& get_trace_file()
+{
+    static trace_file t;
+    return t;
+}
+
+inline void start(const std::string& filename) { get_trace_file().start(filename); }
+inline void stop() { get_trace_file().stop(); }
+inline bool enabled() { return get_trace_file().enabled(); }
+
+class span
+{
+public:
+    explicit span(const char* name) : name_(name), enabled_(tracing::enabled()), generation_(0), start_(0)
+    {
+        if (!enabled_) return;
+        trace_file& t = get_trace_file();
+        generation_ = t.generation();
+        start_ = t.now();
+    }
+
+    ~span()
+    {
+        if (!enabled_ || !tracing::enabled()) return;
+        trace_file& t = get_trace_file();
+        if (t.generation() != generation_) return; // the trace it started in was stopped
+        t.record(name_, start_, t.now() - start_, args_);
+    }
+
+    explicit operator bool() const { return enabled_; }
+
+    template<typename T>
+    span& arg(const char* key, const T& value)
+    {
+        if (!enabled_) return *this;
+        std::stringstream ss;
+        ss << value;
+        if (!args_.empty()) { args_ += ","; }
+        args_ += std::string("\"") + key + "\":\"" + detail::escape(ss.str()) + "\"";
+        return *this;
+    }
+
+private:
+    span(const span&);
+    span& operator=(const span&);
+
+    const char* name_;
+    bool enabled_;
+    unsigned int generation_;
+    uint64_t start_;
+    std::string args_;
+};
+
+}
+}
+
+#define TRACE_SPAN(var, name) stdutils::tracing::span var(name)
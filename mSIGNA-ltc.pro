@@ -81,6 +81,9 @@ HEADERS = \
     src/createtxdialog.h \
     src/unspenttxoutmodel.h \
     src/unspenttxoutview.h \
+    src/vaultservice.h \
+    src/refreshscheduler.h \
+    src/pagedrowcache.h \
     src/txmodel.h \
     src/txview.h \
     src/accounthistorydialog.h \
@@ -138,6 +141,8 @@ SOURCES = \
     src/createtxdialog.cpp \
     src/unspenttxoutmodel.cpp \
     src/unspenttxoutview.cpp \
+    src/vaultservice.cpp \
+    src/refreshscheduler.cpp \
     src/txmodel.cpp \
     src/txview.cpp \
     src/accounthistorydialog.cpp \
@@ -201,6 +206,7 @@ LIBS += \
     -lboost_thread$$BOOST_THREAD_LIB_SUFFIX$$BOOST_LIB_SUFFIX \
     -lboost_serialization$$BOOST_LIB_SUFFIX \
     -lcrypto \
+    -lz \
     -lodb-sqlite \
     -lodb \
     -lsqlite3
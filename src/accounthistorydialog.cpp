@@ -32,7 +32,7 @@
 #include <CoinDB/Vault.h>
 #include <CoinQ/CoinQ_netsync.h>
 
-AccountHistoryDialog::AccountHistoryDialog(CoinDB::Vault* vault, const QString& accountName, CoinQ::Network::NetworkSync* networkSync, QWidget* parent)
+AccountHistoryDialog::AccountHistoryDialog(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, CoinQ::Network::NetworkSync* networkSync, QWidget* parent)
     : QDialog(parent), currentRow(-1)
 {
     resize(QSize(800, 400));
@@ -40,13 +40,15 @@ AccountHistoryDialog::AccountHistoryDialog(CoinDB::Vault* vault, const QString&
     createActions();
     createMenus();
 
-    accountHistoryModel = new TxModel(vault, accountName, this);
-    accountHistoryModel->update();
+    // The model streams the account history from the vault service when the account is set.
+    accountHistoryModel = new TxModel(vaultService, vault, accountName, this);
 
     accountHistoryView = new TxView(this);
     accountHistoryView->setModel(accountHistoryModel);
     accountHistoryView->setMenu(menu);
     accountHistoryView->update();
+    connect(accountHistoryModel, &TxModel::updated, [this]() { accountHistoryView->updateColumns(); });
+    connect(accountHistoryModel, &TxModel::error, [this](const QString& message) { QMessageBox::critical(this, tr("Error"), message); });
 
     txSelectionModel = accountHistoryView->selectionModel();
     connect(txSelectionModel, &QItemSelectionModel::currentChanged,
@@ -67,9 +69,8 @@ AccountHistoryDialog::AccountHistoryDialog(CoinDB::Vault* vault, const QString&
 void AccountHistoryDialog::updateCurrentTx(const QModelIndex& current, const QModelIndex& /*previous*/)
 {
     currentRow = current.row();
-    if (currentRow != -1) {
-        QStandardItem* typeItem = accountHistoryModel->item(currentRow, 6);
-        int type = typeItem->data(Qt::UserRole).toInt();
+    if (currentRow != -1 && accountHistoryModel->isRowLoaded(currentRow)) {
+        int type = accountHistoryModel->getTxStatus(currentRow);
         if (type == CoinDB::Tx::UNSIGNED) {
             signTxAction->setEnabled(true);
         }
@@ -104,8 +105,7 @@ void AccountHistoryDialog::updateCurrentTx(const QModelIndex& current, const QMo
 void AccountHistoryDialog::signTx()
 {
     try {
-        accountHistoryModel->signTx(currentRow);
-        accountHistoryView->update();
+        accountHistoryModel->signTx(currentRow, [this]() { accountHistoryView->update(); });
     }
     catch (const std::exception& e) {
         QMessageBox::critical(this, tr("Error"), e.what());
@@ -127,10 +127,12 @@ void AccountHistoryDialog::sendTx()
 void AccountHistoryDialog::viewRawTx()
 {
     try {
-        std::shared_ptr<CoinDB::Tx> tx = accountHistoryModel->getTx(currentRow);
-        RawTxDialog rawTxDlg(tr("Raw Transaction"));
-        rawTxDlg.setRawTx(tx->raw());
-        rawTxDlg.exec();
+        accountHistoryModel->getTx(currentRow, [](std::shared_ptr<CoinDB::Tx> tx) {
+            if (!tx) return;
+            RawTxDialog rawTxDlg(tr("Raw Transaction"));
+            rawTxDlg.setRawTx(tx->raw());
+            rawTxDlg.exec();
+        });
     }
     catch (const std::exception& e) {
         QMessageBox::critical(this, tr("Error"), e.what());
@@ -142,10 +144,12 @@ void AccountHistoryDialog::viewTxOnWeb()
     const QString URL_PREFIX("https://blockchain.info/tx/");
 
     try {
-        std::shared_ptr<CoinDB::Tx> tx = accountHistoryModel->getTx(currentRow);
-        if (!QDesktopServices::openUrl(QUrl(URL_PREFIX + QString::fromStdString(uchar_vector(tx->hash()).getHex())))) {
-            throw std::runtime_error(tr("Unable to open browser.").toStdString());
-        }
+        accountHistoryModel->getTx(currentRow, [this, URL_PREFIX](std::shared_ptr<CoinDB::Tx> tx) {
+            if (!tx) return;
+            if (!QDesktopServices::openUrl(QUrl(URL_PREFIX + QString::fromStdString(uchar_vector(tx->hash()).getHex())))) {
+                QMessageBox::critical(this, tr("Error"), tr("Unable to open browser."));
+            }
+        });
     }
     catch (const std::exception& e) {
         QMessageBox::critical(this, tr("Error"), e.what());
@@ -155,9 +159,10 @@ void AccountHistoryDialog::viewTxOnWeb()
 void AccountHistoryDialog::deleteTx()
 {
     try {
-        accountHistoryModel->deleteTx(currentRow);
-        accountHistoryView->update();
-        emit txDeleted();
+        accountHistoryModel->deleteTx(currentRow, [this]() {
+            accountHistoryView->update();
+            emit txDeleted();
+        });
     }
     catch (const std::exception& e) {
         QMessageBox::critical(this, tr("Error"), e.what());
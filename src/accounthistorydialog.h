@@ -17,6 +17,7 @@
 
 class TxModel;
 class TxView;
+class VaultService;
 
 class QAction;
 class QMenu;
@@ -35,7 +36,7 @@ class AccountHistoryDialog : public QDialog
     Q_OBJECT
 
 public:
-    AccountHistoryDialog(CoinDB::Vault* vault, const QString& accountName, CoinQ::Network::NetworkSync* networkSync, QWidget* parent = NULL);
+    AccountHistoryDialog(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, CoinQ::Network::NetworkSync* networkSync, QWidget* parent = NULL);
 
 signals:
     void txDeleted();
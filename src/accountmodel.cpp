@@ -28,6 +28,7 @@
 #include <QFile>
 
 #include "severitylogger.h"
+#include "vaultservice.h"
 
 const bool USE_WITNESS_P2SH = true; // only used if segregated witness is enabled
 
@@ -35,8 +36,8 @@ using namespace CoinDB;
 using namespace CoinQ::Script;
 using namespace std;
 
-AccountModel::AccountModel(CoinDB::SynchedVault& synchedVault)
-    : m_synchedVault(synchedVault), numAccounts(0)
+AccountModel::AccountModel(CoinDB::SynchedVault& synchedVault, VaultService* vaultService)
+    : m_synchedVault(synchedVault), m_vaultService(vaultService), numAccounts(0), generation(0)
 {
     setBase58Versions();
     currencySymbol = getCurrencySymbol();
@@ -80,59 +81,99 @@ void AccountModel::update()
         setColumns();
     }
 
-    removeRows(0, rowCount());
-
-    CoinDB::Vault* vault = m_synchedVault.getVault();
-    if (!vault) {
+    uint64_t requestGeneration = ++generation;
+    if (!m_synchedVault.getVault()) {
+        removeRows(0, rowCount());
         numAccounts = 0;
         return;
     }
 
-    QStringList accountNames;
-    std::vector<AccountInfo> accounts = vault->getAllAccountInfo();
-    for (auto& account: accounts) {
-        QString accountName = QString::fromStdString(account.name());
-        QString policy = QString::number(account.minsigs()) + tr(" of ") + QString::fromStdString(stdutils::delimited_list(account.keychain_names(), ", "));
-        //QString balance = QString::number(vault->getAccountBalance(account.name(), 0)/(1.0 * currency_divisor), 'g', 8);
-
-        uint64_t total = vault->getAccountBalance(account.name(), 0);
-        uint64_t confirmed = vault->getAccountBalance(account.name(), 1);
-        uint64_t pending = total - confirmed;
-        QString confirmedBalance = getFormattedCurrencyAmount(confirmed);
-        QString pendingBalance = tr("+") + getFormattedCurrencyAmount(pending);
-        QString totalBalance = getFormattedCurrencyAmount(total);
+    m_vaultService->post<std::vector<AccountRow>>(this, [](Vault* vault) {
+        std::vector<AccountRow> accounts;
+        if (!vault) return accounts;
+
+        for (auto& info: vault->getAllAccountInfo()) {
+            AccountRow account;
+            account.name = info.name();
+            account.useWitness = info.use_witness();
+            account.minsigs = info.minsigs();
+            account.keychainNames = info.keychain_names();
+            account.timeCreated = info.time_created();
+            account.total = vault->getAccountBalance(info.name(), 0);
+            account.confirmed = vault->getAccountBalance(info.name(), 1);
+            accounts.push_back(account);
+        }
+        return accounts;
+    }, [this, requestGeneration](std::vector<AccountRow>& accounts) {
+        if (requestGeneration != generation) return;
 
-        QDateTime dateTime;
-        dateTime.setTime_t(account.time_created());
-        QString creationTime = dateTime.toString("yyyy-MM-dd hh:mm:ss");
+        QStringList accountNames;
+        for (auto& account: accounts) { accountNames << QString::fromStdString(account.name); }
 
-        accountNames << accountName;
+        // Refresh the rows in place when the accounts are unchanged so the selection survives.
+        bool sameAccounts = (rowCount() == accountNames.size());
+        for (int i = 0; sameAccounts && i < rowCount(); i++) {
+            sameAccounts = (item(i, 0)->text() == accountNames[i]);
+        }
 
-        QStandardItem* segwitItem = new QStandardItem();
-        if (account.use_witness())
-        {
-            segwitItem->setIcon(QIcon(":/icons/segwit_64x64.png"));
-            segwitItem->setData(true, Qt::UserRole);
+        if (!sameAccounts) {
+            removeRows(0, rowCount());
         }
-        else
-        {
-            segwitItem->setData(false, Qt::UserRole);
+
+        for (int i = 0; i < (int)accounts.size(); i++) {
+            setAccountRow(sameAccounts ? i : -1, accounts[i]);
         }
-        
-        QList<QStandardItem*> row;
-        row.append(new QStandardItem(accountName));
-        row.append(segwitItem);
-        row.append(new QStandardItem(confirmedBalance));
-        row.append(new QStandardItem(pendingBalance));
-        row.append(new QStandardItem(totalBalance));
-        row.append(new QStandardItem(policy));
-        row.append(new QStandardItem(creationTime));
-        appendRow(row);
+        numAccounts = accountNames.size();
 
+        emit updated(accountNames);
+    }, [this](const QString& message) {
+        emit error(message);
+    });
+}
+
+void AccountModel::setAccountRow(int row, const AccountRow& account)
+{
+    QString accountName = QString::fromStdString(account.name);
+    QString policy = QString::number(account.minsigs) + tr(" of ") + QString::fromStdString(stdutils::delimited_list(account.keychainNames, ", "));
+    //QString balance = QString::number(vault->getAccountBalance(account.name(), 0)/(1.0 * currency_divisor), 'g', 8);
+
+    uint64_t pending = account.total - account.confirmed;
+    QString confirmedBalance = getFormattedCurrencyAmount(account.confirmed);
+    QString pendingBalance = tr("+") + getFormattedCurrencyAmount(pending);
+    QString totalBalance = getFormattedCurrencyAmount(account.total);
+
+    QDateTime dateTime;
+    dateTime.setTime_t(account.timeCreated);
+    QString creationTime = dateTime.toString("yyyy-MM-dd hh:mm:ss");
+
+    QStandardItem* segwitItem = new QStandardItem();
+    if (account.useWitness)
+    {
+        segwitItem->setIcon(QIcon(":/icons/segwit_64x64.png"));
+        segwitItem->setData(true, Qt::UserRole);
+    }
+    else
+    {
+        segwitItem->setData(false, Qt::UserRole);
     }
-    numAccounts = accountNames.size();
 
-    emit updated(accountNames);
+    QList<QStandardItem*> items;
+    items.append(new QStandardItem(accountName));
+    items.append(segwitItem);
+    items.append(new QStandardItem(confirmedBalance));
+    items.append(new QStandardItem(pendingBalance));
+    items.append(new QStandardItem(totalBalance));
+    items.append(new QStandardItem(policy));
+    items.append(new QStandardItem(creationTime));
+
+    if (row == -1) {
+        appendRow(items);
+        return;
+    }
+
+    for (int column = 0; column < items.size(); column++) {
+        setItem(row, column, items[column]);
+    }
 }
 
 CoinDB::Vault* AccountModel::getVault() const
@@ -22,6 +22,8 @@
 
 #include <CoinDB/SynchedVault.h>
 
+class VaultService;
+
 class TaggedOutput
 {
 public:
@@ -44,7 +46,7 @@ class AccountModel : public QStandardItemModel
     Q_OBJECT
 
 public:
-    AccountModel(CoinDB::SynchedVault& synchedVault);
+    AccountModel(CoinDB::SynchedVault& synchedVault, VaultService* vaultService);
     ~AccountModel() { };
 
     CoinDB::Vault* getVault() const;
@@ -100,16 +102,34 @@ signals:
     void error(const QString& message);
 
 public slots:
+    // Balances are read through the vault service - updated is emitted once they arrive.
     void update();
 
 private:
     void setColumns();
 
+    struct AccountRow
+    {
+        std::string name;
+        bool useWitness;
+        unsigned int minsigs;
+        std::vector<std::string> keychainNames;
+        uint32_t timeCreated;
+        uint64_t total;
+        uint64_t confirmed;
+    };
+
+    void setAccountRow(int row, const AccountRow& account);
+
     unsigned char base58_versions[4];
     QString currencySymbol;
 
     //CoinDB::Vault* vault;
     CoinDB::SynchedVault& m_synchedVault;
+    VaultService* m_vaultService;
     int numAccounts;
+
+    // Bumped on every update so only the latest snapshot is applied.
+    uint64_t generation;
 };
 
@@ -126,10 +126,10 @@ void TxOutLayout::removeWidgets()
     }
 }
 
-CoinControlWidget::CoinControlWidget(CoinDB::Vault* vault, const QString& accountName, QWidget* parent)
+CoinControlWidget::CoinControlWidget(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, QWidget* parent)
     : QWidget(parent)
 {
-    model = new UnspentTxOutModel(vault, accountName, this);
+    model = new UnspentTxOutModel(vaultService, vault, accountName, this);
     view = new UnspentTxOutView(this);
     view->setModel(model);
     view->setMinimumWidth(COIN_CONTROL_VIEW_MIN_WIDTH);
@@ -168,8 +168,7 @@ std::vector<unsigned long> CoinControlWidget::getInputTxOutIds() const
 
     for (auto& index: indexes)
     {
-        QStandardItem* item = model->item(index.row(), 1);
-        ids.push_back((unsigned long)item->data(Qt::UserRole).toInt());
+        ids.push_back(model->getTxOutId(index.row()));
     }
 
     return ids; 
@@ -198,9 +197,7 @@ void CoinControlWidget::updateTotal(const QItemSelection& /*selected*/, const QI
     uint64_t total = 0;
     for (auto& index: indexes)
     {
-        QStandardItem* amountItem = model->item(index.row(), 0);
-        QString strAmount = amountItem->data(Qt::UserRole).toString();
-        total += strtoull(strAmount.toStdString().c_str(), NULL, 10);
+        total += model->getValue(index.row());
     }
 
     //QString amount(QString::number(total/(1.0 * model->getCurrencyDivisor()), 'g', 8));
@@ -208,7 +205,7 @@ void CoinControlWidget::updateTotal(const QItemSelection& /*selected*/, const QI
     totalEdit->setText(amount);
 }
 
-CreateTxDialog::CreateTxDialog(CoinDB::Vault* vault, const QString& accountName, const PaymentRequest& paymentRequest, QWidget* parent)
+CreateTxDialog::CreateTxDialog(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, const PaymentRequest& paymentRequest, QWidget* parent)
     : QDialog(parent), status(SAVE)
 {
     // Coin parameters
@@ -255,7 +252,7 @@ CreateTxDialog::CreateTxDialog(CoinDB::Vault* vault, const QString& accountName,
     // Coin control
     coinControlCheckBox = new QCheckBox(tr("Enable Coin Control"));
     coinControlCheckBox->setChecked(false);
-    coinControlWidget = new CoinControlWidget(vault, accountName, this);
+    coinControlWidget = new CoinControlWidget(vaultService, vault, accountName, this);
     coinControlWidget->hide();
     connect(coinControlCheckBox, SIGNAL(stateChanged(int)), this, SLOT(switchCoinControl(int)));
 
@@ -15,6 +15,7 @@
 
 class UnspentTxOutModel;
 class UnspentTxOutView;
+class VaultService;
 
 class QTextEdit;
 
@@ -75,7 +76,7 @@ class CoinControlWidget : public QWidget
     Q_OBJECT
 
 public:
-    CoinControlWidget(CoinDB::Vault* vault, const QString& accountName, QWidget* parent = nullptr);
+    CoinControlWidget(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, QWidget* parent = nullptr);
 
     std::vector<unsigned long> getInputTxOutIds() const;
 
@@ -99,7 +100,7 @@ class CreateTxDialog : public QDialog
 
 public:
     CreateTxDialog(const QString& accountName, const PaymentRequest& paymentRequest = PaymentRequest(), QWidget* parent = nullptr);
-    CreateTxDialog(CoinDB::Vault* vault, const QString& accountName, const PaymentRequest& paymentRequest = PaymentRequest(), QWidget* parent = nullptr);
+    CreateTxDialog(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, const PaymentRequest& paymentRequest = PaymentRequest(), QWidget* parent = nullptr);
 
     QString getAccountName() const;
     uint64_t getFeeValue() const;
@@ -12,14 +12,15 @@
 //
 
 #include "keychainmodel.h"
+#include "vaultservice.h"
 
 #include <QStandardItemModel>
 
 using namespace CoinDB;
 using namespace std;
 
-KeychainModel::KeychainModel()
-    : vault(NULL)
+KeychainModel::KeychainModel(VaultService* vaultService)
+    : vaultService(vaultService), vault(NULL), generation(0)
 {
     QStringList columns;
     columns << tr("Keychain") << tr("") << tr("") << tr("Hash");
@@ -35,50 +36,65 @@ void KeychainModel::setVault(CoinDB::Vault* vault)
 
 void KeychainModel::update()
 {
-    removeRows(0, rowCount());
-
-    if (!vault) return;
-
-    std::vector<KeychainView> keychains = vault->getRootKeychainViews();
-    for (auto& keychain: keychains)
+    uint64_t requestGeneration = ++generation;
+    if (!vault)
     {
-        QList<QStandardItem*> row;
+        removeRows(0, rowCount());
+        emit updated();
+        return;
+    }
 
-        row.append(new QStandardItem(QString::fromStdString(keychain.name)));
+    vaultService->post<std::vector<KeychainView>>(this, [](Vault* vault) {
+        if (!vault) return std::vector<KeychainView>();
+        return vault->getRootKeychainViews();
+    }, [this, requestGeneration](std::vector<KeychainView>& keychains) {
+        if (requestGeneration != generation) return;
 
-        QStandardItem* encryptedItem = new QStandardItem();
-        if (keychain.is_encrypted)
-        {
-            encryptedItem->setIcon(QIcon(":/icons/encrypted.png"));
-            encryptedItem->setData(true, Qt::UserRole);
-        }
-        else
+        removeRows(0, rowCount());
+        for (auto& keychain: keychains)
         {
-            encryptedItem->setData(false, Qt::UserRole);
-        }
-        row.append(encryptedItem);
+            QList<QStandardItem*> row;
+
+            row.append(new QStandardItem(QString::fromStdString(keychain.name)));
+
+            QStandardItem* encryptedItem = new QStandardItem();
+            if (keychain.is_encrypted)
+            {
+                encryptedItem->setIcon(QIcon(":/icons/encrypted.png"));
+                encryptedItem->setData(true, Qt::UserRole);
+            }
+            else
+            {
+                encryptedItem->setData(false, Qt::UserRole);
+            }
+            row.append(encryptedItem);
         
-        QStandardItem* statusItem = new QStandardItem();
-        if (!keychain.is_private)
-        {
-            statusItem->setIcon(QIcon(":/icons/shared.png"));
-            statusItem->setData(PUBLIC, Qt::UserRole);
-        }
-        else if (keychain.is_locked)
-        {
-            statusItem->setIcon(QIcon(":/icons/locked.png"));
-            statusItem->setData(LOCKED, Qt::UserRole);
-        }
-        else
-        {
-            statusItem->setIcon(QIcon(":/icons/unlocked.png"));
-            statusItem->setData(UNLOCKED, Qt::UserRole);
+            QStandardItem* statusItem = new QStandardItem();
+            if (!keychain.is_private)
+            {
+                statusItem->setIcon(QIcon(":/icons/shared.png"));
+                statusItem->setData(PUBLIC, Qt::UserRole);
+            }
+            else if (keychain.is_locked)
+            {
+                statusItem->setIcon(QIcon(":/icons/locked.png"));
+                statusItem->setData(LOCKED, Qt::UserRole);
+            }
+            else
+            {
+                statusItem->setIcon(QIcon(":/icons/unlocked.png"));
+                statusItem->setData(UNLOCKED, Qt::UserRole);
+            }
+            row.append(statusItem);
+
+            row.append(new QStandardItem(QString::fromStdString(uchar_vector(keychain.hash).getHex())));
+            appendRow(row);
         }
-        row.append(statusItem);
 
-        row.append(new QStandardItem(QString::fromStdString(uchar_vector(keychain.hash).getHex())));
-        appendRow(row);
-    }
+        emit updated();
+    }, [this](const QString& message) {
+        emit error(message);
+    });
 }
 
 void KeychainModel::exportKeychain(const QString& keychainName, const QString& fileName, bool exportPrivate) const
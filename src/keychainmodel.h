@@ -19,14 +19,18 @@
 
 #include <CoinQ/CoinQ_typedefs.h>
 
+class VaultService;
+
 class KeychainModel : public QStandardItemModel
 {
     Q_OBJECT
 
 public:
-    KeychainModel();
+    KeychainModel(VaultService* vaultService);
 
     void setVault(CoinDB::Vault* vault);
+
+    // The keychains are read through the vault service - updated is emitted once they arrive.
     void update();
 
     void exportKeychain(const QString& keychainName, const QString& fileName, bool exportPrivate) const;
@@ -59,8 +63,11 @@ public:
 signals:
     void error(const QString& message);
     void keychainChanged();
+    void updated();
 
 private:
+    VaultService* vaultService;
     CoinDB::Vault* vault;
+    uint64_t generation;
 };
 
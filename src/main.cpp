@@ -157,16 +157,13 @@ int main(int argc, char* argv[])
     mainWin.loadHeaders();
 
     // Require splash screen to always remain open for at least a couple seconds
-    bool waiting = true;
     boost::asio::io_service timer_io;
     boost::asio::deadline_timer timer(timer_io, boost::posix_time::seconds(MINIMUM_SPLASH_SECS));
-    timer.async_wait([&](const boost::system::error_code& /*ec*/) { waiting = false; });
-    timer_io.run();
+    timer.async_wait([](const boost::system::error_code& /*ec*/) { });
 
     splash.showProgressMessage("Initializing...");
     app.processEvents();
-    while (waiting) { usleep(200); }
-    timer_io.stop();
+    timer_io.run(); // returns when the timer expires
 
     mainWin.tryConnect();
     mainWin.show();
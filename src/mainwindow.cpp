@@ -41,6 +41,8 @@
 #include "keychainview.h"
 #include "txmodel.h"
 #include "txview.h"
+#include "vaultservice.h"
+#include "refreshscheduler.h"
 
 // Actions
 #include "txactions.h"
@@ -95,6 +97,7 @@ MainWindow::MainWindow() :
     syncHeight(0),
     bestHeight(0),
     networkState(NETWORK_STATE_STOPPED),
+    vaultService(nullptr),
     accountModel(nullptr),
     keychainModel(nullptr),
     txActions(nullptr)
@@ -109,12 +112,17 @@ MainWindow::MainWindow() :
     //setCurrentFile("");
     setUnifiedTitleAndToolBarOnMac(true);
 
+    // All model reads go through the vault service so the GUI thread never waits on the vault.
+    vaultService = new VaultService(this);
+    connect(vaultService, SIGNAL(error(const QString&)), this, SLOT(showError(const QString&)));
+
     // Keychain tab page
-    keychainModel = new KeychainModel();
+    keychainModel = new KeychainModel(vaultService);
     keychainView = new KeychainView();
     keychainView->setModel(keychainModel);
     keychainView->setSelectionMode(KeychainView::MultiSelection);
     connect(keychainModel, SIGNAL(keychainChanged()), keychainView, SLOT(updateColumns()));
+    connect(keychainModel, SIGNAL(updated()), keychainView, SLOT(updateColumns()));
 
     keychainSelectionModel = keychainView->selectionModel();
     connect(keychainSelectionModel, &QItemSelectionModel::currentChanged,
@@ -126,10 +134,20 @@ MainWindow::MainWindow() :
     //synchedVault.subscribeKeychainLocked([this](const std::string& /*keychain_name*/) { keychainModel->update(); });
 
     // Account tab page
-    accountModel = new AccountModel(synchedVault);
+    accountModel = new AccountModel(synchedVault, vaultService);
     accountView = new AccountView();
     accountView->setModel(accountModel);
     accountView->updateColumns();
+    connect(accountModel, &AccountModel::updated, [this]() {
+        accountView->updateColumns();
+
+        // Rebuilding the rows drops the selection - put it back.
+        if (accountView->selectionModel()->selectedRows(0).isEmpty() && !selectAccount(accountToSelect))
+        {
+            selectAccount(0);
+        }
+        accountToSelect.clear();
+    });
     connect(accountView, SIGNAL(updateModel()), accountModel, SLOT(update()));
     connect(keychainModel, SIGNAL(keychainChanged()), accountModel, SLOT(update()));
 
@@ -173,12 +191,28 @@ MainWindow::MainWindow() :
     //synchedVault.subscribeVaultError([this](const std::string& error, int /*code*/) { emit signal_error(tr("Vault error: ") + QString::fromStdString(error)); });
     connect(this, SIGNAL(signal_error(const QString&)), this, SLOT(showError(const QString&)));
 
-    synchedVault.subscribeTxInserted([this](std::shared_ptr<CoinDB::Tx> /*tx*/) { if (isSynched()) emit signal_newTx(); });
-    synchedVault.subscribeTxUpdated([this](std::shared_ptr<CoinDB::Tx> /*tx*/) { if (isSynched()) emit signal_newTx(); });
-    synchedVault.subscribeMerkleBlockInserted([this](std::shared_ptr<CoinDB::MerkleBlock> /*merkleblock*/) { emit signal_newBlock(); });
+    // Vault events arrive from the sync thread, often hundreds per second. They are collected by the
+    // refresh scheduler and applied to the models in one batch per interval.
+    refreshScheduler = new RefreshScheduler(this);
+    connect(refreshScheduler, &RefreshScheduler::refresh, this, &MainWindow::applyRefresh);
+
+    // The subscribers below only mark the scheduler, so vault notifications can run off the thread
+    // that inserts blocks and txs.
+    synchedVault.setAsyncNotifications(true);
+
+    synchedVault.subscribeTxInserted([this](std::shared_ptr<CoinDB::Tx> tx) { refreshScheduler->txChanged(tx); refreshScheduler->accountsChanged(); });
+    synchedVault.subscribeTxUpdated([this](std::shared_ptr<CoinDB::Tx> tx) { refreshScheduler->txChanged(tx); refreshScheduler->accountsChanged(); });
+    synchedVault.subscribeTxDeleted([this](std::shared_ptr<CoinDB::Tx> tx) { refreshScheduler->txDeleted(tx); refreshScheduler->accountsChanged(); });
+    synchedVault.subscribeMerkleBlockInserted([this](std::shared_ptr<CoinDB::MerkleBlock> merkleblock) {
+        refreshScheduler->bestHeightChanged(merkleblock->blockheader()->height());
+        refreshScheduler->accountsChanged();
+    });
+    synchedVault.subscribeConfirmationsChanged([this](uint32_t /*height*/, const hashvector_t& /*txhashes*/) {
+        // Reorgs can move any number of txs - rebuild the tx model.
+        refreshScheduler->historyChanged();
+        refreshScheduler->accountsChanged();
+    });
 
-    connect(this, SIGNAL(signal_newTx()), this, SLOT(newTx()));
-    connect(this, SIGNAL(signal_newBlock()), this, SLOT(newBlock()));
     connect(this, SIGNAL(signal_refreshAccounts()), this, SLOT(refreshAccounts()));
 
     accountSelectionModel = accountView->selectionModel();
@@ -190,7 +224,9 @@ MainWindow::MainWindow() :
     connect(keychainModel, SIGNAL(error(const QString&)), this, SLOT(showError(const QString&)));
 
     // Transaction tab page
-    txModel = new TxModel();
+    txModel = new TxModel(vaultService);
+    connect(txModel, &TxModel::updated, [this]() { txView->updateColumns(); });
+    connect(txModel, SIGNAL(error(const QString&)), this, SLOT(showError(const QString&)));
     connect(txModel, SIGNAL(txSigned(const QString&)), this, SLOT(showUpdate(const QString&)));
 
     txView = new TxView();
@@ -221,6 +257,8 @@ MainWindow::MainWindow() :
     synchedVault.subscribeVaultClosed([this]() { emit vaultClosed(); });
 
     connect(this, &MainWindow::vaultOpened, [this](CoinDB::Vault* vault) {
+        vaultService->setVault(vault);
+
         keychainModel->setVault(vault);
         keychainModel->update();
         keychainView->updateColumns();
@@ -231,8 +269,6 @@ MainWindow::MainWindow() :
         txModel->setVault(vault);
         txModel->update();
         txView->updateColumns();
-
-        selectAccount(0);
     });
     connect(this, &MainWindow::vaultClosed, [this]() {
         if (bQuitting) return;
@@ -306,6 +342,7 @@ void MainWindow::closeEvent(QCloseEvent* event)
 {
     bQuitting = true;
     synchedVault.stopSync();
+    vaultService->setVault(nullptr);
     saveSettings();
     joinEntropyThread();
     event->accept();
@@ -524,6 +561,7 @@ void MainWindow::newVault(QString fileName)
 
     try
     {
+        vaultService->setVault(nullptr);
         synchedVault.openVault(fileName.toStdString(), true, SCHEMA_VERSION, getCoinParams().network_name());
         updateVaultStatus(fileName);
         addToRecents(fileName);
@@ -581,6 +619,7 @@ void MainWindow::openVault(QString fileName)
         try
         {
             closeVault();
+            vaultService->setVault(nullptr);
             synchedVault.openVault(fileName.toStdString(), false, SCHEMA_VERSION, getCoinParams().network_name(), false);
         }
         catch (const CoinDB::VaultNeedsSchemaMigrationException& e)
@@ -618,6 +657,7 @@ void MainWindow::openVault(QString fileName)
                 n++;
             }
 
+            vaultService->setVault(nullptr);
             synchedVault.openVault(fileName.toStdString(), false, SCHEMA_VERSION, getCoinParams().network_name(), true);
             QMessageBox::information(this, tr("Backup Made"), tr("Your vault file has been backed up to ") + backupFileName);
         }
@@ -675,25 +715,24 @@ void MainWindow::exportVault(QString fileName, bool exportPrivKeys)
     setDocDir(fileInfo.dir().absolutePath());
     saveSettings();
 
-    try
-    {
-        if (!synchedVault.isVaultOpen()) throw std::runtime_error("No vault is open.");
-        CoinDB::VaultLock lock(synchedVault);
-        if (!synchedVault.isVaultOpen()) throw std::runtime_error("No vault is open.");
-
-        synchedVault.getVault()->exportVault(fileName.toStdString(), exportPrivKeys);
-    }
-    catch (const exception& e)
-    {
-        LOGGER(debug) << "MainWindow::exportVault - " << e.what() << std::endl;
-        showError(e.what());
-    }
+    std::string file = fileName.toStdString();
+    vaultService->post<bool>(this, [file, exportPrivKeys](CoinDB::Vault* vault) {
+        if (!vault) throw std::runtime_error("No vault is open.");
+        vault->exportVault(file, exportPrivKeys);
+        return true;
+    }, [this, fileName](bool&) {
+        updateStatusMessage(tr("Exported vault to ") + fileName);
+    }, [this](const QString& message) {
+        LOGGER(debug) << "MainWindow::exportVault - " << message.toStdString() << std::endl;
+        showError(message);
+    });
 }
 
 void MainWindow::closeVault()
 {
     try
     {
+        vaultService->setVault(nullptr);
         synchedVault.closeVault();
         updateVaultStatus();
     }
@@ -742,15 +781,21 @@ void MainWindow::newKeychain()
                     } 
                 }
 */
-                CoinDB::VaultLock lock(synchedVault);
-                if (!synchedVault.isVaultOpen()) throw std::runtime_error("No vault is open.");
-                synchedVault.getVault()->newKeychain(name.toStdString(), seed);
+                std::string keychainName = name.toStdString();
+                vaultService->post<bool>(this, [keychainName, seed](CoinDB::Vault* vault) {
+                    if (!vault) throw std::runtime_error("No vault is open.");
+                    vault->newKeychain(keychainName, seed);
+                    return true;
+                }, [this, name](bool&) {
+                    keychainModel->update();
+                    keychainView->updateColumns();
+                    tabWidget->setCurrentWidget(keychainView);
+                    updateStatusMessage(tr("Created keychain ") + name);
+                }, [this](const QString& message) {
+                    LOGGER(debug) << "MainWindow::newKeyChain - " << message.toStdString() << std::endl;
+                    showError(message);
+                });
             }
-
-            keychainModel->update();
-            keychainView->updateColumns();
-            tabWidget->setCurrentWidget(keychainView);
-            updateStatusMessage(tr("Created keychain ") + name);
         }
     }
     catch (const exception& e) {
@@ -964,7 +1009,7 @@ int MainWindow::setKeychainPassphrase(const QString& keychainName)
     return QDialog::Rejected;
 }
 
-int MainWindow::makeKeychainBackup(const QString& keychainName)
+void MainWindow::makeKeychainBackup(const QString& keychainName)
 {
     QString name;
     bool bLocked;
@@ -974,13 +1019,13 @@ int MainWindow::makeKeychainBackup(const QString& keychainName)
         int row = index.row();
         if (row < 0) {
             showError(tr("No keychain is selected."));
-            return QDialog::Rejected;
+            return;
         }
 
         if (!keychainModel->hasSeed(row))
         {
             showError(tr("Entropy seed for keychain is not known. Please use another backup format."));
-            return QDialog::Rejected;
+            return;
         }
 
         bLocked = (keychainModel->getStatus(row) == KeychainModel::LOCKED);
@@ -993,13 +1038,13 @@ int MainWindow::makeKeychainBackup(const QString& keychainName)
         if (!keychainModel->exists(keychainName))
         {
             showError(tr("Keychain not found."));
-            return QDialog::Rejected;
+            return;
         }
 
         if (!keychainModel->hasSeed(keychainName))
         {
             showError(tr("Entropy seed for keychain is not known. Please use another backup format."));
-            return QDialog::Rejected;
+            return;
         }
 
         bLocked = keychainModel->isLocked(keychainName);
@@ -1007,28 +1052,31 @@ int MainWindow::makeKeychainBackup(const QString& keychainName)
         name = keychainName;
     } 
 
-    try
-    {
-        if (!synchedVault.isVaultOpen()) throw std::runtime_error("No vault is open.");
-        CoinDB::VaultLock lock(synchedVault);
-        if (!synchedVault.isVaultOpen()) throw std::runtime_error("No vault is open.");
-
-        if (bLocked && !unlockKeychain(name)) return QDialog::Rejected;
-
-        secure_bytes_t seed = synchedVault.getVault()->exportBIP39(name.toStdString());
+    if (bLocked && !unlockKeychain(name)) return;
 
-        KeychainBackupWizard wizard(name, seed, this);
+    // The seed is read on the vault service. The wizard is shown once it is back, and the keychain is
+    // locked again right away if it was locked before.
+    std::string keychainNameStr = name.toStdString();
+    vaultService->post<secure_bytes_t>(this, [keychainNameStr](CoinDB::Vault* vault) {
+        if (!vault) throw std::runtime_error("No vault is open.");
+        return vault->exportBIP39(keychainNameStr);
+    }, [this, name, bLocked](secure_bytes_t& seed) {
         if (bLocked) { lockKeychain(name); }
-        return wizard.exec();
-    }
-    catch (const exception& e)
-    {
-        LOGGER(error) << "MainWindow::makeKeychainBackup - " << e.what() << std::endl;
+        try
+        {
+            KeychainBackupWizard wizard(name, seed, this);
+            wizard.exec();
+        }
+        catch (const exception& e)
+        {
+            LOGGER(error) << "MainWindow::makeKeychainBackup - " << e.what() << std::endl;
+            showError(e.what());
+        }
+    }, [this, name, bLocked](const QString& message) {
+        LOGGER(error) << "MainWindow::makeKeychainBackup - " << message.toStdString() << std::endl;
         if (bLocked) { lockKeychain(name); }
-        showError(e.what());
-    }
-
-    return QDialog::Rejected;
+        showError(message);
+    });
 }
 
 void MainWindow::importKeychain(QString fileName)
@@ -1141,13 +1189,20 @@ void MainWindow::importBIP32()
             secure_bytes_t extkey = dlg.getExtendedKey();
             string name = dlg.getName().toStdString();
 
-            if (!synchedVault.isVaultOpen()) throw std::runtime_error("No vault is open.");
-            CoinDB::VaultLock lock(synchedVault);
-            if (!synchedVault.isVaultOpen()) throw std::runtime_error("No vault is open.");
-            /*std::shared_ptr<Keychain> keychain =*/ synchedVault.getVault()->importBIP32(name, extkey);
-            keychainModel->update();
-            keychainView->updateColumns();
-            tabWidget->setCurrentWidget(keychainView);
+            // The import runs on the vault service - if it fails the dialog is opened again.
+            vaultService->post<bool>(this, [name, extkey](CoinDB::Vault* vault) {
+                if (!vault) throw std::runtime_error("No vault is open.");
+                /*std::shared_ptr<Keychain> keychain =*/ vault->importBIP32(name, extkey);
+                return true;
+            }, [this](bool&) {
+                keychainModel->update();
+                keychainView->updateColumns();
+                tabWidget->setCurrentWidget(keychainView);
+            }, [this](const QString& message) {
+                LOGGER(error) << "MainWindow::importBIP32 - " << message.toStdString() << std::endl;
+                showError(message);
+                importBIP32();
+            });
             break;
         }
         catch (const exception& e)
@@ -1338,6 +1393,9 @@ bool MainWindow::selectAccount(const QString& account)
             return true;
         }
     }
+
+    // It may not have been loaded yet.
+    accountToSelect = account;
     return false;
 }
 
@@ -1381,22 +1439,45 @@ void MainWindow::updateSelectedAccounts(const QItemSelection& /*selected*/, cons
 
 void MainWindow::refreshAccounts()
 {
-    LOGGER(trace) << "MainWindow::refreshAccounts()" << std::endl;
+    refreshAccounts(true);
+}
+
+void MainWindow::refreshAccounts(bool updateTxModel)
+{
+    LOGGER(trace) << "MainWindow::refreshAccounts(" << (updateTxModel ? "true" : "false") << ")" << std::endl;
 
     if (bQuitting) return;
 
-    QString prevSelectedAccount = selectedAccount;
-    accountModel->update();
-    accountView->updateColumns();
+    // User-initiated refreshes skip the wait and take anything already pending with them.
+    refreshScheduler->accountsChanged();
+    if (updateTxModel) { refreshScheduler->historyChanged(); }
+    refreshScheduler->flush();
+}
 
-    if (prevSelectedAccount != selectedAccount)
+void MainWindow::applyRefresh(const RefreshBatch& batch)
+{
+    if (bQuitting) return;
+
+    if (batch.history)
     {
-        selectAccount(prevSelectedAccount);
+        txModel->update();
     }
     else
     {
-        txModel->update();
-        txView->updateColumns();
+        for (auto& change: batch.txs)
+        {
+            if (change.deleted)     { txModel->removeTx(change.tx); }
+            else                    { txModel->updateTx(change.tx); }
+        }
+    }
+
+    if (batch.bestHeight) { txModel->setBestHeight(batch.bestHeight); }
+
+    if (batch.accounts)
+    {
+        // The selection is restored once the accounts come back if the rows had to be rebuilt.
+        accountToSelect = selectedAccount;
+        accountModel->update();
     }
 }
 
@@ -1666,7 +1747,7 @@ void MainWindow::viewAccountHistory()
 
     try {
         // TODO: Make this dialog not modal and allow viewing several account histories simultaneously.
-        AccountHistoryDialog dlg(accountModel->getVault(), accountName, &networkSync, this);
+        AccountHistoryDialog dlg(vaultService, accountModel->getVault(), accountName, &networkSync, this);
         connect(&dlg, &AccountHistoryDialog::txDeleted, [this]() { accountModel->update(); });
         dlg.exec();
     }
@@ -1775,7 +1856,7 @@ void MainWindow::createRawTx()
  
     QString accountName = accountModel->data(indexes.at(0)).toString();
 
-    CreateTxDialog dlg(accountModel->getVault(), accountName, PaymentRequest(), this);
+    CreateTxDialog dlg(vaultService, accountModel->getVault(), accountName, PaymentRequest(), this);
     while (dlg.exec()) {
         try {
             std::vector<TaggedOutput> outputs = dlg.getOutputs();
@@ -1810,78 +1891,105 @@ void MainWindow::createTx(const PaymentRequest& paymentRequest)
  
     QString accountName = accountModel->data(indexes.at(0)).toString();
 
-    CreateTxDialog dlg(accountModel->getVault(), accountName, paymentRequest, this);
-    bool saved = false;
-    while (!saved && dlg.exec()) {
+    runCreateTxDialog(new CreateTxDialog(vaultService, accountModel->getVault(), accountName, paymentRequest, this));
+}
+
+void MainWindow::runCreateTxDialog(CreateTxDialog* dlg)
+{
+    // The tx is created on the vault service, so a failure reopens the dialog from the error callback.
+    std::string accountName;
+    std::vector<unsigned long> coinIds;
+    CoinDB::txouts_t txouts;
+    uint64_t fee;
+    bool sign;
+    while (true) {
+        if (!dlg->exec()) {
+            dlg->deleteLater();
+            return;
+        }
+
         try {
-            std::shared_ptr<CoinDB::Tx> tx = accountModel->getVault()->createTx(
-                dlg.getAccountName().toStdString(),
-                1,
-                0,
-                dlg.getInputTxOutIds(),
-                dlg.getTxOuts(),
-                dlg.getFeeValue(),
-                0,
-                true);
-            if (!tx) throw std::runtime_error(tr("Error creating transaction.").toStdString());
-
-            saved = true;
-            newTx();
+            accountName = dlg->getAccountName().toStdString();
+            coinIds = dlg->getInputTxOutIds();
+            txouts = dlg->getTxOuts();
+            fee = dlg->getFeeValue();
+            sign = (dlg->getStatus() == CreateTxDialog::SIGN);
+            break;
+        }
+        catch (const exception& e) {
+            LOGGER(debug) << "MainWindow::createTx - " << e.what() << std::endl;
+            showError(e.what());
+        }
+    }
 
-            tabWidget->setCurrentWidget(txView);
+    vaultService->post<std::shared_ptr<CoinDB::Tx>>(this, [=](CoinDB::Vault* vault) {
+        if (!vault) throw std::runtime_error(tr("No vault is open.").toStdString());
+        std::shared_ptr<CoinDB::Tx> tx = vault->createTx(accountName, 1, 0, coinIds, txouts, fee, 0, true);
+        if (!tx) throw std::runtime_error(tr("Error creating transaction.").toStdString());
+        return tx;
+    }, [this, dlg, sign](std::shared_ptr<CoinDB::Tx>& tx) {
+        dlg->deleteLater();
 
-            if (dlg.getStatus() == CreateTxDialog::SIGN)
-            {
-                // First try to sign with unlocked keychains
-                std::vector<std::string> keychains;
-                tx = accountModel->getVault()->signTx(tx->id(), keychains, true);
-                txModel->update();
+        // Show the new tx now rather than at the next scheduled refresh. The vault notification
+        // may still be on its way from the dispatcher thread, so mark the tx here too.
+        refreshScheduler->txChanged(tx);
+        refreshScheduler->accountsChanged();
+        refreshScheduler->flush();
 
-                if (tx->status() == CoinDB::Tx::UNSIGNED)
-                {
-                    // If still unsigned, pop open dialog
-                    SignatureDialog dlg(synchedVault, tx->unsigned_hash(), this);
-                    connect(&dlg, &SignatureDialog::error, [this](const QString& msg) { showError(msg); });
-                    connect(&dlg, &SignatureDialog::txUpdated, [this]() { txModel->update(); });
-                    connect(&dlg, &SignatureDialog::keychainsUpdated, [this]() { keychainModel->update(); });
-                    dlg.exec();
-                }
-                else if (isConnected())
-                {
-                    // TODO: Create new dialog for sending confirmation.
-                    QMessageBox sendPrompt;
-                    sendPrompt.setText(tr("Transaction is fully signed. Would you like to send?"));
-                    sendPrompt.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
-                    sendPrompt.setDefaultButton(QMessageBox::Yes);
-                    if (sendPrompt.exec() == QMessageBox::Yes)
-                    {
-                        if (!synchedVault.isConnected()) throw std::runtime_error(tr("Connection was lost.").toStdString());
+        tabWidget->setCurrentWidget(txView);
 
-                        Coin::Transaction coin_tx = tx->toCoinCore();
-                        synchedVault.sendTx(coin_tx);
-                    }
-                }
+        if (sign) { signNewTx(tx->id()); }
+    }, [this, dlg](const QString& message) {
+        LOGGER(debug) << "MainWindow::createTx - " << message.toStdString() << std::endl;
+        showError(message);
+        runCreateTxDialog(dlg);
+    });
+}
+
+void MainWindow::signNewTx(unsigned long txId)
+{
+    // First try to sign with unlocked keychains
+    vaultService->post<std::shared_ptr<CoinDB::Tx>>(this, [txId](CoinDB::Vault* vault) {
+        if (!vault) throw std::runtime_error(tr("No vault is open.").toStdString());
+        std::vector<std::string> keychains;
+        return vault->signTx(txId, keychains, true);
+    }, [this](std::shared_ptr<CoinDB::Tx>& tx) {
+        txModel->update();
+
+        try {
+            if (tx->status() == CoinDB::Tx::UNSIGNED)
+            {
+                // If still unsigned, pop open dialog
+                SignatureDialog dlg(synchedVault, tx->unsigned_hash(), this);
+                connect(&dlg, &SignatureDialog::error, [this](const QString& msg) { showError(msg); });
+                connect(&dlg, &SignatureDialog::txUpdated, [this]() { txModel->update(); });
+                connect(&dlg, &SignatureDialog::keychainsUpdated, [this]() { keychainModel->update(); });
+                dlg.exec();
             }
-/*
-            if (status == CreateTxDialog::SIGN_AND_SEND) {
-                // TODO: Clean up signing and sending code
-                if (tx->status() == CoinDB::Tx::UNSIGNED) {
-                    throw std::runtime_error(tr("Could not send - transaction still missing signatures.").toStdString());
-                }
-                if (!isConnected()) {
-                    throw std::runtime_error(tr("Must be connected to network to send.").toStdString());
+            else if (isConnected())
+            {
+                // TODO: Create new dialog for sending confirmation.
+                QMessageBox sendPrompt;
+                sendPrompt.setText(tr("Transaction is fully signed. Would you like to send?"));
+                sendPrompt.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+                sendPrompt.setDefaultButton(QMessageBox::Yes);
+                if (sendPrompt.exec() == QMessageBox::Yes)
+                {
+                    if (!synchedVault.isConnected()) throw std::runtime_error(tr("Connection was lost.").toStdString());
+
+                    Coin::Transaction coin_tx = tx->toCoinCore();
+                    synchedVault.sendTx(coin_tx);
                 }
-                Coin::Transaction coin_tx = tx->toCoinCore();
-                synchedVault.sendTx(coin_tx);
             }
-*/
-            return;
         }
         catch (const exception& e) {
-            LOGGER(debug) << "MainWindow::createTx - " << e.what() << std::endl;
+            LOGGER(debug) << "MainWindow::signNewTx - " << e.what() << std::endl;
             showError(e.what());
         }
-    }
+    }, [this](const QString& message) {
+        LOGGER(debug) << "MainWindow::signNewTx - " << message.toStdString() << std::endl;
+        showError(message);
+    });
 }
 
 void MainWindow::signRawTx()
@@ -1925,16 +2033,6 @@ void MainWindow::sendRawTx()
     }
 }
 
-void MainWindow::newTx()
-{
-    refreshAccounts();
-}
-
-void MainWindow::newBlock()
-{
-    if (isSynched() || syncHeight % 10 == 0) { refreshAccounts(); }
-}
-
 void MainWindow::syncBlocks()
 {
     updateStatusMessage(tr("Synchronizing vault"));
@@ -2693,6 +2791,7 @@ void MainWindow::clearSettings()
 
 void MainWindow::loadVault(const QString &fileName)
 {
+    vaultService->setVault(nullptr);
     synchedVault.openVault(fileName.toStdString(), false, SCHEMA_VERSION, getCoinParams().network_name());
 }
 
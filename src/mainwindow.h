@@ -31,9 +31,13 @@ class TxModel;
 class TxView;
 
 class TxActions;
+class VaultService;
+class RefreshScheduler;
+struct RefreshBatch;
 class SignatureActions;
 
 class RequestPaymentDialog;
+class CreateTxDialog;
 
 #include <CoinDB/SynchedVault.h>
 //#include <CoinQ/CoinQ_netsync.h>
@@ -92,8 +96,6 @@ signals:
     void signal_networkTimeout();
     void signal_networkDoneSync();
 
-    void signal_newTx();
-    void signal_newBlock();
     void signal_refreshAccounts();
 
     void signal_addBestChain(const chain_header_t& header);
@@ -153,7 +155,7 @@ private slots:
     void lockKeychain(QString name = QString());
     void lockAllKeychains();
     int  setKeychainPassphrase(const QString& keychainName = QString());
-    int  makeKeychainBackup(const QString& keychainName = QString());
+    void makeKeychainBackup(const QString& keychainName = QString());
     void importKeychain(QString fileName = QString());
     void exportKeychain(bool exportPrivate);
     void importBIP32();
@@ -181,6 +183,8 @@ private slots:
     void updateCurrentAccount(const QModelIndex& current, const QModelIndex& previous);
     void updateSelectedAccounts(const QItemSelection& selected, const QItemSelection& deselected);
     void refreshAccounts();
+    void refreshAccounts(bool updateTxModel);
+    void applyRefresh(const RefreshBatch& batch);
 
     /////////////////////////
     // TRANSACTION OPERATIONS
@@ -189,8 +193,9 @@ private slots:
 //    void requestTx();
     void createRawTx();
     void createTx(const PaymentRequest& paymentRequest = PaymentRequest());
+    void runCreateTxDialog(CreateTxDialog* dlg);
+    void signNewTx(unsigned long txId);
     void signRawTx();
-    void newTx();
     void sendRawTx();
 
     //////////////////////////////
@@ -202,7 +207,6 @@ private slots:
     void blocksSynched();
     void addBestChain(const chain_header_t& header);
     void removeBestChain(const chain_header_t& header);
-    void newBlock();
 
     /////////////////////
     // NETWORK OPERATIONS
@@ -261,6 +265,7 @@ private:
     bool selectAccount(int i);
     bool selectAccount(const QString& account);
     QString selectedAccount;
+    QString accountToSelect; // selected once the account model has caught up
 
     CoinDB::SynchedVault synchedVault;
 
@@ -388,6 +393,9 @@ private:
     // tabs
     QTabWidget* tabWidget;
 
+    VaultService* vaultService;
+    RefreshScheduler* refreshScheduler;
+
     AccountModel* accountModel;
     AccountView* accountView;
 
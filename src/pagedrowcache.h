@@ -0,0 +1,215 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// mSIGNA
+//
+// pagedrowcache.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+// Row storage for models backed by a keyset cursor over the vault.
+//
+// Pages are appended in order, each one loaded from nextCursor(). Only the cursor at the start of each
+// page is kept for the whole history - the rows themselves live in a small LRU cache. Rows of evicted
+// pages read as null until the owner reloads the page from pageStart() and restores it. Any state a
+// loader needs to reproduce a page (running totals and the like) must therefore be carried in the cursor.
+//
+// Loading is left to the owner so it can happen off the GUI thread.
+template<typename CursorType, typename RowType>
+class PagedRowCache
+{
+public:
+    explicit PagedRowCache(std::size_t maxCachedPages = 8) : maxCachedPages_(maxCachedPages), rowCount_(0), atEnd_(true) { }
+
+    // Starts over with nothing fetched yet.
+    void reset(const CursorType& start = CursorType())
+    {
+        pages_.clear();
+        cache_.clear();
+        lru_.clear();
+        next_ = start;
+        rowCount_ = 0;
+        atEnd_ = false;
+    }
+
+    // Starts over with nothing to fetch.
+    void clear()
+    {
+        reset();
+        atEnd_ = true;
+    }
+
+    bool canFetchMore() const { return !atEnd_; }
+    const CursorType& nextCursor() const { return next_; }
+    void setNextCursor(const CursorType& next) { next_ = next; }
+
+    // Appends a page loaded from nextCursor() and returns the number of rows added. next is the cursor
+    // following the page. If given, beginInsert is called with the first new row and the row count before
+    // the rows are counted, so models can announce the insertion.
+    int appendPage(std::vector<RowType>&& rows, const CursorType& next, bool atEnd, std::function<void(int first, int count)> beginInsert = nullptr)
+    {
+        int count = indexPage(rows.size(), next, atEnd, beginInsert);
+        if (count > 0) cachePage(pages_.size() - 1, std::move(rows));
+        return count;
+    }
+
+    // Like appendPage() but only records where the page starts - its rows read as null until restored.
+    int indexPage(int count, const CursorType& next, bool atEnd, std::function<void(int first, int count)> beginInsert = nullptr)
+    {
+        Page page;
+        page.start = next_;
+        page.firstRow = rowCount_;
+        page.rowCount = count;
+
+        next_ = next;
+        atEnd_ = atEnd;
+        if (count == 0) return 0;
+
+        if (beginInsert) beginInsert(page.firstRow, page.rowCount);
+        pages_.push_back(page);
+        rowCount_ += page.rowCount;
+        return page.rowCount;
+    }
+
+    std::size_t pageCount() const { return pages_.size(); }
+
+    int rowCount() const { return rowCount_; }
+
+    // Returns null if the page holding the row has been evicted.
+    const RowType* row(int i) const { return const_cast<PagedRowCache*>(this)->row(i); }
+
+    RowType* row(int i)
+    {
+        std::size_t index = pageIndex(i);
+        auto it = cache_.find(index);
+        if (it == cache_.end()) return nullptr;
+
+        lru_.splice(lru_.begin(), lru_, it->second.second);
+        return &it->second.first[i - pages_[index].firstRow];
+    }
+
+    std::size_t pageIndex(int i) const
+    {
+        if (i < 0 || i >= rowCount_) throw std::out_of_range("PagedRowCache::pageIndex() - index out of range.");
+
+        // Binary search for the page containing the row.
+        std::size_t lo = 0;
+        std::size_t hi = pages_.size();
+        while (hi - lo > 1)
+        {
+            std::size_t mid = (lo + hi) / 2;
+            if (pages_[mid].firstRow <= i)  { lo = mid; }
+            else                            { hi = mid; }
+        }
+        return lo;
+    }
+
+    const CursorType& pageStart(std::size_t index) const { return pages_.at(index).start; }
+    void setPageStart(std::size_t index, const CursorType& start) { pages_.at(index).start = start; }
+    int pageFirstRow(std::size_t index) const { return pages_.at(index).firstRow; }
+    int pageRowCount(std::size_t index) const { return pages_.at(index).rowCount; }
+
+    // Returns null if the page has been evicted.
+    std::vector<RowType>* cachedPage(std::size_t index)
+    {
+        auto it = cache_.find(index);
+        return it != cache_.end() ? &it->second.first : nullptr;
+    }
+
+    // Inserts rows into a page at offset pos, for rows that now belong between its start and the start
+    // of the next page. An evicted page only has its row count raised - reloading it picks up the rows.
+    void insertRows(std::size_t index, int pos, std::vector<RowType>&& rows, std::function<void(int first, int count)> beginInsert = nullptr)
+    {
+        Page& page = pages_.at(index);
+        if (pos < 0 || pos > page.rowCount) throw std::out_of_range("PagedRowCache::insertRows() - position out of range.");
+        if (rows.empty()) return;
+
+        int count = rows.size();
+        if (beginInsert) beginInsert(page.firstRow + pos, count);
+
+        std::vector<RowType>* cached = cachedPage(index);
+        if (cached) cached->insert(cached->begin() + pos, std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+
+        page.rowCount += count;
+        for (std::size_t i = index + 1; i < pages_.size(); i++) { pages_[i].firstRow += count; }
+        rowCount_ += count;
+    }
+
+    // Removes rows from a cached page.
+    void removeRows(std::size_t index, int pos, int count, std::function<void(int first, int count)> beginRemove = nullptr)
+    {
+        Page& page = pages_.at(index);
+        if (pos < 0 || count < 0 || pos + count > page.rowCount) throw std::out_of_range("PagedRowCache::removeRows() - position out of range.");
+        if (count == 0) return;
+
+        if (beginRemove) beginRemove(page.firstRow + pos, count);
+
+        std::vector<RowType>* cached = cachedPage(index);
+        if (cached) cached->erase(cached->begin() + pos, cached->begin() + pos + count);
+
+        page.rowCount -= count;
+        for (std::size_t i = index + 1; i < pages_.size(); i++) { pages_[i].firstRow -= count; }
+        rowCount_ -= count;
+    }
+
+    // Puts a reloaded page back. Rows beyond the indexed count belong to later pages and are dropped.
+    void restorePage(std::size_t index, std::vector<RowType>&& rows)
+    {
+        if (index >= pages_.size()) return;
+        rows.resize(pages_[index].rowCount);
+
+        auto it = cache_.find(index);
+        if (it != cache_.end())
+        {
+            lru_.erase(it->second.second);
+            cache_.erase(it);
+        }
+        cachePage(index, std::move(rows));
+    }
+
+private:
+    struct Page
+    {
+        CursorType start;
+        int firstRow;
+        int rowCount;
+    };
+
+    typedef std::pair<std::vector<RowType>, typename std::list<std::size_t>::iterator> cached_page_t;
+
+    std::size_t maxCachedPages_;
+
+    std::vector<Page> pages_;
+    CursorType next_;
+    int rowCount_;
+    bool atEnd_;
+
+    std::map<std::size_t, cached_page_t> cache_;
+    std::list<std::size_t> lru_; // most recently used first
+
+    void cachePage(std::size_t index, std::vector<RowType>&& rows)
+    {
+        while (cache_.size() >= maxCachedPages_ && !lru_.empty())
+        {
+            cache_.erase(lru_.back());
+            lru_.pop_back();
+        }
+
+        lru_.push_front(index);
+        cached_page_t& entry = cache_[index];
+        entry.first = std::move(rows);
+        entry.second = lru_.begin();
+    }
+};
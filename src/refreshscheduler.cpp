@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// mSIGNA
+//
+// refreshscheduler.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#include "refreshscheduler.h"
+
+#include <CoinDB/Schema.h>
+
+#include "severitylogger.h"
+
+RefreshScheduler::RefreshScheduler(QObject* parent, int interval)
+    : QObject(parent), scheduled(false)
+{
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setInterval(interval);
+    connect(timer, &QTimer::timeout, this, &RefreshScheduler::flush);
+}
+
+void RefreshScheduler::setInterval(int interval)
+{
+    timer->setInterval(interval);
+}
+
+int RefreshScheduler::getInterval() const
+{
+    return timer->interval();
+}
+
+void RefreshScheduler::txChanged(std::shared_ptr<CoinDB::Tx> tx)
+{
+    markTx(tx, false);
+}
+
+void RefreshScheduler::txDeleted(std::shared_ptr<CoinDB::Tx> tx)
+{
+    markTx(tx, true);
+}
+
+void RefreshScheduler::bestHeightChanged(uint32_t height)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        if (height <= pending.bestHeight) return;
+        pending.bestHeight = height;
+    }
+    requestSchedule();
+}
+
+void RefreshScheduler::accountsChanged()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        pending.accounts = true;
+    }
+    requestSchedule();
+}
+
+void RefreshScheduler::historyChanged()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        pending.history = true;
+        pending.txs.clear();
+        pendingTxIndex.clear();
+    }
+    requestSchedule();
+}
+
+void RefreshScheduler::markTx(std::shared_ptr<CoinDB::Tx> tx, bool deleted)
+{
+    if (!tx) return;
+
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        if (pending.history) return;
+
+        auto it = pendingTxIndex.find(tx->unsigned_hash());
+        if (it != pendingTxIndex.end())
+        {
+            pending.txs[it->second].tx = tx;
+            pending.txs[it->second].deleted = deleted;
+        }
+        else
+        {
+            pendingTxIndex[tx->unsigned_hash()] = pending.txs.size();
+            pending.txs.push_back(RefreshBatch::TxChange{tx, deleted});
+            if (pending.txs.size() > MAX_COALESCED_TX_CHANGES) pending.history = true;
+        }
+
+        if (pending.history)
+        {
+            pending.txs.clear();
+            pendingTxIndex.clear();
+        }
+    }
+    requestSchedule();
+}
+
+void RefreshScheduler::requestSchedule()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        if (scheduled) return;
+        scheduled = true;
+    }
+
+    // The timer belongs to the GUI thread - start it from there.
+    QMetaObject::invokeMethod(this, "schedule", Qt::QueuedConnection);
+}
+
+void RefreshScheduler::schedule()
+{
+    if (!timer->isActive()) timer->start();
+}
+
+void RefreshScheduler::flush()
+{
+    timer->stop();
+
+    RefreshBatch batch;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        std::swap(batch, pending);
+        pendingTxIndex.clear();
+        scheduled = false;
+    }
+
+    if (batch.empty()) return;
+
+    LOGGER(trace) << "RefreshScheduler::flush() - txs: " << batch.txs.size() << " best height: " << batch.bestHeight
+                  << (batch.accounts ? " accounts" : "") << (batch.history ? " history" : "") << std::endl;
+    emit refresh(batch);
+}
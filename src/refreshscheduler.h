@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// mSIGNA
+//
+// refreshscheduler.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+
+#include <CoinQ/CoinQ_typedefs.h>
+
+#include <boost/thread.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace CoinDB
+{
+    class Tx;
+}
+
+const int DEFAULT_REFRESH_INTERVAL = 200; // milliseconds
+
+// Above this many tx changes in one interval the tx model is rebuilt instead of patched row by row.
+const std::size_t MAX_COALESCED_TX_CHANGES = 100;
+
+struct RefreshBatch
+{
+    RefreshBatch() : bestHeight(0), accounts(false), history(false) { }
+
+    bool empty() const { return txs.empty() && !bestHeight && !accounts && !history; }
+
+    struct TxChange
+    {
+        std::shared_ptr<CoinDB::Tx> tx;
+        bool deleted;
+    };
+
+    std::vector<TxChange> txs;  // only the latest change to each tx, empty if history is set
+    uint32_t bestHeight;        // zero if unchanged
+    bool accounts;              // account balances need to be reloaded
+    bool history;               // the tx model needs to be rebuilt
+};
+
+// Collects vault and network events and hands them to the GUI as one batch per interval, so a sync
+// that inserts thousands of txs and blocks does not turn into thousands of model refreshes.
+//
+// The marking methods can be called from any thread. The refresh signal is emitted on the thread
+// that owns the scheduler.
+class RefreshScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RefreshScheduler(QObject* parent = nullptr, int interval = DEFAULT_REFRESH_INTERVAL);
+
+    void setInterval(int interval);
+    int getInterval() const;
+
+    void txChanged(std::shared_ptr<CoinDB::Tx> tx);
+    void txDeleted(std::shared_ptr<CoinDB::Tx> tx);
+    void bestHeightChanged(uint32_t height);
+    void accountsChanged();
+    void historyChanged();
+
+public slots:
+    // Emits whatever is pending right away - for changes the user just made.
+    void flush();
+
+signals:
+    void refresh(const RefreshBatch& batch);
+
+private slots:
+    void schedule();
+
+private:
+    void markTx(std::shared_ptr<CoinDB::Tx> tx, bool deleted);
+    void requestSchedule();
+
+    mutable boost::mutex mutex;
+    RefreshBatch pending;
+    std::map<bytes_t, std::size_t> pendingTxIndex; // unsigned hash -> position in pending.txs
+    bool scheduled;
+
+    QTimer* timer;
+};
@@ -47,18 +47,17 @@ TxActions::TxActions(TxModel* txModel, TxView* txView, AccountModel* accountMode
     createActions();
     createMenus();
     connect(m_txView->selectionModel(), &QItemSelectionModel::currentChanged, this, &TxActions::updateCurrentTx);
+    connect(m_txModel, &TxModel::txFound, this, &TxActions::showFoundTx);
 }
 
 void TxActions::updateCurrentTx(const QModelIndex& current, const QModelIndex& /*previous*/)
 {
     currentRow = current.row();
-    if (m_txModel && currentRow != -1)
+    if (m_txModel && currentRow != -1 && m_txModel->isRowLoaded(currentRow))
     {
-        QStandardItem* typeItem = m_txModel->item(currentRow, 2);
-        signaturesAction->setEnabled(typeItem->text() == tr("Send"));
+        signaturesAction->setEnabled(m_txModel->getTxOutType(currentRow) == TxModel::SEND);
 
-        typeItem = m_txModel->item(currentRow, 6);
-        int type = typeItem->data(Qt::UserRole).toInt();
+        int type = m_txModel->getTxStatus(currentRow);
         if (type == CoinDB::Tx::UNSIGNED) {
             signTxAction->setEnabled(true);
         }
@@ -72,7 +71,7 @@ void TxActions::updateCurrentTx(const QModelIndex& current, const QModelIndex& /
         }
         else {
             sendTxAction->setText(tr("Resend Transaction"));
-            sendTxAction->setEnabled(m_synchedVault && m_synchedVault->isConnected() && typeItem->text() == "0");
+            sendTxAction->setEnabled(m_synchedVault && m_synchedVault->isConnected() && type >= CoinDB::Tx::PROPAGATED && m_txModel->getTxConfirmations(currentRow) == 0);
         }
 
         exportTxToFileAction->setEnabled(true);
@@ -122,28 +121,8 @@ void TxActions::searchTx()
         TxSearchDialog dlg(m_txModel, m_parent);
         if (dlg.exec())
         {
-            QString txhash = dlg.getTxHash();
-
-            // TODO: faster search
-            QStandardItem* hashItem = nullptr;
-            int row = 0;
-            for (; row < m_txModel->rowCount(); row++)
-            {
-                QStandardItem* item = m_txModel->item(row, 8);
-                if (item->text().left(txhash.size()) == txhash)
-                {
-                    hashItem = item;
-                    break;
-                }
-            }
-
-            if (!hashItem) throw std::runtime_error("Transaction not found.");
-
-            emit setCurrentWidget(m_txView);
-            QItemSelection selection(m_txModel->index(row, 0), m_txModel->index(row, 0));//m_txModel->columnCount() - 1));
-            m_txView->clearSelection();
-            m_txView->scrollTo(hashItem->index(), QAbstractItemView::PositionAtCenter);
-            m_txView->selectionModel()->select(selection, QItemSelectionModel::SelectCurrent);
+            // The result comes back through showFoundTx() once the history has been searched.
+            m_txModel->findTxRow(dlg.getTxHash());
         }
     }
     catch (const std::exception& e)
@@ -152,6 +131,21 @@ void TxActions::searchTx()
     }
 }
 
+void TxActions::showFoundTx(int row)
+{
+    if (row == -1)
+    {
+        emit error(tr("Transaction not found."));
+        return;
+    }
+
+    emit setCurrentWidget(m_txView);
+    QItemSelection selection(m_txModel->index(row, 0), m_txModel->index(row, 0));//m_txModel->columnCount() - 1));
+    m_txView->clearSelection();
+    m_txView->scrollTo(m_txModel->index(row, 8), QAbstractItemView::PositionAtCenter);
+    m_txView->selectionModel()->select(selection, QItemSelectionModel::SelectCurrent);
+}
+
 void TxActions::showSignatureDialog()
 {
     try
@@ -182,9 +176,10 @@ void TxActions::signTx()
     try
     {
         seedEntropySource(false);
-        m_txModel->signTx(currentRow);
-        m_txView->updateColumns();
-        emit setCurrentWidget(m_txView);
+        m_txModel->signTx(currentRow, [this]() {
+            m_txView->updateColumns();
+            emit setCurrentWidget(m_txView);
+        });
     }
     catch (const std::exception& e)
     {
@@ -195,8 +190,7 @@ void TxActions::signTx()
 void TxActions::sendTx()
 {
     try {
-        m_txModel->sendTx(currentRow, m_synchedVault);
-        m_txView->updateColumns();
+        m_txModel->sendTx(currentRow, m_synchedVault, [this]() { m_txView->updateColumns(); });
     }
     catch (const std::exception& e) {
         emit error(e.what());
@@ -208,38 +202,40 @@ void TxActions::exportTxToFile()
     try {
         if (!m_synchedVault || !m_synchedVault->isVaultOpen()) throw std::runtime_error("You must create a vault or open an existing vault before exporting transactions.");
 
-        std::shared_ptr<CoinDB::Tx> tx = m_txModel->getTx(currentRow);
-        QString fileName;
-        if (m_txModel->getTxOutType(currentRow) == TxModel::SEND)
-        {
-            fileName = QString::fromStdString(uchar_vector(tx->hash()).getHex()).left(16);
-            CoinDB::SignatureInfo signatureInfo = m_synchedVault->getVault()->getSignatureInfo(tx->hash());
-            for (auto& keychain: signatureInfo.signingKeychains())
+        int type = m_txModel->getTxOutType(currentRow);
+        withTx([this, type](std::shared_ptr<CoinDB::Tx> tx) {
+            QString fileName;
+            if (type == TxModel::SEND)
             {
-                fileName += keychain.hasSigned() ? "+" : "-";
-                fileName += QString::fromStdString(keychain.name());
+                fileName = QString::fromStdString(uchar_vector(tx->hash()).getHex()).left(16);
+                CoinDB::SignatureInfo signatureInfo = m_synchedVault->getVault()->getSignatureInfo(tx->hash());
+                for (auto& keychain: signatureInfo.signingKeychains())
+                {
+                    fileName += keychain.hasSigned() ? "+" : "-";
+                    fileName += QString::fromStdString(keychain.name());
+                }
             }
-        }
-        else
-        {
-            fileName = QString::fromStdString(uchar_vector(tx->hash()).getHex());
-        }
-        fileName += ".tx";        
-        fileName = QFileDialog::getSaveFileName(
-            nullptr,
-            tr("Export Transaction"),
-            getDocDir() + "/" + fileName,
-            tr("Transactions (*.tx)"));
-        if (fileName.isEmpty()) return;
+            else
+            {
+                fileName = QString::fromStdString(uchar_vector(tx->hash()).getHex());
+            }
+            fileName += ".tx";
+            fileName = QFileDialog::getSaveFileName(
+                nullptr,
+                tr("Export Transaction"),
+                getDocDir() + "/" + fileName,
+                tr("Transactions (*.tx)"));
+            if (fileName.isEmpty()) return;
 
-        fileName = QFileInfo(fileName).absoluteFilePath();
+            fileName = QFileInfo(fileName).absoluteFilePath();
 
-        QFileInfo fileInfo(fileName);
-        setDocDir(fileInfo.dir().absolutePath());
+            QFileInfo fileInfo(fileName);
+            setDocDir(fileInfo.dir().absolutePath());
 
-        // TODO: emit settings changed signal
+            // TODO: emit settings changed signal
 
-        m_accountModel->getVault()->exportTx(tx, fileName.toStdString()); 
+            m_accountModel->getVault()->exportTx(tx, fileName.toStdString());
+        });
     }
     catch (const std::exception& e) {
         emit error(e.what());
@@ -366,10 +362,11 @@ void TxActions::importTxsFromFile()
 void TxActions::viewRawTx()
 {
     try {
-        std::shared_ptr<CoinDB::Tx> tx = m_txModel->getTx(currentRow);
-        RawTxDialog rawTxDlg(tr("Raw Transaction"));
-        rawTxDlg.setRawTx(tx->raw());
-        rawTxDlg.exec();
+        withTx([](std::shared_ptr<CoinDB::Tx> tx) {
+            RawTxDialog rawTxDlg(tr("Raw Transaction"));
+            rawTxDlg.setRawTx(tx->raw());
+            rawTxDlg.exec();
+        });
     }
     catch (const std::exception& e) {
         emit error(e.what());
@@ -391,9 +388,10 @@ void TxActions::copyAddressToClipboard()
 void TxActions::copyTxHashToClipboard()
 {
     try {
-        std::shared_ptr<CoinDB::Tx> tx = m_txModel->getTx(currentRow);
-        QClipboard* clipboard = QApplication::clipboard();
-        clipboard->setText(QString::fromStdString(uchar_vector(tx->hash()).getHex()));
+        withTx([](std::shared_ptr<CoinDB::Tx> tx) {
+            QClipboard* clipboard = QApplication::clipboard();
+            clipboard->setText(QString::fromStdString(uchar_vector(tx->hash()).getHex()));
+        });
     }
     catch (const std::exception& e) {
         emit error(e.what());
@@ -403,9 +401,10 @@ void TxActions::copyTxHashToClipboard()
 void TxActions::copyRawTxToClipboard()
 {
     try {
-        std::shared_ptr<CoinDB::Tx> tx = m_txModel->getTx(currentRow);
-        QClipboard* clipboard = QApplication::clipboard();
-        clipboard->setText(QString::fromStdString(uchar_vector(tx->raw()).getHex()));
+        withTx([](std::shared_ptr<CoinDB::Tx> tx) {
+            QClipboard* clipboard = QApplication::clipboard();
+            clipboard->setText(QString::fromStdString(uchar_vector(tx->raw()).getHex()));
+        });
     }
     catch (const std::exception& e) {
         emit error(e.what());
@@ -415,25 +414,26 @@ void TxActions::copyRawTxToClipboard()
 void TxActions::saveRawTxToFile()
 {
     try {
-        std::shared_ptr<CoinDB::Tx> tx = m_txModel->getTx(currentRow);
-        QString fileName = QString::fromStdString(uchar_vector(tx->hash()).getHex()) + ".rawtx";
-        fileName = QFileDialog::getSaveFileName(
-            nullptr,
-            tr("Save Raw Transaction"),
-            getDocDir() + "/" + fileName,
-            tr("Transactions (*.rawtx)"));
-        if (fileName.isEmpty()) return;
+        withTx([this](std::shared_ptr<CoinDB::Tx> tx) {
+            QString fileName = QString::fromStdString(uchar_vector(tx->hash()).getHex()) + ".rawtx";
+            fileName = QFileDialog::getSaveFileName(
+                nullptr,
+                tr("Save Raw Transaction"),
+                getDocDir() + "/" + fileName,
+                tr("Transactions (*.rawtx)"));
+            if (fileName.isEmpty()) return;
 
-        fileName = QFileInfo(fileName).absoluteFilePath();
+            fileName = QFileInfo(fileName).absoluteFilePath();
 
-        QFileInfo fileInfo(fileName);
-        setDocDir(fileInfo.dir().absolutePath());
+            QFileInfo fileInfo(fileName);
+            setDocDir(fileInfo.dir().absolutePath());
 
-        // TODO: emit settings changed signal
+            // TODO: emit settings changed signal
 
-        std::ofstream ofs(fileName.toStdString(), std::ofstream::out);
-        ofs << uchar_vector(tx->raw()).getHex() << std::endl;
-        ofs.close();
+            std::ofstream ofs(fileName.toStdString(), std::ofstream::out);
+            ofs << uchar_vector(tx->raw()).getHex() << std::endl;
+            ofs.close();
+        });
     }
     catch (const std::exception& e) {
         emit error(e.what());
@@ -502,10 +502,11 @@ void TxActions::viewTxOnWeb()
     const QString URL_PREFIX("https://blockchain.info/tx/");
 
     try {
-        std::shared_ptr<CoinDB::Tx> tx = m_txModel->getTx(currentRow);
-        if (!QDesktopServices::openUrl(QUrl(URL_PREFIX + QString::fromStdString(uchar_vector(tx->hash()).getHex())))) {
-            throw std::runtime_error(tr("Unable to open browser.").toStdString());
-        }
+        withTx([URL_PREFIX](std::shared_ptr<CoinDB::Tx> tx) {
+            if (!QDesktopServices::openUrl(QUrl(URL_PREFIX + QString::fromStdString(uchar_vector(tx->hash()).getHex())))) {
+                throw std::runtime_error(tr("Unable to open browser.").toStdString());
+            }
+        });
     }
     catch (const std::exception& e) {
         emit error(e.what());
@@ -522,16 +523,31 @@ void TxActions::deleteTx()
     if (msgBox.exec() == QMessageBox::Cancel) return;
 
     try {
-        m_txModel->deleteTx(currentRow);
-        m_txView->updateColumns();
-        emit txsChanged();
-        //m_accountModel->update();
+        m_txModel->deleteTx(currentRow, [this]() {
+            m_txView->updateColumns();
+            emit txsChanged();
+            //m_accountModel->update();
+        });
     }
     catch (const std::exception& e) {
         emit error(e.what());
     }
 }
 
+void TxActions::withTx(std::function<void(std::shared_ptr<CoinDB::Tx>)> callback)
+{
+    // The tx is loaded on the vault service's worker, so the rest runs once it arrives.
+    m_txModel->getTx(currentRow, [this, callback](std::shared_ptr<CoinDB::Tx> tx) {
+        try {
+            if (!tx) throw std::runtime_error(tr("Transaction not found.").toStdString());
+            callback(tx);
+        }
+        catch (const std::exception& e) {
+            emit error(e.what());
+        }
+    });
+}
+
 void TxActions::createActions()
 {
     searchTxAction = new QAction(QIcon(":/icons/search_32x32.png"), tr("Search For Transaction..."), this);
@@ -15,6 +15,9 @@
 
 #include <QObject>
 
+#include <functional>
+#include <memory>
+
 class QWidget;
 class QAction;
 class QMenu;
@@ -29,6 +32,7 @@ class KeychainModel;
 namespace CoinDB
 {
     class SynchedVault;
+    class Tx;
 }
 
 class TxActions : public QObject
@@ -52,6 +56,7 @@ signals:
 private slots:
     void updateCurrentTx(const QModelIndex& current, const QModelIndex& previous);
     void searchTx();
+    void showFoundTx(int row);
     void showSignatureDialog();
     void signTx();
     void sendTx();
@@ -73,6 +78,8 @@ private slots:
 private:
     QWidget* m_parent;
 
+    void withTx(std::function<void(std::shared_ptr<CoinDB::Tx>)> callback);
+
     void createActions();
     void createMenus();
 
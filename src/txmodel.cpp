@@ -19,7 +19,7 @@
 
 #include <stdutils/stringutils.h>
 
-#include <QStandardItemModel>
+#include <QBrush>
 #include <QDateTime>
 #include <QMessageBox>
 
@@ -27,13 +27,20 @@
 #include "coinparams.h"
 
 #include "severitylogger.h"
+#include "vaultservice.h"
+
+#include <algorithm>
 
 using namespace CoinDB;
 using namespace CoinQ::Script;
 using namespace std;
 
-TxModel::TxModel(QObject* parent)
-    : QStandardItemModel(parent)
+const unsigned int HISTORY_PAGE_SIZE = 1000;
+const std::size_t MAX_CACHED_HISTORY_PAGES = 4;
+const int PENDING_TX_STATUS_FLAGS = Tx::ALL & ~Tx::CONFIRMED;
+
+TxModel::TxModel(VaultService* vaultService, QObject* parent)
+    : QAbstractTableModel(parent), vaultService(vaultService), vault(nullptr), bestHeight(0), confirmedRows(MAX_CACHED_HISTORY_PAGES), accountBalance(0), confirmedBalance(0), generation(0), fetching(false)
 {
     setBase58Versions();
     currencySymbol = getCurrencySymbol();
@@ -41,8 +48,8 @@ TxModel::TxModel(QObject* parent)
     setColumns();
 }
 
-TxModel::TxModel(CoinDB::Vault* vault, const QString& accountName, QObject* parent)
-    : QStandardItemModel(parent)
+TxModel::TxModel(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, QObject* parent)
+    : QAbstractTableModel(parent), vaultService(vaultService), vault(nullptr), bestHeight(0), confirmedRows(MAX_CACHED_HISTORY_PAGES), accountBalance(0), confirmedBalance(0), generation(0), fetching(false)
 {
     setBase58Versions();
     currencySymbol = getCurrencySymbol();
@@ -64,7 +71,7 @@ void TxModel::setBase58Versions()
 
 void TxModel::setColumns()
 {
-    QStringList columns;
+    columns.clear();
     columns
         << tr("Time")
         << tr("Description")
@@ -75,7 +82,7 @@ void TxModel::setColumns()
         << tr("Confirmations")
         << tr("Address")
         << tr("Transaction Hash");
-    setHorizontalHeaderLabels(columns);
+    emit headerDataChanged(Qt::Horizontal, 0, columns.size() - 1);
 }
 
 void TxModel::setVault(CoinDB::Vault* vault)
@@ -90,35 +97,156 @@ void TxModel::setAccount(const QString& accountName)
         throw std::runtime_error("Vault is not open.");
     }
 
-    if (!vault->accountExists(accountName.toStdString())) {
-        throw std::runtime_error("Account not found.");
-    }
-
     this->accountName = accountName;
     update();
 }
 
-class SortableRow
+bool TxModel::rowLessThan(const Row& a, const Row& b)
+{
+    // order by status first (unsigned, then propagated, then confirmed)
+    if (a.status < b.status) return true;
+    if (a.status > b.status) return false;
+
+    // if confirmation counts are equal
+    if (a.height == b.height) {
+        // if one value is positive and the other is negative, sort so that running balance remains positive
+        if (a.netValue < 0 && b.netValue > 0) return true;
+        if (a.netValue > 0 && b.netValue < 0) return false;
+
+        // otherwise sort by ascending tx index
+        return (a.txindex < b.txindex);
+    }
+
+    // otherwise sort by ascending confirmation count - unconfirmed first, then descending height
+    if (a.height == 0) return true;
+    if (b.height == 0) return false;
+    return (a.height > b.height);
+}
+
+TxModel::Row TxModel::createRow(const TxOutView& view, bytes_t& last_txhash)
+{
+    Row row;
+    row.timestamp = view.tx_timestamp;
+    row.label = view.role_label();
+    row.value = view.value;
+    row.fee = 0;
+    row.feeDisplay = NO_FEE;
+    row.netValue = 0;
+    row.balance = 0;
+    row.status = view.tx_status;
+    row.height = (view.tx_status >= Tx::PROPAGATED) ? view.height : 0;
+    row.script = view.script;
+    row.txhash = view.tx_status == Tx::UNSIGNED ? view.tx_unsigned_hash : view.tx_hash;
+    row.unsignedHash = view.tx_unsigned_hash;
+    row.txindex = view.tx_index;
+
+    switch (view.role_flags) {
+    case TxOut::ROLE_NONE:
+        row.type = NONE;
+        break;
+
+    case TxOut::ROLE_SENDER:
+        row.type = SEND;
+        row.netValue -= view.value;
+        if (view.tx_has_all_outpoints && view.tx_fee() > 0) {
+            if (row.txhash != last_txhash) {
+                row.fee = view.tx_fee();
+                row.feeDisplay = FEE;
+                row.netValue -= view.tx_fee();
+                last_txhash = row.txhash;
+            }
+            else {
+                row.feeDisplay = SAME_TX_FEE;
+            }
+        }
+        break;
+
+    case TxOut::ROLE_RECEIVER:
+        row.type = RECEIVE;
+        row.netValue += view.value;
+        break;
+
+    default:
+        row.type = UNKNOWN;
+    }
+
+    return row;
+}
+
+std::vector<TxOutView> TxModel::getTxOutViews(std::shared_ptr<Tx> tx) const
 {
-public:
-    SortableRow(const QList<QStandardItem*>& row, int status, uint32_t nConfirmations, int64_t value, uint32_t txindex) :
-        row_(row), status_(status), nConfirmations_(nConfirmations), value_(value), txindex_(txindex) { }
+    // Build the same views the vault query would return for this tx.
+    std::string account_name = accountName.toStdString();
+    std::vector<TxOutView> views;
+    for (auto& txout: tx->txouts())
+    {
+        std::shared_ptr<Account> sending_account = txout->sending_account();
+        std::shared_ptr<Account> receiving_account = txout->receiving_account();
+        std::shared_ptr<AccountBin> account_bin = txout->account_bin();
+        if (account_bin && account_bin->name() == CHANGE_BIN_NAME) continue;
+
+        TxOutView view;
+        view.sending_account_id = sending_account ? sending_account->id() : 0;
+        view.sending_account_name = sending_account ? sending_account->name() : std::string();
+        view.sending_label = txout->sending_label();
+        view.receiving_account_id = receiving_account ? receiving_account->id() : 0;
+        view.receiving_account_name = receiving_account ? receiving_account->name() : std::string();
+        view.receiving_label = txout->receiving_label();
+        view.account_bin_name = account_bin ? account_bin->name() : std::string();
+        view.script = txout->script();
+        view.value = txout->value();
+        view.tx_index = txout->txindex();
+        view.tx_hash = tx->signed_hash();
+        view.tx_unsigned_hash = tx->unsigned_hash();
+        view.tx_timestamp = tx->timestamp();
+        view.tx_status = tx->status();
+        view.tx_has_all_outpoints = tx->have_all_outpoints();
+        view.tx_txin_total = tx->txin_total();
+        view.tx_txout_total = tx->txout_total();
+        view.height = tx->blockheader() ? tx->blockheader()->height() : 0;
+        view.blockheader_id = tx->blockheader() ? tx->blockheader()->id() : 0;
+        view.updateRole(TxOut::ROLE_BOTH);
+
+        std::vector<TxOutView> split_views = view.getSplitRoles(TxOut::ROLE_RECEIVER, account_name);
+        views.insert(views.end(), split_views.begin(), split_views.end());
+    }
+    return views;
+}
 
-    QList<QStandardItem*>& row() { return row_; }
+std::vector<TxModel::Row> TxModel::loadPage(Vault* vault, const std::string& accountName, PageCursor& cursor, bool& atEnd, unsigned int count)
+{
+    std::vector<Row> rows;
+    unsigned int n = vault->getTxOutViews(cursor.history, [&](const TxOutView& view) {
+        rows.push_back(createRow(view, cursor.feeTxHash));
+        return true;
+    }, accountName, "", TxOut::ROLE_BOTH, TxOut::BOTH, Tx::CONFIRMED, true, count);
+
+    // Running balances are carried down from the account balance so any page can be loaded on its own.
+    for (auto& row: rows)
+    {
+        row.balance = cursor.balance;
+        cursor.balance -= row.netValue;
+    }
 
-    int status() const { return status_; }
-    uint32_t nConfirmations() const { return nConfirmations_; }
-    int64_t value() const { return value_; }
-    uint32_t txindex() const { return txindex_; }
+    atEnd = n < count;
+    return rows;
+}
+
+int64_t TxModel::updatePendingBalances(std::vector<Row>& rows, int64_t accountBalance)
+{
+    int64_t pendingTotal = 0;
+    for (auto& row: rows) { pendingTotal += row.netValue; }
 
-private:
-    QList<QStandardItem*> row_;
+    // iterate in reverse order to compute running balance
+    int64_t balance = accountBalance - pendingTotal;
+    for (auto it = rows.rbegin(); it != rows.rend(); ++it)
+    {
+        balance += it->netValue;
+        it->balance = balance;
+    }
 
-    int status_;
-    uint32_t nConfirmations_;
-    int64_t value_;
-    uint32_t txindex_;
-};
+    return accountBalance - pendingTotal;
+}
 
 void TxModel::update()
 {
@@ -131,226 +259,524 @@ void TxModel::update()
         setColumns();
     }
 
-    removeRows(0, rowCount());
+    uint64_t requestGeneration = ++generation;
+    fetching = false;
+    loadingPages.clear();
 
-    if (!vault || accountName.isEmpty()) return;
+    if (!vault || accountName.isEmpty())
+    {
+        beginResetModel();
+        pendingRows.clear();
+        confirmedRows.clear();
+        endResetModel();
+        emit updated();
+        return;
+    }
 
-    std::shared_ptr<BlockHeader> bestHeader = vault->getBestBlockHeader();
+    // The current rows stay up until the new ones arrive.
+    std::string account_name = accountName.toStdString();
+    vaultService->post<Snapshot>(this, [account_name](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+        if (!vault->accountExists(account_name)) throw std::runtime_error("Account not found.");
+
+        Snapshot snapshot;
+        snapshot.bestHeight = vault->getBestHeight();
+
+        bytes_t last_txhash;
+        HistoryCursor cursor;
+        vault->getTxOutViews(cursor, [&](const TxOutView& view) {
+            snapshot.pendingRows.push_back(createRow(view, last_txhash));
+            return true;
+        }, account_name, "", TxOut::ROLE_BOTH, TxOut::BOTH, PENDING_TX_STATUS_FLAGS, true);
+        std::stable_sort(snapshot.pendingRows.begin(), snapshot.pendingRows.end(), rowLessThan);
+
+        snapshot.accountBalance = vault->getAccountBalance(account_name, 0);
+        snapshot.firstPage.next.balance = updatePendingBalances(snapshot.pendingRows, snapshot.accountBalance);
+        snapshot.firstPage.rows = loadPage(vault, account_name, snapshot.firstPage.next, snapshot.firstPage.atEnd, HISTORY_PAGE_SIZE);
+        snapshot.firstPage.rowCount = snapshot.firstPage.rows.size();
+        return snapshot;
+    }, [this, requestGeneration](Snapshot& snapshot) {
+        if (requestGeneration != generation) return;
+
+        beginResetModel();
+        bestHeight = snapshot.bestHeight;
+        accountBalance = snapshot.accountBalance;
+        pendingRows.swap(snapshot.pendingRows);
+        confirmedBalance = updatePendingBalances(pendingRows, accountBalance);
+
+        PageCursor start;
+        start.balance = confirmedBalance;
+        confirmedRows.reset(start);
+        confirmedRows.appendPage(std::move(snapshot.firstPage.rows), snapshot.firstPage.next, snapshot.firstPage.atEnd);
+        endResetModel();
+
+        emit updated();
+    }, [this](const QString& message) {
+        emit error(message);
+    });
+}
 
-    std::vector<TxOutView> txoutviews = vault->getTxOutViews(accountName.toStdString(), "", TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, true);
-    bytes_t last_txhash;
-    QList<SortableRow> rows;
-    for (auto& item: txoutviews) {
-        QList<QStandardItem*> row;
-
-        QDateTime utc;
-        utc.setTime_t(item.tx_timestamp);
-        QString time = utc.toLocalTime().toString();
-
-        QString description = QString::fromStdString(item.role_label());
-
-        // The type stuff is just to test the new db schema. It's all wrong, we're not going to use TxOutViews for this.
-        TxType txType;
-        QString type;
-        QString amount;
-        QString fee;
-        int64_t value = 0;
-        bytes_t this_txhash = item.tx_status == Tx::UNSIGNED ? item.tx_unsigned_hash : item.tx_hash;
-        switch (item.role_flags) {
-        case TxOut::ROLE_NONE:
-            txType = NONE;
-            type = tr("None");
-            break;
-
-        case TxOut::ROLE_SENDER:
-            txType = SEND;
-            type = tr("Send");
-            amount = "-";
-            value -= item.value;
-            if (item.tx_has_all_outpoints && item.tx_fee() > 0) {
-                if (this_txhash != last_txhash) {
-                    fee = "-";
-                    //fee += QString::number(item.tx_fee()/(1.0 * currency_divisor), 'g', 8);
-                    fee += getFormattedCurrencyAmount(item.tx_fee());
-                    value -= item.tx_fee();
-                    last_txhash = this_txhash;
-                }
-                else {
-                    fee = "||";
-                }
-            }
-            break;
+bool TxModel::removePendingRows(const bytes_t& unsigned_hash)
+{
+    bool removed = false;
+    for (int i = pendingRows.size() - 1; i >= 0; i--)
+    {
+        if (pendingRows[i].unsignedHash != unsigned_hash) continue;
 
-        case TxOut::ROLE_RECEIVER:
-            txType = RECEIVE;
-            type = tr("Receive");
-            amount = "+";
-            value += item.value;
-            break;
+        beginRemoveRows(QModelIndex(), i, i);
+        pendingRows.erase(pendingRows.begin() + i);
+        endRemoveRows();
+        removed = true;
+    }
+    return removed;
+}
 
-        default:
-            txType = UNKNOWN;
-            type = tr("Unknown");
+void TxModel::setBestHeight(uint32_t bestHeight)
+{
+    if (this->bestHeight == bestHeight) return;
+    this->bestHeight = bestHeight;
+
+    // Confirmation counts are derived from the best height in data() - just repaint them.
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+    }
+}
+
+void TxModel::updateTx(std::shared_ptr<Tx> tx)
+{
+    if (!vault || accountName.isEmpty() || !tx) return;
+
+    bool wasPending = removePendingRows(tx->unsigned_hash());
+    std::vector<TxOutView> views = getTxOutViews(tx);
+    if (views.empty() && !wasPending) return;
+
+    bytes_t last_txhash;
+    if (tx->status() == Tx::CONFIRMED)
+    {
+        // History is newest first, so rows are built the same way - the fee goes on the first one.
+        std::vector<Row> rows;
+        for (auto it = views.rbegin(); it != views.rend(); ++it) { rows.push_back(createRow(*it, last_txhash)); }
+        if (!insertConfirmedRows(rows))
+        {
+            update();
+            return;
         }
 
-        //amount += QString::number(item.value/(1.0 * currency_divisor), 'g', 8);
-        amount += getFormattedCurrencyAmount(item.value);
+        updateBalances();
+        return;
+    }
 
-        uint32_t nConfirmations = 0;
-        QString confirmations;
-        if (item.tx_status >= Tx::PROPAGATED) {
-            if (bestHeader && item.height) {
-                nConfirmations = bestHeader->height() + 1 - item.height;
-                confirmations = QString::number(nConfirmations);
-            }
-            else {
-                confirmations = "0";
+    for (auto& view: views)
+    {
+        Row row = createRow(view, last_txhash);
+        int pos = std::upper_bound(pendingRows.begin(), pendingRows.end(), row, rowLessThan) - pendingRows.begin();
+        beginInsertRows(QModelIndex(), pos, pos);
+        pendingRows.insert(pendingRows.begin() + pos, row);
+        endInsertRows();
+    }
+
+    updateBalances();
+}
+
+bool TxModel::insertConfirmedRows(std::vector<Row>& rows)
+{
+    if (rows.empty()) return true;
+
+    // Newly confirmed txs nearly always belong in the first page of history. Anything else - a
+    // reorg, a first page that is not in memory - needs the history rebuilt.
+    std::vector<Row>* firstPage = nullptr;
+    if (confirmedRows.pageCount() > 0)
+    {
+        firstPage = confirmedRows.cachedPage(0);
+        if (!firstPage) return false;
+    }
+    else if (confirmedRows.canFetchMore())
+    {
+        return false;
+    }
+
+    uint32_t height = rows.front().height;
+    const bytes_t& unsignedHash = rows.front().unsignedHash;
+    int pos = 0;
+    if (firstPage)
+    {
+        // Already there - the tx was updated again after it confirmed. Refresh its rows in place.
+        auto it = std::find_if(firstPage->begin(), firstPage->end(), [&](const Row& row) { return row.unsignedHash == unsignedHash; });
+        if (it != firstPage->end())
+        {
+            int first = it - firstPage->begin();
+            if (first + rows.size() > firstPage->size()) return false;
+            for (std::size_t i = 0; i < rows.size(); i++)
+            {
+                Row& row = (*firstPage)[first + i];
+                if (row.unsignedHash != unsignedHash || row.height != height || row.netValue != rows[i].netValue) return false;
+                rows[i].balance = row.balance;
+                row = rows[i];
             }
+            int offset = pendingRows.size() + first;
+            emit dataChanged(index(offset, 0), index(offset + rows.size() - 1, columnCount() - 1));
+            return true;
         }
-        else if (item.tx_status == Tx::UNSIGNED) {
-            confirmations = tr("Unsigned");
-        }
-        else if (item.tx_status == Tx::UNSENT) {
-            confirmations = tr("Unsent");
-        }
-        QStandardItem* confirmationsItem = new QStandardItem(confirmations);
-        confirmationsItem->setData(item.tx_status, Qt::UserRole);
-        confirmationsItem->setData((int)nConfirmations, Qt::UserRole + 1);
 
-        QString address = QString::fromStdString(getAddressForTxOutScript(item.script, base58_versions));
-        QString hash = QString::fromStdString(uchar_vector(this_txhash).getHex());
+        while (pos < (int)firstPage->size() && (*firstPage)[pos].height > height) { pos++; }
+        if (pos == (int)firstPage->size() && confirmedRows.pageCount() > 1) return false;
+    }
+
+    // Balances above the new rows go up by what they add. Those below are unchanged.
+    int64_t netValue = 0;
+    for (auto& row: rows) { netValue += row.netValue; }
+
+    int64_t balance = firstPage && pos > 0 ? (*firstPage)[pos - 1].balance - (*firstPage)[pos - 1].netValue + netValue : confirmedBalance + netValue;
+    for (auto& row: rows)
+    {
+        row.balance = balance;
+        balance -= row.netValue;
+    }
+
+    if (firstPage)
+    {
+        for (int i = 0; i < pos; i++) { (*firstPage)[i].balance += netValue; }
+    }
 
-        row.append(new QStandardItem(time));
-        row.append(new QStandardItem(description));
+    confirmedBalance += netValue;
+    PageCursor start;
+    start.balance = confirmedBalance;
 
-        QStandardItem* typeItem = new QStandardItem(type);
-        typeItem->setData(txType, Qt::UserRole);
-        row.append(typeItem);
+    int offset = pendingRows.size();
+    auto beginInsert = [&](int first, int count) { beginInsertRows(QModelIndex(), offset + first, offset + first + count - 1); };
+    if (firstPage)
+    {
+        confirmedRows.setPageStart(0, start);
+        confirmedRows.insertRows(0, pos, std::move(rows), beginInsert);
+    }
+    else
+    {
+        confirmedRows.setNextCursor(start);
+        confirmedRows.appendPage(std::move(rows), start, true, beginInsert);
+    }
+    endInsertRows();
 
-        row.append(new QStandardItem(amount));
-        row.append(new QStandardItem(fee));
-        row.append(new QStandardItem("")); // placeholder for balance, once sorted
-        row.append(confirmationsItem);
-        row.append(new QStandardItem(address));
+    if (pos > 0) { emit dataChanged(index(offset, 5), index(offset + pos - 1, 5)); }
+    return true;
+}
 
-        // Store the tx hash and tx index to uniquely identify the output.
-        QStandardItem* hashItem = new QStandardItem(hash);
-        hashItem->setData(item.tx_index, Qt::UserRole);
-        row.append(hashItem);
+bool TxModel::removeConfirmedRows(const bytes_t& unsigned_hash)
+{
+    // The rows can only be found in pages that are in memory.
+    std::size_t page = 0;
+    std::vector<Row>* rows = nullptr;
+    int pos = -1;
+    for (; page < confirmedRows.pageCount() && pos == -1; page++)
+    {
+        rows = confirmedRows.cachedPage(page);
+        if (!rows) continue;
+
+        auto it = std::find_if(rows->begin(), rows->end(), [&](const Row& row) { return row.unsignedHash == unsigned_hash; });
+        if (it != rows->end()) pos = it - rows->begin();
+    }
+    if (pos == -1) return false;
+    page--;
 
-        rows.append(SortableRow(row, item.tx_status, nConfirmations, value, item.tx_index));
+    int count = 0;
+    int64_t netValue = 0;
+    while (pos + count < (int)rows->size() && (*rows)[pos + count].unsignedHash == unsigned_hash) { netValue += (*rows)[pos + count++].netValue; }
+
+    // Every balance above the removed rows goes down by what they added, including the starting
+    // balances of earlier pages, so those still reload correctly.
+    for (std::size_t i = 0; i < page; i++)
+    {
+        PageCursor start = confirmedRows.pageStart(i);
+        start.balance -= netValue;
+        confirmedRows.setPageStart(i, start);
+
+        std::vector<Row>* earlier = confirmedRows.cachedPage(i);
+        if (earlier) { for (auto& row: *earlier) { row.balance -= netValue; } }
     }
+    for (int i = 0; i < pos; i++) { (*rows)[i].balance -= netValue; }
 
-    qSort(rows.begin(), rows.end(), [](const SortableRow& a, const SortableRow& b) {
-        // order by status first (unsigned, then propagated, then confirmed)
-        if (a.status() < b.status()) return true;
-        if (a.status() > b.status()) return false;
+    PageCursor start = confirmedRows.pageStart(page);
+    start.balance -= netValue;
+    confirmedRows.setPageStart(page, start);
+    confirmedBalance -= netValue;
 
-        // if confirmation counts are equal
-        if (a.nConfirmations() == b.nConfirmations()) {
-            // if one value is positive and the other is negative, sort so that running balance remains positive
-            if (a.value() < 0 && b.value() > 0) return true;
-            if (a.value() > 0 && b.value() < 0) return false;
+    int offset = pendingRows.size();
+    int first = offset + confirmedRows.pageFirstRow(page) + pos;
+    confirmedRows.removeRows(page, pos, count, [&](int f, int n) { beginRemoveRows(QModelIndex(), offset + f, offset + f + n - 1); });
+    endRemoveRows();
 
-            // otherwise sort by ascending tx index
-            return (a.txindex() < b.txindex());
+    if (first > offset) { emit dataChanged(index(offset, 5), index(first - 1, 5)); }
+    return true;
+}
+
+void TxModel::removeTx(std::shared_ptr<Tx> tx)
+{
+    if (!vault || accountName.isEmpty() || !tx) return;
+
+    if (!removePendingRows(tx->unsigned_hash()))
+    {
+        if (tx->status() != Tx::CONFIRMED) return;
+
+        if (!removeConfirmedRows(tx->unsigned_hash()))
+        {
+            // Not in memory - there is no telling which rows are its without reloading.
+            if (!getTxOutViews(tx).empty()) update();
+            return;
         }
+    }
 
-        // otherwise sort by ascending confirmation count
-        return (a.nConfirmations() < b.nConfirmations());
+    updateBalances();
+}
+
+void TxModel::updateBalances()
+{
+    // Pending txs do not change the confirmed history, so its balances only move if something else did.
+    uint64_t requestGeneration = generation;
+    std::string account_name = accountName.toStdString();
+    vaultService->post<int64_t>(this, [account_name](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+        return (int64_t)vault->getAccountBalance(account_name, 0);
+    }, [this, requestGeneration](int64_t& balance) {
+        if (requestGeneration != generation) return;
+
+        accountBalance = balance;
+        if (updatePendingBalances(pendingRows, accountBalance) != confirmedBalance)
+        {
+            update();
+            return;
+        }
+
+        if (!pendingRows.empty()) {
+            emit dataChanged(index(0, 5), index(pendingRows.size() - 1, 5));
+        }
+    }, [this](const QString& message) {
+        emit error(message);
     });
+}
 
-    // iterate in reverse order to compute running balance
-    int64_t balance = 0;
-    for (int i = rows.size() - 1; i >= 0; i--) {
-        balance += rows[i].value();
-        (rows[i].row())[5]->setText(getFormattedCurrencyAmount(balance));
-    }
+const TxModel::Row* TxModel::findRow(int row) const
+{
+    if (row < 0 || row >= rowCount()) return nullptr;
 
-    // iterate in forward order to display
-    for (auto& row: rows) appendRow(row.row());
+    if (row < (int)pendingRows.size()) return &pendingRows[row];
+    return confirmedRows.row(row - pendingRows.size());
 }
 
-bytes_t TxModel::getTxHash(int row) const
+const TxModel::Row& TxModel::getRow(int row) const
 {
-    if (row == -1 || row >= rowCount()) throw std::runtime_error(tr("Invalid row.").toStdString());
+    if (row < 0 || row >= rowCount()) throw std::runtime_error(tr("Invalid row.").toStdString());
 
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
-    return txhash;
+    const Row* r = findRow(row);
+    if (!r)
+    {
+        requestPage(confirmedRows.pageIndex(row - pendingRows.size()));
+        throw std::runtime_error(tr("Transaction is still loading.").toStdString());
+    }
+    return *r;
 }
 
-int TxModel::getTxStatus(int row) const
+bytes_t TxModel::getTxHash(int row) const
 {
-    if (row == -1 || row >= rowCount()) throw std::runtime_error(tr("Invalid row.").toStdString());
+    return getRow(row).txhash;
+}
 
-    QStandardItem* confirmationsItem = item(row, 6);
-    return confirmationsItem->data(Qt::UserRole).toInt();
+int TxModel::getTxStatus(int row) const
+{
+    return getRow(row).status;
 }
 
 int TxModel::getTxConfirmations(int row) const
 {
-    if (row == -1 || row >= rowCount()) throw std::runtime_error(tr("Invalid row.").toStdString());
+    return getConfirmations(getRow(row));
+}
 
-    QStandardItem* confirmationsItem = item(row, 6);
-    return confirmationsItem->data(Qt::UserRole + 1).toInt();
+int TxModel::getConfirmations(const Row& row) const
+{
+    return (row.height && bestHeight >= row.height) ? (int)(bestHeight + 1 - row.height) : 0;
 }
 
 int TxModel::getTxOutType(int row) const
 {
-    if (row == -1 || row >= rowCount()) throw std::runtime_error(tr("Invalid row.").toStdString());
-
-    QStandardItem* typeItem = item(row, 2);
-    return typeItem->data(Qt::UserRole).toInt();
+    return getRow(row).type;
 }
 
 QString TxModel::getTxOutAddress(int row) const
 {
-    if (row == -1 || row >= rowCount()) throw std::runtime_error(tr("Invalid row.").toStdString());
-
-    QStandardItem* typeItem = item(row, 7);
-    return typeItem->text();
+    return QString::fromStdString(getAddressForTxOutScript(getRow(row).script, base58_versions));
 }
 
-void TxModel::signTx(int row)
+void TxModel::findTxRow(const QString& hashPrefix)
 {
-    LOGGER(trace) << "TxModel::signTx(" << row << ")" << std::endl;
+    std::string prefix = hashPrefix.toLower().toStdString();
+    auto matches = [prefix](const Row& row) { return uchar_vector(row.txhash).getHex().compare(0, prefix.size(), prefix) == 0; };
 
-    if (row == -1 || row >= rowCount()) {
-        throw std::runtime_error(tr("Invalid row.").toStdString());
+    for (std::size_t i = 0; i < pendingRows.size(); i++)
+    {
+        if (matches(pendingRows[i]))
+        {
+            emit txFound(i);
+            return;
+        }
     }
 
-    QStandardItem* typeItem = item(row, 6);
-    int type = typeItem->data(Qt::UserRole).toInt();
-    if (type != CoinDB::Tx::UNSIGNED) {
-        throw std::runtime_error(tr("Transaction is already signed.").toStdString());
+    if (!vault || accountName.isEmpty())
+    {
+        emit txFound(-1);
+        return;
     }
 
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
+    // Walk the confirmed history on the vault thread. Pages already indexed are reloaded from their own
+    // starts and sizes, which confirmations may have changed, and the rest is walked with the same paging
+    // as fetchMore() so that it can be indexed here without being loaded twice.
+    uint64_t requestGeneration = generation;
+    std::vector<Page> knownPages(confirmedRows.pageCount());
+    for (std::size_t i = 0; i < knownPages.size(); i++)
+    {
+        knownPages[i].firstRow = confirmedRows.pageFirstRow(i);
+        knownPages[i].rowCount = confirmedRows.pageRowCount(i);
+        knownPages[i].next = confirmedRows.pageStart(i);
+    }
+    bool canFetchMore = confirmedRows.canFetchMore();
+    PageCursor next = confirmedRows.nextCursor();
+    int fetchedRows = confirmedRows.rowCount();
+    std::string account_name = accountName.toStdString();
+    vaultService->post<SearchResult>(this, [=](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+
+        SearchResult result;
+        result.row = -1;
+        result.knownPage = -1;
+
+        for (std::size_t i = 0; i < knownPages.size(); i++)
+        {
+            Page page = knownPages[i];
+            bool atEnd;
+            page.rows = loadPage(vault, account_name, page.next, atEnd, page.rowCount);
+            for (int j = 0; j < (int)page.rows.size(); j++)
+            {
+                if (matches(page.rows[j]))
+                {
+                    result.row = page.firstRow + j;
+                    result.knownPage = i;
+                    result.pages.push_back(std::move(page));
+                    return result;
+                }
+            }
+        }
+
+        PageCursor cursor = next;
+        int firstRow = fetchedRows;
+        bool atEnd = !canFetchMore;
+        while (!atEnd)
+        {
+            Page page;
+            page.firstRow = firstRow;
+            page.rows = loadPage(vault, account_name, cursor, atEnd, HISTORY_PAGE_SIZE);
+            page.rowCount = page.rows.size();
+            page.next = cursor;
+            page.atEnd = atEnd;
+            firstRow += page.rowCount;
+
+            for (int j = 0; j < page.rowCount; j++)
+            {
+                if (matches(page.rows[j]))
+                {
+                    result.row = page.firstRow + j;
+                    break;
+                }
+            }
 
-    std::vector<std::string> keychainNames;
-    std::shared_ptr<Tx> tx = vault->signTx(txhash, keychainNames, true);
-    if (!tx) throw std::runtime_error(tr("No new signatures were added.").toStdString());
+            if (result.row == -1) page.rows.clear();
+            result.pages.push_back(std::move(page));
+            if (result.row != -1) break;
+        }
+        return result;
+    }, [this, requestGeneration](SearchResult& result) {
+        if (requestGeneration != generation) return;
 
-    LOGGER(trace) << "TxModel::signTx - signature(s) added. raw tx: " << uchar_vector(tx->raw()).getHex() << std::endl;
-    update();
+        if (result.knownPage != -1)
+        {
+            // Put the page back unless it has changed since.
+            Page& page = result.pages.front();
+            std::size_t index = result.knownPage;
+            if (index < confirmedRows.pageCount() && confirmedRows.pageFirstRow(index) == page.firstRow && confirmedRows.pageRowCount(index) == page.rowCount)
+            {
+                if (!confirmedRows.row(page.firstRow)) { confirmedRows.restorePage(index, std::move(page.rows)); }
+                emit txFound(pendingRows.size() + result.row);
+            }
+            else
+            {
+                emit txFound(-1);
+            }
+            return;
+        }
 
-    QString msg;
-    if (keychainNames.empty())
-    {
-        msg = tr("No new signatures were added.");
-    }
-    else
-    {
-        msg = tr("Signatures added using keychain(s) ") + QString::fromStdString(stdutils::delimited_list(keychainNames, ", ")) + tr(".");
+        for (auto& page: result.pages)
+        {
+            // Pages fetched in the meantime are already there.
+            if (page.firstRow < confirmedRows.rowCount()) continue;
+            if (page.firstRow > confirmedRows.rowCount() || !confirmedRows.canFetchMore()) break;
+            appendPage(page);
+        }
+
+        int row = result.row;
+        if (row != -1 && row < confirmedRows.rowCount())
+        {
+            // The matching page might have been indexed without its rows.
+            std::size_t index = confirmedRows.pageIndex(row);
+            if (!confirmedRows.row(row) && !result.pages.empty() && !result.pages.back().rows.empty()) {
+                confirmedRows.restorePage(index, std::move(result.pages.back().rows));
+            }
+            emit txFound(pendingRows.size() + row);
+        }
+        else
+        {
+            emit txFound(-1);
+        }
+    }, [this](const QString& message) {
+        emit error(message);
+        emit txFound(-1);
+    });
+}
+
+void TxModel::signTx(int row, std::function<void()> callback)
+{
+    LOGGER(trace) << "TxModel::signTx(" << row << ")" << std::endl;
+
+    if (getTxStatus(row) != CoinDB::Tx::UNSIGNED) {
+        throw std::runtime_error(tr("Transaction is already signed.").toStdString());
     }
-    emit txSigned(msg);
+
+    typedef std::vector<std::string> keychain_names_t;
+    bytes_t txhash = getTxHash(row);
+    vaultService->post<keychain_names_t>(this, [txhash](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+
+        keychain_names_t keychainNames;
+        std::shared_ptr<Tx> tx = vault->signTx(txhash, keychainNames, true);
+        if (!tx) throw std::runtime_error(tr("No new signatures were added.").toStdString());
+
+        LOGGER(trace) << "TxModel::signTx - signature(s) added. raw tx: " << uchar_vector(tx->raw()).getHex() << std::endl;
+        return keychainNames;
+    }, [this, callback](keychain_names_t& keychainNames) {
+        update();
+
+        QString msg;
+        if (keychainNames.empty())
+        {
+            msg = tr("No new signatures were added.");
+        }
+        else
+        {
+            msg = tr("Signatures added using keychain(s) ") + QString::fromStdString(stdutils::delimited_list(keychainNames, ", ")) + tr(".");
+        }
+        emit txSigned(msg);
+        if (callback) callback();
+    }, [this](const QString& message) {
+        emit error(message);
+    });
 }
 
-void TxModel::sendTx(int row, CoinDB::SynchedVault* synchedVault)
+void TxModel::sendTx(int row, CoinDB::SynchedVault* synchedVault, std::function<void()> callback)
 {
     if (row == -1 || row >= rowCount()) {
         throw std::runtime_error(tr("Invalid row.").toStdString());
@@ -360,8 +786,7 @@ void TxModel::sendTx(int row, CoinDB::SynchedVault* synchedVault)
         throw std::runtime_error(tr("Must be connected to network to send.").toStdString());
     }
 
-    QStandardItem* typeItem = item(row, 6);
-    int type = typeItem->data(Qt::UserRole).toInt();
+    int type = getTxStatus(row);
     if (type == CoinDB::Tx::UNSIGNED) {
         throw std::runtime_error(tr("Transaction must be fully signed before sending.").toStdString());
     }
@@ -369,64 +794,241 @@ void TxModel::sendTx(int row, CoinDB::SynchedVault* synchedVault)
         throw std::runtime_error(tr("Transaction already sent.").toStdString());
     }
 
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
+    bytes_t txhash = getTxHash(row);
+    vaultService->post<bytes_t>(this, [txhash](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+        return vault->getTxRawView(txhash).tx_raw();
+    }, [this, synchedVault, callback](bytes_t& raw) {
+        try
+        {
+            Coin::Transaction coin_tx(raw);
+            synchedVault->sendTx(coin_tx);
+        }
+        catch (const std::exception& e)
+        {
+            emit error(e.what());
+            return;
+        }
+
+        // TODO: Check transaction has propagated before changing status to PROPAGATED
+        if (callback) callback();
+    }, [this](const QString& message) {
+        emit error(message);
+    });
+}
 
-    std::shared_ptr<CoinDB::Tx> tx = vault->getTx(txhash);
-    Coin::Transaction coin_tx = tx->toCoinCore();
-    synchedVault->sendTx(coin_tx);
+void TxModel::getTx(int row, std::function<void(std::shared_ptr<CoinDB::Tx>)> callback)
+{
+    bytes_t txhash = getTxHash(row);
+    vaultService->post<std::shared_ptr<Tx>>(this, [txhash](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+        return vault->getTx(txhash);
+    }, [callback](std::shared_ptr<Tx>& tx) {
+        callback(tx);
+    }, [this](const QString& message) {
+        emit error(message);
+    });
+}
 
-    // TODO: Check transaction has propagated before changing status to PROPAGATED
-//    tx->updateStatus(CoinDB::Tx::PROPAGATED);
-//    vault->insertTx(tx);
+void TxModel::deleteTx(int row, std::function<void()> callback)
+{
+    bytes_t txhash = getTxHash(row);
+    vaultService->post<bool>(this, [txhash](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+        vault->deleteTx(txhash);
+        return true;
+    }, [this, callback](bool&) {
+        update();
+
+        emit txDeleted();
+        if (callback) callback();
+    }, [this](const QString& message) {
+        emit error(message);
+        update();
+    });
+}
 
-//    update();
-    //networkSync->getTx(txhash);
+int TxModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return pendingRows.size() + confirmedRows.rowCount();
 }
 
-std::shared_ptr<Tx> TxModel::getTx(int row)
+int TxModel::columnCount(const QModelIndex& parent) const
 {
-    if (row == -1 || row >= rowCount()) {
-        throw std::runtime_error(tr("Invalid row.").toStdString());
-    }
+    if (parent.isValid()) return 0;
+    return columns.size();
+}
 
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
+bool TxModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return false;
+    return confirmedRows.canFetchMore();
+}
 
-    return vault->getTx(txhash);
+void TxModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.isValid() || !confirmedRows.canFetchMore() || fetching) return;
+
+    fetching = true;
+    uint64_t requestGeneration = generation;
+    std::string account_name = accountName.toStdString();
+    Page request;
+    request.firstRow = confirmedRows.rowCount();
+    request.next = confirmedRows.nextCursor();
+    vaultService->post<Page>(this, [account_name, request](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+
+        Page page = request;
+        page.rows = loadPage(vault, account_name, page.next, page.atEnd, HISTORY_PAGE_SIZE);
+        page.rowCount = page.rows.size();
+        return page;
+    }, [this, requestGeneration](Page& page) {
+        if (requestGeneration != generation) return;
+
+        fetching = false;
+        if (page.firstRow == confirmedRows.rowCount() && confirmedRows.canFetchMore()) appendPage(page);
+    }, [this, requestGeneration](const QString& message) {
+        if (requestGeneration == generation) fetching = false;
+        emit error(message);
+    });
 }
 
-void TxModel::deleteTx(int row)
+void TxModel::appendPage(Page& page)
 {
-    if (row == -1 || row >= rowCount()) {
-        throw std::runtime_error(tr("Invalid row.").toStdString());
-    }
+    int offset = pendingRows.size();
+    auto beginInsert = [&](int first, int count) { beginInsertRows(QModelIndex(), offset + first, offset + first + count - 1); };
 
-    QStandardItem* txHashItem = item(row, 8);
-    uchar_vector txhash;
-    txhash.setHex(txHashItem->text().toStdString());
+    int count = page.rows.empty() ?
+        confirmedRows.indexPage(page.rowCount, page.next, page.atEnd, beginInsert) :
+        confirmedRows.appendPage(std::move(page.rows), page.next, page.atEnd, beginInsert);
+    if (count > 0) endInsertRows();
+}
 
-    vault->deleteTx(txhash);
-    update();
+void TxModel::requestPage(std::size_t page) const
+{
+    if (!loadingPages.insert(page).second) return;
+
+    TxModel* model = const_cast<TxModel*>(this);
+    uint64_t requestGeneration = generation;
+    std::string account_name = accountName.toStdString();
+    PageCursor start = confirmedRows.pageStart(page);
+    unsigned int count = confirmedRows.pageRowCount(page); // pages can grow past HISTORY_PAGE_SIZE as txs confirm
+    vaultService->post<std::vector<Row>>(model, [account_name, start, count](Vault* vault) {
+        if (!vault) throw std::runtime_error("Vault is not open.");
+
+        PageCursor cursor = start;
+        bool atEnd;
+        return loadPage(vault, account_name, cursor, atEnd, count);
+    }, [model, requestGeneration, page](std::vector<Row>& rows) {
+        if (requestGeneration != model->generation) return;
+
+        model->loadingPages.erase(page);
+        model->confirmedRows.restorePage(page, std::move(rows));
+
+        int first = model->pendingRows.size() + model->confirmedRows.pageFirstRow(page);
+        int last = first + model->confirmedRows.pageRowCount(page) - 1;
+        emit model->dataChanged(model->index(first, 0), model->index(last, model->columnCount() - 1));
+    }, [model, requestGeneration, page](const QString& message) {
+        if (requestGeneration == model->generation) model->loadingPages.erase(page);
+        emit model->error(message);
+    });
+}
 
-    emit txDeleted();
+QVariant TxModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < columns.size())
+    {
+        return columns[section];
+    }
+
+    return QAbstractTableModel::headerData(section, orientation, role);
 }
 
 QVariant TxModel::data(const QModelIndex& index, int role) const
 {
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant();
+
     // Right-align numeric fields
     if (role == Qt::TextAlignmentRole && index.column() >= 3 && index.column() <= 6)
     {
         return Qt::AlignRight;
     }
+
+    if (role != Qt::DisplayRole && role != Qt::EditRole && role != Qt::BackgroundRole) return QVariant();
+
+    // Evicted rows are blank until their page comes back from the vault.
+    const Row* pRow = findRow(index.row());
+    if (!pRow)
+    {
+        requestPage(confirmedRows.pageIndex(index.row() - pendingRows.size()));
+        return QVariant();
+    }
+
+    const Row& row = *pRow;
+    if (role == Qt::DisplayRole || role == Qt::EditRole)
+    {
+        switch (index.column())
+        {
+        case 0: {
+            QDateTime utc;
+            utc.setTime_t(row.timestamp);
+            return utc.toLocalTime().toString();
+        }
+
+        case 1:
+            return QString::fromStdString(row.label);
+
+        case 2:
+            switch (row.type)
+            {
+            case NONE:      return tr("None");
+            case SEND:      return tr("Send");
+            case RECEIVE:   return tr("Receive");
+            default:        return tr("Unknown");
+            }
+
+        case 3: {
+            QString amount;
+            if (row.type == SEND)           { amount = "-"; }
+            else if (row.type == RECEIVE)   { amount = "+"; }
+            //amount += QString::number(row.value/(1.0 * currency_divisor), 'g', 8);
+            return amount + getFormattedCurrencyAmount(row.value);
+        }
+
+        case 4:
+            switch (row.feeDisplay)
+            {
+            case FEE:           return QString("-") + getFormattedCurrencyAmount(row.fee);
+            case SAME_TX_FEE:   return QString("||");
+            default:            return QString();
+            }
+
+        case 5:
+            return getFormattedCurrencyAmount(row.balance);
+
+        case 6:
+            if (row.status >= Tx::PROPAGATED)       return QString::number(getConfirmations(row));
+            else if (row.status == Tx::UNSIGNED)    return tr("Unsigned");
+            else if (row.status == Tx::UNSENT)      return tr("Unsent");
+            return QString();
+
+        case 7:
+            return QString::fromStdString(getAddressForTxOutScript(row.script, base58_versions));
+
+        case 8:
+            return QString::fromStdString(uchar_vector(row.txhash).getHex());
+
+        default:
+            return QVariant();
+        }
+    }
     else if (role == Qt::BackgroundRole)
     {
         QBrush brush;
 
-        int txStatus = getTxStatus(index.row());
-        int txOutType = getTxOutType(index.row());
+        int txStatus = row.status;
+        int txOutType = row.type;
 
         if (txStatus == Tx::UNSIGNED && txOutType == SEND)
         {
@@ -450,7 +1052,7 @@ QVariant TxModel::data(const QModelIndex& index, int role) const
 
             if (txStatus >= Tx::CONFIRMED)
             {
-                switch (getTxConfirmations(index.row()))
+                switch (getConfirmations(row))
                 {
                 case 0:
                     brush.setStyle(Qt::Dense6Pattern); // this should never happen - case 0 is unconfirmed. Just here to be safe.
@@ -477,7 +1079,7 @@ QVariant TxModel::data(const QModelIndex& index, int role) const
             else if (txStatus == Tx::PROPAGATED)
             {
                 brush.setStyle(Qt::Dense6Pattern);
-            } 
+            }
             else if (txStatus == Tx::UNSENT)
             {
                 brush.setStyle(Qt::Dense7Pattern);
@@ -490,8 +1092,8 @@ QVariant TxModel::data(const QModelIndex& index, int role) const
             return brush;
         }
     }
- 
-    return QStandardItemModel::data(index, role);
+
+    return QVariant();
 }
 
 bool TxModel::setData(const QModelIndex& index, const QVariant& value, int role)
@@ -500,38 +1102,35 @@ bool TxModel::setData(const QModelIndex& index, const QVariant& value, int role)
         if (index.column() == 1) {
             // Keychain name edited.
             if (!vault) return false;
- 
-            try {
-                // Get account role (sender/receiver)
-                QStandardItem* typeItem = item(index.row(), 2);
-                int txtype = typeItem->data(Qt::UserRole).toInt();                
-                if (txtype != SEND && txtype != RECEIVE) return false;
-
-                // Get outpoint information
-                QStandardItem* txHashItem = item(index.row(), 8);
-                uchar_vector txhash;
-                txhash.setHex(txHashItem->text().toStdString());
-                uint32_t txindex = (uint32_t)txHashItem->data(Qt::UserRole).toInt();
-
-                if (txtype == SEND)
-                {
-                    vault->setSendingLabel(txhash, txindex, value.toString().toStdString());
-                }
-                else
-                {
-                    vault->setReceivingLabel(txhash, txindex, value.toString().toStdString());
-                }
 
-                setItem(index.row(), index.column(), new QStandardItem(value.toString()));
+            // Get account role (sender/receiver)
+            const Row* pRow = findRow(index.row());
+            if (!pRow || (pRow->type != SEND && pRow->type != RECEIVE)) return false;
+
+            Row& row = const_cast<Row&>(*pRow);
+            row.label = value.toString().toStdString();
+            emit dataChanged(index, index);
+
+            // Evicted pages are reloaded from the vault and pick up the new label there.
+            bytes_t txhash = row.txhash;
+            uint32_t txindex = row.txindex;
+            bool sending = row.type == SEND;
+            std::string label = row.label;
+            vaultService->post<bool>(this, [=](Vault* vault) {
+                if (!vault) throw std::runtime_error("Vault is not open.");
+
+                if (sending)    { vault->setSendingLabel(txhash, txindex, label); }
+                else            { vault->setReceivingLabel(txhash, txindex, label); }
                 return true;
-            }
-            catch (const std::exception& e) {
-                emit error(QString::fromStdString(e.what()));
-            }
+            }, [](bool&) { }, [this](const QString& message) {
+                emit error(message);
+                update();
+            });
+            return true;
         }
         return false;
     }
- 
+
     return true;
 }
 
@@ -540,7 +1139,6 @@ Qt::ItemFlags TxModel::flags(const QModelIndex& index) const
     if (index.column() == 1) {
         return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable;
     }
- 
+
     return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
 }
-
@@ -13,24 +13,35 @@
 
 #pragma once
 
-#include <QStandardItemModel>
+#include <QAbstractTableModel>
+#include <QStringList>
 
 #include <CoinDB/Vault.h>
 
+#include "pagedrowcache.h"
+
+#include <functional>
+#include <set>
+
 namespace CoinDB
 {
     class SynchedVault;
 }
 
-class TxModel : public QStandardItemModel
+class VaultService;
+
+// Pending txs are few and are kept in memory, sorted by status. Confirmed history is fetched from
+// the vault in pages as the view scrolls, newest first, and only a window of it is kept in memory.
+// All reads go through the vault service, so rows appear once their page has been delivered.
+class TxModel : public QAbstractTableModel
 {
     Q_OBJECT
 
 public:
     enum TxType { NONE, SEND, RECEIVE, UNKNOWN };
 
-    TxModel(QObject* parent = nullptr);
-    TxModel(CoinDB::Vault* vault, const QString& accountName, QObject* parent = nullptr);
+    TxModel(VaultService* vaultService, QObject* parent = nullptr);
+    TxModel(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, QObject* parent = nullptr);
 
     void setBase58Versions();
 
@@ -38,6 +49,7 @@ public:
     CoinDB::Vault* getVault() const { return vault; }
     void setAccount(const QString& accountName);
     void update();
+    void setBestHeight(uint32_t bestHeight);
 
     bytes_t getTxHash(int row) const;
     int getTxStatus(int row) const;
@@ -45,17 +57,38 @@ public:
     int getTxOutType(int row) const;
     QString getTxOutAddress(int row) const;
 
-    void signTx(int row);
-    void sendTx(int row, CoinDB::SynchedVault* synchedVault);
-    std::shared_ptr<CoinDB::Tx> getTx(int row);
-    void deleteTx(int row);
+    // False while the row's page is being reloaded from the vault.
+    bool isRowLoaded(int row) const { return findRow(row) != nullptr; }
+
+    // Looks for the first row whose tx hash starts with hashPrefix, fetching history as needed.
+    // Emits txFound with the row, or -1 if there is none.
+    void findTxRow(const QString& hashPrefix);
+
+    // These run on the vault service's worker. Callbacks are called on the GUI thread once the vault
+    // work has finished, and failures are reported through error() instead.
+    void signTx(int row, std::function<void()> callback = nullptr);
+    void sendTx(int row, CoinDB::SynchedVault* synchedVault, std::function<void()> callback = nullptr);
+    void getTx(int row, std::function<void(std::shared_ptr<CoinDB::Tx>)> callback);
+    void deleteTx(int row, std::function<void()> callback = nullptr);
 
     // Overridden methods
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
     bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole);
     Qt::ItemFlags flags(const QModelIndex& index) const;
- 
+    bool canFetchMore(const QModelIndex& parent) const;
+    void fetchMore(const QModelIndex& parent);
+
+public slots:
+    // Incremental updates from vault tx signals - only the rows of the given tx are touched.
+    void updateTx(std::shared_ptr<CoinDB::Tx> tx);
+    void removeTx(std::shared_ptr<CoinDB::Tx> tx);
+
 signals:
+    void updated();
+    void txFound(int row);
     void txSigned(const QString& keychainNames);
     void txDeleted();
     void error(const QString& message);
@@ -63,12 +96,97 @@ signals:
 private:
     unsigned char base58_versions[2];
     QString currencySymbol;
+    QStringList columns;
 
     void setColumns();
 
+    enum FeeDisplay { NO_FEE, FEE, SAME_TX_FEE };
+
+    struct Row
+    {
+        uint32_t timestamp;
+        std::string label;
+        TxType type;
+        uint64_t value;
+        uint64_t fee;
+        FeeDisplay feeDisplay;
+        int64_t netValue;   // change to the account balance, including the fee
+        int64_t balance;    // account balance after this row
+        int status;
+        uint32_t height;    // zero unless propagated and in a block
+        bytes_t script;
+        bytes_t txhash;     // unsigned hash for unsigned txs
+        bytes_t unsignedHash;
+        uint32_t txindex;
+    };
+
+    // State needed to reload a page of confirmed history on its own.
+    struct PageCursor
+    {
+        PageCursor() : balance(0) { }
+
+        CoinDB::HistoryCursor history;
+        bytes_t feeTxHash;
+        int64_t balance;
+    };
+
+    struct Page
+    {
+        Page() : firstRow(0), rowCount(0), atEnd(true) { }
+
+        int firstRow;
+        int rowCount;
+        std::vector<Row> rows; // may be left empty for pages that are only indexed
+        PageCursor next;
+        bool atEnd;
+    };
+
+    struct SearchResult
+    {
+        int row;
+        int knownPage;              // index of the already indexed page holding row, or -1
+        std::vector<Page> pages;    // the matching known page, or pages following those already fetched
+    };
+
+    struct Snapshot
+    {
+        uint32_t bestHeight;
+        int64_t accountBalance;
+        std::vector<Row> pendingRows;
+        Page firstPage;
+    };
+
+    // These run on the vault service thread and must not touch the model.
+    static bool rowLessThan(const Row& a, const Row& b);
+    static Row createRow(const CoinDB::TxOutView& view, bytes_t& last_txhash);
+    static std::vector<Row> loadPage(CoinDB::Vault* vault, const std::string& accountName, PageCursor& cursor, bool& atEnd, unsigned int count);
+    static int64_t updatePendingBalances(std::vector<Row>& rows, int64_t accountBalance);
+
+    std::vector<CoinDB::TxOutView> getTxOutViews(std::shared_ptr<CoinDB::Tx> tx) const;
+
+    const Row& getRow(int row) const;
+    const Row* findRow(int row) const;
+    void requestPage(std::size_t page) const;
+    void appendPage(Page& page);
+    int getConfirmations(const Row& row) const;
+
+    bool removePendingRows(const bytes_t& unsigned_hash);
+    bool insertConfirmedRows(std::vector<Row>& rows);
+    bool removeConfirmedRows(const bytes_t& unsigned_hash);
+    void updateBalances();
+
+    VaultService* vaultService;
     CoinDB::Vault* vault;
     QString accountName; // empty when not loaded
-    uint64_t confirmedBalance;
-    uint64_t pendingBalance;
-};
+    uint32_t bestHeight;
 
+    std::vector<Row> pendingRows;
+    PagedRowCache<PageCursor, Row> confirmedRows;
+    int64_t accountBalance;
+    int64_t confirmedBalance;
+
+    // Bumped whenever the rows are reset so results of older requests are dropped.
+    uint64_t generation;
+    bool fetching;
+    mutable std::set<std::size_t> loadingPages;
+};
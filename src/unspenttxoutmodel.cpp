@@ -16,19 +16,20 @@
 #include <CoinQ/CoinQ_script.h>
 #include <CoinQ/CoinQ_netsync.h>
 
-#include <QStandardItemModel>
-
 #include "settings.h"
 #include "coinparams.h"
 
 #include "severitylogger.h"
+#include "vaultservice.h"
 
 using namespace CoinDB;
 using namespace CoinQ::Script;
 using namespace std;
 
-UnspentTxOutModel::UnspentTxOutModel(QObject* parent)
-    : QStandardItemModel(parent)
+const unsigned int UNSPENT_PAGE_SIZE = 1000;
+
+UnspentTxOutModel::UnspentTxOutModel(VaultService* vaultService, QObject* parent)
+    : QAbstractTableModel(parent), vaultService(vaultService), vault(nullptr), bestHeight(0), generation(0), fetching(false)
 {
     base58_versions[0] = getCoinParams().pay_to_pubkey_hash_version();
     base58_versions[1] = getCoinParams().pay_to_script_hash_version();
@@ -39,8 +40,8 @@ UnspentTxOutModel::UnspentTxOutModel(QObject* parent)
     initColumns();
 }
 
-UnspentTxOutModel::UnspentTxOutModel(CoinDB::Vault* vault, const QString& accountName, QObject* parent)
-    : QStandardItemModel(parent)
+UnspentTxOutModel::UnspentTxOutModel(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, QObject* parent)
+    : QAbstractTableModel(parent), vaultService(vaultService), vault(nullptr), bestHeight(0), generation(0), fetching(false)
 {
     base58_versions[0] = getCoinParams().pay_to_pubkey_hash_version();
     base58_versions[1] = getCoinParams().pay_to_script_hash_version();
@@ -55,9 +56,8 @@ UnspentTxOutModel::UnspentTxOutModel(CoinDB::Vault* vault, const QString& accoun
 
 void UnspentTxOutModel::initColumns()
 {
-    QStringList columns;
+    columns.clear();
     columns << (tr("Amount") + " (" + getCurrencySymbol() + ")") << tr("Address") << tr("Confirmations");
-    setHorizontalHeaderLabels(columns);
 }
 
 void UnspentTxOutModel::setVault(CoinDB::Vault* vault)
@@ -70,59 +70,213 @@ void UnspentTxOutModel::setAccount(const QString& accountName)
 {
     if (!vault) throw std::runtime_error("Vault is not open.");
 
-    if (!vault->accountExists(accountName.toStdString()))
-        throw std::runtime_error("Account not found.");
-
     this->accountName = accountName;
 }
 
+UnspentTxOutModel::Page UnspentTxOutModel::loadPage(Vault* vault, const std::string& accountName, const UnspentCursor& start)
+{
+    if (!vault) throw std::runtime_error("Vault is not open.");
+
+    Page page;
+    page.bestHeight = vault->getBestHeight();
+    page.next = start;
+    unsigned int n = vault->getUnspentTxOutViews(page.next, [&](const TxOutView& view) {
+        Row row;
+        row.id = view.id;
+        row.value = view.value;
+        row.script = view.script;
+        row.height = view.height;
+        page.rows.push_back(row);
+        return true;
+    }, accountName, 0, UNSPENT_PAGE_SIZE);
+    page.atEnd = n < UNSPENT_PAGE_SIZE;
+    return page;
+}
+
 void UnspentTxOutModel::update()
 {
-    removeRows(0, rowCount());
+    uint64_t requestGeneration = ++generation;
+    fetching = false;
+    loadingPages.clear();
+
+    if (!vault || accountName.isEmpty())
+    {
+        beginResetModel();
+        rows.clear();
+        keys.clear();
+        endResetModel();
+        emit updated();
+        return;
+    }
+
+    std::string account_name = accountName.toStdString();
+    vaultService->post<Page>(this, [account_name](Vault* vault) {
+        if (vault && !vault->accountExists(account_name)) throw std::runtime_error("Account not found.");
+        return loadPage(vault, account_name, UnspentCursor());
+    }, [this, requestGeneration](Page& page) {
+        if (requestGeneration != generation) return;
+
+        beginResetModel();
+        rows.reset();
+        keys.clear();
+        appendPage(page);
+        endResetModel();
+
+        emit updated();
+    }, [this](const QString& message) {
+        emit error(message);
+    });
+}
+
+void UnspentTxOutModel::appendPage(Page& page)
+{
+    bestHeight = page.bestHeight;
+    for (auto& row: page.rows) { keys.push_back(Key{row.id, row.value}); }
+    rows.appendPage(std::move(page.rows), page.next, page.atEnd);
+}
+
+void UnspentTxOutModel::requestPage(std::size_t page) const
+{
+    if (!loadingPages.insert(page).second) return;
+
+    UnspentTxOutModel* model = const_cast<UnspentTxOutModel*>(this);
+    uint64_t requestGeneration = generation;
+    std::string account_name = accountName.toStdString();
+    UnspentCursor start = rows.pageStart(page);
+    vaultService->post<Page>(model, [account_name, start](Vault* vault) {
+        return loadPage(vault, account_name, start);
+    }, [model, requestGeneration, page](Page& result) {
+        if (requestGeneration != model->generation) return;
+
+        model->loadingPages.erase(page);
+        model->rows.restorePage(page, std::move(result.rows));
+
+        int first = model->rows.pageFirstRow(page);
+        int last = first + model->rows.pageRowCount(page) - 1;
+        emit model->dataChanged(model->index(first, 0), model->index(last, model->columnCount() - 1));
+    }, [model, requestGeneration, page](const QString& message) {
+        if (requestGeneration == model->generation) model->loadingPages.erase(page);
+        emit model->error(message);
+    });
+}
+
+const UnspentTxOutModel::Key& UnspentTxOutModel::getKey(int row) const
+{
+    if (row < 0 || row >= (int)keys.size()) throw std::runtime_error(tr("Invalid row.").toStdString());
+    return keys[row];
+}
 
-    if (!vault || accountName.isEmpty()) return;
+unsigned long UnspentTxOutModel::getTxOutId(int row) const
+{
+    return getKey(row).id;
+}
 
-    uint32_t bestHeight = vault->getBestHeight();
+uint64_t UnspentTxOutModel::getValue(int row) const
+{
+    return getKey(row).value;
+}
 
-    std::vector<TxOutView> txoutviews = vault->getUnspentTxOutViews(accountName.toStdString());
-    for (auto& item: txoutviews) {
-        QList<QStandardItem*> row;
+int UnspentTxOutModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return rows.rowCount();
+}
 
-        //QString amount(QString::number(item.value/(1.0 * currency_divisor), 'g', 8));
-        QString amount(getFormattedCurrencyAmount(item.value));
-        QStandardItem* amountItem = new QStandardItem(amount);
-        std::stringstream strAmount;
-        strAmount << item.value;
-        amountItem->setData(QString::fromStdString(strAmount.str()), Qt::UserRole);
+int UnspentTxOutModel::columnCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return 0;
+    return columns.size();
+}
+
+bool UnspentTxOutModel::canFetchMore(const QModelIndex& parent) const
+{
+    if (parent.isValid()) return false;
+    return rows.canFetchMore();
+}
 
-        QString address(QString::fromStdString(getAddressForTxOutScript(item.script, base58_versions)));
-        QStandardItem* addressItem = new QStandardItem(address);
-        addressItem->setData((int)item.id, Qt::UserRole);
+void UnspentTxOutModel::fetchMore(const QModelIndex& parent)
+{
+    if (parent.isValid() || !rows.canFetchMore() || fetching) return;
 
-        uint32_t nConfirmations = 0;
-        if (bestHeight && item.height) { nConfirmations = bestHeight + 1 - item.height; }
-        QString confirmations(QString::number(nConfirmations));
+    fetching = true;
+    uint64_t requestGeneration = generation;
+    int firstRow = rows.rowCount();
+    std::string account_name = accountName.toStdString();
+    UnspentCursor start = rows.nextCursor();
+    vaultService->post<Page>(this, [account_name, start](Vault* vault) {
+        return loadPage(vault, account_name, start);
+    }, [this, requestGeneration, firstRow](Page& page) {
+        if (requestGeneration != generation) return;
 
-        row.append(amountItem);
-        row.append(addressItem);
-        row.append(new QStandardItem(confirmations));
-        appendRow(row);
+        fetching = false;
+        if (page.rows.empty())
+        {
+            // Nothing more to fetch.
+            appendPage(page);
+            return;
+        }
+
+        beginInsertRows(QModelIndex(), firstRow, firstRow + page.rows.size() - 1);
+        appendPage(page);
+        endInsertRows();
+    }, [this, requestGeneration](const QString& message) {
+        if (requestGeneration == generation) fetching = false;
+        emit error(message);
+    });
+}
+
+QVariant UnspentTxOutModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < columns.size())
+    {
+        return columns[section];
     }
+
+    return QAbstractTableModel::headerData(section, orientation, role);
 }
 
 QVariant UnspentTxOutModel::data(const QModelIndex& index, int role) const
 {
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant();
+
     // Right-align numeric fields
     if (role == Qt::TextAlignmentRole) {// && index.column() >= 3 && index.column() <= 6) {
         return Qt::AlignRight;
     }
-    else {
-        return QStandardItemModel::data(index, role);
+    else if (role == Qt::DisplayRole) {
+        // Evicted rows are blank until their page comes back from the vault.
+        const Row* pRow = rows.row(index.row());
+        if (!pRow)
+        {
+            requestPage(rows.pageIndex(index.row()));
+            return QVariant();
+        }
+
+        const Row& row = *pRow;
+        switch (index.column())
+        {
+        case 0:
+            //return QString::number(row.value/(1.0 * currency_divisor), 'g', 8);
+            return getFormattedCurrencyAmount(row.value);
+
+        case 1:
+            return QString::fromStdString(getAddressForTxOutScript(row.script, base58_versions));
+
+        case 2: {
+            uint32_t nConfirmations = 0;
+            if (bestHeight && row.height) { nConfirmations = bestHeight + 1 - row.height; }
+            return QString::number(nConfirmations);
+        }
+
+        default:
+            return QVariant();
+        }
     }
+
+    return QVariant();
 }
 
 Qt::ItemFlags UnspentTxOutModel::flags(const QModelIndex& /*index*/) const
 {
     return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
 }
-
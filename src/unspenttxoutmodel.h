@@ -13,39 +13,99 @@
 
 #pragma once
 
-#include <QStandardItemModel>
+#include <QAbstractTableModel>
+#include <QStringList>
 
 #include <CoinDB/Vault.h>
 
-class UnspentTxOutModel : public QStandardItemModel
+#include "pagedrowcache.h"
+
+#include <set>
+
+class VaultService;
+
+// Unspent outputs are fetched from the vault in pages, largest first, as the view scrolls. Reads go
+// through the vault service. Ids and values are kept for every fetched row so selections can be
+// totalled even after their pages have been evicted.
+class UnspentTxOutModel : public QAbstractTableModel
 {
     Q_OBJECT
 
 public:
-    UnspentTxOutModel(QObject* parent = nullptr);
-    UnspentTxOutModel(CoinDB::Vault* vault, const QString& accountName, QObject* parent = nullptr);
+    UnspentTxOutModel(VaultService* vaultService, QObject* parent = nullptr);
+    UnspentTxOutModel(VaultService* vaultService, CoinDB::Vault* vault, const QString& accountName, QObject* parent = nullptr);
 
     void setVault(CoinDB::Vault* vault);
     void setAccount(const QString& accountName);
     void update();
 
+    unsigned long getTxOutId(int row) const;
+    uint64_t getValue(int row) const;
+
     // Overridden methods
+    int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const;
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
     Qt::ItemFlags flags(const QModelIndex& index) const;
+    bool canFetchMore(const QModelIndex& parent) const;
+    void fetchMore(const QModelIndex& parent);
 
     //uint64_t getCurrencyDivisor() const { return currency_divisor; }
     //const char* getCurrencySymbol() const { return currency_symbol; }
 
 signals:
+    void updated();
+    void error(const QString& message);
 
 private:
     unsigned char base58_versions[2];
     //uint64_t currency_divisor;
     //const char* currency_symbol;
 
+    QStringList columns;
     void initColumns();
 
+    struct Row
+    {
+        unsigned long id;
+        uint64_t value;
+        bytes_t script;
+        uint32_t height;
+    };
+
+    struct Key
+    {
+        unsigned long id;
+        uint64_t value;
+    };
+
+    struct Page
+    {
+        uint32_t bestHeight;
+        std::vector<Row> rows;
+        CoinDB::UnspentCursor next;
+        bool atEnd;
+    };
+
+    // Runs on the vault service thread.
+    static Page loadPage(CoinDB::Vault* vault, const std::string& accountName, const CoinDB::UnspentCursor& start);
+
+    const Key& getKey(int row) const;
+    void appendPage(Page& page);
+    void requestPage(std::size_t page) const;
+
+    VaultService* vaultService;
     CoinDB::Vault* vault;
     QString accountName; // empty when not loaded
+    uint32_t bestHeight;
+
+    PagedRowCache<CoinDB::UnspentCursor, Row> rows;
+    std::vector<Key> keys;
+
+    // Bumped whenever the rows are reset so results of older requests are dropped.
+    uint64_t generation;
+    bool fetching;
+    mutable std::set<std::size_t> loadingPages;
 };
 
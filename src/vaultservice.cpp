@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// mSIGNA
+//
+// vaultservice.cpp
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#include "vaultservice.h"
+
+#include "severitylogger.h"
+
+VaultService::VaultService(QObject* parent)
+    : QObject(parent), vault(nullptr), running(false), stopping(false)
+{
+    qRegisterMetaType<VaultServiceDelivery>("VaultServiceDelivery");
+    connect(this, &VaultService::delivery, this, &VaultService::deliver, Qt::QueuedConnection);
+
+    worker = boost::thread(&VaultService::processJobs, this);
+}
+
+VaultService::~VaultService()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    cond.notify_all();
+    worker.join();
+}
+
+void VaultService::setVault(CoinDB::Vault* vault)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (running) { cond.wait(lock); }
+    this->vault = vault;
+}
+
+std::size_t VaultService::pendingJobs() const
+{
+    boost::lock_guard<boost::mutex> lock(mutex);
+    return jobs.size() + (running ? 1 : 0);
+}
+
+void VaultService::enqueue(job_t run, error_handler_t fail)
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex);
+        if (stopping) return;
+        Job job;
+        job.run = run;
+        job.fail = fail;
+        jobs.push_back(job);
+    }
+    cond.notify_all();
+}
+
+void VaultService::deliver(VaultServiceDelivery delivery)
+{
+    if (delivery) delivery();
+}
+
+void VaultService::reportError(const QString& message, std::function<void(const QString&)> onError)
+{
+    if (onError)
+    {
+        onError(message);
+    }
+    else
+    {
+        LOGGER(error) << "VaultService - " << message.toStdString() << std::endl;
+        emit error(message);
+    }
+}
+
+void VaultService::processJobs()
+{
+    while (true)
+    {
+        Job job;
+        CoinDB::Vault* currentVault;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (jobs.empty() && !stopping) { cond.wait(lock); }
+            if (stopping) return;
+
+            job = jobs.front();
+            jobs.pop_front();
+            currentVault = vault;
+            running = true;
+        }
+
+        VaultServiceDelivery result;
+        try
+        {
+            result = job.run(currentVault);
+        }
+        catch (const std::exception& e)
+        {
+            result = job.fail(QString::fromStdString(e.what()));
+        }
+        catch (...)
+        {
+            result = job.fail(tr("Unknown vault error."));
+        }
+
+        {
+            boost::lock_guard<boost::mutex> lock(mutex);
+            running = false;
+        }
+        cond.notify_all();
+
+        if (result) emit delivery(result);
+    }
+}
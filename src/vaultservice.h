@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// mSIGNA
+//
+// vaultservice.h
+//
+// Copyright (c) 2011-2016 Ciphrex Corp.
+//
+// Distributed under the MIT software license, see the accompanying
+// file LICENSE or http://www.opensource.org/licenses/mit-license.php.
+//
+
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+#include <boost/thread.hpp>
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace CoinDB
+{
+    class Vault;
+}
+
+typedef std::function<void()> VaultServiceDelivery;
+Q_DECLARE_METATYPE(VaultServiceDelivery)
+
+// Runs vault queries on a dedicated worker thread so the GUI thread never waits on SQLite or on the
+// vault mutex. Jobs run one at a time in the order they were posted. Results are handed back on the
+// thread that owns the service through a queued signal.
+class VaultService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VaultService(QObject* parent = nullptr);
+    ~VaultService();
+
+    // Waits for a running job to finish, so the old vault can be closed as soon as this returns.
+    // Jobs that have not started yet see the new vault.
+    void setVault(CoinDB::Vault* vault);
+
+    // Runs query on the worker thread and calls callback with its result on the service's thread.
+    // Nothing is delivered if context has been destroyed by then. Exceptions thrown by the query are
+    // passed to onError instead, or logged if there is none. The query gets a null vault if none is open.
+    template<typename Result>
+    void post(QObject* context, std::function<Result(CoinDB::Vault*)> query, std::function<void(Result&)> callback, std::function<void(const QString&)> onError = nullptr)
+    {
+        QPointer<QObject> guard(context);
+        std::shared_ptr<Result> result = std::make_shared<Result>();
+        enqueue([=](CoinDB::Vault* vault) {
+            *result = query(vault);
+            return VaultServiceDelivery([=]() { if (guard) callback(*result); });
+        }, [=](const QString& message) {
+            return VaultServiceDelivery([=]() { if (guard) reportError(message, onError); });
+        });
+    }
+
+    // Runs query on the worker thread. Waiting on the future from the GUI thread defeats the purpose -
+    // this is meant for other worker code and tests.
+    template<typename Result>
+    std::future<Result> submit(std::function<Result(CoinDB::Vault*)> query)
+    {
+        std::shared_ptr<std::promise<Result>> promise = std::make_shared<std::promise<Result>>();
+        enqueue([=](CoinDB::Vault* vault) {
+            promise->set_value(query(vault));
+            return VaultServiceDelivery();
+        }, [=](const QString&) {
+            promise->set_exception(std::current_exception());
+            return VaultServiceDelivery();
+        });
+        return promise->get_future();
+    }
+
+    std::size_t pendingJobs() const;
+
+signals:
+    void delivery(VaultServiceDelivery delivery);
+    void error(const QString& message);
+
+private slots:
+    void deliver(VaultServiceDelivery delivery);
+
+private:
+    typedef std::function<VaultServiceDelivery(CoinDB::Vault*)> job_t;
+    typedef std::function<VaultServiceDelivery(const QString&)> error_handler_t;
+
+    struct Job
+    {
+        job_t run;
+        error_handler_t fail;
+    };
+
+    void enqueue(job_t run, error_handler_t fail);
+    void reportError(const QString& message, std::function<void(const QString&)> onError);
+    void processJobs();
+
+    mutable boost::mutex mutex;
+    boost::condition_variable cond;
+    std::deque<Job> jobs;
+    CoinDB::Vault* vault;
+    bool running;
+    bool stopping;
+    boost::thread worker;
+};
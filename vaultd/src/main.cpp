@@ -20,11 +20,11 @@
 #include <random.h>
 
 #include <logger.h>
+#include <stdutils/metrics.h>
 
 #include <Base58Check.h>
 
-#include <thread>
-#include <chrono>
+#include <boost/asio.hpp>
 
 #include <iostream>
 #include <sstream>
@@ -39,13 +39,8 @@ using namespace CoinDB;
 
 const string WS_PORT = "12345";
 
-bool g_bShutdown = false;
-
-void finish(int sig)
-{
-    LOGGER(debug) << "Stopping..." << endl;
-    g_bShutdown = true;
-}
+// Delivers SIGINT and SIGTERM. main() runs it while the server is up and returns when it stops.
+boost::asio::io_service g_shutdownService;
 
 // Global operations
 cli::result_t cmd_create(const cli::params_t& params)
@@ -426,12 +421,13 @@ cli::result_t cmd_history(const cli::params_t& params)
     
     Vault vault(params[0], false);
     uint32_t best_height = vault.getBestHeight();
-    vector<TxOutView> txOutViews = vault.getTxOutViews(account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
-    stringstream ss;
-    ss << formattedTxOutViewHeader();
-    for (auto& txOutView: txOutViews)
-        ss << endl << formattedTxOutView(txOutView, best_height);
-    return ss.str();
+    cout << formattedTxOutViewHeader();
+    HistoryCursor cursor;
+    vault.getTxOutViews(cursor, [&](const TxOutView& txOutView) {
+        cout << '\n' << formattedTxOutView(txOutView, best_height);
+        return true;
+    }, account_name, bin_name, TxOut::ROLE_BOTH, TxOut::BOTH, Tx::ALL, hide_change);
+    return "";
 }
 
 cli::result_t cmd_refillaccountpool(const cli::params_t& params)
@@ -734,6 +730,11 @@ cli::result_t cmd_randombytes(const cli::params_t& params)
     return bytes.getHex();
 }
 
+cli::result_t cmd_metrics(const cli::params_t& params)
+{
+    return stdutils::metrics::get_registry().report();
+}
+
 // WebSocket callbacks
 void openCallback(WebSocket::Server& server, websocketpp::connection_hdl hdl)
 {
@@ -772,7 +773,11 @@ int main(int argc, char* argv[])
 {
     INIT_LOGGER("vaultd.log");
 
-    signal(SIGINT, &finish);
+    boost::asio::signal_set signals(g_shutdownService, SIGINT, SIGTERM);
+    signals.async_wait([](const boost::system::error_code& ec, int /*sig*/)
+    {
+        if (!ec) { LOGGER(debug) << "Stopping..." << endl; }
+    });
 
     // Global operations
     shell.add(command(&cmd_create, "create", "create a new vault", command::params(1, "db file")));
@@ -829,6 +834,7 @@ int main(int argc, char* argv[])
 
     // Miscellaneous
     shell.add(command(&cmd_randombytes, "randombytes", "output random bytes in hex", command::params(1, "length")));
+    shell.add(command(&cmd_metrics, "metrics", "display counters and latencies (in microseconds) since the daemon started"));
 
     WebSocket::Server wsServer(WS_PORT);
     wsServer.setOpenCallback(&openCallback);
@@ -847,7 +853,7 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    while (!g_bShutdown) { std::this_thread::sleep_for(std::chrono::microseconds(200)); }
+    g_shutdownService.run();
 
     try
     {